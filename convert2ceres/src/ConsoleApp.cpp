@@ -13,6 +13,7 @@
 #include <iostream>
 #include <mutex>
 #include <numbers>
+#include <algorithm>
 
 
 std::mutex g_console_mutex;
@@ -58,7 +59,7 @@ int main(int argc, char** argv)
 		("Show usage information.")
 		| lyra::opt(num_of_threads, "threads")
 		["-t"]["--threads"]
-		("The number of threads to use for repairing data files.")
+		("The number of files to convert at the same time.  Each conversion uses a reader and a writer thread.")
 		.optional()
 		| lyra::arg(input_directory, "input directory")
 		("The path to input directory for converting data to a ceres file(s).")
@@ -125,6 +126,11 @@ int main(int argc, char** argv)
 
 	}
 
+	// Start the largest files first so that a long conversion does not end up
+	// running by itself after all of the other threads have finished.
+	std::sort(lidar_data_files_to_process.begin(), lidar_data_files_to_process.end(),
+		[](const directory_entry& a, const directory_entry& b) { return a.file_size() > b.file_size(); });
+
 	int max_threads = std::thread::hardware_concurrency();
 
 	num_of_threads = std::max(num_of_threads, 0);
@@ -3,6 +3,9 @@
 #include "bdf_v1/BlockDataFileExceptions.hpp"
 
 #include <iostream>
+#include <thread>
+#include <memory>
+#include <vector>
 
 
 extern void console_message(const std::string& msg);
@@ -11,10 +14,17 @@ extern void update_file_progress(const int id, const int progress_pct);
 extern void complete_file_progress(const int id);
 
 
+namespace
+{
+    /// The number of decoded blocks the reader stage may run ahead of the writer
+    const std::size_t WRITE_QUEUE_DEPTH = 64;
+}
+
+
 cLidarData2CeresConverter::cLidarData2CeresConverter(int id, std::filesystem::directory_entry in,
     std::filesystem::path out)
 :
-    cFileProcessor(id), mInputFile(in), mOutputFile(out)
+    cFileProcessor(id), mInputFile(in), mOutputFile(out), mWriteQueue(WRITE_QUEUE_DEPTH)
 {
     mOusterSerializer.setVersion(2, 3);
     mOusterSerializer.setBufferCapacity(256*1024*1024);
@@ -85,15 +95,65 @@ void cLidarData2CeresConverter::convert()
     mExperimentSerializer.writeBeginHeader();
     mExperimentSerializer.writeEndOfHeader();
 
+    // The v1 blocks are read and decoded on their own thread while this
+    // thread serializes and writes the ceres blocks in the original order.
+    std::thread reader(&cLidarData2CeresConverter::readBlocks, this);
+
+    try
+    {
+        write_task_t task;
+        while (mWriteQueue.pop(task))
+        {
+            task();
+        }
+    }
+    catch (const std::exception& e)
+    {
+        // Stop the reader stage before reporting the error
+        mWriteQueue.close();
+        reader.join();
+
+        std::string msg = "Unknown Exception: ";
+        msg += e.what();
+        console_message(msg);
+        return;
+    }
+
+    reader.join();
+
+    if (mReadFailed)
+    {
+        if (!mReadError.empty())
+        {
+            console_message(mReadError);
+            return;
+        }
+
+        mFileReader.close();
+        mFileWriter.close();
+        return;
+    }
+
+    mExperimentSerializer.writeBeginFooter();
+    mExperimentSerializer.writeEndOfFooter();
+
+    complete_file_progress(mID);
+}
+
+void cLidarData2CeresConverter::readBlocks()
+{
     try
     {
         while (!mFileReader.eof())
         {
+            // The writer stage has given up
+            if (mWriteQueue.closed())
+                break;
+
             if (mFileReader.fail())
             {
-                mFileReader.close();
-                mFileWriter.close();
-                return;
+                mReadFailed = true;
+                break;
             }
 
             mFileReader.processBlock();
@@ -102,103 +162,102 @@ void cLidarData2CeresConverter::convert()
             file_pos = 100.0 * (file_pos / mFileSize);
             update_file_progress(mID, static_cast<int>(file_pos));
         }
-
-        mExperimentSerializer.writeBeginFooter();
-        mExperimentSerializer.writeEndOfFooter();
     }
     catch (const v1::bdf::stream_error& e)
     {
-        std::string msg = "Stream Error: ";
-        msg += e.what();
-        console_message(msg);
-        return;
+        mReadError = "Stream Error: ";
+        mReadError += e.what();
+        mReadFailed = true;
     }
     catch (const v1::bdf::crc_error& e)
     {
-        std::string msg = "CRC Error: ";
-        msg += e.what();
-        console_message(msg);
-        return;
+        mReadError = "CRC Error: ";
+        mReadError += e.what();
+        mReadFailed = true;
     }
     catch (const std::exception& e)
     {
-        std::string msg = "Unknown Exception: ";
-        msg += e.what();
-        console_message(msg);
-        return;
+        mReadError = "Unknown Exception: ";
+        mReadError += e.what();
+        mReadFailed = true;
     }
 
-    complete_file_progress(mID);
+    mWriteQueue.close();
+}
+
+void cLidarData2CeresConverter::queueWrite(write_task_t task)
+{
+    mWriteQueue.push(std::move(task));
 }
 
 void cLidarData2CeresConverter::onConfigParam(::ouster::config_param_2_t config_param)
 {
-    mOusterSerializer.write(config_param);
+    queueWrite([this, config_param]() { mOusterSerializer.write(config_param); });
 }
 
 void cLidarData2CeresConverter::onSensorInfo(::ouster::sensor_info_2_t sensor_info)
 {
-    mOusterSerializer.write(sensor_info);
+    queueWrite([this, sensor_info]() { mOusterSerializer.write(sensor_info); });
 }
 
 void cLidarData2CeresConverter::onTimestamp(::ouster::timestamp_2_t timestamp)
 {
-    mOusterSerializer.write(timestamp);
+    queueWrite([this, timestamp]() { mOusterSerializer.write(timestamp); });
 }
 
 void cLidarData2CeresConverter::onSyncPulseIn(::ouster::sync_pulse_in_2_t pulse_info)
 {
-    mOusterSerializer.write(pulse_info);
+    queueWrite([this, pulse_info]() { mOusterSerializer.write(pulse_info); });
 }
 
 void cLidarData2CeresConverter::onSyncPulseOut(::ouster::sync_pulse_out_2_t pulse_info)
 {
-    mOusterSerializer.write(pulse_info);
+    queueWrite([this, pulse_info]() { mOusterSerializer.write(pulse_info); });
 }
 
 void cLidarData2CeresConverter::onMultipurposeIo(::ouster::multipurpose_io_2_t io)
 {
-    mOusterSerializer.write(io);
+    queueWrite([this, io]() { mOusterSerializer.write(io); });
 }
 
 void cLidarData2CeresConverter::onNmea(::ouster::nmea_2_t nmea)
 {
-    mOusterSerializer.write(nmea);
+    queueWrite([this, nmea]() { mOusterSerializer.write(nmea); });
 }
 
 void cLidarData2CeresConverter::onTimeInfo(::ouster::time_info_2_t time_info)
 {
-    mOusterSerializer.write(time_info);
+    queueWrite([this, time_info]() { mOusterSerializer.write(time_info); });
 }
 
 void cLidarData2CeresConverter::onBeamIntrinsics(::ouster::beam_intrinsics_2_t intrinsics)
 {
-    mOusterSerializer.write(intrinsics);
+    queueWrite([this, intrinsics]() { mOusterSerializer.write(intrinsics); });
 }
 
 void cLidarData2CeresConverter::onImuIntrinsics(::ouster::imu_intrinsics_2_t intrinsics)
 {
-    mOusterSerializer.write(intrinsics);
+    queueWrite([this, intrinsics]() { mOusterSerializer.write(intrinsics); });
 }
 
 void cLidarData2CeresConverter::onLidarIntrinsics(::ouster::lidar_intrinsics_2_t intrinsics)
 {
-    mOusterSerializer.write(intrinsics);
+    queueWrite([this, intrinsics]() { mOusterSerializer.write(intrinsics); });
 }
 
 void cLidarData2CeresConverter::onLidarDataFormat(::ouster::lidar_data_format_2_t format)
 {
-    mOusterSerializer.write(format);
+    queueWrite([this, format]() { mOusterSerializer.write(format); });
 }
 
 void cLidarData2CeresConverter::onImuData(::ouster::imu_data_t data)
 {
-    mOusterSerializer.write(data);
+    queueWrite([this, data]() { mOusterSerializer.write(data); });
 }
 
 void cLidarData2CeresConverter::onLidarData(cOusterLidarData data)
 {
-    mOusterSerializer.write(data.frame_id(), data);
+    queueWrite([this, data = std::move(data)]() { mOusterSerializer.write(data.frame_id(), data); });
 }
 
 void cLidarData2CeresConverter::onPositionUnits(v1::pvt::ePOSTION_UNITS  positionUnit)
@@ -251,7 +310,7 @@ void cLidarData2CeresConverter::onTimestamp(std::uint64_t timeStamp)
     std::uint64_t timestamp_ns = static_cast<std::uint64_t>(timeStamp * mTimeScaler);
 
     if (timestamp_ns > 0)
-        mExperimentSerializer.heartbeatTimestamp(timestamp_ns);
+        queueWrite([this, timestamp_ns]() { mExperimentSerializer.heartbeatTimestamp(timestamp_ns); });
 }
 
 
@@ -260,7 +319,7 @@ void cLidarData2CeresConverter::processBlock(const v1::cBlockID& id)
     cBlockID new_id(id.classID(), id.majorVersion(), id.minorVersion());
     new_id.dataID(id.dataID());
 
-    mFileWriter.writeBlock(new_id);
+    queueWrite([this, new_id]() { mFileWriter.writeBlock(new_id); });
 }
 
 void cLidarData2CeresConverter::processBlock(const v1::cBlockID& id, const std::byte* buf, std::size_t len)
@@ -268,6 +327,9 @@ void cLidarData2CeresConverter::processBlock(const v1::cBlockID& id, const std::
     cBlockID new_id(id.classID(), id.majorVersion(), id.minorVersion());
     new_id.dataID(id.dataID());
 
-    mFileWriter.writeBlock(new_id, buf, len);
+    // The reader reuses its buffer for the next block, so keep a copy
+    auto data = std::make_shared<std::vector<std::byte>>(buf, buf + len);
+
+    queueWrite([this, new_id, data]() { mFileWriter.writeBlock(new_id, data->data(), data->size()); });
 }
 
@@ -3,6 +3,8 @@
 
 #include "FileProcessor.hpp"
 
+#include "BoundedQueue.hpp"
+
 #include "bdf_v1/BlockDataFile.hpp"
 #include "bdf_v1/OusterVerificationParser.hpp"
 #include "bdf_v1/PvtVerificationParser.hpp"
@@ -14,6 +16,8 @@
 #include <filesystem>
 #include <string>
 #include <fstream>
+#include <functional>
+#include <atomic>
 
 
 class cLidarData2CeresConverter : public cFileProcessor, 
@@ -35,6 +39,12 @@ public:
 protected:
 	void convert();
 
+	/**
+	 * Reader stage of the conversion pipeline.  Reads and decodes the v1
+	 * blocks and queues the matching ceres writes for the writer stage.
+	 */
+	void readBlocks();
+
 protected:
 	void onConfigParam(::ouster::config_param_2_t config_param) override;
 	void onSensorInfo(::ouster::sensor_info_2_t sensor_info) override;
@@ -67,7 +77,16 @@ private:
 	void processBlock(const v1::cBlockID& id);
 	void processBlock(const v1::cBlockID& id, const std::byte* buf, std::size_t len);
 
+	typedef std::function<void()> write_task_t;
+
+	void queueWrite(write_task_t task);
+
 private:
+	/// Serialized ceres writes in file order, from the reader to the writer stage
+	cBoundedQueue<write_task_t> mWriteQueue;
+	std::atomic<bool> mReadFailed = false;
+	std::string mReadError;
+
 	std::filesystem::directory_entry mInputFile;
 	std::filesystem::path mOutputFile;
 
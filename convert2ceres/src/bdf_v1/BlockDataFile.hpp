@@ -9,7 +9,7 @@
 #include <string>
 #include <cstdio>
 #include <fstream>
-#include <map>
+#include <vector>
 #include <mutex>
 #include <functional>
 
@@ -128,6 +128,15 @@ namespace v1
 		std::streampos filePosition();
 		void gotoPosition(std::streampos pos);
 
+		/**
+		 * @brief Sets the size of the chunks read from the file
+		 *
+		 * Blocks are parsed in place from a read-ahead buffer that is filled
+		 * with large sequential reads.  The buffer grows to hold any block
+		 * that is larger than the chunk size.
+		 */
+		void setReadAheadSize(std::size_t size);
+
 		/**
 		 * @brief Returns the file size
 		 */
@@ -141,6 +150,10 @@ namespace v1
 
 		bool processBlock();
 
+	private:
+		bool fillReadAhead(std::size_t required);
+		void resetReadAhead(std::streamoff offset);
+
 	private:
 		//    FILE* mpFile;
 		std::ifstream mFile;
@@ -149,8 +162,20 @@ namespace v1
 		std::string mFileName;
 		bool mByteSwapNeeded;
 
+		/// Read-ahead buffer, mReadAhead[0] is at file offset mReadAheadOffset
+		std::vector<std::byte> mReadAhead;
+		std::size_t mReadAheadSize;
+		std::size_t mReadPos = 0;
+		std::size_t mReadEnd = 0;
+		std::streamoff mReadAheadOffset = 0;
+		bool mEndOfStream = false;
+		bool mEof = false;
+
+		/// The payload of the current block, a view into the read-ahead buffer
 		cDataBuffer mBuffer;
-		std::map<BLOCK_CLASS_ID_t, cBlockParser*> mParsers;
+
+		/// Parsers indexed directly by block class id
+		std::vector<cBlockParser*> mParsers;
 
 		emptyBlock_t mEmptyBlockCallback;
 		dataBlock_t  mDataBlockCallback;
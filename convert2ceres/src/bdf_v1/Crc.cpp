@@ -19,8 +19,10 @@ namespace
         return id;
     }
 
-    /* Table of CRCs of all 8-bit messages. */
-    uint32_t crc_table[256];
+    /* Table of CRCs of all 8-bit messages.  Tables 1-7 extend table 0 so the
+       CRC can be updated eight bytes at a time (slicing-by-8). */
+    uint32_t crc_tables[8][256];
+    uint32_t (&crc_table)[256] = crc_tables[0];
 
     /* Flag: has the table been computed? Initially false. */
     bool crc_table_computed = false;
@@ -33,7 +35,25 @@ namespace
     uint32_t update_crc(uint32_t crc, const std::byte* buf, std::size_t len)
     {
         std::uint32_t c = crc;
-        for (int n = 0; n < len; ++n)
+
+        while (len >= 8)
+        {
+            std::uint32_t one = 0;
+            std::uint32_t two = 0;
+            std::memcpy(&one, buf, sizeof(one));
+            std::memcpy(&two, buf + 4, sizeof(two));
+            one ^= c;
+
+            c = crc_tables[7][one & 0xff] ^ crc_tables[6][(one >> 8) & 0xff]
+                ^ crc_tables[5][(one >> 16) & 0xff] ^ crc_tables[4][one >> 24]
+                ^ crc_tables[3][two & 0xff] ^ crc_tables[2][(two >> 8) & 0xff]
+                ^ crc_tables[1][(two >> 16) & 0xff] ^ crc_tables[0][two >> 24];
+
+            buf += 8;
+            len -= 8;
+        }
+
+        for (std::size_t n = 0; n < len; ++n)
         {
             c = crc_table[(c ^ static_cast<const unsigned char>(buf[n])) & 0xff] ^ (c >> 8);
         }
@@ -60,6 +80,16 @@ void v1::make_crc_table()
         crc_table[n] = c;
     }
 
+    for (int n = 0; n < 256; ++n)
+    {
+        std::uint32_t c = crc_table[n];
+        for (int k = 1; k < 8; ++k)
+        {
+            c = crc_table[c & 0xff] ^ (c >> 8);
+            crc_tables[k][n] = c;
+        }
+    }
+
     crc_table_computed = true;
 }
 
@@ -75,200 +75,232 @@ bool cCeresDailyChecker::setFileToCheck(std::filesystem::directory_entry file_to
 //-----------------------------------------------------------------------------
 void cCeresDailyChecker::process_file()
 {
-    auto filename = mFileToCheck.path().filename();
-
-    bool needs_repair = false;
-
     new_file_progress(mID, mFileToCheck.path().string());
 
     update_prefix_progress(mID, "Verifying File", 0);
 
-    {
-        std::filesystem::path failed_files = mSourceDir / "failed_files";
-        std::unique_ptr<cCeresFileVerifier> pFileVerifier = std::make_unique<cCeresFileVerifier>(mID, mFileToCheck, failed_files);
+    auto result = cCeresDataVerifier::eRETURN_TYPE::PASSED;
+
+    if (!verify(result))
+        return;
 
-        try
+    // Only files that need rewriting are read again
+    if (result == cCeresDataVerifier::eRETURN_TYPE::INVALID_FILE)
+    {
+        if (!moveFileToFailed())
         {
-            auto result = pFileVerifier->run();
-
-            switch (result)
-            {
-            case cCeresFileVerifier::eRETURN_TYPE::COULD_NOT_OPEN_FILE:
-            case cCeresFileVerifier::eRETURN_TYPE::ABORT:
-                return;
-            case cCeresFileVerifier::eRETURN_TYPE::PASSED:
-                needs_repair = false;
-                break;
-            case cCeresFileVerifier::eRETURN_TYPE::INVALID_DATA:
-            case cCeresFileVerifier::eRETURN_TYPE::INVALID_FILE:
-                needs_repair = true;
-                break;
-            }
+            complete_file_progress(mID, "Error", "Could not move failed file");
+            return;
         }
-        catch (const std::exception& e)
+
+        if (!repairFile())
+            return;
+
+        update_prefix_progress(mID, "Verifying Data", 0);
+
+        if (!verify(result))
+            return;
+
+        if (result == cCeresDataVerifier::eRETURN_TYPE::INVALID_FILE)
         {
-            std::string msg = "Exception throw in FileVerifier: ";
-            msg += e.what();
-            console_message(msg);
-            complete_file_progress(mID, "Error", "File verifier exception");
+            complete_file_progress(mID, "Error", "File is invalid.");
             return;
         }
     }
 
-    if (needs_repair)
+    if (result == cCeresDataVerifier::eRETURN_TYPE::INVALID_DATA)
     {
-        update_prefix_progress(mID, "Repairing File", 0);
+        if (!repairData())
+            return;
+
+        complete_file_progress(mID, "Complete", "Fixed");
+        return;
+    }
+
+    complete_file_progress(mID, "Complete", "Passed");
+}
 
-        std::filesystem::path failed_file = mSourceDir / "failed_files" / filename;
+//-----------------------------------------------------------------------------
+bool cCeresDailyChecker::verify(cCeresDataVerifier::eRETURN_TYPE& result)
+{
+    std::filesystem::path invalid_data_files = mSourceDir / "invalid_data";
+    std::unique_ptr<cCeresDataVerifier> pDataVerifier = std::make_unique<cCeresDataVerifier>(mID, invalid_data_files, mExperimentFile);
 
-        std::filesystem::path tmp_dir = mSourceDir / "file_repair_tmp";
-        std::filesystem::path partial_repaired_files = mSourceDir / "partial_repaired_files";
-        std::filesystem::path repaired_files = mSourceDir / "fully_repaired_files";
+    pDataVerifier->checkFileStructure(true);
+    pDataVerifier->setFileToCheck(mFileToCheck);
 
-        std::unique_ptr<cFileRepairProcessor> pFileRepair = std::make_unique<cFileRepairProcessor>(mID, tmp_dir, partial_repaired_files, repaired_files);
+    if (!pDataVerifier->open(mFileToCheck.path()))
+    {
+        complete_file_progress(mID, "Error", "Could not open file");
+        return false;
+    }
 
-        if (pFileRepair->open(failed_file))
-        {
-            try
-            {
-                auto result = pFileRepair->run();
-
-                std::filesystem::path repaired_file = repaired_files / filename;
-
-                std::filesystem::path out_file = mSourceDir / filename;
-
-                if (std::filesystem::exists(repaired_file) && !std::filesystem::exists(out_file))
-                {
-                    std::filesystem::rename(repaired_file, out_file);
-                }
-                else
-                {
-                    std::filesystem::path partial_repaired_file = partial_repaired_files / filename;
-
-                    if (std::filesystem::exists(partial_repaired_file))
-                        complete_file_progress(mID, "Warning", "The file could only be partially repaired.");
-                    else
-                        complete_file_progress(mID, "Error", "Error in copying repaired file!");
-
-                    return;
-                }
-            }
-            catch (const std::exception& e)
-            {
-                std::string msg = "Exception throw in FileRepair: ";
-                msg += e.what();
-                console_message(msg);
-                complete_file_progress(mID, "Error", "File repair exception");
-                return;
-            }
+    try
+    {
+        result = pDataVerifier->run();
 
-        }
-        else
+        switch (result)
         {
-            complete_file_progress(mID, "Error", "Could not open failed file");
-            return;
+        case cCeresDataVerifier::eRETURN_TYPE::COULD_NOT_OPEN_FILE:
+            complete_file_progress(mID, "Error", "Could not open file");
+            return false;
+        case cCeresDataVerifier::eRETURN_TYPE::WARNING_MISSING_DATA:
+            complete_file_progress(mID, "Warning", pDataVerifier->message());
+            return false;
+        case cCeresDataVerifier::eRETURN_TYPE::PASSED:
+        case cCeresDataVerifier::eRETURN_TYPE::INVALID_DATA:
+        case cCeresDataVerifier::eRETURN_TYPE::INVALID_FILE:
+            break;
         }
     }
+    catch (const std::exception& e)
+    {
+        std::string msg = "Exception throw in DataVerifier: ";
+        msg += e.what();
+        console_message(msg);
+        complete_file_progress(mID, "Error", "Data verifier exception");
+        return false;
+    }
 
-    needs_repair = false;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+bool cCeresDailyChecker::moveFileToFailed()
+{
+    std::filesystem::path failed_files = mSourceDir / "failed_files";
+
+    ::create_directory(failed_files);
 
-    update_prefix_progress(mID, "Verifying Data", 0);
+    std::filesystem::path dest = failed_files / mFileToCheck.path().filename();
 
+    std::string msg = "Moving ";
+    msg += mFileToCheck.path().string();
+    msg += " to ";
+    msg += dest.string();
+    console_message(msg);
+
+    try
+    {
+        std::filesystem::rename(mFileToCheck.path(), dest);
+    }
+    catch (const std::filesystem::filesystem_error& e)
     {
-        std::filesystem::path invalid_data_files = mSourceDir / "invalid_data";
-        std::unique_ptr<cCeresDataVerifier> pDataVerifier = std::make_unique<cCeresDataVerifier>(mID, mFileToCheck, invalid_data_files, mExperimentFile);
+        std::string msg = "Move File To Failed: ";
+        msg += e.what();
+        console_message(msg);
+        return false;
+    }
+
+    ++ceres_file_verifier::g_num_failed_files;
 
-        try
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+bool cCeresDailyChecker::repairFile()
+{
+    auto filename = mFileToCheck.path().filename();
+
+    update_prefix_progress(mID, "Repairing File", 0);
+
+    std::filesystem::path failed_file = mSourceDir / "failed_files" / filename;
+
+    std::filesystem::path tmp_dir = mSourceDir / "file_repair_tmp";
+    std::filesystem::path partial_repaired_files = mSourceDir / "partial_repaired_files";
+    std::filesystem::path repaired_files = mSourceDir / "fully_repaired_files";
+
+    std::unique_ptr<cFileRepairProcessor> pFileRepair = std::make_unique<cFileRepairProcessor>(mID, tmp_dir, partial_repaired_files, repaired_files);
+
+    if (!pFileRepair->open(failed_file))
+    {
+        complete_file_progress(mID, "Error", "Could not open failed file");
+        return false;
+    }
+
+    try
+    {
+        pFileRepair->run();
+
+        std::filesystem::path repaired_file = repaired_files / filename;
+
+        std::filesystem::path out_file = mSourceDir / filename;
+
+        if (std::filesystem::exists(repaired_file) && !std::filesystem::exists(out_file))
         {
-            auto result = pDataVerifier->run();
-
-            switch (result)
-            {
-            case cCeresDataVerifier::eRETURN_TYPE::COULD_NOT_OPEN_FILE:
-                complete_file_progress(mID, "Error", "Could not open failed file");
-                return;
-            case cCeresDataVerifier::eRETURN_TYPE::PASSED:
-                needs_repair = false;
-                break;
-            case cCeresDataVerifier::eRETURN_TYPE::INVALID_DATA:
-                needs_repair = true;
-                break;
-            case cCeresDataVerifier::eRETURN_TYPE::INVALID_FILE:
-            {
-                complete_file_progress(mID, "Error", "File is invalid.");
-                return;
-
-            }
-            case cCeresDataVerifier::eRETURN_TYPE::WARNING_MISSING_DATA:
-            {
-                complete_file_progress(mID, "Warning", pDataVerifier->message());
-                return;
-
-            }
-            }
+            std::filesystem::rename(repaired_file, out_file);
         }
-        catch (const std::exception& e)
+        else
         {
-            std::string msg = "Exception throw in DataVerifier: ";
-            msg += e.what();
-            console_message(msg);
-            complete_file_progress(mID, "Error", "Data verifier exception");
-            return;
+            std::filesystem::path partial_repaired_file = partial_repaired_files / filename;
+
+            if (std::filesystem::exists(partial_repaired_file))
+                complete_file_progress(mID, "Warning", "The file could only be partially repaired.");
+            else
+                complete_file_progress(mID, "Error", "Error in copying repaired file!");
+
+            return false;
         }
     }
-
-    if (needs_repair)
+    catch (const std::exception& e)
     {
-        update_prefix_progress(mID, "Repairing Data", 0);
+        std::string msg = "Exception throw in FileRepair: ";
+        msg += e.what();
+        console_message(msg);
+        complete_file_progress(mID, "Error", "File repair exception");
+        return false;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+bool cCeresDailyChecker::repairData()
+{
+    auto filename = mFileToCheck.path().filename();
+
+    update_prefix_progress(mID, "Repairing Data", 0);
+
+    std::filesystem::path invalid_data_file = mSourceDir / "invalid_data" / filename;
 
-        std::filesystem::path invalid_data_file = mSourceDir / "invalid_data" / filename;
+    std::filesystem::path tmp_dir = mSourceDir / "data_repair_tmp";
+    std::filesystem::path failed_data_files = mSourceDir / "failed_data_files";
+    std::filesystem::path repaired_data_files = mSourceDir / "repaired_data_files";
 
-        std::filesystem::path tmp_dir = mSourceDir / "data_repair_tmp";
-        std::filesystem::path failed_data_files = mSourceDir / "failed_data_files";
-        std::filesystem::path repaired_data_files = mSourceDir / "repaired_data_files";
+    std::unique_ptr<cDataRepairProcessor> pDataRepair = std::make_unique<cDataRepairProcessor>(mID, tmp_dir, failed_data_files, repaired_data_files, mExperimentFile);
 
-        std::unique_ptr<cDataRepairProcessor> pDataRepair = std::make_unique<cDataRepairProcessor>(mID, tmp_dir, failed_data_files, repaired_data_files, mExperimentFile);
+    if (!pDataRepair->open(invalid_data_file))
+    {
+        complete_file_progress(mID, "Error", "Could not open invalid data file");
+        return false;
+    }
+
+    try
+    {
+        pDataRepair->run();
+
+        std::filesystem::path repaired_file = repaired_data_files / filename;
+        std::filesystem::path out_file = mSourceDir / filename;
 
-        if (pDataRepair->open(invalid_data_file))
+        if (std::filesystem::exists(repaired_file) && !std::filesystem::exists(out_file))
         {
-            try
-            {
-                auto result = pDataRepair->run();
-
-                std::filesystem::path repaired_file = repaired_data_files / filename;
-                std::filesystem::path out_file = mSourceDir / filename;
-
-                if (std::filesystem::exists(repaired_file) && !std::filesystem::exists(out_file))
-                {
-                    std::filesystem::rename(repaired_file, out_file);
-                }
-                else
-                {
-                    complete_file_progress(mID, "Error", "Error in copying repaired file!");
-                    return;
-                }
-            }
-            catch (const std::exception& e)
-            {
-                std::string msg = "Exception throw in DataRepair: ";
-                msg += e.what();
-                console_message(msg);
-                complete_file_progress(mID, "Error", "Data repair exception");
-                return;
-            }
+            std::filesystem::rename(repaired_file, out_file);
         }
         else
         {
-            complete_file_progress(mID, "Error", "Could not open invalid data file");
-            return;
+            complete_file_progress(mID, "Error", "Error in copying repaired file!");
+            return false;
         }
-
-        complete_file_progress(mID, "Complete", "Fixed");
-        return;
     }
-    else
+    catch (const std::exception& e)
     {
-        complete_file_progress(mID, "Complete", "Passed");
+        std::string msg = "Exception throw in DataRepair: ";
+        msg += e.what();
+        console_message(msg);
+        complete_file_progress(mID, "Error", "Data repair exception");
+        return false;
     }
+
+    return true;
 }
 
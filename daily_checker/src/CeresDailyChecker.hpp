@@ -32,6 +32,18 @@ public:
 	void process_file();
 
 protected:
+	/**
+	 * Verify the file structure and the sensor data in a single pass.
+	 *
+	 * Returns false if checking should stop, otherwise result holds the
+	 * outcome of the pass.
+	 */
+	bool verify(cCeresDataVerifier::eRETURN_TYPE& result);
+
+	bool moveFileToFailed();
+
+	bool repairFile();
+	bool repairData();
 
 private:
 	const int mID;
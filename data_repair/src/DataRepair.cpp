@@ -3,12 +3,15 @@
 #include "ParserExceptions.hpp"
 
 #include "ExperimentInfoFromJson.hpp"
+#include "FileRangeCopy.hpp"
 
 #include <cbdf/BlockDataFileExceptions.hpp>
 
 #include <memory>
 #include <string>
 #include <stdexcept>
+#include <algorithm>
+#include <limits>
 
 
 extern std::atomic<uint32_t> g_num_failed_files;
@@ -100,7 +103,19 @@ cDataRepair::eResult cDataRepair::pass1()
 
     update_prefix_progress(mID, "Checking Info Block", 0);
 
+    // The ouster repair parser without a writer attached only checks which
+    // blocks would be repaired
+    cOusterRepairParser ousterPlanner;
+
     fileReader.attach(mExperimentInfoRepairParser.get());
+    fileReader.attach(&ousterPlanner);
+
+    std::uintmax_t endOfHeader = 0;
+    std::uintmax_t ousterRepairEnd = 0;
+    std::size_t numOusterRepairs = 0;
+
+    mRewriteEnd = 0;
+    mValidEnd = 0;
 
     try
     {
@@ -114,9 +129,26 @@ cDataRepair::eResult cDataRepair::pass1()
 
             fileReader.processBlock();
 
-            auto file_pos = static_cast<double>(fileReader.filePosition());
-            file_pos = 100.0 * (file_pos / mFileSize);
-            update_progress(mID, static_cast<int>(file_pos));
+            // The position is invalid once the end of the file has been hit
+            auto file_pos = static_cast<std::streamoff>(fileReader.filePosition());
+            if (file_pos <= 0)
+                continue;
+
+            auto block_end = static_cast<std::uintmax_t>(file_pos);
+            mValidEnd = block_end;
+
+            if ((endOfHeader == 0) && mExperimentInfoRepairParser->endOfHeaderFound())
+                endOfHeader = block_end;
+
+            if (ousterPlanner.numRepairedBlocks() != numOusterRepairs)
+            {
+                numOusterRepairs = ousterPlanner.numRepairedBlocks();
+                ousterRepairEnd = block_end;
+            }
+
+            auto progress = static_cast<double>(block_end);
+            progress = 100.0 * (progress / mFileSize);
+            update_progress(mID, static_cast<int>(progress));
         }
     }
     catch (const bdf::invalid_data& e)
@@ -211,6 +243,20 @@ cDataRepair::eResult cDataRepair::pass1()
         }
     }
 
+    // Work out how much of the file has to go through the repair parsers
+    mRewriteEnd = ousterRepairEnd;
+
+    if (mExperimentInfoRepairParser->needsUpdating())
+    {
+        if (endOfHeader == 0)
+            mRewriteEnd = std::numeric_limits<std::uintmax_t>::max();
+        else
+            mRewriteEnd = std::max(mRewriteEnd, endOfHeader);
+    }
+
+    if (mValidEnd == 0)
+        mRewriteEnd = std::numeric_limits<std::uintmax_t>::max();
+
     return eResult::VALID;
 }
 
@@ -219,6 +265,16 @@ cDataRepair::eResult cDataRepair::pass2()
 {
     update_prefix_progress(mID, "Repairing", 0);
 
+    if (mRewriteEnd == 0)
+    {
+        // Nothing needs to be rewritten, so the repaired file is just the
+        // complete blocks of the original file.
+        mFileReader.close();
+        mFileWriter.close();
+
+        return copyValidBlocks(0, false);
+    }
+
     mFileReader.registerCallback([this](const cBlockID& id) { this->processBlock(id); });
     mFileReader.registerCallback([this](const cBlockID& id, const std::byte* buf, std::size_t len) { this->processBlock(id, buf, len); });
 
@@ -239,11 +295,17 @@ cDataRepair::eResult cDataRepair::pass2()
                 return eResult::INVALID_FILE;
             }
 
+            auto file_pos = static_cast<std::uintmax_t>(static_cast<std::streamoff>(mFileReader.filePosition()));
+
+            // The rest of the blocks are copied as is
+            if (file_pos >= mRewriteEnd)
+                break;
+
             mFileReader.processBlock();
 
-            auto file_pos = static_cast<double>(mFileReader.filePosition());
-            file_pos = 100.0 * (file_pos / mFileSize);
-            update_progress(mID, static_cast<int>(file_pos));
+            auto progress = static_cast<double>(mFileReader.filePosition());
+            progress = 100.0 * (progress / mFileSize);
+            update_progress(mID, static_cast<int>(progress));
         }
     }
     catch (const bdf::invalid_data& e)
@@ -313,6 +375,26 @@ cDataRepair::eResult cDataRepair::pass2()
     mFileReader.close();
     mFileWriter.close();
 
+    if (mRewriteEnd < mValidEnd)
+        return copyValidBlocks(mRewriteEnd, true);
+
+    return eResult::VALID;
+}
+
+//-----------------------------------------------------------------------------
+cDataRepair::eResult cDataRepair::copyValidBlocks(std::uintmax_t offset, bool append)
+{
+    if (!cdr::copy_file_range(mCurrentFile, mTemporaryFile, offset, mValidEnd - offset, append))
+    {
+        std::string msg = mCurrentFile.string();
+        msg += ": Failed to copy the unchanged blocks.";
+        console_message(msg);
+
+        return eResult::INVALID_FILE;
+    }
+
+    update_progress(mID, 100);
+
     return eResult::VALID;
 }
 
@@ -32,10 +32,11 @@ public:
 
 	bool open(std::filesystem::path file_to_repair);
 
-	// Check for missing experiment data
+	// Check for missing experiment data and plan which blocks need rewriting
 	eResult pass1();
 
-	// Repair data in the recovered file if possible
+	// Repair data in the recovered file if possible.  Only the blocks up to
+	// the last one that needs repairing are rewritten, the rest is copied.
 	eResult pass2();
 
 	// Validate the repaired file
@@ -49,11 +50,19 @@ private:
 
 	bool moveRepairedFile();
 
+	eResult copyValidBlocks(std::uintmax_t offset, bool append);
+
 private:
 	const int mID;
 
 	std::uintmax_t mFileSize = 0;
 
+	/// Blocks starting at or after this file offset are copied unchanged
+	std::uintmax_t mRewriteEnd = 0;
+
+	/// The end of the last complete block in the file
+	std::uintmax_t mValidEnd = 0;
+
 	cBlockDataFileReader mFileReader;
 	cBlockDataFileWriter mFileWriter;
 	
@@ -87,6 +87,16 @@ cBlockDataFileWriter* cExperimentInfoRepairParser::detach()
 	return mSerializer.detach();
 }
 
+bool cExperimentInfoRepairParser::needsUpdating() const
+{
+	return mNeedsUpdating;
+}
+
+bool cExperimentInfoRepairParser::endOfHeaderFound() const
+{
+	return mEndOfHeaderFound;
+}
+
 void cExperimentInfoRepairParser::setReferenceInfo(const cdr::cExperimentInfoFromJson& info)
 {
 	bool valid_json = false;
@@ -197,6 +207,9 @@ void cExperimentInfoRepairParser::onBeginHeader()
 
 void cExperimentInfoRepairParser::onEndOfHeader()
 {
+	if (!mSerializer)
+		mEndOfHeaderFound = true;
+
 	if (mSerializer && !mNeedsUpdating)
 		mSerializer.writeEndOfHeader();
 }
@@ -37,6 +37,17 @@ public:
 
 	void setReferenceInfo(const cdr::cExperimentInfoFromJson& info);
 
+	/**
+	 * True if the header blocks have to be rewritten to match the reference info.
+	 */
+	bool needsUpdating() const;
+
+	/**
+	 * True once the end of the header has been read while collecting the
+	 * header information (no writer attached).
+	 */
+	bool endOfHeaderFound() const;
+
 protected:
 	void onBeginHeader() override;
 	void onEndOfHeader() override;
@@ -103,6 +114,7 @@ protected:
 
 private:
 	bool mNeedsUpdating = false;
+	bool mEndOfHeaderFound = false;
 
 	std::string mMeasurementTitle;
 	std::string mExperimentTitle;
@@ -0,0 +1,112 @@
+
+#include "FileRangeCopy.hpp"
+
+#include <fstream>
+#include <vector>
+#include <algorithm>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+
+namespace
+{
+	const std::size_t COPY_BUFFER_SIZE = 8 * 1024 * 1024;
+
+	bool stream_copy(const std::filesystem::path& from, const std::filesystem::path& to,
+		std::uintmax_t offset, std::uintmax_t length, bool append)
+	{
+		std::ifstream in(from, std::ios_base::binary);
+		if (!in.is_open())
+			return false;
+
+		std::ios_base::openmode mode = std::ios_base::binary;
+		mode |= append ? std::ios_base::app : std::ios_base::trunc;
+
+		std::ofstream out(to, mode);
+		if (!out.is_open())
+			return false;
+
+		in.seekg(offset);
+
+		std::vector<char> buffer(COPY_BUFFER_SIZE);
+
+		while (length > 0)
+		{
+			auto n = static_cast<std::streamsize>(std::min<std::uintmax_t>(length, buffer.size()));
+
+			in.read(buffer.data(), n);
+			if (in.gcount() != n)
+				return false;
+
+			out.write(buffer.data(), n);
+			if (!out.good())
+				return false;
+
+			length -= n;
+		}
+
+		return true;
+	}
+}
+
+
+bool cdr::copy_file_range(const std::filesystem::path& from, const std::filesystem::path& to,
+	std::uintmax_t offset, std::uintmax_t length, bool append)
+{
+#if defined(__linux__)
+	int in = ::open(from.c_str(), O_RDONLY);
+	if (in < 0)
+		return false;
+
+	int flags = O_WRONLY | O_CREAT;
+	if (!append)
+		flags |= O_TRUNC;
+
+	// Note: copy_file_range does not accept an O_APPEND descriptor
+	int out = ::open(to.c_str(), flags, 0644);
+	if (out < 0)
+	{
+		::close(in);
+		return false;
+	}
+
+	off_t in_offset = static_cast<off_t>(offset);
+	off_t out_offset = ::lseek(out, 0, SEEK_END);
+
+	bool use_fallback = false;
+
+	while (length > 0)
+	{
+		auto n = ::copy_file_range(in, &in_offset, out, &out_offset, length, 0);
+
+		if (n > 0)
+		{
+			length -= static_cast<std::uintmax_t>(n);
+			continue;
+		}
+
+		if ((n < 0) && ((errno == EXDEV) || (errno == ENOSYS) || (errno == EINVAL) || (errno == EOPNOTSUPP)))
+			use_fallback = true;
+
+		break;
+	}
+
+	::close(out);
+	::close(in);
+
+	if (length == 0)
+		return true;
+
+	if (!use_fallback)
+		return false;
+
+	// The file system cannot do the copy for us, finish it the slow way
+	return stream_copy(from, to, static_cast<std::uintmax_t>(in_offset), length, true);
+#else
+	return stream_copy(from, to, offset, length, append);
+#endif
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+
+
+namespace cdr
+{
+	/**
+	 * Copies length bytes starting at offset in the "from" file to the end of
+	 * the "to" file.  If append is false, the "to" file is truncated first.
+	 *
+	 * On Linux the copy is done with copy_file_range so that the kernel can
+	 * share the extents (reflink) or copy without passing the data through
+	 * user space.  Other systems fall back to a buffered stream copy.
+	 */
+	bool copy_file_range(const std::filesystem::path& from, const std::filesystem::path& to,
+		std::uintmax_t offset, std::uintmax_t length, bool append);
+}
@@ -21,16 +21,31 @@ cBlockDataFileWriter* cOusterRepairParser::detach()
     return mSerializer.detach();
 }
 
+std::size_t cOusterRepairParser::numRepairedBlocks() const
+{
+    return mNumRepairedBlocks;
+}
+
 void cOusterRepairParser::onConfigParam(uint8_t instance_id, ouster::config_param_2_t config_param)
 {
+    bool repaired = false;
+
     if (config_param.udp_ip.empty())
+    {
         config_param.udp_ip = "fe80::7c35:e17b:e9aa:f24d";
+        repaired = true;
+    }
 
     if (config_param.udp_dest.empty())
+    {
         config_param.udp_dest = "fe80::7c35:e17b:e9aa:f24d";
+        repaired = true;
+    }
 
     if ((config_param.lidar_port == 0) || (config_param.imu_port == 0))
     {
+        repaired = true;
+
         config_param.lidar_port = 7502;
         config_param.imu_port = 7503;
         config_param.timestamp_mode = ::ouster::eTIMESTAMP_MODE::TIME_FROM_INTERNAL_OSC;
@@ -53,74 +68,112 @@ void cOusterRepairParser::onConfigParam(uint8_t instance_id, ouster::config_para
         config_param.phase_lock_offset_deg = 0;
     }
 
-    mSerializer.write(instance_id, config_param);
+    if (repaired)
+        ++mNumRepairedBlocks;
+
+    if (mSerializer)
+        mSerializer.write(instance_id, config_param);
 }
 
 void cOusterRepairParser::onSensorInfo(uint8_t instance_id, ouster::sensor_info_2_t sensor_info)
 {
+    bool repaired = false;
+
     if (sensor_info.product_line.empty())
+    {
         sensor_info.product_line = "OS-0-128";
+        repaired = true;
+    }
 
     if (sensor_info.product_part_number.empty())
+    {
         sensor_info.product_part_number = "840-102144-C";
+        repaired = true;
+    }
 
     if (sensor_info.product_serial_number.empty())
+    {
         sensor_info.product_serial_number = "992037000167";
+        repaired = true;
+    }
 
     if (sensor_info.image_rev.empty())
+    {
         sensor_info.image_rev = "ousteros-image-prod-aries-v2.3.0+20220415163956";
+        repaired = true;
+    }
 
     if (sensor_info.build_revision.major == 0)
     {
         sensor_info.build_revision.major = 2;
         sensor_info.build_revision.minor = 3;
         sensor_info.build_revision.patch = 0;
+        repaired = true;
     }
 
     if (sensor_info.build_date.empty())
+    {
         sensor_info.build_date = "2022-04-14T21:11:47Z";
+        repaired = true;
+    }
 
     if ((sensor_info.status == ::ouster::eSENSOR_STATUS::UNKNOWN) ||
         (static_cast<int>(sensor_info.status) >= static_cast<int>(::ouster::eSENSOR_STATUS::UNCONFIGURED)))
+    {
         sensor_info.status = ::ouster::eSENSOR_STATUS::RUNNING;
+        repaired = true;
+    }
+
+    if (repaired)
+        ++mNumRepairedBlocks;
 
-    mSerializer.write(instance_id, sensor_info);
+    if (mSerializer)
+        mSerializer.write(instance_id, sensor_info);
 }
 
 void cOusterRepairParser::onTimestamp(uint8_t instance_id, ouster::timestamp_2_t timestamp)
 {
-    mSerializer.write(instance_id, timestamp);
+    if (mSerializer)
+        mSerializer.write(instance_id, timestamp);
 }
 
 void cOusterRepairParser::onSyncPulseIn(uint8_t instance_id, ouster::sync_pulse_in_2_t pulse_info)
 {
-    mSerializer.write(instance_id, pulse_info);
+    if (mSerializer)
+        mSerializer.write(instance_id, pulse_info);
 }
 
 void cOusterRepairParser::onSyncPulseOut(uint8_t instance_id, ouster::sync_pulse_out_2_t pulse_info)
 {
-    mSerializer.write(instance_id, pulse_info);
+    if (mSerializer)
+        mSerializer.write(instance_id, pulse_info);
 }
 
 void cOusterRepairParser::onMultipurposeIo(uint8_t instance_id, ouster::multipurpose_io_2_t io)
 {
-    mSerializer.write(instance_id, io);
+    if (mSerializer)
+        mSerializer.write(instance_id, io);
 }
 
 void cOusterRepairParser::onNmea(uint8_t instance_id, ouster::nmea_2_t nmea)
 {
-    mSerializer.write(instance_id, nmea);
+    if (mSerializer)
+        mSerializer.write(instance_id, nmea);
 }
 
 void cOusterRepairParser::onTimeInfo(uint8_t instance_id, ouster::time_info_2_t time_info)
 {
-    mSerializer.write(instance_id, time_info);
+    if (mSerializer)
+        mSerializer.write(instance_id, time_info);
 }
 
 void cOusterRepairParser::onBeamIntrinsics(uint8_t instance_id, ouster::beam_intrinsics_2_t intrinsics)
 {
+    bool repaired = false;
+
     if (intrinsics.altitude_angles_deg.empty() || intrinsics.azimuth_angles_deg.empty())
     {
+        repaired = true;
         intrinsics.altitude_angles_deg =
             { 46.25, 45.24, 44.54, 44.12, 43.24, 42.27, 41.58, 41.16, 40.28, 39.31, 38.64,
             38.21, 37.33, 36.4, 35.71, 35.27, 34.38, 33.47, 32.81, 32.36, 31.47, 30.59,
@@ -152,36 +205,57 @@ void cOusterRepairParser::onBeamIntrinsics(uint8_t instance_id, ouster::beam_int
         intrinsics.lidar_to_beam_origins_mm = 27.67;
     }
 
-    mSerializer.write(instance_id, intrinsics);
+    if (repaired)
+        ++mNumRepairedBlocks;
+
+    if (mSerializer)
+        mSerializer.write(instance_id, intrinsics);
 }
 
 void cOusterRepairParser::onImuIntrinsics(uint8_t instance_id, ouster::imu_intrinsics_2_t intrinsics)
 {
+    bool repaired = false;
+
     if (intrinsics.imu_to_sensor_transform.empty())
     {
+        repaired = true;
         intrinsics.imu_to_sensor_transform =
             { 1, 0, 0, 6.253, 0, 1, 0, -11.775, 0, 0, 1, 7.645, 0, 0, 0, 1 };
     }
 
-    mSerializer.write(instance_id, intrinsics);
+    if (repaired)
+        ++mNumRepairedBlocks;
+
+    if (mSerializer)
+        mSerializer.write(instance_id, intrinsics);
 }
 
 void cOusterRepairParser::onLidarIntrinsics(uint8_t instance_id, ouster::lidar_intrinsics_2_t intrinsics)
 {
+    bool repaired = false;
+
     if (intrinsics.lidar_to_sensor_transform.empty())
     {
+        repaired = true;
         intrinsics.lidar_to_sensor_transform =
             { -1, 0, 0, 0, 0, -1, 0, 0, 0, 0, 1, 36.18, 0, 0, 0, 1 };
     }
 
-    mSerializer.write(instance_id, intrinsics);
+    if (repaired)
+        ++mNumRepairedBlocks;
+
+    if (mSerializer)
+        mSerializer.write(instance_id, intrinsics);
 }
 
 void cOusterRepairParser::onLidarDataFormat(uint8_t instance_id, ouster::lidar_data_format_2_t format)
 {
+    bool repaired = false;
+
     if ((format.pixels_per_column < 32)
         || (format.pixels_per_column > 128))
     {
+        repaired = true;
         format.pixels_per_column = 128;
         format.columns_per_packet = 16;
         format.columns_per_frame = 1024;
@@ -199,12 +273,22 @@ void cOusterRepairParser::onLidarDataFormat(uint8_t instance_id, ouster::lidar_d
     }
 
     if (format.udp_profile_lidar.empty())
+    {
         format.udp_profile_lidar = "LEGACY";
+        repaired = true;
+    }
 
     if (format.udp_profile_imu.empty())
+    {
         format.udp_profile_imu = "LEGACY";
+        repaired = true;
+    }
+
+    if (repaired)
+        ++mNumRepairedBlocks;
 
-    mSerializer.write(instance_id, format);
+    if (mSerializer)
+        mSerializer.write(instance_id, format);
 }
 
 void cOusterRepairParser::onImuData(uint8_t instance_id, ouster::imu_data_t data)
@@ -216,7 +300,8 @@ void cOusterRepairParser::onImuData(uint8_t instance_id, ouster::imu_data_t data
         throw bdf::invalid_data("Bad lidar data");
     }
 
-    mSerializer.write(instance_id, data);
+    if (mSerializer)
+        mSerializer.write(instance_id, data);
 }
 
 void cOusterRepairParser::onLidarData(uint8_t instance_id, cOusterLidarData data)
@@ -242,7 +327,8 @@ void cOusterRepairParser::onLidarData(uint8_t instance_id, cOusterLidarData data
 
     if (data_valid)
     {
-        mSerializer.write(instance_id, data.frame_id(), data);
+        if (mSerializer)
+            mSerializer.write(instance_id, data.frame_id(), data);
         return;
     }
 
@@ -253,7 +339,8 @@ void cOusterRepairParser::onLidarData(uint8_t instance_id, cOusterLidarData data
         throw bdf::invalid_data("Missing lidar data!");
     }
 
-    mSerializer.write(instance_id, data.frame_id(), data);
+    if (mSerializer)
+        mSerializer.write(instance_id, data.frame_id(), data);
 }
 
 void cOusterRepairParser::processConfigParam_2(cDataBuffer& buffer)
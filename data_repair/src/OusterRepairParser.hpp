@@ -16,6 +16,12 @@ public:
 	void attach(cBlockDataFileWriter* pDataFile);
 	cBlockDataFileWriter* detach();
 
+	/**
+	 * The number of blocks that have been repaired.  If no writer is attached,
+	 * the blocks are only checked and this is the number that would be repaired.
+	 */
+	std::size_t numRepairedBlocks() const;
+
 public:
 	void onConfigParam(uint8_t instance_id, ouster::config_param_2_t config_param) override;
 	void onSensorInfo(uint8_t instance_id, ouster::sensor_info_2_t sensor_info) override;
@@ -50,6 +56,8 @@ protected:
 	void processLidarDataFrameTimestamp(cDataBuffer& buffer) override;
 
 private:
+	std::size_t mNumRepairedBlocks = 0;
+
 	int mNumBadFrames = 0;
 	const int mMaxNumBadFrames = 10;
 
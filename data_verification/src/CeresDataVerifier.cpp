@@ -171,6 +171,8 @@ cCeresDataVerifier::eRETURN_TYPE cCeresDataVerifier::run()
 
     mFileSize = mFileReader.file_size();
 
+    std::string invalid_data_msg;
+
     try
     {
         while (!mFileReader.eof())
@@ -183,7 +185,20 @@ cCeresDataVerifier::eRETURN_TYPE cCeresDataVerifier::run()
                 return eRETURN_TYPE::INVALID_FILE;
             }
 
-            mFileReader.processBlock();
+            try
+            {
+                mFileReader.processBlock();
+            }
+            catch (const bdf::invalid_data& e)
+            {
+                // Keep reading so that a damaged block later in the file is
+                // still found in this pass.
+                if (!mCheckFileStructure)
+                    throw;
+
+                if (invalid_data_msg.empty())
+                    invalid_data_msg = e.what();
+            }
 
             auto file_pos = static_cast<double>(mFileReader.filePosition());
             file_pos = 100.0 * (file_pos / mFileSize);
@@ -217,7 +232,7 @@ cCeresDataVerifier::eRETURN_TYPE cCeresDataVerifier::run()
     }
     catch (const std::exception& e)
     {
-        if (!mFileReader.eof())
+        if (mCheckFileStructure || !mFileReader.eof())
         {
             std::string msg = mFileToCheck.string();
             msg += ":  std::exception, ";
@@ -231,6 +246,20 @@ cCeresDataVerifier::eRETURN_TYPE cCeresDataVerifier::run()
         }
     }
 
+    if (!invalid_data_msg.empty())
+    {
+        std::string msg = mFileToCheck.string();
+        msg += ": Invalid Data, ";
+        msg += invalid_data_msg;
+        console_message(msg);
+
+        mFileReader.close();
+
+        moveFileToInvalid();
+
+        return eRETURN_TYPE::INVALID_DATA;
+    }
+
     if (gps->sensorPresent)
     {
         if (gps->mNumPosition == 0)
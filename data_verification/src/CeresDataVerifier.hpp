@@ -36,6 +36,15 @@ public:
 	bool setFileToCheck(std::filesystem::directory_entry file_to_check);
 	void process_file();
 
+	/**
+	 * Also treat any stream, CRC or formatting error as an invalid file.
+	 *
+	 * With this enabled, invalid data no longer stops the pass; the rest of
+	 * the file is still read so that a single pass both verifies the file
+	 * structure and validates the sensor data.
+	 */
+	void checkFileStructure(bool check) { mCheckFileStructure = check; }
+
 	bool open(std::filesystem::path file_to_check);
 	eRETURN_TYPE run();
 
@@ -57,5 +66,7 @@ private:
 	std::filesystem::path mExperimentFile;
 
 	std::string mMessage;
+
+	bool mCheckFileStructure = false;
 };
 
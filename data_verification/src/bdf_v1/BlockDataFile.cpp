@@ -17,6 +17,13 @@ namespace
     static const uint8_t  BLOCK_FILE_HEADER_SIZE = 8;
     static const uint8_t  BLOCK_FILE_HEADER[BLOCK_FILE_HEADER_SIZE] = { 137, 83, 80, 68, 82, 67, 77, 3 };
     static const uint16_t BLOCK_FILE_BOM = 0x55AA;
+
+    /* Length + class id + major version + minor version + data id */
+    static const std::size_t BLOCK_HEADER_SIZE = sizeof(uint32_t) + sizeof(v1::BLOCK_CLASS_ID_t)
+        + sizeof(v1::BLOCK_MAJOR_VERSION_t) + sizeof(v1::BLOCK_MINOR_VERSION_t) + sizeof(v1::BLOCK_DATA_ID_t);
+
+    static const std::size_t NUM_CLASS_IDS = 0x10000;
+    static const std::size_t DEFAULT_READ_AHEAD_SIZE = 8 * 1024 * 1024;
 }
 
 /*******************************************************************
@@ -159,7 +166,10 @@ bool v1::cBlockDataFileWriter::writeBlock(const cBlockID& id, const std::byte* b
  *
  ******************************************************************/
 
-v1::cBlockDataFileReader::cBlockDataFileReader() : mByteSwapNeeded(false)
+v1::cBlockDataFileReader::cBlockDataFileReader()
+:
+    mByteSwapNeeded(false), mReadAheadSize(DEFAULT_READ_AHEAD_SIZE),
+    mParsers(NUM_CLASS_IDS, nullptr)
 {
     v1::make_crc_table();
 }
@@ -168,7 +178,6 @@ v1::cBlockDataFileReader::cBlockDataFileReader(const std::string& filename)
     : cBlockDataFileReader()
 {
     open(filename);
-    mBuffer.capacity(4096);
 }
 
 v1::cBlockDataFileReader::~cBlockDataFileReader()
@@ -218,6 +227,8 @@ bool v1::cBlockDataFileReader::open(const std::string& filename)
         return false;
     }
 
+    resetReadAhead(BLOCK_FILE_HEADER_SIZE + sizeof(BLOCK_FILE_BOM));
+
     mFileName = filename;
     return true;
 }
@@ -230,6 +241,7 @@ bool v1::cBlockDataFileReader::isOpen() const
 void v1::cBlockDataFileReader::close()
 {
     mFile.close();
+    resetReadAhead(0);
 }
 
 bool v1::cBlockDataFileReader::fail() const
@@ -244,28 +256,46 @@ bool v1::cBlockDataFileReader::bad() const
 
 bool v1::cBlockDataFileReader::good() const
 {
-    return mFile.good();
+    return mFile.good() && !mEof;
 }
 
 bool v1::cBlockDataFileReader::eof() const
 {
-    return mFile.eof();
+    return mEof;
 }
 
 std::streampos v1::cBlockDataFileReader::filePosition()
 {
-    return mFile.tellg();
+    return mReadAheadOffset + static_cast<std::streamoff>(mReadPos);
 }
 
 void v1::cBlockDataFileReader::gotoPosition(std::streampos pos)
 {
-    if (mFile.eof() || mFile.fail())
+    std::streamoff offset = pos;
+
+    // Stay in the read-ahead buffer if we can
+    if ((offset >= mReadAheadOffset)
+        && (offset <= mReadAheadOffset + static_cast<std::streamoff>(mReadEnd)))
+    {
+        mReadPos = static_cast<std::size_t>(offset - mReadAheadOffset);
+        mEof = false;
+        return;
+    }
+
+    if (mFile.fail())
     {
         mFile.close();
         open(mFileName);
     }
 
+    mFile.clear();
     mFile.seekg(pos);
+    resetReadAhead(offset);
+}
+
+void v1::cBlockDataFileReader::setReadAheadSize(std::size_t size)
+{
+    mReadAheadSize = std::max<std::size_t>(size, BLOCK_HEADER_SIZE + sizeof(uint32_t));
 }
 
 
@@ -281,19 +311,15 @@ void v1::cBlockDataFileReader::attach(cBlockParser* pParser)
     // sBlockHeader id = pParser->blockID().blockHeader();
     BLOCK_CLASS_ID_t id = pParser->blockID().classID();
 
-    mParsers.insert(std::make_pair(id, pParser));
+    mParsers[id] = pParser;
 }
 
 v1::cBlockParser* v1::cBlockDataFileReader::detach(cBlockID id)
 {
-    auto it = mParsers.find(id.classID());
-    if (mParsers.end() != it)
-    {
-        mParsers.erase(it);
-        return it->second;
-    }
+    cBlockParser* pParser = mParsers[id.classID()];
+    mParsers[id.classID()] = nullptr;
 
-    return nullptr;
+    return pParser;
 }
 
 void v1::cBlockDataFileReader::registerCallback(emptyBlock_t callback)
@@ -306,68 +332,106 @@ void v1::cBlockDataFileReader::registerCallback(dataBlock_t callback)
     mDataBlockCallback = callback;
 }
 
-bool v1::cBlockDataFileReader::processBlock()
+void v1::cBlockDataFileReader::resetReadAhead(std::streamoff offset)
 {
-    if (mFile.eof())
+    mReadPos = 0;
+    mReadEnd = 0;
+    mReadAheadOffset = offset;
+    mEndOfStream = false;
+    mEof = false;
+
+    mBuffer.wrap(nullptr, 0);
+}
+
+/**
+ * Makes sure at least "required" unread bytes are in the read-ahead buffer.
+ * Returns false if the end of the file is reached first.
+ */
+bool v1::cBlockDataFileReader::fillReadAhead(std::size_t required)
+{
+    std::size_t available = mReadEnd - mReadPos;
+    if (available >= required)
+        return true;
+
+    if (mEndOfStream)
         return false;
 
-    if (mFile.fail())
+    // Move the unread tail of the buffer to the front
+    if (mReadPos > 0)
     {
-        throw bdf::formatting_error("I/O error while processing block.");
+        if (available > 0)
+            std::memmove(mReadAhead.data(), mReadAhead.data() + mReadPos, available);
+
+        mReadAheadOffset += static_cast<std::streamoff>(mReadPos);
+        mReadPos = 0;
+        mReadEnd = available;
     }
 
-    std::uint32_t len = 0;
-    mFile.read(reinterpret_cast<char*>(&len), sizeof(len));
-    if (mFile.eof())
-        return false;
-    if (mFile.bad())
+    if (mReadAhead.size() < std::max(required, mReadAheadSize))
     {
-        std::string msg = "I/O error while reading block length: ";
-        msg += std::strerror(errno);
-        throw bdf::stream_error(errno, msg);
+        // Grow in whole chunks so that a large block does not cause a
+        // reallocation for every block that follows it.
+        std::size_t chunks = (required + mReadAheadSize - 1) / mReadAheadSize;
+        mReadAhead.resize(chunks * mReadAheadSize);
     }
 
-    if (mByteSwapNeeded)
+    while ((mReadEnd < required) && !mEndOfStream)
     {
-    }
+        mFile.read(reinterpret_cast<char*>(mReadAhead.data() + mReadEnd), mReadAhead.size() - mReadEnd);
+        mReadEnd += static_cast<std::size_t>(mFile.gcount());
 
-    BLOCK_CLASS_ID_t classID = 0;;
-    BLOCK_MAJOR_VERSION_t majorVersion = 0;
-    BLOCK_MINOR_VERSION_t minorVersion = 0;
-    BLOCK_DATA_ID_t data_id = 0;
+        if (mFile.bad())
+        {
+            std::string msg = "I/O error while reading block data: ";
+            msg += std::strerror(errno);
+            throw bdf::stream_error(errno, msg);
+        }
 
-    mFile.read(reinterpret_cast<char*>(&classID), sizeof(classID));;
-    if (mFile.bad())
-    {
-        std::string msg = "I/O error while reading class id: ";
-        msg += std::strerror(errno);
-        throw bdf::stream_error(errno, msg);
+        if (mFile.eof())
+        {
+            // The short read is expected at the end of the file, the blocks
+            // still in the buffer have to be processed.
+            mFile.clear();
+            mEndOfStream = true;
+        }
     }
 
-    mFile.read(reinterpret_cast<char*>(&majorVersion), sizeof(majorVersion));;
-    if (mFile.bad())
-    {
-        std::string msg = "I/O error while reading major version: ";
-        msg += std::strerror(errno);
-        throw bdf::stream_error(errno, msg);
-    }
+    return (mReadEnd - mReadPos) >= required;
+}
 
-    mFile.read(reinterpret_cast<char*>(&minorVersion), sizeof(minorVersion));;
-    if (mFile.bad())
+bool v1::cBlockDataFileReader::processBlock()
+{
+    if (mEof)
+        return false;
+
+    if (mFile.fail())
     {
-        std::string msg = "I/O error while reading minor version: ";
-        msg += std::strerror(errno);
-        throw bdf::stream_error(errno, msg);
+        throw bdf::formatting_error("I/O error while processing block.");
     }
 
-    mFile.read(reinterpret_cast<char*>(&data_id), sizeof(data_id));
-    if (mFile.bad())
+    if (!fillReadAhead(BLOCK_HEADER_SIZE))
     {
-        std::string msg = "I/O error while reading data id: ";
-        msg += std::strerror(errno);
-        throw bdf::stream_error(errno, msg);
+        mEof = true;
+        return false;
     }
 
+    const std::byte* header = mReadAhead.data() + mReadPos;
+
+    std::uint32_t len = 0;
+    BLOCK_CLASS_ID_t classID = 0;
+    BLOCK_MAJOR_VERSION_t majorVersion = 0;
+    BLOCK_MINOR_VERSION_t minorVersion = 0;
+    BLOCK_DATA_ID_t data_id = 0;
+
+    std::memcpy(&len, header, sizeof(len));
+    header += sizeof(len);
+    std::memcpy(&classID, header, sizeof(classID));
+    header += sizeof(classID);
+    std::memcpy(&majorVersion, header, sizeof(majorVersion));
+    header += sizeof(majorVersion);
+    std::memcpy(&minorVersion, header, sizeof(minorVersion));
+    header += sizeof(minorVersion);
+    std::memcpy(&data_id, header, sizeof(data_id));
 
     if (mByteSwapNeeded)
     {
@@ -376,79 +440,59 @@ bool v1::cBlockDataFileReader::processBlock()
     cBlockID blockId(static_cast<ClassIDs>(classID), majorVersion, minorVersion);
     blockId.dataID(data_id);
 
-    if (len == 0)
-    {
-        uint32_t file_crc = 0;
-        mFile.read(reinterpret_cast<char*>(&file_crc), sizeof(file_crc));
-        if (mFile.bad())
-        {
-            std::string msg = "I/O error while reading file CRC: ";
-            msg += std::strerror(errno);
-            throw bdf::stream_error(errno, msg);
-        }
+    const std::size_t blockSize = BLOCK_HEADER_SIZE + static_cast<std::size_t>(len) + sizeof(uint32_t);
 
-        if (file_crc != crc(blockId))
-        {
-            std::string msg = "CRC failure: Class ID=";
-            msg += std::to_string(classID);
-            msg += ", Major Version=";
-            msg += std::to_string(majorVersion);
-            msg += ", Minor Version=";
-            msg += std::to_string(minorVersion);
-            msg += ", Data ID=";
-            msg += std::to_string(data_id);
-            msg += ", Data Lenth=0";
-            throw bdf::crc_error(classID, majorVersion, minorVersion, data_id, msg);
-        }
-
-        mBuffer.reset();
-    }
-    else
+    if (!fillReadAhead(blockSize))
     {
-        if (mBuffer.capacity() < len)
-        {
-            mBuffer.capacity(len);
-        }
+        // The block was cut off by the end of the file
+        mReadPos = mReadEnd;
+        mEof = true;
+
+        std::string msg = "Truncated block: Class ID=";
+        msg += std::to_string(classID);
+        msg += ", Major Version=";
+        msg += std::to_string(majorVersion);
+        msg += ", Minor Version=";
+        msg += std::to_string(minorVersion);
+        msg += ", Data ID=";
+        msg += std::to_string(data_id);
+        msg += ", Data Lenth=";
+        msg += std::to_string(len);
+        throw bdf::crc_error(classID, majorVersion, minorVersion, data_id, msg);
+    }
 
-        mBuffer.reset();
-        mFile.read(reinterpret_cast<char*>(mBuffer.data(len)), len);
-        if (mFile.bad())
-        {
-            std::string msg = "I/O error while reading block data: ";
-            msg += std::strerror(errno);
-            throw bdf::stream_error(errno, msg);
-        }
+    std::byte* payload = mReadAhead.data() + mReadPos + BLOCK_HEADER_SIZE;
 
-        uint32_t file_crc = 0;
-        mFile.read(reinterpret_cast<char*>(&file_crc), sizeof(file_crc));
-        if (mFile.bad())
-        {
-            std::string msg = "I/O error while reading file CRC: ";
-            msg += std::strerror(errno);
-            throw bdf::stream_error(errno, msg);
-        }
+    uint32_t file_crc = 0;
+    std::memcpy(&file_crc, payload + len, sizeof(file_crc));
 
-        uint32_t c = crc(blockId, mBuffer.data(), len);
-        if (file_crc != c)
-        {
-            std::string msg = "CRC failure: Class ID=";
-            msg += std::to_string(classID);
-            msg += ", Major Version=";
-            msg += std::to_string(majorVersion);
-            msg += ", Minor Version=";
-            msg += std::to_string(minorVersion);
-            msg += ", Data ID=";
-            msg += std::to_string(data_id);
-            msg += ", Data Lenth=";
-            msg += std::to_string(len);
-            throw bdf::crc_error(classID, majorVersion, minorVersion, data_id, msg);
-        }
+    uint32_t c = (len == 0) ? crc(blockId) : crc(blockId, payload, len);
+    if (file_crc != c)
+    {
+        mReadPos += blockSize;
+
+        std::string msg = "CRC failure: Class ID=";
+        msg += std::to_string(classID);
+        msg += ", Major Version=";
+        msg += std::to_string(majorVersion);
+        msg += ", Minor Version=";
+        msg += std::to_string(minorVersion);
+        msg += ", Data ID=";
+        msg += std::to_string(data_id);
+        msg += ", Data Lenth=";
+        msg += std::to_string(len);
+        throw bdf::crc_error(classID, majorVersion, minorVersion, data_id, msg);
     }
 
-    auto parser = mParsers.find(classID);
-    if (parser != mParsers.end())
+    // The parsers read the payload straight out of the read-ahead buffer.
+    // The buffer is not touched again until the next call to processBlock.
+    mBuffer.wrap(payload, len);
+    mReadPos += blockSize;
+
+    cBlockParser* parser = mParsers[classID];
+    if (parser)
     {
-        parser->second->processData(majorVersion, minorVersion, data_id, mBuffer);
+        parser->processData(majorVersion, minorVersion, data_id, mBuffer);
     }
     else
     {
@@ -460,10 +504,9 @@ bool v1::cBlockDataFileReader::processBlock()
         else
         {
             if (mDataBlockCallback)
-                mDataBlockCallback(blockId, mBuffer.data(), len);
+                mDataBlockCallback(blockId, payload, len);
         }
     }
 
-    return !mFile.eof();
+    return true;
 }
-
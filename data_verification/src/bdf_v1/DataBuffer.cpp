@@ -131,6 +131,7 @@ v1::cDataBuffer::cDataBuffer(v1::cDataBuffer&& objToMove) noexcept
 	mWriteIndex = objToMove.mWriteIndex;
 	mUnderrun = objToMove.mUnderrun;
 	mOverrun = objToMove.mOverrun;
+	mOwnsBuffer = objToMove.mOwnsBuffer;
 
 	objToMove.mpBuffer = nullptr;
 	objToMove.mCapacity = 0;
@@ -138,13 +139,17 @@ v1::cDataBuffer::cDataBuffer(v1::cDataBuffer&& objToMove) noexcept
 	objToMove.mWriteIndex = 0;
 	objToMove.mUnderrun = false;
 	objToMove.mOverrun = false;
+	objToMove.mOwnsBuffer = true;
 }
 
 void v1::cDataBuffer::operator=(const v1::cDataBuffer& objToCopy)
 {
-	delete[] mpBuffer;
+	if (mOwnsBuffer)
+		delete[] mpBuffer;
+
 	mpBuffer = nullptr;
 	mpBuffer = new std::byte[objToCopy.mCapacity];
+	mOwnsBuffer = true;
 
 	if (mpBuffer != nullptr)
 	{
@@ -161,7 +166,9 @@ void v1::cDataBuffer::operator=(const v1::cDataBuffer& objToCopy)
 
 v1::cDataBuffer::~cDataBuffer()
 {
-	delete[] mpBuffer;
+	if (mOwnsBuffer)
+		delete[] mpBuffer;
+
 	mpBuffer = nullptr;
 
 	mReadIndex = 0;
@@ -220,12 +227,14 @@ void v1::cDataBuffer::capacity(size_type capacity)
 		{
 			memcpy(pBuffer, mpBuffer, mCapacity);
 
-			delete[] mpBuffer;
+			if (mOwnsBuffer)
+				delete[] mpBuffer;
 
 			mpBuffer = pBuffer;
 			mCapacity = capacity;
 			mUnderrun = false;
 			mOverrun = false;
+			mOwnsBuffer = true;
 		}
 
 		return;
@@ -237,10 +246,12 @@ void v1::cDataBuffer::capacity(size_type capacity)
 	{
 		reset();
 
-		delete[] mpBuffer;
+		if (mOwnsBuffer)
+			delete[] mpBuffer;
 
 		mpBuffer = pBuffer;
 		mCapacity = capacity;
+		mOwnsBuffer = true;
 	}
 }
 
@@ -272,10 +283,12 @@ std::byte* v1::cDataBuffer::data(std::size_t len)
 
 void v1::cDataBuffer::attach(std::byte* buffer, std::size_t size)
 {
-	delete[] mpBuffer;
+	if (mOwnsBuffer)
+		delete[] mpBuffer;
 
 	mpBuffer = buffer;
 	mCapacity = size;
+	mOwnsBuffer = true;
 	reset();
 	mWriteIndex = size;
 }
@@ -287,12 +300,25 @@ std::byte* v1::cDataBuffer::detach()
 	// Clear our internal pointer and reset the indexes
 	mpBuffer = nullptr;
 	mCapacity = 0;
+	mOwnsBuffer = true;
 
 	reset();
 
 	return retPtr;
 }
 
+void v1::cDataBuffer::wrap(std::byte* buffer, std::size_t size)
+{
+	if (mOwnsBuffer)
+		delete[] mpBuffer;
+
+	mpBuffer = buffer;
+	mCapacity = size;
+	mOwnsBuffer = false;
+	reset();
+	mWriteIndex = size;
+}
+
 void v1::cDataBuffer::reset()
 {
 	mReadIndex = 0;
@@ -1,4 +1,6 @@
 #include "CommonFunctions.h"
+
+#include <algorithm>
   
 using namespace cv;
 using namespace std;
@@ -189,50 +191,509 @@ namespace lineFunctions
 /************************************************************************/
 
 
-void PCAFunctions::Ori_PCA( PointCloud<double> &cloud, int k, std::vector<PCAInfo> &pcaInfos, double &scale, double &magnitd )
+void VoxelNormals::Moments::add( const Moments &other )
+{
+	if ( !other.n )
+	{
+		return;
+	}
+
+	if ( !n )
+	{
+		*this = other;
+		return;
+	}
+
+	// the pairwise update of Chan et al., stable for any distance between the means
+	double total = double(n) + other.n;
+	double d[3] = { other.mean[0] - mean[0], other.mean[1] - mean[1], other.mean[2] - mean[2] };
+	double f = double(n) * other.n / total;
+
+	m2[0] += other.m2[0] + d[0]*d[0]*f;
+	m2[1] += other.m2[1] + d[0]*d[1]*f;
+	m2[2] += other.m2[2] + d[0]*d[2]*f;
+	m2[3] += other.m2[3] + d[1]*d[1]*f;
+	m2[4] += other.m2[4] + d[1]*d[2]*f;
+	m2[5] += other.m2[5] + d[2]*d[2]*f;
+
+	for ( int j=0; j<3; ++j )
+	{
+		mean[j] += d[j] * other.n / total;
+	}
+	n += other.n;
+}
+
+int VoxelNormals::estimate( const PointCloud<float> &cloud, double voxelSize, int minPoints,
+	std::vector<cv::Matx31d> &normals, std::vector<double> &lambda0, std::vector<char> &stable )
+{
+	int pointNum = cloud.pts.size();
+	stable.assign( pointNum, 0 );
+
+	if ( !pointNum || !( voxelSize > 0.0 ) )
+	{
+		return 0;
+	}
+
+	// 1. the fine voxels of the points, and the coarse voxels of the fine ones
+	Voxels coarse;
+	std::vector<int> fineToCoarse;
+
+	// a cloud too large for the voxel indices has no stable points
+	if ( !voxelize( cloud, voxelSize ) )
+	{
+		return 0;
+	}
+	coarsen( mFine, coarse, fineToCoarse );
+
+	// 2. PCA of the blocks of both sizes
+	std::vector<int> fineCounts, coarseCounts;
+	std::vector<cv::Matx31d> fineNormals, coarseNormals;
+	std::vector<double> fineLambda0, coarseLambda0;
+	blockPCA( mFine, fineCounts, fineNormals, fineLambda0 );
+	blockPCA( coarse, coarseCounts, coarseNormals, coarseLambda0 );
+
+	// 3. the stability check of each point
+	double cosMaxAngle = cos( mMaxAngle );
+	int numStable = 0;
+#pragma omp parallel for reduction(+:numStable)
+	for ( int i=0; i<pointNum; ++i )
+	{
+		int f = mPointVoxel[i];
+		int c = fineToCoarse[f];
+
+		if ( fineCounts[f] < minPoints || coarseCounts[c] < minPoints )
+		{
+			continue;
+		}
+
+		if ( fineLambda0[f] > mMaxCurvature || coarseLambda0[c] > mMaxCurvature )
+		{
+			continue;
+		}
+
+		if ( fabs( fineNormals[f].dot( coarseNormals[c] ) ) < cosMaxAngle )
+		{
+			continue;
+		}
+
+		stable[i] = 1;
+		normals[i] = fineNormals[f];
+		lambda0[i] = fineLambda0[f];
+		++numStable;
+	}
+
+	return numStable;
+}
+
+bool VoxelNormals::voxelize( const PointCloud<float> &cloud, double voxelSize )
+{
+	int pointNum = cloud.pts.size();
+
+	// the origin keeps the voxel indices positive
+	double origin[3] = { cloud.pts[0].x, cloud.pts[0].y, cloud.pts[0].z };
+	for ( const auto &pt : cloud.pts )
+	{
+		origin[0] = std::min<double>( origin[0], pt.x );
+		origin[1] = std::min<double>( origin[1], pt.y );
+		origin[2] = std::min<double>( origin[2], pt.z );
+	}
+
+	// sort the points by voxel
+	std::vector<std::pair<uint64_t,int> > keys( pointNum );
+	bool overflow = false;
+#pragma omp parallel for reduction(||:overflow)
+	for ( int i=0; i<pointNum; ++i )
+	{
+		int64_t ix = int64_t( floor( ( cloud.pts[i].x - origin[0] ) / voxelSize ) );
+		int64_t iy = int64_t( floor( ( cloud.pts[i].y - origin[1] ) / voxelSize ) );
+		int64_t iz = int64_t( floor( ( cloud.pts[i].z - origin[2] ) / voxelSize ) );
+
+		overflow = overflow || ix > MAXINDEX || iy > MAXINDEX || iz > MAXINDEX;
+		keys[i] = std::make_pair( voxelKey( ix, iy, iz ), i );
+	}
+
+	if ( overflow )
+	{
+		return false;
+	}
+
+	std::sort( keys.begin(), keys.end() );
+
+	mVoxelSize = voxelSize;
+	mPointVoxel.resize( pointNum );
+	mOrder.resize( pointNum );
+	mFine.keys.clear();
+	mFirst.clear();
+	for ( int i=0; i<pointNum; ++i )
+	{
+		if ( mFine.keys.empty() || mFine.keys.back() != keys[i].first )
+		{
+			mFine.keys.push_back( keys[i].first );
+			mFirst.push_back( i );
+		}
+		mPointVoxel[keys[i].second] = mFine.keys.size() - 1;
+		mOrder[i] = keys[i].second;
+	}
+	mFirst.push_back( pointNum );
+
+	// the moments of each voxel, about its own mean
+	int voxelNum = mFine.keys.size();
+	mFine.moments.assign( voxelNum, Moments() );
+#pragma omp parallel for
+	for ( int v=0; v<voxelNum; ++v )
+	{
+		Moments &m = mFine.moments[v];
+		m.n = mFirst[v+1] - mFirst[v];
+
+		for ( int j=mFirst[v]; j<mFirst[v+1]; ++j )
+		{
+			const auto &pt = cloud.pts[mOrder[j]];
+			m.mean[0] += pt.x;  m.mean[1] += pt.y;  m.mean[2] += pt.z;
+		}
+		m.mean[0] *= 1.0/m.n;  m.mean[1] *= 1.0/m.n;  m.mean[2] *= 1.0/m.n;
+
+		for ( int j=mFirst[v]; j<mFirst[v+1]; ++j )
+		{
+			const auto &pt = cloud.pts[mOrder[j]];
+			double dx = pt.x - m.mean[0], dy = pt.y - m.mean[1], dz = pt.z - m.mean[2];
+
+			m.m2[0] += dx*dx; m.m2[1] += dx*dy; m.m2[2] += dx*dz;
+			m.m2[3] += dy*dy; m.m2[4] += dy*dz;
+			m.m2[5] += dz*dz;
+		}
+	}
+
+	return true;
+}
+
+void VoxelNormals::coarsen( const Voxels &fine, Voxels &coarse, std::vector<int> &fineToCoarse )
+{
+	int fineNum = fine.keys.size();
+
+	// the voxels twice as large, from the moments of the fine voxels they hold
+	std::vector<std::pair<uint64_t,int> > keys( fineNum );
+	for ( int v=0; v<fineNum; ++v )
+	{
+		uint64_t key = fine.keys[v];
+		keys[v] = std::make_pair( voxelKey( key >> ( 2*BITS + 1 ), ( ( key >> BITS ) & MAXINDEX ) >> 1, ( key & MAXINDEX ) >> 1 ), v );
+	}
+	std::sort( keys.begin(), keys.end() );
+
+	fineToCoarse.resize( fineNum );
+	coarse.keys.clear();
+	coarse.moments.clear();
+	for ( int j=0; j<fineNum; ++j )
+	{
+		if ( coarse.keys.empty() || coarse.keys.back() != keys[j].first )
+		{
+			coarse.keys.push_back( keys[j].first );
+			coarse.moments.push_back( Moments() );
+		}
+		coarse.moments.back().add( fine.moments[keys[j].second] );
+		fineToCoarse[keys[j].second] = coarse.keys.size() - 1;
+	}
+}
+
+void VoxelNormals::blockPCA( const Voxels &voxels, std::vector<int> &counts,
+	std::vector<cv::Matx31d> &normals, std::vector<double> &lambda0 )
+{
+	double MINVALUE = 1e-7;
+	int voxelNum = voxels.keys.size();
+
+	counts.resize( voxelNum );
+	normals.resize( voxelNum );
+	lambda0.resize( voxelNum );
+#pragma omp parallel for
+	for ( int v=0; v<voxelNum; ++v )
+	{
+		int64_t ix = int64_t( voxels.keys[v] >> ( 2*BITS ) );
+		int64_t iy = int64_t( ( voxels.keys[v] >> BITS ) & MAXINDEX );
+		int64_t iz = int64_t( voxels.keys[v] & MAXINDEX );
+
+		Moments block;
+		for ( int64_t x = std::max<int64_t>( ix-1, 0 ); x <= std::min( ix+1, MAXINDEX ); ++x )
+		{
+			for ( int64_t y = std::max<int64_t>( iy-1, 0 ); y <= std::min( iy+1, MAXINDEX ); ++y )
+			{
+				auto range = column( voxels, x, y, iz );
+				for ( int c=range.first; c<range.second; ++c )
+				{
+					block.add( voxels.moments[c] );
+				}
+			}
+		}
+
+		cv::Matx33d h_cov(
+			block.m2[0], block.m2[1], block.m2[2],
+			block.m2[1], block.m2[3], block.m2[4],
+			block.m2[2], block.m2[4], block.m2[5]);
+		h_cov *= 1.0/block.n;
+
+		// eigenvector
+		cv::Matx33d h_cov_evectors;
+		cv::Matx31d h_cov_evals;
+		cv::eigen( h_cov, h_cov_evals, h_cov_evectors );
+
+		double t = h_cov_evals.row(0).val[0] + h_cov_evals.row(1).val[0] + h_cov_evals.row(2).val[0] + MINVALUE;
+		counts[v] = block.n;
+		lambda0[v] = h_cov_evals.row(2).val[0] / t;
+		normals[v] = h_cov_evectors.row(2).t();
+	}
+}
+
+
+std::pair<int,int> VoxelNormals::column( const Voxels &voxels, int64_t x, int64_t y, int64_t z ) const
+{
+	// the voxels of a column follow each other in the key order
+	uint64_t keyFirst = voxelKey( x, y, std::max<int64_t>( z-1, 0 ) );
+	uint64_t keyLast = voxelKey( x, y, std::min( z+1, MAXINDEX ) );
+
+	auto first = std::lower_bound( voxels.keys.begin(), voxels.keys.end(), keyFirst );
+	auto last = first;
+	while ( last != voxels.keys.end() && *last <= keyLast )
+	{
+		++last;
+	}
+	return std::make_pair( int( first - voxels.keys.begin() ), int( last - voxels.keys.begin() ) );
+}
+
+void VoxelNormals::blockNeighbors( const PointCloud<float> &cloud, int k, const std::vector<char> &stable,
+	std::vector<int> &neighbors, std::vector<int> &counts )
+{
+	// a point outside of the block is at least a voxel away, less a margin for the rounding of the voxel indices
+	float maxDistance = float( 0.99 * mVoxelSize );
+	float maxDistance2 = maxDistance * maxDistance;
+
+	int voxelNum = mFine.keys.size();
+#pragma omp parallel
+	{
+		// the points of a block, which are the candidates of every point of its voxel
+		std::vector<int> candidates;
+		std::vector<float> cx, cy, cz, d2;
+		std::vector<std::pair<float,int> > distances;
+
+#pragma omp for schedule(dynamic, 256)
+		for ( int v=0; v<voxelNum; ++v )
+		{
+			if ( std::none_of( mOrder.begin() + mFirst[v], mOrder.begin() + mFirst[v+1], [&]( int i ) { return stable[i]; } ) )
+			{
+				continue;
+			}
+
+			int64_t ix = int64_t( mFine.keys[v] >> ( 2*BITS ) );
+			int64_t iy = int64_t( ( mFine.keys[v] >> BITS ) & MAXINDEX );
+			int64_t iz = int64_t( mFine.keys[v] & MAXINDEX );
+
+			candidates.clear();
+			for ( int64_t x = std::max<int64_t>( ix-1, 0 ); x <= std::min( ix+1, MAXINDEX ); ++x )
+			{
+				for ( int64_t y = std::max<int64_t>( iy-1, 0 ); y <= std::min( iy+1, MAXINDEX ); ++y )
+				{
+					auto range = column( mFine, x, y, iz );
+					candidates.insert( candidates.end(), mOrder.begin() + mFirst[range.first], mOrder.begin() + mFirst[range.second] );
+				}
+			}
+
+			int candidateNum = candidates.size();
+			if ( candidateNum < k )
+			{
+				continue;
+			}
+
+			cx.resize( candidateNum );  cy.resize( candidateNum );  cz.resize( candidateNum );  d2.resize( candidateNum );
+			distances.resize( candidateNum );
+			for ( int c=0; c<candidateNum; ++c )
+			{
+				const auto &other = cloud.pts[candidates[c]];
+				cx[c] = other.x;  cy[c] = other.y;  cz[c] = other.z;
+			}
+
+			float radius2 = maxDistance2;
+			for ( int j=mFirst[v]; j<mFirst[v+1]; ++j )
+			{
+				int i = mOrder[j];
+				if ( !stable[i] )
+				{
+					continue;
+				}
+
+				// the squared distances in float, as the k-d tree computes them
+				float px = cloud.pts[i].x, py = cloud.pts[i].y, pz = cloud.pts[i].z;
+				for ( int c=0; c<candidateNum; ++c )
+				{
+					float dx = cx[c] - px, dy = cy[c] - py, dz = cz[c] - pz;
+					d2[c] = dx*dx + dy*dy + dz*dz;
+				}
+
+				// any radius within a voxel that holds k candidates makes the search
+				// exact; they are kept without a branch, as many of them fail
+				auto keep = [&]( float limit2 )
+				{
+					int num = 0;
+					for ( int c=0; c<candidateNum; ++c )
+					{
+						distances[num] = std::make_pair( d2[c], candidates[c] );
+						num += d2[c] < limit2;
+					}
+					return num;
+				};
+
+				int num = keep( radius2 );
+				if ( num < k && radius2 < maxDistance2 )
+				{
+					num = keep( maxDistance2 );
+				}
+
+				if ( num < k )
+				{
+					continue;
+				}
+
+				std::nth_element( distances.begin(), distances.begin() + k-1, distances.begin() + num );
+				std::sort( distances.begin(), distances.begin() + k );
+
+				for ( int m=0; m<k; ++m )
+				{
+					neighbors[size_t(i) * k + m] = distances[m].second;
+				}
+				counts[i] = k;
+
+				// the points of a voxel have about the same kth distance
+				radius2 = std::min( maxDistance2, 1.44f * distances[k-1].first );
+			}
+		}
+	}
+}
+
+void NeighborhoodCache::build( const PointCloud<float> &cloud, int k, bool voxelNormals )
 {
 	double MINVALUE = 1e-7;
+	int SCALE_SAMPLE_STEP = 16;
 	int pointNum = cloud.pts.size();
 
+	mOffsets.assign( pointNum + 1, 0 );
+	mNeighbors.resize( size_t(pointNum) * k );
+	mLambda0.resize( pointNum );
+	mScale.resize( pointNum );
+	mNormal.resize( pointNum );
+	mMeanScale = 0.0;
+	mMagnitd = 0.0;
+
+	if ( !pointNum )
+	{
+		return;
+	}
+
 	// 1. build kd-tree
-	typedef KDTreeSingleIndexAdaptor<L2_Simple_Adaptor<double, PointCloud<double>>, PointCloud<double>, 3/*dim*/ > my_kd_tree_t;
+	typedef KDTreeSingleIndexAdaptor<L2_Simple_Adaptor<float, PointCloud<float>>, PointCloud<float>, 3/*dim*/ > my_kd_tree_t;
 	my_kd_tree_t index(3 /*dim*/, cloud, KDTreeSingleIndexAdaptorParams(10 /* max leaf */) );
 	index.buildIndex();
 
-	// 2. knn search
-	size_t *out_ks = new size_t[pointNum];
-	size_t **out_indices = new size_t *[pointNum];
-#pragma omp parallel for
-	for (int i=0; i<pointNum; ++i)
+	// 2. the normals of the planar regions and their neighbours from the voxels.
+	// The voxel size comes from the scale of a sample of the points, the scale
+	// of each point is only known once it has its neighbours.  A fine voxel
+	// holds about k/2 points of a surface and its block about 4k.
+	std::vector<int> counts( pointNum, 0 );
+	std::vector<char> stable( pointNum, 0 );
+	mNumVoxelNormals = 0;
+	mNumVoxelNeighbors = 0;
+	if ( voxelNormals )
+	{
+		double sampleScale = 0.0;
+		int sampleNum = 0;
+		for ( int i=0; i<pointNum; i+=SCALE_SAMPLE_STEP )
+		{
+			size_t out_indices[4];
+			float dis_temp[4];
+			float query_pt[3] = { cloud.pts[i].x, cloud.pts[i].y, cloud.pts[i].z };
+
+			nanoflann::KNNResultSet<float> resultSet(4);
+			resultSet.init( out_indices, dis_temp );
+			index.findNeighbors(resultSet, query_pt, nanoflann::SearchParams(10));
+
+			sampleScale += sqrt( double( dis_temp[resultSet.size() - 1] ) );
+			++sampleNum;
+		}
+		sampleScale /= sampleNum;
+
+		VoxelNormals voxels;
+		mNumVoxelNormals = voxels.estimate( cloud, 0.75 * sqrt(double(k)) * sampleScale, k, mNormal, mLambda0, stable );
+		voxels.blockNeighbors( cloud, k, stable, mNeighbors, counts );
+
+		mNumVoxelNeighbors = pointNum - std::count( counts.begin(), counts.end(), 0 );
+	}
+
+	// 3. knn search of the other points, k slots per point until the counts are known
+#pragma omp parallel
 	{
-		double *query_pt = new double[3];
-		query_pt[0] = cloud.pts[i].x;  query_pt[1] = cloud.pts[i].y;  query_pt[2] = cloud.pts[i].z;
-		double *dis_temp = new double[k];
-		out_indices[i]= new size_t[k];
+		std::vector<size_t> out_indices( k );
+		std::vector<float> dis_temp( k );
+
+#pragma omp for schedule(dynamic, 1024)
+		for (int i=0; i<pointNum; ++i)
+		{
+			if ( counts[i] )
+			{
+				continue;
+			}
 
-		nanoflann::KNNResultSet<double> resultSet(k);
-		resultSet.init(out_indices[i], dis_temp );
-		index.findNeighbors(resultSet, &query_pt[0], nanoflann::SearchParams(10));
-		out_ks[i] = resultSet.size();
+			float query_pt[3] = { cloud.pts[i].x, cloud.pts[i].y, cloud.pts[i].z };
 
-		delete query_pt;
-		delete dis_temp;
+			nanoflann::KNNResultSet<float> resultSet(k);
+			resultSet.init( out_indices.data(), dis_temp.data() );
+			index.findNeighbors(resultSet, query_pt, nanoflann::SearchParams(10));
+
+			counts[i] = resultSet.size();
+			for ( int j=0; j<counts[i]; ++j )
+			{
+				mNeighbors[size_t(i) * k + j] = out_indices[j];
+			}
+		}
 	}
 	index.freeIndex(index);
 
-	// 3. PCA normal estimation
-	scale = 0.0;
-	pcaInfos.resize( pointNum );
-#pragma omp parallel for
+	// only a cloud of fewer than k points leaves slots empty
+	for ( int i=0; i<pointNum; ++i )
+	{
+		mOffsets[i+1] = mOffsets[i] + counts[i];
+		if ( mOffsets[i] != i * k )
+		{
+			std::copy_n( mNeighbors.begin() + size_t(i) * k, counts[i], mNeighbors.begin() + mOffsets[i] );
+		}
+	}
+	mNeighbors.resize( mOffsets[pointNum] );
+
+	// 4. the scale, the distance to the 4th neighbour, the first is the point itself
+	double scale = 0.0;
+#pragma omp parallel for reduction(+:scale)
+	for ( int i = 0; i < pointNum; ++i )
+	{
+		int idx = neighbors(i)[std::min(3, numNeighbors(i) - 1)];
+		double dx = double(cloud.pts[idx].x) - cloud.pts[i].x;
+		double dy = double(cloud.pts[idx].y) - cloud.pts[i].y;
+		double dz = double(cloud.pts[idx].z) - cloud.pts[i].z;
+		mScale[i] = sqrt(dx*dx + dy*dy + dz*dz);
+		scale += mScale[i];
+	}
+	mMeanScale = scale / pointNum;
+
+	// 5. PCA normal estimation of the other points
+#pragma omp parallel for schedule(dynamic, 1024)
 	for ( int i = 0; i < pointNum; ++i ) 
 	{
-		// 
-		int ki = out_ks[i];
+		if ( stable[i] )
+		{
+			continue;
+		}
 
+		int ki = numNeighbors(i);
+		const int *idxs = neighbors(i);
+
+		// The clouds are float32, the PCA itself runs in double
 		double h_mean_x = 0.0, h_mean_y = 0.0, h_mean_z = 0.0;
 		for( int j = 0; j < ki; ++j )
 		{
-			int idx = out_indices[i][j];
+			int idx = idxs[j];
 			h_mean_x += cloud.pts[idx].x;
 			h_mean_y += cloud.pts[idx].y;
 			h_mean_z += cloud.pts[idx].z;
@@ -243,9 +704,9 @@ void PCAFunctions::Ori_PCA( PointCloud<double> &cloud, int k, std::vector<PCAInf
 		double h_cov_5 = 0.0, h_cov_6 = 0.0;
 		double h_cov_9 = 0.0;
 		double dx = 0.0, dy = 0.0, dz = 0.0;
-		for( int j = 0; j < k; ++j )
+		for( int j = 0; j < ki; ++j )
 		{
-			int idx = out_indices[i][j];
+			int idx = idxs[j];
 			dx = cloud.pts[idx].x - h_mean_x;
 			dy = cloud.pts[idx].y - h_mean_y;
 			dz = cloud.pts[idx].z - h_mean_z;
@@ -265,61 +726,43 @@ void PCAFunctions::Ori_PCA( PointCloud<double> &cloud, int k, std::vector<PCAInf
 		cv::Matx31d h_cov_evals;
 		cv::eigen( h_cov, h_cov_evals, h_cov_evectors );
 
-		// 
-		pcaInfos[i].idxAll.resize( ki );
-		for ( int j =0; j<ki; ++j )
-		{
-			int idx = out_indices[i][j];
-			pcaInfos[i].idxAll[j] = idx;
-		}
-
-		int idx = out_indices[i][3];
-		dx = cloud.pts[idx].x - cloud.pts[i].x;
-		dy = cloud.pts[idx].y - cloud.pts[i].y;
-		dz = cloud.pts[idx].z - cloud.pts[i].z;
-		double scaleTemp = sqrt(dx*dx + dy*dy + dz*dz);
-		pcaInfos[i].scale = scaleTemp;
-		scale += scaleTemp;
-
-		//pcaInfos[i].lambda0 = h_cov_evals.row(2).val[0];
-		double t = h_cov_evals.row(0).val[0] + h_cov_evals.row(1).val[0] + h_cov_evals.row(2).val[0] + ( rand()%10 + 1 ) * MINVALUE;
-		pcaInfos[i].lambda0 = h_cov_evals.row(2).val[0] / t;
-		pcaInfos[i].normal = h_cov_evectors.row(2).t();
-
-		// outliers removal via MCMD
-		pcaInfos[i].idxIn = pcaInfos[i].idxAll;
-
-		delete out_indices[i];
+		// MINVALUE keeps the curvature of a degenerate neighbourhood finite
+		double t = h_cov_evals.row(0).val[0] + h_cov_evals.row(1).val[0] + h_cov_evals.row(2).val[0] + MINVALUE;
+		mLambda0[i] = h_cov_evals.row(2).val[0] / t;
+		mNormal[i] = h_cov_evectors.row(2).t();
 	}
-	delete []out_indices;
-	delete out_ks;
 
-	scale /= pointNum;
-	magnitd = sqrt(cloud.pts[0].x*cloud.pts[0].x + cloud.pts[0].y*cloud.pts[0].y + cloud.pts[0].z*cloud.pts[0].z);
+	double x0 = cloud.pts[0].x, y0 = cloud.pts[0].y, z0 = cloud.pts[0].z;
+	mMagnitd = sqrt(x0*x0 + y0*y0 + z0*z0);
+}
+
+bool NeighborhoodCache::isNeighbor( int i, int j ) const
+{
+	const int *first = neighbors(i);
+	const int *last = first + numNeighbors(i);
+	return std::find( first, last, j ) != last;
 }
 
 
-void PCAFunctions::PCASingle( std::vector<std::vector<double> > &pointData, PCAInfo &pcaInfo )
+void PCAFunctions::PCASingle( const PointCloud<float> &cloud, const std::vector<int> &idx, PCAInfo &pcaInfo )
 {
-	int i, j;
-	int k = pointData.size();
-	double a = 1.4826;
-	double thRz = 2.5;
+	int i;
+	int k = idx.size();
 
-	// 
-	pcaInfo.idxIn.resize( k );
+	// The clouds are float32, the PCA itself runs in double
 	cv::Matx31d h_mean( 0, 0, 0 );
 	for( i = 0; i < k; ++i )
 	{
-		pcaInfo.idxIn[i] = i;
-		h_mean += cv::Matx31d( pointData[i][0], pointData[i][1], pointData[i][2] );
+		const auto &pt = cloud.pts[idx[i]];
+		h_mean += cv::Matx31d( pt.x, pt.y, pt.z );
 	}
 	h_mean *= ( 1.0 / k );
 
 	cv::Matx33d h_cov( 0, 0, 0, 0, 0, 0, 0, 0, 0 );
 	for( i = 0; i < k; ++i )
 	{
-		cv::Matx31d hi = cv::Matx31d( pointData[i][0], pointData[i][1], pointData[i][2] );
+		const auto &pt = cloud.pts[idx[i]];
+		cv::Matx31d hi = cv::Matx31d( pt.x, pt.y, pt.z );
 		h_cov += ( hi - h_mean ) * ( hi - h_mean ).t();
 	}
 	h_cov *=( 1.0 / k );
@@ -330,17 +773,18 @@ void PCAFunctions::PCASingle( std::vector<std::vector<double> > &pointData, PCAI
 	cv::eigen( h_cov, h_cov_evals, h_cov_evectors );
 
 	// 
-	pcaInfo.idxAll = pcaInfo.idxIn;
+	pcaInfo.idxAll = idx;
+	pcaInfo.idxIn = idx;
 	//pcaInfo.lambda0 = h_cov_evals.row(2).val[0];
 	pcaInfo.lambda0 = h_cov_evals.row(2).val[0] / ( h_cov_evals.row(0).val[0] + h_cov_evals.row(1).val[0] + h_cov_evals.row(2).val[0] );
 	pcaInfo.normal  = h_cov_evectors.row(2).t();
 	pcaInfo.planePt = h_mean;
 
 	// outliers removal via MCMD
-	MCMD_OutlierRemoval( pointData, pcaInfo );	
+	MCMD_OutlierRemoval( cloud, pcaInfo );	
 }
 
-void PCAFunctions::MCMD_OutlierRemoval( std::vector<std::vector<double> > &pointData, PCAInfo &pcaInfo )
+void PCAFunctions::MCMD_OutlierRemoval( const PointCloud<float> &cloud, PCAInfo &pcaInfo )
 {
 	double a = 1.4826;
 	double thRz = 2.5;
@@ -350,17 +794,16 @@ void PCAFunctions::MCMD_OutlierRemoval( std::vector<std::vector<double> > &point
 	cv::Matx31d h_mean( 0, 0, 0 );
 	for( int j = 0; j < pcaInfo.idxIn.size(); ++j )
 	{
-		int idx = pcaInfo.idxIn[j];
-		h_mean += cv::Matx31d( pointData[idx][0], pointData[idx][1], pointData[idx][2] );
+		const auto &pt = cloud.pts[pcaInfo.idxIn[j]];
+		h_mean += cv::Matx31d( pt.x, pt.y, pt.z );
 	}
 	h_mean *= ( 1.0 / pcaInfo.idxIn.size() );
 
 	std::vector<double> ODs( num );
 	for( int j = 0; j < num; ++j )
 	{
-		int idx = pcaInfo.idxAll[j];
-		cv::Matx31d pt( pointData[idx][0], pointData[idx][1], pointData[idx][2] );
-		cv::Matx<double, 1, 1> OD_mat = ( pt - h_mean ).t() * pcaInfo.normal;
+		const auto &pt = cloud.pts[pcaInfo.idxAll[j]];
+		cv::Matx<double, 1, 1> OD_mat = ( cv::Matx31d( pt.x, pt.y, pt.z ) - h_mean ).t() * pcaInfo.normal;
 		double OD = fabs( OD_mat.val[0] );
 		ODs[j] = OD;
 	}
@@ -3,6 +3,7 @@
 #pragma once
 
 #include <opencv2/opencv.hpp>
+#include <cstdint>
 #include <vector>
 
 #include "nanoflann.hpp"
@@ -42,17 +43,143 @@ struct PCAInfo
 	}
 };
 
+/*
+ * Normals from the moments of voxels instead of the neighbours of each point.
+ * The cloud is binned into fine voxels, and into coarse voxels twice as large;
+ * the normal of a voxel is the PCA of the moments of the 3x3x3 voxels around
+ * it, and every point takes the normal of its fine voxel.  A point is stable
+ * when both its voxel blocks hold enough points, are flat to mMaxCurvature and
+ * their normals agree within mMaxAngle, that is where the surface is planar at
+ * both scales; the others, edges, corners and sparse or noisy regions, need
+ * the PCA of their k nearest neighbours.
+ */
+class VoxelNormals
+{
+public:
+	VoxelNormals(void) = default;
+	~VoxelNormals(void) = default;
+
+	// returns the number of stable points, the normals of the others are left as they are
+	int estimate( const PointCloud<float> &cloud, double voxelSize, int minPoints,
+				std::vector<cv::Matx31d> &normals, std::vector<double> &lambda0,
+				std::vector<char> &stable );
+
+	// the k nearest neighbours of the stable points of the last estimate, nearest
+	// first, from the points of the 3x3x3 block of fine voxels around each; they
+	// go to the k slots of each point in neighbors and counts is set to k.  The
+	// block reaches at least a voxel past the point, so the search is exact when
+	// the kth neighbour is nearer than that; the other points keep a count of 0
+	// and are left to the k-d tree.
+	void blockNeighbors( const PointCloud<float> &cloud, int k, const std::vector<char> &stable,
+				std::vector<int> &neighbors, std::vector<int> &counts );
+
+public:
+	double mMaxAngle = 5.0/180.0*CV_PI;
+	double mMaxCurvature = 0.02;
+
+private:
+	// the count, mean and central second moments (xx, xy, xz, yy, yz, zz) of a set of points
+	struct Moments
+	{
+		int n = 0;
+		double mean[3] = { 0.0, 0.0, 0.0 };
+		double m2[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+
+		void add( const Moments &other );
+	};
+
+	// the occupied voxels of one size, sorted by key
+	struct Voxels
+	{
+		std::vector<uint64_t> keys;
+		std::vector<Moments> moments;
+	};
+
+	// 21 bits per voxel index
+	static constexpr int BITS = 21;
+	static constexpr int64_t MAXINDEX = ( int64_t(1) << BITS ) - 1;
+
+	static uint64_t voxelKey( int64_t ix, int64_t iy, int64_t iz )
+	{
+		return ( uint64_t(ix) << ( 2*BITS ) ) | ( uint64_t(iy) << BITS ) | uint64_t(iz);
+	}
+
+	// false if the cloud spans more voxels than the keys can index
+	bool voxelize( const PointCloud<float> &cloud, double voxelSize );
+
+	void coarsen( const Voxels &fine, Voxels &coarse, std::vector<int> &fineToCoarse );
+
+	// the PCA of the 3x3x3 block of voxels around each voxel
+	void blockPCA( const Voxels &voxels, std::vector<int> &counts,
+				std::vector<cv::Matx31d> &normals, std::vector<double> &lambda0 );
+
+	// the first and one past the last fine voxel of the column x, y, z-1 to z+1
+	std::pair<int,int> column( const Voxels &voxels, int64_t x, int64_t y, int64_t z ) const;
+
+private:
+	// the fine voxels of the last estimate; the points of voxel v are
+	// mOrder[mFirst[v]] up to mOrder[mFirst[v+1]]
+	double mVoxelSize = 0.0;
+	Voxels mFine;
+	std::vector<int> mPointVoxel;
+	std::vector<int> mFirst;
+	std::vector<int> mOrder;
+};
+
+/*
+ * The k nearest neighbours of every point of a cloud and the PCA features of
+ * each neighbourhood, computed once per cloud and shared by every stage of the
+ * line detection.  The neighbours are stored in compressed sparse row form:
+ * those of point i, nearest first, are mNeighbors[mOffsets[i]] up to
+ * mNeighbors[mOffsets[i+1]].
+ */
+class NeighborhoodCache
+{
+public:
+	NeighborhoodCache(void) = default;
+	~NeighborhoodCache(void) = default;
+
+	// voxelNormals takes the normals and the neighbours of the planar regions
+	// from VoxelNormals, only the other points search the k-d tree and run the
+	// PCA of their neighbours
+	void build( const PointCloud<float> &cloud, int k, bool voxelNormals = false );
+
+	int size() const { return mLambda0.size(); }
+
+	int numNeighbors( int i ) const { return mOffsets[i+1] - mOffsets[i]; }
+	const int *neighbors( int i ) const { return mNeighbors.data() + mOffsets[i]; }
+
+	// true if j is one of the k nearest neighbours of i
+	bool isNeighbor( int i, int j ) const;
+
+	double lambda0( int i ) const { return mLambda0[i]; }
+	double scale( int i ) const { return mScale[i]; }
+	const cv::Matx31d &normal( int i ) const { return mNormal[i]; }
+
+public:
+	double mMeanScale = 0.0;
+	double mMagnitd = 0.0;
+	int mNumVoxelNormals = 0;
+	int mNumVoxelNeighbors = 0;
+
+	std::vector<int> mOffsets;
+	std::vector<int> mNeighbors;
+
+	std::vector<double> mLambda0;
+	std::vector<double> mScale;
+	std::vector<cv::Matx31d> mNormal;
+};
+
 class PCAFunctions 
 {
 public:
 	PCAFunctions(void) = default;
 	~PCAFunctions(void) = default;
 
-	void Ori_PCA( PointCloud<double> &cloud, int k, std::vector<PCAInfo> &pcaInfos, double &scale, double &magnitd );
-
-	void PCASingle( std::vector<std::vector<double> > &pointData, PCAInfo &pcaInfo );
+	// idx are points of the cloud, so are the idxAll and idxIn of the result
+	void PCASingle( const PointCloud<float> &cloud, const std::vector<int> &idx, PCAInfo &pcaInfo );
 
-	void MCMD_OutlierRemoval( std::vector<std::vector<double> > &pointData, PCAInfo &pcaInfo );
+	void MCMD_OutlierRemoval( const PointCloud<float> &cloud, PCAInfo &pcaInfo );
 
 	double median(std::vector<double> dataset);
 };
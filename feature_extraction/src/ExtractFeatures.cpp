@@ -1,18 +1,21 @@
 
 #include "ExtractFeatures.hpp"
+#include "TiledLineDetection.hpp"
 #include "PointCloudTypes.hpp"
 
 #include "nanoflann.hpp"
 #include "utils.h"
 
-#include <tinyply.h>
+#include "PlyWriter.hpp"
 
 #include <iostream>
 
 
-//#define USE_BINARY
-
 bool cExtractFeatures::mIndividualPlyFiles = false;
+bool cExtractFeatures::mPlyUseBinaryFormat = true;
+double cExtractFeatures::mTileSize_m = 0.0;
+double cExtractFeatures::mTileOverlap_m = 2.0;
+bool cExtractFeatures::mVoxelNormals = false;
 
 
 cExtractFeatures::cExtractFeatures() : cPointCloudParser()
@@ -122,14 +125,14 @@ void cExtractFeatures::onPointCloudData(uint16_t frameID, uint64_t timestamp_ns,
     std::vector<uint3>    returns;
     std::vector<uint16_t> frameIDs;
 
-    PointCloud<double> cloud;
+    PointCloud<float> cloud;
 
     for (const auto& point : cloud_data)
     {
         if ((point.X_m == 0) && (point.Y_m == 0) && (point.Z_m == 0))
             continue;
 
-        cloud.pts.push_back(PointCloud<double>::PtData(point.X_m, point.Y_m, point.Z_m));
+        cloud.pts.push_back(PointCloud<float>::PtData(point.X_m, point.Y_m, point.Z_m));
 
         float3 xyz;
         xyz.x = point.X_m;
@@ -156,9 +159,10 @@ void cExtractFeatures::onPointCloudData(uint16_t frameID, uint64_t timestamp_ns,
 
     int k = 20;
     LineDetection3D detector;
+    detector.mVoxelNormals = mVoxelNormals;
     std::vector<PLANE> planes;
     std::vector<std::vector<cv::Point3d>> lines;
-    detector.run(cloud, k, planes, lines);
+    detector.run(std::move(cloud), k, planes, lines);
 
     if (mIndividualPlyFiles)
     {
@@ -185,6 +189,17 @@ void cExtractFeatures::onPointCloudData(uint16_t frameID, uint64_t timestamp_ns,
             writeLineFile(filename, lines, detector.mScale);
         }
 
+        // Write out the table of the detected planes and lines
+        {
+            std::filesystem::path filename = mOutputPath;
+
+            std::string ext = std::to_string(mFrameCount);
+            ext += ".features.ply";
+
+            filename.replace_extension(ext);
+            writeFeatureFile(filename, planes, lines);
+        }
+
         // Write out the main frame point clound
         {
             std::filesystem::path filename = mOutputPath;
@@ -236,6 +251,19 @@ void cExtractFeatures::onPointCloudData(cPointCloud pointCloud)
         returns.push_back(data);
     }
 
+    if (mTileSize_m > 0.0)
+    {
+        PointCloud<float> cloud;
+        cloud.pts.reserve(vertices.size());
+
+        for (const auto& xyz : vertices)
+        {
+            cloud.pts.push_back(PointCloud<float>::PtData(xyz.x, xyz.y, xyz.z));
+        }
+
+        detectTiledFeatures(cloud);
+    }
+
     mVertices.insert(mVertices.end(), vertices.begin(), vertices.end());
     mRanges.insert(mRanges.end(), ranges.begin(), ranges.end());
     mReturns.insert(mReturns.end(), returns.begin(), returns.end());
@@ -261,48 +289,73 @@ void cExtractFeatures::onPointCloudData(cPointCloud_FrameId pointCloud)
 void cExtractFeatures::onPointCloudData(cPointCloud_SensorInfo pointCloud)
 {}
 
+void cExtractFeatures::detectTiledFeatures(const PointCloud<float>& cloud)
+{
+    cTiledLineDetection detector;
+    detector.setTileSize(mTileSize_m);
+    detector.setOverlap(mTileOverlap_m);
+    detector.setVoxelNormals(mVoxelNormals);
+
+    std::vector<PLANE> planes;
+    std::vector<std::vector<cv::Point3d>> lines;
+    detector.run(cloud, planes, lines);
+
+    // Write out the detected planes of the whole cloud
+    {
+        std::filesystem::path filename = mOutputPath;
+
+        std::string ext = std::to_string(mFrameCount);
+        ext += ".planes.ply";
+
+        filename.replace_extension(ext);
+        writePlaneFile(filename, planes, detector.scale());
+    }
+
+    // Write out the detected lines of the whole cloud
+    {
+        std::filesystem::path filename = mOutputPath;
+
+        std::string ext = std::to_string(mFrameCount);
+        ext += ".lines.ply";
+
+        filename.replace_extension(ext);
+        writeLineFile(filename, lines, detector.scale());
+    }
+
+    // Write out the table of the detected planes and lines
+    {
+        std::filesystem::path filename = mOutputPath;
+
+        std::string ext = std::to_string(mFrameCount);
+        ext += ".features.ply";
+
+        filename.replace_extension(ext);
+        writeFeatureFile(filename, planes, lines);
+    }
+}
+
 void cExtractFeatures::writePlyFile(std::filesystem::path filename)
 {
     using namespace tinyply;
 
-#ifdef USE_BINARY
-    std::filebuf binary_buffer;
-    binary_buffer.open(filename, std::ios::out | std::ios::binary);
-    std::ostream outstream_binary(&binary_buffer);
-    if (outstream_binary.fail())
-        throw std::runtime_error("failed to open " + filename.string());
-#else
-    std::filebuf fb_ascii;
-    fb_ascii.open(filename, std::ios::out);
-    std::ostream outstream_ascii(&fb_ascii);
-    if (outstream_ascii.fail()) 
-        throw std::runtime_error("failed to open " + filename.string());
-#endif
-
-    PlyFile ply_file;
+    cPlyWriter ply_file(mPlyUseBinaryFormat);
 
-    ply_file.add_properties_to_element("vertex", { "x", "y", "z" },
-        Type::FLOAT32, mVertices.size(), reinterpret_cast<uint8_t*>(mVertices.data()), Type::INVALID, 0);
+    ply_file.addProperties("vertex", { "x", "y", "z" },
+        Type::FLOAT32, mVertices.size(), mVertices.data());
 
-    ply_file.add_properties_to_element("vertex", { "range_mm" },
-        Type::UINT32, mRanges.size(), reinterpret_cast<uint8_t*>(mRanges.data()), Type::INVALID, 0);
+    ply_file.addProperties("vertex", { "range_mm" },
+        Type::UINT32, mRanges.size(), mRanges.data());
 
-    ply_file.add_properties_to_element("vertex", { "intensity", "reflectivity", "ambient_noise" },
-        Type::UINT16, mReturns.size(), reinterpret_cast<uint8_t*>(mReturns.data()), Type::INVALID, 0);
+    ply_file.addProperties("vertex", { "intensity", "reflectivity", "ambient_noise" },
+        Type::UINT16, mReturns.size(), mReturns.data());
 
     if (!mFrameIDs.empty())
     {
-        ply_file.add_properties_to_element("vertex", { "frame_id" },
-            Type::UINT16, mFrameIDs.size(), reinterpret_cast<uint8_t*>(mFrameIDs.data()), Type::INVALID, 0);
+        ply_file.addProperties("vertex", { "frame_id" },
+            Type::UINT16, mFrameIDs.size(), mFrameIDs.data());
     }
 
-#ifdef USE_BINARY
-    // Write a binary file
-    ply_file.write(outstream_binary, true);
-#else
-    // Write an ASCII file
-    ply_file.write(outstream_ascii, false);
-#endif
+    ply_file.write(filename);
 
     mVertices.clear();
     mRanges.clear();
@@ -368,42 +421,18 @@ void cExtractFeatures::writePlaneFile(std::filesystem::path filename,
 
     using namespace tinyply;
 
-#ifdef USE_BINARY
-    std::filebuf binary_buffer;
-    binary_buffer.open(filename, std::ios::out | std::ios::binary);
-    std::ostream outstream_binary(&binary_buffer);
-    if (outstream_binary.fail())
-        throw std::runtime_error("failed to open " + filename.string());
-#else
-    std::filebuf fb_ascii;
-    fb_ascii.open(filename, std::ios::out);
-    std::ostream outstream_ascii(&fb_ascii);
-    if (outstream_ascii.fail())
-        throw std::runtime_error("failed to open " + filename.string());
-#endif
+    cPlyWriter ply_file(mPlyUseBinaryFormat);
 
-    PlyFile ply_file;
+    ply_file.addProperties("vertex", { "x", "y", "z" },
+        Type::FLOAT32, vertices.size(), vertices.data());
 
-    ply_file.add_properties_to_element("vertex", { "x", "y", "z" },
-        Type::FLOAT32, vertices.size(), reinterpret_cast<uint8_t*>(vertices.data()), Type::INVALID, 0);
+    ply_file.addProperties("vertex", { "red", "green", "blue" },
+        Type::UINT8, colors.size(), colors.data());
 
-    ply_file.add_properties_to_element("vertex", { "red", "green", "blue" },
-        Type::UINT8, colors.size(), reinterpret_cast<uint8_t*>(colors.data()), Type::INVALID, 0);
-
-    if (!mFrameIDs.empty())
-    {
-        ply_file.add_properties_to_element("vertex", { "plane_id" },
-            Type::INT32, indexs.size(), reinterpret_cast<uint8_t*>(indexs.data()), Type::INVALID, 0);
-    }
-
-#ifdef USE_BINARY
-    // Write a binary file
-    ply_file.write(outstream_binary, true);
-#else
-    // Write an ASCII file
-    ply_file.write(outstream_ascii, false);
-#endif
+    ply_file.addProperties("vertex", { "plane_id" },
+        Type::INT32, indexs.size(), indexs.data());
 
+    ply_file.write(filename);
 }
 
 void cExtractFeatures::writeLineFile(std::filesystem::path filename,
@@ -454,41 +483,68 @@ void cExtractFeatures::writeLineFile(std::filesystem::path filename,
 
     using namespace tinyply;
 
-#ifdef USE_BINARY
-    std::filebuf binary_buffer;
-    binary_buffer.open(filename, std::ios::out | std::ios::binary);
-    std::ostream outstream_binary(&binary_buffer);
-    if (outstream_binary.fail())
-        throw std::runtime_error("failed to open " + filename.string());
-#else
-    std::filebuf fb_ascii;
-    fb_ascii.open(filename, std::ios::out);
-    std::ostream outstream_ascii(&fb_ascii);
-    if (outstream_ascii.fail())
-        throw std::runtime_error("failed to open " + filename.string());
-#endif
+    cPlyWriter ply_file(mPlyUseBinaryFormat);
 
-    PlyFile ply_file;
+    ply_file.addProperties("vertex", { "x", "y", "z" },
+        Type::FLOAT32, vertices.size(), vertices.data());
 
-    ply_file.add_properties_to_element("vertex", { "x", "y", "z" },
-        Type::FLOAT32, vertices.size(), reinterpret_cast<uint8_t*>(vertices.data()), Type::INVALID, 0);
+    ply_file.addProperties("vertex", { "red", "green", "blue" },
+        Type::UINT8, colors.size(), colors.data());
 
-    ply_file.add_properties_to_element("vertex", { "red", "green", "blue" },
-        Type::UINT8, colors.size(), reinterpret_cast<uint8_t*>(colors.data()), Type::INVALID, 0);
+    ply_file.addProperties("vertex", { "line_id" },
+        Type::INT32, indexes.size(), indexes.data());
 
-    if (!mFrameIDs.empty())
+    ply_file.write(filename);
+}
+
+void cExtractFeatures::writeFeatureFile(std::filesystem::path filename,
+    const std::vector<PLANE>& planes, const std::vector<std::vector<cv::Point3d>>& lines)
+{
+    struct plane_t { float nx, ny, nz, x, y, z, scale; };
+    struct line_t  { float x0, y0, z0, x1, y1, z1; };
+
+    std::vector<plane_t> planeTable;
+    planeTable.reserve(planes.size());
+
+    for (const auto& plane : planes)
     {
-        ply_file.add_properties_to_element("vertex", { "plane_id" },
-            Type::INT32, indexes.size(), reinterpret_cast<uint8_t*>(indexes.data()), Type::INVALID, 0);
+        plane_t p;
+        p.nx = plane.normal.val[0];
+        p.ny = plane.normal.val[1];
+        p.nz = plane.normal.val[2];
+        p.x = plane.planePt.val[0];
+        p.y = plane.planePt.val[1];
+        p.z = plane.planePt.val[2];
+        p.scale = plane.scale;
+
+        planeTable.push_back(p);
     }
 
-#ifdef USE_BINARY
-    // Write a binary file
-    ply_file.write(outstream_binary, true);
-#else
-    // Write an ASCII file
-    ply_file.write(outstream_ascii, false);
-#endif
+    std::vector<line_t> lineTable;
+    lineTable.reserve(lines.size());
 
-}
+    for (const auto& line : lines)
+    {
+        line_t l;
+        l.x0 = line[0].x;
+        l.y0 = line[0].y;
+        l.z0 = line[0].z;
+        l.x1 = line[1].x;
+        l.y1 = line[1].y;
+        l.z1 = line[1].z;
+
+        lineTable.push_back(l);
+    }
+
+    using namespace tinyply;
 
+    cPlyWriter ply_file(mPlyUseBinaryFormat);
+
+    ply_file.addProperties("plane", { "nx", "ny", "nz", "x", "y", "z", "scale" },
+        Type::FLOAT32, planeTable.size(), planeTable.data());
+
+    ply_file.addProperties("line", { "x0", "y0", "z0", "x1", "y1", "z1" },
+        Type::FLOAT32, lineTable.size(), lineTable.data());
+
+    ply_file.write(filename);
+}
@@ -15,6 +15,14 @@ class cExtractFeatures : public cPointCloudParser
 {
 public:
     static bool mIndividualPlyFiles;
+    static bool mPlyUseBinaryFormat;
+
+    /// Detect the planes and lines of whole clouds in tiles of this size, 0 to skip
+    static double mTileSize_m;
+    static double mTileOverlap_m;
+
+    /// Take the normals of the planar regions from voxels instead of the nearest neighbours
+    static bool mVoxelNormals;
 
 public:
     cExtractFeatures();
@@ -45,10 +53,19 @@ private:
     void onPointCloudData(cPointCloud_FrameId pointCloud) override;
     void onPointCloudData(cPointCloud_SensorInfo pointCloud) override;
 
+    void detectTiledFeatures(const PointCloud<float>& cloud);
+
     void writePlyFile(std::filesystem::path filename);
     void writePlaneFile(std::filesystem::path filename, const std::vector<PLANE>& planes, double scale);
     void writeLineFile(std::filesystem::path filename, const std::vector<std::vector<cv::Point3d>>& lines, double scale);
 
+    /**
+     * Writes the planes, as normal, point and scale, and the lines, as their
+     * end points, in one small table.
+     */
+    void writeFeatureFile(std::filesystem::path filename, const std::vector<PLANE>& planes,
+        const std::vector<std::vector<cv::Point3d>>& lines);
+
 private:
     std::filesystem::path mOutputPath;
 
@@ -11,12 +11,24 @@ using namespace cv;
 
 //#define DEBUG_MSG
 
-void LineDetection3D::run(PointCloud<double>& data, int k, 
+void LineDetection3D::run(PointCloud<float> data, int k, 
 					std::vector<PLANE>& planes,
 					std::vector<std::vector<cv::Point3d>>& lines)
 {
-	mPointData = data;
-	mPointNum = data.pts.size();
+	detectPlanes( std::move(data), k, planes );
+
+	// step4: line merging
+#ifdef DEBUG_MSG
+	cout << "Step4: Line Merging ..." << endl;
+#endif
+
+	lineMerging( planes, lines );
+}
+
+void LineDetection3D::detectPlanes(PointCloud<float> data, int k, std::vector<PLANE>& planes)
+{
+	mPointData = std::move(data);
+	mPointNum = mPointData.pts.size();
 	mK = k;
 
 	// step1: point cloud segmentation
@@ -35,12 +47,12 @@ void LineDetection3D::run(PointCloud<double>& data, int k,
 
 	planeBased3DLineDetection( regions, planes );
 
-	// step3: post processing
+	// step3: plane line regularization
 #ifdef DEBUG_MSG
-	cout << "Step3: Post Processing ..." << endl;
+	cout << "Step3: Outliers Removal ..." << endl;
 #endif
 
-	postProcessing( planes, lines );
+	outliersRemoval( planes );
 }
 
 
@@ -50,9 +62,19 @@ void LineDetection3D::pointCloudSegmentation( std::vector<std::vector<int> > &re
 	cout << "----- Normal Calculation ..." << endl;
 #endif
 
-	PCAFunctions pcaer;
-	pcaer.Ori_PCA(mPointData, mK, mPcaInfos, mScale, mMagnitd );
-	
+	// the neighbourhoods are shared by the region growing and merging
+	mNeighborhoods.build( mPointData, mK, mVoxelNormals );
+	mScale = mNeighborhoods.mMeanScale;
+	mMagnitd = mNeighborhoods.mMagnitd;
+
+#ifdef DEBUG_MSG
+	if ( mVoxelNormals )
+	{
+		cout << "----- " << mNeighborhoods.mNumVoxelNormals << " of " << mPointNum << " normals from voxels" << endl;
+		cout << "----- " << mNeighborhoods.mNumVoxelNeighbors << " of " << mPointNum << " neighbourhoods from voxels" << endl;
+	}
+#endif
+
 #ifdef DEBUG_MSG
 	cout << "----- Region Growing ..." << endl;
 #endif
@@ -79,7 +101,7 @@ void LineDetection3D::regionGrow( double thAngle, std::vector<std::vector<int> >
 	for (int i=0; i < mPointNum; ++i )
 	{
 		idxSorted[i].first = i;
-		idxSorted[i].second = mPcaInfos[i].lambda0;
+		idxSorted[i].second = mNeighborhoods.lambda0(i);
 	}
 	std::sort( idxSorted.begin(), idxSorted.end(), [](const std::pair<int,double>& lhs, const std::pair<int,double>& rhs) { return lhs.second < rhs.second; } );
 
@@ -93,9 +115,9 @@ void LineDetection3D::regionGrow( double thAngle, std::vector<std::vector<int> >
 
 		if ( isUsed[idxStrater] ) { continue; }
 
-		cv::Matx31d normalStarter = mPcaInfos[idxStrater].normal;
+		cv::Matx31d normalStarter = mNeighborhoods.normal(idxStrater);
 		double xStrater = mPointData.pts[idxStrater].x, yStrater = mPointData.pts[idxStrater].y, zStrater = mPointData.pts[idxStrater].z;
-		double thRadius2 = pow(50 * mPcaInfos[idxStrater].scale, 2);
+		double thRadius2 = pow(50 * mNeighborhoods.scale(idxStrater), 2);
 
 		std::vector<int> clusterTemp;
 		clusterTemp.reserve(10000);
@@ -104,21 +126,22 @@ void LineDetection3D::regionGrow( double thAngle, std::vector<std::vector<int> >
 		while( count < clusterTemp.size() )
 		{
 			int idxSeed = clusterTemp[count];
-			cv::Matx31d normalSeed = mPcaInfos[idxSeed].normal;
-			double thOrtho = mPcaInfos[idxSeed].scale;
+			cv::Matx31d normalSeed = mNeighborhoods.normal(idxSeed);
+			double thOrtho = mNeighborhoods.scale(idxSeed);
 
 			// point cloud collection
-			int num = mPcaInfos[idxSeed].idxAll.size();
+			int num = mNeighborhoods.numNeighbors(idxSeed);
+			const int *idxNeighbors = mNeighborhoods.neighbors(idxSeed);
 			for( int j = 0; j < num; ++j )
 			{
-				int idxCur = mPcaInfos[idxSeed].idxAll[j];
+				int idxCur = idxNeighbors[j];
 				if (isUsed[idxCur])
 				{
 					continue;
 				}
 
 				// judgement1: normal deviation
-				cv::Matx31d normalCur = mPcaInfos[idxCur].normal;
+				const cv::Matx31d &normalCur = mNeighborhoods.normal(idxCur);
 
 				double normalDev = abs(normalCur.val[0] * normalStarter.val[0] + 
 										normalCur.val[1] * normalStarter.val[1] +
@@ -179,26 +202,14 @@ void LineDetection3D::regionMerging( double thAngle, std::vector<std::vector<int
 #pragma omp parallel for
 	for ( int i=0; i<regions.size(); ++i )
 	{
-		int pointNumCur = regions[i].size();
-		std::vector<std::vector<double> > pointDataCur(pointNumCur);
-		for ( int j=0; j<pointNumCur; ++j )
-		{
-			pointDataCur[j].resize(3);
-			pointDataCur[j][0] = mPointData.pts[regions[i][j]].x;
-			pointDataCur[j][1] = mPointData.pts[regions[i][j]].y;
-			pointDataCur[j][2] = mPointData.pts[regions[i][j]].z;
-		}
-
 		PCAFunctions pcaer;
-		pcaer.PCASingle( pointDataCur, patches[i] );
+		pcaer.PCASingle( mPointData, regions[i], patches[i] );
 
-		patches[i].idxAll = regions[i];
 		double scaleAvg = 0.0;
 		for ( int j=0; j<patches[i].idxIn.size(); ++j )
 		{
-			int idx = regions[i][patches[i].idxIn[j]];
-			patches[i].idxIn[j] = idx;
-			scaleAvg += mPcaInfos[idx].scale;
+			int idx = patches[i].idxIn[j];
+			scaleAvg += mNeighborhoods.scale(idx);
 		}
 		scaleAvg /= patches[i].idxIn.size();
 		patches[i].scale = 5.0 * scaleAvg;
@@ -226,24 +237,19 @@ void LineDetection3D::regionMerging( double thAngle, std::vector<std::vector<int
 		for ( int j=0; j<patches[i].idxIn.size(); ++j )
 		{
 			int id = patches[i].idxIn[j];
-			for (int m=0; m < mPcaInfos[id].idxIn.size(); ++m)
+			int numNeighbors = mNeighborhoods.numNeighbors(id);
+			const int *idNeighbors = mNeighborhoods.neighbors(id);
+			for (int m=0; m < numNeighbors; ++m)
 			{
-				int idPoint = mPcaInfos[id].idxIn[m];
+				int idPoint = idNeighbors[m];
 				int labelPatch = label[idPoint];
 				if ( labelPatch == i || labelPatch < 0 )
 				{
 					continue;
 				}
 
-				bool isNeighbor = false;
-				for (int n=0; n < mPcaInfos[idPoint].idxIn.size(); ++n)
-				{
-					if (mPcaInfos[idPoint].idxIn[n] == id)
-					{
-						isNeighbor = true;
-					}
-				}
-				if ( ! isNeighbor )
+				// only mutual neighbours make two patches adjacent
+				if ( ! mNeighborhoods.isNeighbor(idPoint, id) )
 				{
 					continue;
 				}
@@ -396,25 +402,8 @@ void LineDetection3D::planeBased3DLineDetection( std::vector<std::vector<int> >
 #pragma omp parallel for
 	for ( int i=0; i<numPatches; ++i )
 	{
-		int pointNumCur = regions[i].size();
-		std::vector<std::vector<double> > pointDataCur(pointNumCur);
-		for ( int j=0; j<pointNumCur; ++j )
-		{
-			pointDataCur[j].resize(3);
-			pointDataCur[j][0] = mPointData.pts[regions[i][j]].x;
-			pointDataCur[j][1] = mPointData.pts[regions[i][j]].y;
-			pointDataCur[j][2] = mPointData.pts[regions[i][j]].z;
-		}
-
 		PCAFunctions pcaer;
-		pcaer.PCASingle( pointDataCur, patches[i] );
-
-		patches[i].idxAll = regions[i];
-		for ( int j=0; j<patches[i].idxIn.size(); ++j )
-		{
-			int idx = patches[i].idxIn[j];
-			patches[i].idxIn[j] = regions[i][idx];
-		}
+		pcaer.PCASingle( mPointData, regions[i], patches[i] );
 	}
 
 	// step2: 3D line detection
@@ -453,7 +442,7 @@ void LineDetection3D::planeBased3DLineDetection( std::vector<std::vector<int> >
 				double x = vPlane.dot(vX);
 				double y = vPlane.dot(vY);
 				pts2d.push_back(cv::Point2d(x,y));
-				ptScales.push_back(mPcaInfos[id].scale);
+				ptScales.push_back(mNeighborhoods.scale(id));
 			}
 		}
 
@@ -484,6 +473,8 @@ void LineDetection3D::planeBased3DLineDetection( std::vector<std::vector<int> >
 
 		// C. 2D-3D Projection
 		planes[i].scale = gridSideLength;
+		planes[i].normal = patches[i].normal;
+		planes[i].planePt = patches[i].planePt;
 		for ( int m=0; m<lines2d.size(); ++m ) 
 		{
 			std::vector<std::vector<cv::Point3d> > temp;
@@ -586,15 +577,6 @@ void LineDetection3D::lineFromMask( cv::Mat &mask, int thLineLengthPixel, std::v
 }
 
 
-void LineDetection3D::postProcessing( std::vector<PLANE> &planes, std::vector<std::vector<cv::Point3d> > &lines )
-{
-	// step1: plane line regularization
-	outliersRemoval( planes );
-
-	// step2: line merging
-	lineMerging( planes, lines );
-}
-
 void LineDetection3D::outliersRemoval( std::vector<PLANE> &planes )
 {
 	double thCosAngleIN = cos(12.5/180.0*CV_PI);
@@ -700,6 +682,8 @@ void LineDetection3D::outliersRemoval( std::vector<PLANE> &planes )
 		// step2: remove non-structural lines
 		PLANE planeNew;
 		planeNew.scale = planes[i].scale;
+		planeNew.normal = planes[i].normal;
+		planeNew.planePt = planes[i].planePt;
 		//double scaleCur = planes[i].scale;
 		double thNonStructLineLength = scaleCur*thNonStructLineRatio;
 		for (int m=0; m<planes[i].lines3d.size(); ++m)
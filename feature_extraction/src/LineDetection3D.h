@@ -7,11 +7,14 @@
 struct PLANE
 {
 	double scale = 1.0;
+	cv::Matx31d normal, planePt;
 	std::vector<std::vector<std::vector<cv::Point3d>>> lines3d;
 
 	PLANE &operator =(const PLANE &info)
 	{
 		this->scale   = info.scale;
+		this->normal  = info.normal;
+		this->planePt = info.planePt;
 		this->lines3d = info.lines3d;
 		return *this;
 	}
@@ -23,16 +26,17 @@ public:
 	LineDetection3D() = default;
 	~LineDetection3D() = default;
 
-	void run(PointCloud<double> &data, int k, 
+	void run(PointCloud<float> data, int k, 
 			std::vector<PLANE>& planes, 
 			std::vector<std::vector<cv::Point3d>>& lines);
 
+	// the planes and their contour lines, without merging the lines
+	void detectPlanes(PointCloud<float> data, int k, std::vector<PLANE>& planes);
+
 	void pointCloudSegmentation( std::vector<std::vector<int> > &regions );
 
 	void planeBased3DLineDetection( std::vector<std::vector<int> > &regions, std::vector<PLANE> &planes );
 
-	void postProcessing( std::vector<PLANE> &planes, std::vector<std::vector<cv::Point3d> > &lines );
-
 	// 
 	void regionGrow( double thAngle, std::vector<std::vector<int> > &regions );
 
@@ -50,11 +54,12 @@ public:
 
 public:
 	int mK = 0;
+	bool mVoxelNormals = false;
 	int mPointNum = 0;
 	double mScale = 1.0;
 	double mMagnitd = 0.0;
-	std::vector<PCAInfo> mPcaInfos;
-	PointCloud<double> mPointData;
+	NeighborhoodCache mNeighborhoods;
+	PointCloud<float> mPointData;
 };
 
 #endif //_LINE_DETECTION_H_
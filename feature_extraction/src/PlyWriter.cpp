@@ -0,0 +1,227 @@
+
+#include "PlyWriter.hpp"
+
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+
+namespace
+{
+    /// The size of the file buffer and of the blocks of formatted text
+    const std::size_t BUFFER_SIZE = 1 << 20;
+
+    /// The longest formatted value, a double with its exponent
+    const std::size_t MAX_VALUE_CHARS = 32;
+
+    std::size_t typeSize(tinyply::Type type)
+    {
+        switch (type)
+        {
+        case tinyply::Type::INT8:
+        case tinyply::Type::UINT8:
+            return 1;
+        case tinyply::Type::INT16:
+        case tinyply::Type::UINT16:
+            return 2;
+        case tinyply::Type::INT32:
+        case tinyply::Type::UINT32:
+        case tinyply::Type::FLOAT32:
+            return 4;
+        case tinyply::Type::FLOAT64:
+            return 8;
+        default:
+            break;
+        }
+
+        throw std::invalid_argument("Unsupported PLY property type.");
+    }
+
+    const char* typeName(tinyply::Type type)
+    {
+        switch (type)
+        {
+        case tinyply::Type::INT8:    return "char";
+        case tinyply::Type::UINT8:   return "uchar";
+        case tinyply::Type::INT16:   return "short";
+        case tinyply::Type::UINT16:  return "ushort";
+        case tinyply::Type::INT32:   return "int";
+        case tinyply::Type::UINT32:  return "uint";
+        case tinyply::Type::FLOAT32: return "float";
+        case tinyply::Type::FLOAT64: return "double";
+        default:
+            break;
+        }
+
+        throw std::invalid_argument("Unsupported PLY property type.");
+    }
+
+    template<typename T>
+    char* format(char* first, char* last, const uint8_t* value)
+    {
+        T v;
+        std::memcpy(&v, value, sizeof(T));
+        return std::to_chars(first, last, v).ptr;
+    }
+
+    char* format(char* first, char* last, tinyply::Type type, const uint8_t* value)
+    {
+        switch (type)
+        {
+        case tinyply::Type::INT8:    return format<int8_t>(first, last, value);
+        case tinyply::Type::UINT8:   return format<uint8_t>(first, last, value);
+        case tinyply::Type::INT16:   return format<int16_t>(first, last, value);
+        case tinyply::Type::UINT16:  return format<uint16_t>(first, last, value);
+        case tinyply::Type::INT32:   return format<int32_t>(first, last, value);
+        case tinyply::Type::UINT32:  return format<uint32_t>(first, last, value);
+        case tinyply::Type::FLOAT32: return format<float>(first, last, value);
+        case tinyply::Type::FLOAT64: return format<double>(first, last, value);
+        default:
+            break;
+        }
+
+        throw std::invalid_argument("Unsupported PLY property type.");
+    }
+}
+
+
+cPlyWriter::cPlyWriter(bool binary) : mBinary(binary)
+{}
+
+void cPlyWriter::addProperties(const std::string& element, const std::vector<std::string>& names,
+    tinyply::Type type, std::size_t count, const void* data)
+{
+    typeSize(type);
+
+    sElement* e = nullptr;
+    for (auto& existing : mElements)
+    {
+        if (existing.name == element)
+            e = &existing;
+    }
+
+    if (!e)
+    {
+        mElements.emplace_back();
+        e = &mElements.back();
+        e->name = element;
+        e->count = count;
+    }
+
+    if (e->count != count)
+    {
+        throw std::invalid_argument("The properties of the element " + element + " have different counts.");
+    }
+
+    sProperties properties;
+    properties.names = names;
+    properties.type = type;
+    properties.data = static_cast<const uint8_t*>(data);
+
+    e->properties.push_back(std::move(properties));
+}
+
+void cPlyWriter::write(const std::filesystem::path& filename) const
+{
+    std::vector<char> buffer(BUFFER_SIZE);
+
+    std::filebuf file_buffer;
+    file_buffer.pubsetbuf(buffer.data(), buffer.size());
+
+    if (mBinary)
+        file_buffer.open(filename, std::ios::out | std::ios::binary);
+    else
+        file_buffer.open(filename, std::ios::out);
+
+    if (!file_buffer.is_open())
+        throw std::runtime_error("failed to open " + filename.string());
+
+    std::ostream out(&file_buffer);
+
+    if (mBinary)
+        writeBinary(out);
+    else
+        writeText(out);
+
+    out.flush();
+    if (out.fail())
+        throw std::runtime_error("failed to write " + filename.string());
+}
+
+void cPlyWriter::writeBinary(std::ostream& out) const
+{
+    using namespace tinyply;
+
+    PlyFile ply_file;
+
+    for (const auto& element : mElements)
+    {
+        for (const auto& properties : element.properties)
+        {
+            // tinyply only reads the data when writing
+            ply_file.add_properties_to_element(element.name, properties.names, properties.type,
+                element.count, const_cast<uint8_t*>(properties.data), Type::INVALID, 0);
+        }
+    }
+
+    ply_file.write(out, true);
+}
+
+void cPlyWriter::writeText(std::ostream& out) const
+{
+    out << "ply\nformat ascii 1.0\n";
+
+    for (const auto& element : mElements)
+    {
+        out << "element " << element.name << " " << element.count << "\n";
+
+        for (const auto& properties : element.properties)
+        {
+            for (const auto& name : properties.names)
+                out << "property " << typeName(properties.type) << " " << name << "\n";
+        }
+    }
+
+    out << "end_header\n";
+
+    std::vector<char> block(BUFFER_SIZE);
+
+    for (const auto& element : mElements)
+    {
+        std::size_t rowChars = 1;
+        for (const auto& properties : element.properties)
+            rowChars += properties.names.size() * (MAX_VALUE_CHARS + 1);
+
+        if (rowChars > block.size())
+            block.resize(rowChars);
+
+        char* const last = block.data() + block.size();
+        char* p = block.data();
+
+        for (std::size_t row = 0; row < element.count; ++row)
+        {
+            if (static_cast<std::size_t>(last - p) < rowChars)
+            {
+                out.write(block.data(), p - block.data());
+                p = block.data();
+            }
+
+            for (const auto& properties : element.properties)
+            {
+                const std::size_t size = typeSize(properties.type);
+                const uint8_t* value = properties.data + row * size * properties.names.size();
+
+                for (std::size_t i = 0; i < properties.names.size(); ++i, value += size)
+                {
+                    p = format(p, last, properties.type, value);
+                    *p++ = ' ';
+                }
+            }
+
+            p[-1] = '\n';
+        }
+
+        out.write(block.data(), p - block.data());
+    }
+}
@@ -0,0 +1,57 @@
+
+#pragma once
+
+#include <tinyply.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+/**
+ * Writes a PLY file from the same interleaved property arrays as tinyply.
+ *
+ * The binary format is written by tinyply.  The text format is written here:
+ * tinyply formats every value through an ostream, this formats whole rows
+ * with std::to_chars into a block that is written at once.  Both go through
+ * a file buffer much larger than the default one.
+ */
+class cPlyWriter
+{
+public:
+    explicit cPlyWriter(bool binary);
+
+    /**
+     * Adds properties to an element, interleaved in data as for
+     * tinyply::PlyFile::add_properties_to_element.  The data must stay valid
+     * until the file is written.
+     */
+    void addProperties(const std::string& element, const std::vector<std::string>& names,
+        tinyply::Type type, std::size_t count, const void* data);
+
+    void write(const std::filesystem::path& filename) const;
+
+private:
+    struct sProperties
+    {
+        std::vector<std::string> names;
+        tinyply::Type type = tinyply::Type::INVALID;
+        const uint8_t* data = nullptr;
+    };
+
+    struct sElement
+    {
+        std::string name;
+        std::size_t count = 0;
+        std::vector<sProperties> properties;
+    };
+
+    void writeBinary(std::ostream& out) const;
+    void writeText(std::ostream& out) const;
+
+private:
+    bool mBinary = true;
+    std::vector<sElement> mElements;
+};
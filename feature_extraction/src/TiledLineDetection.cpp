@@ -0,0 +1,433 @@
+
+#include "TiledLineDetection.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+
+namespace
+{
+    /// A region must have more points than this to become a plane
+    const std::size_t MIN_TILE_POINTS = 100;
+
+    /// The largest angle between the normals of two pieces of a plane
+    const double JOIN_ANGLE_DEG = 10.0;
+
+    /// The largest gap, and offset from each other, of two pieces of a plane in point spacings
+    const double JOIN_GAP_SCALES = 4.0;
+    const double JOIN_OFFSET_SCALES = 10.0;
+
+    struct sBox
+    {
+        double xmin = std::numeric_limits<double>::max();
+        double ymin = std::numeric_limits<double>::max();
+        double xmax = std::numeric_limits<double>::lowest();
+        double ymax = std::numeric_limits<double>::lowest();
+
+        void add(const cv::Point3d& p)
+        {
+            xmin = std::min(xmin, p.x);
+            ymin = std::min(ymin, p.y);
+            xmax = std::max(xmax, p.x);
+            ymax = std::max(ymax, p.y);
+        }
+
+        bool contains(const cv::Point3d& p, double margin) const
+        {
+            return (p.x >= xmin - margin) && (p.x <= xmax + margin)
+                && (p.y >= ymin - margin) && (p.y <= ymax + margin);
+        }
+
+        bool overlaps(const sBox& b, double margin) const
+        {
+            return (xmin - margin <= b.xmax) && (b.xmin <= xmax + margin)
+                && (ymin - margin <= b.ymax) && (b.ymin <= ymax + margin);
+        }
+    };
+
+    sBox boundingBox(const PLANE& plane)
+    {
+        sBox box;
+        for (const auto& contour : plane.lines3d)
+        {
+            for (const auto& line : contour)
+            {
+                box.add(line[0]);
+                box.add(line[1]);
+            }
+        }
+
+        return box;
+    }
+
+    /**
+     * Clips the XY projection of the segment a-b to the rectangle, by
+     * Liang-Barsky.  Returns false if nothing of the segment is left.
+     */
+    bool clipLine(cv::Point3d& a, cv::Point3d& b, double x0, double y0, double x1, double y1)
+    {
+        const cv::Point3d d = b - a;
+
+        const double p[4] = { -d.x, d.x, -d.y, d.y };
+        const double q[4] = { a.x - x0, x1 - a.x, a.y - y0, y1 - a.y };
+
+        double t0 = 0.0;
+        double t1 = 1.0;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            if (p[i] == 0.0)
+            {
+                if (q[i] < 0.0)
+                    return false;
+
+                continue;
+            }
+
+            double r = q[i] / p[i];
+
+            if (p[i] < 0.0)
+                t0 = std::max(t0, r);
+            else
+                t1 = std::min(t1, r);
+
+            if (t0 >= t1)
+                return false;
+        }
+
+        b = a + d * t1;
+        a = a + d * t0;
+
+        return true;
+    }
+
+    double planeDistance(const PLANE& plane, const cv::Point3d& p)
+    {
+        return std::abs(plane.normal.val[0] * (p.x - plane.planePt.val[0])
+            + plane.normal.val[1] * (p.y - plane.planePt.val[1])
+            + plane.normal.val[2] * (p.z - plane.planePt.val[2]));
+    }
+
+    /**
+     * True if an end of a line of a, near the box of b, lies on the plane of b.
+     */
+    bool touches(const PLANE& a, const PLANE& b, const sBox& boxB, double margin, double offset)
+    {
+        for (const auto& contour : a.lines3d)
+        {
+            for (const auto& line : contour)
+            {
+                for (const auto& p : line)
+                {
+                    if (boxB.contains(p, margin) && (planeDistance(b, p) <= offset))
+                        return true;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    int findRoot(std::vector<int>& parent, int i)
+    {
+        while (parent[i] != i)
+        {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+
+        return i;
+    }
+}
+
+
+void cTiledLineDetection::setTileSize(double tileSize_m)
+{
+    mTileSize_m = tileSize_m;
+}
+
+void cTiledLineDetection::setOverlap(double overlap_m)
+{
+    mOverlap_m = overlap_m;
+}
+
+void cTiledLineDetection::setNumNeighbors(int k)
+{
+    mK = k;
+}
+
+void cTiledLineDetection::setVoxelNormals(bool voxelNormals)
+{
+    mVoxelNormals = voxelNormals;
+}
+
+double cTiledLineDetection::scale() const
+{
+    return mScale;
+}
+
+void cTiledLineDetection::run(const PointCloud<float>& cloud, std::vector<PLANE>& planes,
+    std::vector<std::vector<cv::Point3d>>& lines)
+{
+    if ((mTileSize_m <= 0.0) || (mOverlap_m < 0.0))
+    {
+        throw std::invalid_argument("The tiles must have a positive size and a margin of zero or more.");
+    }
+
+    planes.clear();
+    lines.clear();
+
+    const std::size_t n = cloud.pts.size();
+    if (n == 0)
+        return;
+
+    double xmin = cloud.pts[0].x, xmax = xmin;
+    double ymin = cloud.pts[0].y, ymax = ymin;
+    for (const auto& p : cloud.pts)
+    {
+        xmin = std::min<double>(xmin, p.x);
+        xmax = std::max<double>(xmax, p.x);
+        ymin = std::min<double>(ymin, p.y);
+        ymax = std::max<double>(ymax, p.y);
+    }
+
+    const int numTilesX = std::max(1, static_cast<int>(std::ceil((xmax - xmin) / mTileSize_m)));
+    const int numTilesY = std::max(1, static_cast<int>(std::ceil((ymax - ymin) / mTileSize_m)));
+    const int numTiles = numTilesX * numTilesY;
+
+    auto tileX = [&](double x) { return std::clamp(static_cast<int>(std::floor((x - xmin) / mTileSize_m)), 0, numTilesX - 1); };
+    auto tileY = [&](double y) { return std::clamp(static_cast<int>(std::floor((y - ymin) / mTileSize_m)), 0, numTilesY - 1); };
+
+    // The points of each tile and its margin, as one index array
+    std::vector<std::size_t> offsets(numTiles + 1, 0);
+
+    for (const auto& p : cloud.pts)
+    {
+        for (int ty = tileY(p.y - mOverlap_m); ty <= tileY(p.y + mOverlap_m); ++ty)
+            for (int tx = tileX(p.x - mOverlap_m); tx <= tileX(p.x + mOverlap_m); ++tx)
+                ++offsets[ty * numTilesX + tx + 1];
+    }
+
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+    std::vector<int> indices(offsets.back());
+    {
+        std::vector<std::size_t> next(offsets.begin(), offsets.end() - 1);
+
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            const auto& p = cloud.pts[i];
+
+            for (int ty = tileY(p.y - mOverlap_m); ty <= tileY(p.y + mOverlap_m); ++ty)
+                for (int tx = tileX(p.x - mOverlap_m); tx <= tileX(p.x + mOverlap_m); ++tx)
+                    indices[next[ty * numTilesX + tx]++] = static_cast<int>(i);
+        }
+    }
+
+    // The detection of a tile runs its own loops serially, the tiles run in parallel
+    std::vector<sTile> tiles(numTiles);
+    std::string error;
+
+#pragma omp parallel for schedule(dynamic)
+    for (int t = 0; t < numTiles; ++t)
+    {
+        sTile& tile = tiles[t];
+        tile.x = t % numTilesX;
+        tile.y = t / numTilesX;
+
+        // The outer tiles keep everything beyond the edge of the cloud
+        const double inf = std::numeric_limits<double>::infinity();
+        double x0 = (tile.x == 0) ? -inf : xmin + tile.x * mTileSize_m;
+        double y0 = (tile.y == 0) ? -inf : ymin + tile.y * mTileSize_m;
+        double x1 = (tile.x == numTilesX - 1) ? inf : xmin + (tile.x + 1) * mTileSize_m;
+        double y1 = (tile.y == numTilesY - 1) ? inf : ymin + (tile.y + 1) * mTileSize_m;
+
+        try
+        {
+            detectTile(cloud, indices.data() + offsets[t], offsets[t + 1] - offsets[t], x0, y0, x1, y1, tile);
+        }
+        catch (const std::exception& e)
+        {
+#pragma omp critical
+            {
+                if (error.empty())
+                    error = e.what();
+            }
+        }
+    }
+
+    if (!error.empty())
+        throw std::runtime_error(error);
+
+    std::vector<int>().swap(indices);
+
+    double scaleSum = 0.0;
+    std::size_t points = 0;
+    for (const auto& tile : tiles)
+    {
+        scaleSum += tile.scale * tile.points;
+        points += tile.points;
+    }
+
+    mScale = (points > 0) ? scaleSum / points : 1.0;
+
+    joinPlanes(tiles, numTilesX, planes);
+
+    // Merge the lines of the whole cloud, including the pieces clipped at the tile edges
+    LineDetection3D merger;
+    merger.mScale = mScale;
+
+    double x = cloud.pts[0].x, y = cloud.pts[0].y, z = cloud.pts[0].z;
+    merger.mMagnitd = std::sqrt(x * x + y * y + z * z);
+
+    merger.lineMerging(planes, lines);
+}
+
+void cTiledLineDetection::detectTile(const PointCloud<float>& cloud, const int* indices, std::size_t count,
+    double x0, double y0, double x1, double y1, sTile& tile) const
+{
+    if ((count <= MIN_TILE_POINTS) || (count <= static_cast<std::size_t>(mK)))
+        return;
+
+    PointCloud<float> data;
+    data.pts.reserve(count);
+    for (std::size_t i = 0; i < count; ++i)
+        data.pts.push_back(cloud.pts[indices[i]]);
+
+    LineDetection3D detector;
+    detector.mVoxelNormals = mVoxelNormals;
+
+    std::vector<PLANE> planes;
+    detector.detectPlanes(std::move(data), mK, planes);
+
+    tile.scale = detector.mScale;
+    tile.points = count;
+
+    for (const auto& plane : planes)
+    {
+        PLANE clipped;
+        clipped.scale = plane.scale;
+        clipped.normal = plane.normal;
+        clipped.planePt = plane.planePt;
+
+        for (const auto& contour : plane.lines3d)
+        {
+            std::vector<std::vector<cv::Point3d>> kept;
+
+            for (const auto& line : contour)
+            {
+                cv::Point3d a = line[0];
+                cv::Point3d b = line[1];
+
+                if (clipLine(a, b, x0, y0, x1, y1))
+                    kept.push_back({ a, b });
+            }
+
+            if (!kept.empty())
+                clipped.lines3d.push_back(std::move(kept));
+        }
+
+        // A plane only in the margin belongs to the neighbouring tile
+        if (!clipped.lines3d.empty())
+            tile.planes.push_back(std::move(clipped));
+    }
+}
+
+void cTiledLineDetection::joinPlanes(std::vector<sTile>& tiles, int numTilesX, std::vector<PLANE>& planes) const
+{
+    const int numTiles = tiles.size();
+    const int numTilesY = numTiles / numTilesX;
+    const double cosJoinAngle = std::cos(JOIN_ANGLE_DEG / 180.0 * CV_PI);
+
+    // The planes of all the tiles in one list
+    std::vector<std::size_t> first(numTiles + 1, 0);
+    for (int t = 0; t < numTiles; ++t)
+        first[t + 1] = first[t] + tiles[t].planes.size();
+
+    std::vector<const PLANE*> all(first.back());
+    std::vector<sBox> boxes(first.back());
+    for (int t = 0; t < numTiles; ++t)
+    {
+        for (std::size_t i = 0; i < tiles[t].planes.size(); ++i)
+        {
+            all[first[t] + i] = &tiles[t].planes[i];
+            boxes[first[t] + i] = boundingBox(tiles[t].planes[i]);
+        }
+    }
+
+    std::vector<int> parent(all.size());
+    std::iota(parent.begin(), parent.end(), 0);
+
+    // A plane cut by a tile edge continues in one of the next tiles
+    const int neighbors[4][2] = { { 1, 0 }, { 0, 1 }, { 1, 1 }, { -1, 1 } };
+
+    for (int t = 0; t < numTiles; ++t)
+    {
+        const int tx = t % numTilesX;
+        const int ty = t / numTilesX;
+
+        for (const auto& d : neighbors)
+        {
+            const int ux = tx + d[0];
+            const int uy = ty + d[1];
+            if ((ux < 0) || (ux >= numTilesX) || (uy >= numTilesY))
+                continue;
+
+            const int u = uy * numTilesX + ux;
+
+            for (std::size_t i = first[t]; i < first[t + 1]; ++i)
+            {
+                for (std::size_t j = first[u]; j < first[u + 1]; ++j)
+                {
+                    const PLANE& a = *all[i];
+                    const PLANE& b = *all[j];
+
+                    const double planeScale = std::max({ a.scale, b.scale, mScale });
+                    const double gap = JOIN_GAP_SCALES * planeScale;
+                    const double offset = JOIN_OFFSET_SCALES * planeScale;
+
+                    if (!boxes[i].overlaps(boxes[j], gap))
+                        continue;
+
+                    double cosAngle = std::abs(a.normal.dot(b.normal));
+                    if (cosAngle < cosJoinAngle)
+                        continue;
+
+                    if (!touches(a, b, boxes[j], gap, offset) || !touches(b, a, boxes[i], gap, offset))
+                        continue;
+
+                    parent[findRoot(parent, static_cast<int>(j))] = findRoot(parent, static_cast<int>(i));
+                }
+            }
+        }
+    }
+
+    // Each joined plane has the normal and point of its first piece
+    std::vector<int> output(all.size(), -1);
+
+    for (std::size_t i = 0; i < all.size(); ++i)
+    {
+        int root = findRoot(parent, static_cast<int>(i));
+
+        if (output[root] < 0)
+        {
+            output[root] = static_cast<int>(planes.size());
+            planes.push_back(*all[root]);
+
+            if (root == static_cast<int>(i))
+                continue;
+        }
+
+        // The lines of the root went in with it
+        if (root == static_cast<int>(i))
+            continue;
+
+        PLANE& joined = planes[output[root]];
+        joined.scale = std::max(joined.scale, all[i]->scale);
+        joined.lines3d.insert(joined.lines3d.end(), all[i]->lines3d.begin(), all[i]->lines3d.end());
+    }
+}
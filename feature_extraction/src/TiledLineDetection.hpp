@@ -0,0 +1,74 @@
+
+#pragma once
+
+#include "LineDetection3D.h"
+
+#include <cstddef>
+#include <vector>
+
+
+/**
+ * Detects the planes and 3D lines of a cloud too large for LineDetection3D,
+ * such as a whole field, by splitting it into square XY tiles.
+ *
+ * Each tile is detected with a margin of the neighbouring tiles around it,
+ * so the planes near its edges are found from the same neighbourhoods as in
+ * the whole cloud, then its contour lines are clipped to the tile itself.
+ * The tiles are detected in parallel, each with its own LineDetection3D, so
+ * the memory depends on the tile size and the number of threads instead of
+ * the size of the cloud.
+ *
+ * A plane cut by the edge of a tile is joined to the plane it continues in
+ * the neighbouring tile, and the lines are merged over the whole cloud,
+ * which joins the pieces of a line clipped at the tile edges.
+ */
+class cTiledLineDetection
+{
+public:
+    void setTileSize(double tileSize_m);
+    void setOverlap(double overlap_m);
+    void setNumNeighbors(int k);
+
+    /**
+     * Takes the normals of the planar regions of the tiles from their voxels,
+     * see VoxelNormals.
+     */
+    void setVoxelNormals(bool voxelNormals);
+
+    void run(const PointCloud<float>& cloud, std::vector<PLANE>& planes,
+        std::vector<std::vector<cv::Point3d>>& lines);
+
+    /**
+     * The mean point spacing of the tiles, the scale of the planes and lines.
+     */
+    double scale() const;
+
+private:
+    struct sTile
+    {
+        int x = 0;
+        int y = 0;
+
+        double scale = 0.0;
+        std::size_t points = 0;
+
+        std::vector<PLANE> planes;
+    };
+
+    /**
+     * Detects the planes of the points of a tile and its margin, keeping the
+     * contour lines inside x0..x1, y0..y1.
+     */
+    void detectTile(const PointCloud<float>& cloud, const int* indices, std::size_t count,
+        double x0, double y0, double x1, double y1, sTile& tile) const;
+
+    void joinPlanes(std::vector<sTile>& tiles, int numTilesX, std::vector<PLANE>& planes) const;
+
+private:
+    double mTileSize_m = 20.0;
+    double mOverlap_m = 2.0;
+    int mK = 20;
+    bool mVoxelNormals = false;
+
+    double mScale = 1.0;
+};
@@ -84,6 +84,7 @@ int main(int argc, char** argv)
 	std::string output_directory = current_path().string();
 
 	bool isFile = false;
+	bool asciiPly = false;
 	bool showHelp = false;
 
 	auto cli = lyra::cli()
@@ -95,6 +96,20 @@ int main(int argc, char** argv)
 		| lyra::opt(cExtractFeatures::mIndividualPlyFiles)
 		["-i"]["--individual"]
 		("Export individual ply files by frame number.")
+		| lyra::opt(asciiPly)
+		["--ascii"]
+		("Write the ply files as text instead of binary.")
+		| lyra::opt(cExtractFeatures::mTileSize_m, "meters")
+		["--tile"]
+		("Detect the planes and lines of whole point clouds in tiles of this size.")
+		.optional()
+		| lyra::opt(cExtractFeatures::mTileOverlap_m, "meters")
+		["--tile_overlap"]
+		("The margin of the neighbouring tiles each tile is detected with.")
+		.optional()
+		| lyra::opt(cExtractFeatures::mVoxelNormals)
+		["--voxel_normals"]
+		("Estimate the normals of planar regions from voxels, faster on dense clouds.")
 		| lyra::opt(num_of_threads, "threads")
 		["-t"]["--threads"]
 		("The number of threads to use for repairing data files.")
@@ -122,6 +137,8 @@ int main(int argc, char** argv)
 		return 1;
 	}
 
+	cExtractFeatures::mPlyUseBinaryFormat = !asciiPly;
+
 
 	const std::filesystem::path input{ input_directory };
 
@@ -51,13 +51,6 @@ struct PointCloud
 
 	std::vector<PtData>  pts;
 
-	// operator =
-	PointCloud& operator =(const PointCloud &info)
-	{
-		this->pts = info.pts;
-		return *this;
-	}
-
 	// Must return the number of data points
 	inline size_t kdtree_get_point_count() const { return pts.size(); }
 
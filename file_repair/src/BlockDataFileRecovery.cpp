@@ -31,6 +31,26 @@
 #include <cstring>
 
 
+namespace
+{
+    // The size of the chunks read while searching for the next block header
+    constexpr std::size_t SCAN_CHUNK_SIZE = 1024 * 1024;
+
+    // The length, class id, major version, minor version and data id of a block
+    constexpr std::size_t BLOCK_HEADER_SIZE = sizeof(std::size_t) + sizeof(BLOCK_CLASS_ID_t)
+        + sizeof(BLOCK_MAJOR_VERSION_t) + sizeof(BLOCK_MINOR_VERSION_t) + sizeof(BLOCK_DATA_ID_t);
+
+    // The offset of the most significant byte of the block length
+    constexpr std::size_t LENGTH_MSB = sizeof(std::size_t) - 1;
+
+    // How far into a payload of the wrong length a block inserted in it is searched for
+    constexpr std::size_t PAYLOAD_SCAN_SIZE = SCAN_CHUNK_SIZE;
+
+    // No limit on the search for the next block header
+    const std::ifstream::pos_type END_OF_FILE = -1;
+}
+
+
 /*******************************************************************
  *
  * B L O C K   D A T A   F I L E   R E C O V E R Y
@@ -148,7 +168,8 @@ bool cBlockDataFileRecovery::processBlock()
 
     if (len == 0)
     {
-        mStartOfCRC = mFile.tellg();
+        mStartOfPayload = mFile.tellg();
+        mStartOfCRC = mStartOfPayload;
         uint32_t file_crc = readCRC();
         uint32_t crc = bdf::crc(blockId);
         if (file_crc != crc)
@@ -309,54 +330,12 @@ bool cBlockDataFileRecovery::tryToFixBlockId(const cBlockID blockID)
 
 bool cBlockDataFileRecovery::tryToFixBlock(const cBlockID blockID, const std::size_t len)
 {
-    std::ifstream::pos_type mStartPos = mFile.tellg();;
-
     std::size_t insertedLen = 0;
-    BLOCK_CLASS_ID_t classID = 0;
-    BLOCK_MAJOR_VERSION_t majorVer = 0;
-    BLOCK_MINOR_VERSION_t minorVer = 0;
-    BLOCK_DATA_ID_t dataID = 0;
     cBlockID insertedBlockID;
-    uint32_t insertedCRC = 0;
-
     eBlockStatus result;
-    do
-    {
-        mFile.seekg(mStartPos);
-        mFile.read(reinterpret_cast<char*>(&insertedLen), sizeof(insertedLen));
-        mFile.read(reinterpret_cast<char*>(&classID), sizeof(classID));
-        mFile.read(reinterpret_cast<char*>(&majorVer), sizeof(majorVer));
-        mFile.read(reinterpret_cast<char*>(&minorVer), sizeof(minorVer));
-        mFile.read(reinterpret_cast<char*>(&dataID), sizeof(dataID));
-
-        insertedBlockID.classID(static_cast<BLOCK_CLASS_ID_t>(classID));
-        insertedBlockID.setVersion(majorVer, minorVer);
-        insertedBlockID.dataID(dataID);
-
-        mStartPos += 1;
-
-        if (mFile.eof() || mFile.fail())
-            return false;
 
-        result = checkBlockId(insertedBlockID, insertedLen);
-
-        if (result == eBlockStatus::BAD_CRC)
-        {
-            if (insertedLen == 0)
-                processBlock(insertedBlockID);
-            else
-            {
-                cDataBuffer insertedBuffer;
-                std::ifstream::pos_type start_pos = mFile.tellg();
-                readPayload(insertedLen, insertedBuffer);
-
-                processBlock(insertedBlockID, insertedBuffer.data(), insertedLen);
-            }
-
-            return true;
-        }
-
-    } while (eBlockStatus::OK != result);
+    if (!findNextBlockHeader(mFile.tellg(), END_OF_FILE, insertedBlockID, insertedLen, result))
+        return false;
 
     if (insertedLen == 0)
     {
@@ -365,7 +344,6 @@ bool cBlockDataFileRecovery::tryToFixBlock(const cBlockID blockID, const std::si
     else
     {
         cDataBuffer insertedBuffer;
-        std::ifstream::pos_type start_pos = mFile.tellg();
         readPayload(insertedLen, insertedBuffer);
 
         processBlock(insertedBlockID, insertedBuffer.data(), insertedLen);
@@ -374,6 +352,93 @@ bool cBlockDataFileRecovery::tryToFixBlock(const cBlockID blockID, const std::si
     return true;
 }
 
+/**
+ * Search forward from start for the next position holding a plausible block header,
+ * up to but not including end, or to the end of the file if end is END_OF_FILE.
+ *
+ * The file is read in large chunks and scanned in memory.  Any real block is far
+ * smaller than 2^56 bytes, so the most significant byte of its length is zero; memchr
+ * is used to skip straight to those positions before the block id is decoded and checked.
+ *
+ * On success, the file is positioned at the start of the payload of the block found.
+ */
+bool cBlockDataFileRecovery::findNextBlockHeader(std::ifstream::pos_type start, std::ifstream::pos_type end,
+    cBlockID& blockID, std::size_t& len, eBlockStatus& blockStatus)
+{
+    if (start < 0)
+        return false;
+
+    const bool bounded = (end != END_OF_FILE);
+
+    mScanBuffer.resize(SCAN_CHUNK_SIZE + BLOCK_HEADER_SIZE);
+
+    while (!bounded || (start < end))
+    {
+        mFile.clear();
+        mFile.seekg(start);
+        mFile.read(mScanBuffer.data(), mScanBuffer.size());
+
+        auto n = static_cast<std::size_t>(mFile.gcount());
+        if (n < BLOCK_HEADER_SIZE)
+            return false;
+
+        const char* first = mScanBuffer.data();
+        const char* last = first + (n - BLOCK_HEADER_SIZE);
+
+        if (bounded && (end - start <= last - first))
+            last = first + (end - start) - 1;
+
+        for (const char* p = first; p <= last; ++p)
+        {
+            auto* msb = static_cast<const char*>(std::memchr(p + LENGTH_MSB, 0, (last - p) + 1));
+            if (!msb)
+                break;
+
+            p = msb - LENGTH_MSB;
+
+            BLOCK_CLASS_ID_t classID = 0;
+            BLOCK_MAJOR_VERSION_t majorVer = 0;
+            BLOCK_MINOR_VERSION_t minorVer = 0;
+            BLOCK_DATA_ID_t dataID = 0;
+
+            const char* field = p;
+            std::memcpy(&len, field, sizeof(len));
+            field += sizeof(len);
+            std::memcpy(&classID, field, sizeof(classID));
+            field += sizeof(classID);
+            std::memcpy(&majorVer, field, sizeof(majorVer));
+            field += sizeof(majorVer);
+            std::memcpy(&minorVer, field, sizeof(minorVer));
+            field += sizeof(minorVer);
+            std::memcpy(&dataID, field, sizeof(dataID));
+
+            blockID.classID(static_cast<BLOCK_CLASS_ID_t>(classID));
+            blockID.setVersion(majorVer, minorVer);
+            blockID.dataID(dataID);
+
+            blockStatus = checkBlockId(blockID, len);
+
+            if ((blockStatus == eBlockStatus::OK) || (blockStatus == eBlockStatus::BAD_CRC))
+            {
+                mFile.clear();
+                mFile.seekg(start + static_cast<std::streamoff>((p - first) + BLOCK_HEADER_SIZE));
+                return true;
+            }
+        }
+
+        // The last few bytes of this chunk are the start of the next one
+        start += static_cast<std::streamoff>(n - BLOCK_HEADER_SIZE + 1);
+    }
+
+    return false;
+}
+
+void cBlockDataFileRecovery::resumeAt(std::streamoff offset)
+{
+    mFile.clear();
+    mFile.seekg(offset);
+}
+
 bool cBlockDataFileRecovery::tryToFixBlock(const cBlockID blockID, const cDataBuffer buffer, const std::size_t len)
 {
     auto result = checkBlockId(blockID, len);
@@ -555,57 +620,35 @@ bool cBlockDataFileRecovery::fixAtBlockId(const cBlockID originalBlockID, std::s
         break;
     case eBlockStatus::BAD_PAYLOAD:
         mEndPos = mStartPos = mStartOfPayload;
+        mEndPos += PAYLOAD_SCAN_SIZE;
         break;
     default:
         return false;
     }
 
     std::size_t insertedLen = 0;
-    BLOCK_CLASS_ID_t classID = 0;
-    BLOCK_MAJOR_VERSION_t majorVer = 0;
-    BLOCK_MINOR_VERSION_t minorVer = 0;
-    BLOCK_DATA_ID_t dataID = 0;
     cBlockID insertedBlockID;
     uint32_t insertedCRC = 0;
 
+    // A block header inserted in the bad field starts before its end
     eBlockStatus result;
-    do
-    {
-        mFile.seekg(mStartPos);
-        mFile.read(reinterpret_cast<char*>(&insertedLen), sizeof(insertedLen));
-        mFile.read(reinterpret_cast<char*>(&classID), sizeof(classID));
-        mFile.read(reinterpret_cast<char*>(&majorVer), sizeof(majorVer));
-        mFile.read(reinterpret_cast<char*>(&minorVer), sizeof(minorVer));
-        mFile.read(reinterpret_cast<char*>(&dataID), sizeof(dataID));
-
-        insertedBlockID.classID(static_cast<BLOCK_CLASS_ID_t>(classID));
-        insertedBlockID.setVersion(majorVer, minorVer);
-        insertedBlockID.dataID(dataID);
-
-        mStartPos += 1;
-
-        if (mStartPos == mEndPos)
-            return false;
-
-        result = checkBlockId(insertedBlockID, insertedLen);
+    if (!findNextBlockHeader(mStartPos, mEndPos - std::streamoff(1), insertedBlockID, insertedLen, result))
+        return false;
 
-        if (result == eBlockStatus::BAD_CRC)
+    if (result == eBlockStatus::BAD_CRC)
+    {
+        if (insertedLen == 0)
+            processBlock(insertedBlockID);
+        else
         {
-            if (insertedLen == 0)
-                processBlock(insertedBlockID);
-            else
-            {
-                cDataBuffer insertedBuffer;
-                std::ifstream::pos_type start_pos = mFile.tellg();
-                readPayload(insertedLen, insertedBuffer);
-
-                processBlock(insertedBlockID, insertedBuffer.data(), insertedLen);
-            }
+            cDataBuffer insertedBuffer;
+            readPayload(insertedLen, insertedBuffer);
 
-            return true;
+            processBlock(insertedBlockID, insertedBuffer.data(), insertedLen);
         }
 
-    } while (eBlockStatus::OK != result);
+        return true;
+    }
 
     cDataBuffer insertedBuffer;
 
@@ -8,6 +8,7 @@
 #include <cstdio>
 #include <fstream>
 #include <map>
+#include <vector>
 
 
 class cBlockDataFileRecovery : public cBlockDataFileReader
@@ -18,6 +19,12 @@ public:
 	virtual void processBlock(const cBlockID& id) = 0;
 	virtual void processBlock(const cBlockID& id, const std::byte* buf, std::size_t len) = 0;
 
+	/**
+	 * Continue processing with the block starting at the given file offset.
+	 * Used to pick up an interrupted recovery from a checkpoint.
+	 */
+	void resumeAt(std::streamoff offset);
+
 private:
 	void readPayload(std::size_t len, cDataBuffer& buffer);
 	uint32_t readCRC();
@@ -29,6 +36,9 @@ private:
 	enum class eBlockStatus { OK, BAD_CLASS_ID, BAD_MAJOR_VERSION, BAD_MINOR_VERSION, BAD_DATA_ID, BAD_PAYLOAD, BAD_CRC};
 	eBlockStatus checkBlockId(const cBlockID blockID, std::size_t len);
 
+	bool findNextBlockHeader(std::ifstream::pos_type start, std::ifstream::pos_type end,
+		cBlockID& blockID, std::size_t& len, eBlockStatus& blockStatus);
+
 private:
 	bool fixAtBlockId(const cBlockID originalBlockID, std::size_t originalLen, eBlockStatus blockStatus);
 
@@ -66,5 +76,7 @@ private:
 	std::ifstream::pos_type mStartOfDataID;
 	std::ifstream::pos_type mStartOfPayload;
 	std::ifstream::pos_type mStartOfCRC;
+
+	std::vector<char> mScanBuffer;
 };
 
@@ -7,6 +7,7 @@
 #include <memory>
 #include <string>
 #include <stdexcept>
+#include <fstream>
 
 #include <iostream>
 
@@ -16,6 +17,59 @@ extern void update_prefix_progress(const int id, std::string prefix, const int p
 extern void update_progress(const int id, const int progress_pct);
 
 
+namespace
+{
+    // How much of the input file is processed between checkpoints
+    constexpr std::uintmax_t CHECKPOINT_INTERVAL = 256 * 1024 * 1024;
+
+    /**
+     * Copies the blocks recovered by an interrupted run into the new output file.
+     */
+    class cRecoveredBlockCopier : private cBlockDataFileRecovery
+    {
+    public:
+        explicit cRecoveredBlockCopier(cBlockDataFileWriter& writer) : mFileWriter(writer) {}
+
+        using cBlockDataFileRecovery::open;
+        using cBlockDataFileRecovery::close;
+
+        std::uint64_t copy(std::uint64_t num_blocks)
+        {
+            try
+            {
+                while (mNumBlocks < num_blocks)
+                {
+                    if (!cBlockDataFileRecovery::processBlock())
+                        break;
+                }
+            }
+            catch (const std::exception&)
+            {
+            }
+
+            return mNumBlocks;
+        }
+
+    private:
+        void processBlock(const cBlockID& id) override
+        {
+            mFileWriter.writeBlock(id);
+            ++mNumBlocks;
+        }
+
+        void processBlock(const cBlockID& id, const std::byte* buf, std::size_t len) override
+        {
+            mFileWriter.writeBlock(id, buf, len);
+            ++mNumBlocks;
+        }
+
+    private:
+        cBlockDataFileWriter& mFileWriter;
+        std::uint64_t mNumBlocks = 0;
+    };
+}
+
+
 //-----------------------------------------------------------------------------
 cDataFileRecovery::cDataFileRecovery(int id, std::filesystem::path temporary_dir)
     : mID(id)
@@ -64,9 +118,30 @@ bool cDataFileRecovery::open(std::filesystem::path file_to_recover)
     mCurrentFile = file_to_recover;
     mTemporaryFile = mTemporaryDirectory / mCurrentFile.filename();
 
-    if (std::filesystem::exists(mTemporaryFile))
+    mCheckpointFile = mTemporaryFile;
+    mCheckpointFile += ".checkpoint";
+
+    mPartialFile = mTemporaryFile;
+    mPartialFile += ".partial";
+
+    if (std::filesystem::exists(mPartialFile))
     {
-        return false;
+        // An earlier attempt to resume was itself interrupted, the checkpoint
+        // still refers to the partial file
+        std::filesystem::remove(mTemporaryFile);
+    }
+    else if (std::filesystem::exists(mTemporaryFile))
+    {
+        // Without a checkpoint there is no way to tell how much of the
+        // temporary file can be trusted
+        if (!std::filesystem::exists(mCheckpointFile))
+            return false;
+
+        std::filesystem::rename(mTemporaryFile, mPartialFile);
+    }
+    else
+    {
+        mPartialFile.clear();
     }
 
     mFileWriter.open(mTemporaryFile.string());
@@ -92,6 +167,8 @@ bool cDataFileRecovery::run()
 
     mFileWriter.close();
 
+    removeCheckpoint();
+
     update_prefix_progress(mID, "Verifing", 0);
 
     if (!pass2())
@@ -117,6 +194,25 @@ bool cDataFileRecovery::pass1()
         throw std::logic_error("No file is open for recover.");
     }
 
+    mNumBlocksWritten = 0;
+    mPendingCheckpoint = sCheckpoint_t();
+
+    if (!mPartialFile.empty())
+    {
+        if (!resumeFromCheckpoint())
+        {
+            // Start over with an empty output file
+            mFileWriter.close();
+            mFileWriter.open(mTemporaryFile.string());
+
+            mNumBlocksWritten = 0;
+            mPendingCheckpoint = sCheckpoint_t();
+        }
+
+        std::filesystem::remove(mPartialFile);
+        mPartialFile.clear();
+    }
+
     try
     {
         while (!eof())
@@ -130,6 +226,8 @@ bool cDataFileRecovery::pass1()
 
             cBlockDataFileRecovery::processBlock();
 
+            updateCheckpoint();
+
             auto file_pos = static_cast<double>(cBlockDataFileRecovery::filePosition());
             file_pos = 100.0 * (file_pos / mOriginalFileSize);
             update_progress(mID, static_cast<int>(file_pos));
@@ -285,6 +383,7 @@ void cDataFileRecovery::processBlock(const cBlockID& id)
 //        << ", Minor = " << static_cast<int>(id.minorVersion()) << ", Data ID = " << id.dataID() << "\n";
 
     mFileWriter.writeBlock(id);
+    ++mNumBlocksWritten;
 }
 
 void cDataFileRecovery::processBlock(const cBlockID& id, const std::byte* buf, std::size_t len)
@@ -294,6 +393,7 @@ void cDataFileRecovery::processBlock(const cBlockID& id, const std::byte* buf, s
 //        << ", len = " << len << "\n";
 
     mFileWriter.writeBlock(id, buf, len);
+    ++mNumBlocksWritten;
 }
 
 //-----------------------------------------------------------------------------
@@ -325,4 +425,82 @@ bool cDataFileRecovery::removeFailedFile()
     return std::filesystem::remove(mCurrentFile);
 }
 
+//-----------------------------------------------------------------------------
+bool cDataFileRecovery::resumeFromCheckpoint()
+{
+    sCheckpoint_t checkpoint;
+
+    {
+        std::ifstream in(mCheckpointFile);
+
+        if (!(in >> checkpoint.input_offset >> checkpoint.num_blocks))
+            return false;
+    }
+
+    cRecoveredBlockCopier copier(mFileWriter);
+
+    if (!copier.open(mPartialFile.string()))
+        return false;
+
+    auto num_blocks = copier.copy(checkpoint.num_blocks);
+
+    copier.close();
+
+    if (num_blocks != checkpoint.num_blocks)
+        return false;
+
+    std::string msg = mCurrentFile.filename().string();
+    msg += ": Resuming recovery at offset ";
+    msg += std::to_string(checkpoint.input_offset);
+    console_message(msg);
+
+    mNumBlocksWritten = checkpoint.num_blocks;
+    mPendingCheckpoint = checkpoint;
+
+    resumeAt(static_cast<std::streamoff>(checkpoint.input_offset));
 
+    return true;
+}
+
+void cDataFileRecovery::updateCheckpoint()
+{
+    auto file_pos = static_cast<std::streamoff>(cBlockDataFileRecovery::filePosition());
+    if (file_pos <= 0)
+        return;
+
+    auto input_offset = static_cast<std::uintmax_t>(file_pos);
+    if (input_offset < mPendingCheckpoint.input_offset + CHECKPOINT_INTERVAL)
+        return;
+
+    // The blocks before the pending checkpoint were written a whole interval
+    // ago, so they have left the writer's buffer and can be trusted on resume
+    if (mPendingCheckpoint.num_blocks > 0)
+        saveCheckpoint(mPendingCheckpoint.input_offset, mPendingCheckpoint.num_blocks);
+
+    mPendingCheckpoint.input_offset = input_offset;
+    mPendingCheckpoint.num_blocks = mNumBlocksWritten;
+}
+
+void cDataFileRecovery::saveCheckpoint(std::uintmax_t input_offset, std::uint64_t num_blocks)
+{
+    std::filesystem::path tmp = mCheckpointFile;
+    tmp += ".tmp";
+
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        out << input_offset << ' ' << num_blocks << '\n';
+
+        if (!out)
+            return;
+    }
+
+    // Replace the old checkpoint in one step so that it is never half written
+    std::error_code ec;
+    std::filesystem::rename(tmp, mCheckpointFile, ec);
+}
+
+void cDataFileRecovery::removeCheckpoint()
+{
+    std::error_code ec;
+    std::filesystem::remove(mCheckpointFile, ec);
+}
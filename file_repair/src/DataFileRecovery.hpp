@@ -7,6 +7,7 @@
 
 #include <filesystem>
 #include <string>
+#include <cstdint>
 
 class cDataFileRecovery : private cBlockDataFileRecovery
 {
@@ -37,7 +38,19 @@ private:
 
     bool removeFailedFile();
 
+	// Checkpoints allow an interrupted recovery to continue where it left off
+	bool resumeFromCheckpoint();
+	void updateCheckpoint();
+	void saveCheckpoint(std::uintmax_t input_offset, std::uint64_t num_blocks);
+	void removeCheckpoint();
+
 private:
+	struct sCheckpoint_t
+	{
+		std::uintmax_t	input_offset = 0;
+		std::uint64_t	num_blocks = 0;
+	};
+
 	const int mID;
 
 	std::uintmax_t mOriginalFileSize = 0;
@@ -48,5 +61,14 @@ private:
 	std::filesystem::path mTemporaryDirectory;
 	std::filesystem::path mCurrentFile;
 	std::filesystem::path mTemporaryFile;
+
+	/// The output of an interrupted run that is being resumed
+	std::filesystem::path mPartialFile;
+	std::filesystem::path mCheckpointFile;
+
+	std::uint64_t mNumBlocksWritten = 0;
+
+	/// The block boundary that will be saved at the next checkpoint
+	sCheckpoint_t mPendingCheckpoint;
 };
 
@@ -167,6 +167,15 @@ namespace v1
         void attach(std::byte* buffer, size_type size);
         std::byte* detach();
 
+        /**
+         * \brief wrap
+         * \par Description
+         *		Points the data buffer at size bytes of external storage without
+         *		taking ownership of it.  The storage must outlive any use of the
+         *		buffer and is not freed by the data buffer.
+         */
+        void wrap(std::byte* buffer, size_type size);
+
         /**
          * \brief reset
          * \par Description
@@ -367,6 +376,12 @@ namespace v1
          *  \brief  The write index is at the end of the internal buffer storage.
          */
         bool mOverrun;
+
+        /**
+         *  \var	mOwnsBuffer
+         *  \brief  False if the internal buffer storage was supplied by wrap().
+         */
+        bool mOwnsBuffer = true;
         //@}
     };
 
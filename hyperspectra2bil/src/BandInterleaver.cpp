@@ -0,0 +1,154 @@
+#include "BandInterleaver.hpp"
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+	#define USE_SSE2
+	#include <emmintrin.h>
+#endif
+
+
+namespace
+{
+	// The transpose is done in square tiles that fit in the L1 cache
+	constexpr std::size_t TILE_SIZE = 64;
+
+	void transpose_tile(const uint16_t* src, std::size_t src_stride,
+		uint16_t* dst, std::size_t dst_stride, std::size_t rows, std::size_t cols)
+	{
+		std::size_t r = 0;
+
+#ifdef USE_SSE2
+		for (; r + 8 <= rows; r += 8)
+		{
+			std::size_t c = 0;
+
+			for (; c + 8 <= cols; c += 8)
+			{
+				const uint16_t* s = src + r * src_stride + c;
+
+				__m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+				__m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + src_stride));
+				__m128i a2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 2 * src_stride));
+				__m128i a3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 3 * src_stride));
+				__m128i a4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 4 * src_stride));
+				__m128i a5 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 5 * src_stride));
+				__m128i a6 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 6 * src_stride));
+				__m128i a7 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 7 * src_stride));
+
+				__m128i t0 = _mm_unpacklo_epi16(a0, a1);
+				__m128i t1 = _mm_unpackhi_epi16(a0, a1);
+				__m128i t2 = _mm_unpacklo_epi16(a2, a3);
+				__m128i t3 = _mm_unpackhi_epi16(a2, a3);
+				__m128i t4 = _mm_unpacklo_epi16(a4, a5);
+				__m128i t5 = _mm_unpackhi_epi16(a4, a5);
+				__m128i t6 = _mm_unpacklo_epi16(a6, a7);
+				__m128i t7 = _mm_unpackhi_epi16(a6, a7);
+
+				__m128i u0 = _mm_unpacklo_epi32(t0, t2);
+				__m128i u1 = _mm_unpackhi_epi32(t0, t2);
+				__m128i u2 = _mm_unpacklo_epi32(t1, t3);
+				__m128i u3 = _mm_unpackhi_epi32(t1, t3);
+				__m128i u4 = _mm_unpacklo_epi32(t4, t6);
+				__m128i u5 = _mm_unpackhi_epi32(t4, t6);
+				__m128i u6 = _mm_unpacklo_epi32(t5, t7);
+				__m128i u7 = _mm_unpackhi_epi32(t5, t7);
+
+				uint16_t* d = dst + c * dst_stride + r;
+
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(d), _mm_unpacklo_epi64(u0, u4));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(d + dst_stride), _mm_unpackhi_epi64(u0, u4));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(d + 2 * dst_stride), _mm_unpacklo_epi64(u1, u5));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(d + 3 * dst_stride), _mm_unpackhi_epi64(u1, u5));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(d + 4 * dst_stride), _mm_unpacklo_epi64(u2, u6));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(d + 5 * dst_stride), _mm_unpackhi_epi64(u2, u6));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(d + 6 * dst_stride), _mm_unpacklo_epi64(u3, u7));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(d + 7 * dst_stride), _mm_unpackhi_epi64(u3, u7));
+			}
+
+			// The columns left over at the right edge of the tile
+			for (; c < cols; ++c)
+			{
+				for (std::size_t i = r; i < r + 8; ++i)
+					dst[c * dst_stride + i] = src[i * src_stride + c];
+			}
+		}
+#endif
+
+		// The rows left over at the bottom edge of the tile
+		for (; r < rows; ++r)
+		{
+			for (std::size_t c = 0; c < cols; ++c)
+				dst[c * dst_stride + r] = src[r * src_stride + c];
+		}
+	}
+
+	void transpose_tile(const float* src, std::size_t src_stride,
+		float* dst, std::size_t dst_stride, std::size_t rows, std::size_t cols)
+	{
+		for (std::size_t r = 0; r < rows; ++r)
+		{
+			for (std::size_t c = 0; c < cols; ++c)
+				dst[c * dst_stride + r] = src[r * src_stride + c];
+		}
+	}
+
+	template<typename T>
+	void transpose_tiled(const T* src, std::size_t rows, std::size_t cols, T* dst)
+	{
+		for (std::size_t r = 0; r < rows; r += TILE_SIZE)
+		{
+			auto tile_rows = std::min(TILE_SIZE, rows - r);
+
+			for (std::size_t c = 0; c < cols; c += TILE_SIZE)
+			{
+				auto tile_cols = std::min(TILE_SIZE, cols - c);
+
+				transpose_tile(src + r * cols + c, cols, dst + c * rows + r, rows, tile_rows, tile_cols);
+			}
+		}
+	}
+}
+
+void nBandInterleave::transpose(const uint16_t* src, std::size_t rows, std::size_t cols, uint16_t* dst)
+{
+	transpose_tiled(src, rows, cols, dst);
+}
+
+void nBandInterleave::transpose(const float* src, std::size_t rows, std::size_t cols, float* dst)
+{
+	transpose_tiled(src, rows, cols, dst);
+}
+
+void cBandInterleaver::writeBIL(std::ostream& out, const uint16_t* frame, std::size_t spatialSize, std::size_t spectralSize)
+{
+	out.write(reinterpret_cast<const char*>(frame), spatialSize * spectralSize * sizeof(uint16_t));
+}
+
+void cBandInterleaver::writeBIP(std::ostream& out, const uint16_t* frame, std::size_t spatialSize, std::size_t spectralSize)
+{
+	mInterleaved.resize(spatialSize * spectralSize);
+
+	nBandInterleave::transpose(frame, spectralSize, spatialSize, mInterleaved.data());
+
+	write(out, mInterleaved);
+}
+
+void cBandInterleaver::writeBIL(std::ostream& out, const float* frame, std::size_t spatialSize, std::size_t spectralSize)
+{
+	out.write(reinterpret_cast<const char*>(frame), spatialSize * spectralSize * sizeof(float));
+}
+
+void cBandInterleaver::writeBIP(std::ostream& out, const float* frame, std::size_t spatialSize, std::size_t spectralSize)
+{
+	mInterleavedFloat.resize(spatialSize * spectralSize);
+
+	nBandInterleave::transpose(frame, spectralSize, spatialSize, mInterleavedFloat.data());
+
+	out.write(reinterpret_cast<const char*>(mInterleavedFloat.data()), mInterleavedFloat.size() * sizeof(float));
+}
+
+void cBandInterleaver::write(std::ostream& out, const std::vector<uint16_t>& buffer)
+{
+	out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(uint16_t));
+}
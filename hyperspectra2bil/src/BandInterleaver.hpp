@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+
+/**
+ * Converts HySpex frames into band interleaved by line (BIL) or band
+ * interleaved by pixel (BIP) order and writes each frame with one write.
+ *
+ * A frame is gathered into a buffer with its bands one after another,
+ * which is already the BIL order of one image line.  For BIP the buffer
+ * is transposed so that all of the bands of a pixel are together.  The
+ * buffers are kept between frames so that no memory is allocated once
+ * the first frame has been written.
+ */
+class cBandInterleaver
+{
+public:
+	template<class IMAGE>
+	void writeBIL(std::ostream& out, const IMAGE& image)
+	{
+		gatherBands(image);
+		write(out, mFrame);
+	}
+
+	template<class IMAGE>
+	void writeBIP(std::ostream& out, const IMAGE& image)
+	{
+		gatherBands(image);
+
+		if (mSpectralSize > 0)
+			writeBIP(out, mFrame.data(), mFrame.size() / mSpectralSize, mSpectralSize);
+	}
+
+	/**
+	 * Write a frame that holds spectralSize bands of spatialSize samples,
+	 * one band after another.
+	 */
+	void writeBIL(std::ostream& out, const uint16_t* frame, std::size_t spatialSize, std::size_t spectralSize);
+	void writeBIP(std::ostream& out, const uint16_t* frame, std::size_t spatialSize, std::size_t spectralSize);
+
+	/**
+	 * Write a frame of calibrated samples, stored like the raw frames.
+	 */
+	void writeBIL(std::ostream& out, const float* frame, std::size_t spatialSize, std::size_t spectralSize);
+	void writeBIP(std::ostream& out, const float* frame, std::size_t spatialSize, std::size_t spectralSize);
+
+private:
+	template<class IMAGE>
+	void gatherBands(const IMAGE& image)
+	{
+		const auto& data = image.image();
+
+		mSpectralSize = image.spectralSize();
+		mFrame.clear();
+
+		for (std::size_t band = 0; band < mSpectralSize; ++band)
+		{
+			const auto& samples = data.band(band);
+			mFrame.insert(mFrame.end(), samples.begin(), samples.end());
+		}
+	}
+
+	static void write(std::ostream& out, const std::vector<uint16_t>& buffer);
+
+private:
+	std::size_t mSpectralSize = 0;
+
+	std::vector<uint16_t> mFrame;
+	std::vector<uint16_t> mInterleaved;
+	std::vector<float> mInterleavedFloat;
+};
+
+
+namespace nBandInterleave
+{
+	/**
+	 * Transpose a rows x cols matrix of 16-bit samples into a cols x rows matrix.
+	 */
+	void transpose(const uint16_t* src, std::size_t rows, std::size_t cols, uint16_t* dst);
+	void transpose(const float* src, std::size_t rows, std::size_t cols, float* dst);
+}
@@ -0,0 +1,185 @@
+#include "BandSequentialWriter.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+
+cBandSequentialWriter::cBandSequentialWriter()
+{
+}
+
+cBandSequentialWriter::~cBandSequentialWriter()
+{
+	close();
+}
+
+void cBandSequentialWriter::setLinesPerChunk(std::size_t lines)
+{
+	mLinesPerChunk = std::max<std::size_t>(lines, 1);
+}
+
+void cBandSequentialWriter::open(std::filesystem::path scratch_file)
+{
+	close();
+
+	mScratchFilename = scratch_file;
+	mChunkLines = mLinesPerChunk;
+}
+
+void cBandSequentialWriter::addFrame(const uint16_t* frame, std::size_t spatialSize, std::size_t spectralSize)
+{
+	auto* line = beginFrame(spatialSize, spectralSize);
+	if (!line)
+		return;
+
+	for (std::size_t band = 0; band < mSpectralSize; ++band)
+	{
+		std::copy_n(frame + band * mSpatialSize, mSpatialSize, line);
+		line += mChunkLines * mSpatialSize;
+	}
+
+	endFrame();
+}
+
+void cBandSequentialWriter::addFrame(const float* frame, std::size_t spatialSize, std::size_t spectralSize)
+{
+	// A line of float samples is stored as twice as many 16-bit words, which
+	// keeps the bytes of each band together in the same order
+	constexpr std::size_t WORDS_PER_SAMPLE = sizeof(float) / sizeof(uint16_t);
+
+	auto* line = beginFrame(spatialSize * WORDS_PER_SAMPLE, spectralSize);
+	if (!line)
+		return;
+
+	for (std::size_t band = 0; band < mSpectralSize; ++band)
+	{
+		std::memcpy(line, frame + band * spatialSize, spatialSize * sizeof(float));
+		line += mChunkLines * mSpatialSize;
+	}
+
+	endFrame();
+}
+
+uint16_t* cBandSequentialWriter::beginFrame(std::size_t spatialSize, std::size_t spectralSize)
+{
+	if (!isOpen() || (spatialSize == 0) || (spectralSize == 0))
+		return nullptr;
+
+	if (mNumLines == 0)
+	{
+		mSpatialSize = spatialSize;
+		mSpectralSize = spectralSize;
+
+		mChunk.resize(mChunkLines * mSpatialSize * mSpectralSize);
+	}
+	else if ((spatialSize != mSpatialSize) || (spectralSize != mSpectralSize))
+	{
+		throw std::runtime_error("The frame size changed within a band sequential cube.");
+	}
+
+	return mChunk.data() + mLinesInChunk * mSpatialSize;
+}
+
+void cBandSequentialWriter::endFrame()
+{
+	++mNumLines;
+
+	if (++mLinesInChunk == mChunkLines)
+		flushChunk();
+}
+
+void cBandSequentialWriter::flushChunk()
+{
+	if (!mScratchFile.is_open())
+	{
+		mScratchFile.open(mScratchFilename, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+
+		if (!mScratchFile.is_open())
+		{
+			std::string msg = "Could not open: ";
+			msg += mScratchFilename.string();
+			throw std::runtime_error(msg);
+		}
+	}
+
+	mScratchFile.write(reinterpret_cast<const char*>(mChunk.data()), mChunk.size() * sizeof(uint16_t));
+
+	if (!mScratchFile)
+	{
+		std::string msg = "Could not write to: ";
+		msg += mScratchFilename.string();
+		throw std::runtime_error(msg);
+	}
+
+	++mNumChunksFlushed;
+	mLinesInChunk = 0;
+}
+
+void cBandSequentialWriter::write(std::ostream& out)
+{
+	const std::size_t slab_size = mChunkLines * mSpatialSize;
+	const std::size_t chunk_size = slab_size * mSpectralSize;
+
+	std::vector<uint16_t> slab;
+
+	if (mNumChunksFlushed > 0)
+	{
+		mScratchFile.flush();
+		slab.resize(slab_size);
+	}
+
+	for (std::size_t band = 0; band < mSpectralSize; ++band)
+	{
+		for (std::size_t chunk = 0; chunk < mNumChunksFlushed; ++chunk)
+		{
+			auto offset = (chunk * chunk_size + band * slab_size) * sizeof(uint16_t);
+
+			mScratchFile.seekg(static_cast<std::streamoff>(offset));
+			mScratchFile.read(reinterpret_cast<char*>(slab.data()), slab_size * sizeof(uint16_t));
+
+			if (!mScratchFile)
+			{
+				std::string msg = "Could not read from: ";
+				msg += mScratchFilename.string();
+				throw std::runtime_error(msg);
+			}
+
+			out.write(reinterpret_cast<const char*>(slab.data()), slab_size * sizeof(uint16_t));
+		}
+
+		// The last lines of the band are still in memory
+		if (mLinesInChunk > 0)
+		{
+			out.write(reinterpret_cast<const char*>(mChunk.data() + band * slab_size),
+				mLinesInChunk * mSpatialSize * sizeof(uint16_t));
+		}
+	}
+
+	close();
+}
+
+void cBandSequentialWriter::close()
+{
+	if (mScratchFile.is_open())
+		mScratchFile.close();
+
+	if (!mScratchFilename.empty())
+	{
+		std::error_code ec;
+		std::filesystem::remove(mScratchFilename, ec);
+	}
+
+	mScratchFilename.clear();
+
+	mSpatialSize = 0;
+	mSpectralSize = 0;
+	mNumLines = 0;
+	mLinesInChunk = 0;
+	mNumChunksFlushed = 0;
+
+	mChunk.clear();
+	mChunk.shrink_to_fit();
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <ostream>
+#include <vector>
+
+
+/**
+ * Builds a band sequential (BSQ) cube from line frames without holding the
+ * cube in memory.
+ *
+ * Frames are collected into a chunk of a fixed number of lines, stored one
+ * band after another.  Each full chunk is written to a scratch file with a
+ * single write.  When the cube is written, every band is assembled from its
+ * slab in each chunk, so the output file is written strictly in order.
+ * Memory use is bounded by one chunk, no matter how long the recording is.
+ */
+class cBandSequentialWriter
+{
+public:
+	static constexpr std::size_t DEFAULT_LINES_PER_CHUNK = 128;
+
+public:
+	cBandSequentialWriter();
+	~cBandSequentialWriter();
+
+	cBandSequentialWriter(const cBandSequentialWriter&) = delete;
+	cBandSequentialWriter& operator=(const cBandSequentialWriter&) = delete;
+
+	/**
+	 * The number of lines held in memory before they are moved to the
+	 * scratch file.  Only takes effect for the next cube.
+	 */
+	void setLinesPerChunk(std::size_t lines);
+
+	/**
+	 * Start a new cube.  The scratch file is only created if the cube does
+	 * not fit in one chunk.
+	 */
+	void open(std::filesystem::path scratch_file);
+
+	bool isOpen() const { return !mScratchFilename.empty(); }
+
+	std::size_t lines() const { return mNumLines; }
+
+	template<class IMAGE>
+	void addFrame(const IMAGE& image)
+	{
+		const auto& data = image.image();
+
+		auto* line = beginFrame(image.spatialSize(), image.spectralSize());
+		if (!line)
+			return;
+
+		for (std::size_t band = 0; band < mSpectralSize; ++band)
+		{
+			const auto& samples = data.band(band);
+
+			auto it = samples.begin();
+			for (std::size_t i = 0; i < mSpatialSize; ++i, ++it)
+				line[i] = *it;
+
+			line += mChunkLines * mSpatialSize;
+		}
+
+		endFrame();
+	}
+
+	/**
+	 * Add a frame that holds spectralSize bands of spatialSize samples,
+	 * one band after another.
+	 */
+	void addFrame(const uint16_t* frame, std::size_t spatialSize, std::size_t spectralSize);
+
+	/**
+	 * Add a frame of calibrated samples.  A cube must not mix raw and
+	 * calibrated frames.
+	 */
+	void addFrame(const float* frame, std::size_t spatialSize, std::size_t spectralSize);
+
+	/**
+	 * Write the cube in band sequential order, then close it.
+	 */
+	void write(std::ostream& out);
+
+	/**
+	 * Discard the cube and remove the scratch file.
+	 */
+	void close();
+
+private:
+	uint16_t* beginFrame(std::size_t spatialSize, std::size_t spectralSize);
+	void endFrame();
+
+	void flushChunk();
+
+private:
+	std::size_t mLinesPerChunk = DEFAULT_LINES_PER_CHUNK;
+	std::size_t mChunkLines = DEFAULT_LINES_PER_CHUNK;
+
+	std::size_t mSpatialSize = 0;
+	std::size_t mSpectralSize = 0;
+
+	/// The lines of the cube
+	std::size_t mNumLines = 0;
+
+	/// The lines in the current chunk
+	std::size_t mLinesInChunk = 0;
+
+	/// The chunks that have been moved to the scratch file
+	std::size_t mNumChunksFlushed = 0;
+
+	std::vector<uint16_t> mChunk;
+
+	std::filesystem::path mScratchFilename;
+	std::fstream mScratchFile;
+};
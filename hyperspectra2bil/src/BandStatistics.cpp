@@ -0,0 +1,346 @@
+#include "BandStatistics.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+	#define USE_SSE2
+	#include <emmintrin.h>
+#endif
+
+
+namespace
+{
+	struct sIndexDefinition
+	{
+		const char* name;
+		float a_nm;
+		float b_nm;
+	};
+
+	const sIndexDefinition INDICES[] =
+	{
+		{"ndvi", 800.0f, 670.0f},
+		{"pri",  531.0f, 570.0f},
+		{"ndre", 790.0f, 720.0f},
+	};
+
+	/// How far outside of the recorded range an index wavelength may be
+	constexpr float WAVELENGTH_TOLERANCE_NM = 10.0f;
+
+	std::size_t nearest_band(const std::vector<float>& wavelengths_nm, float wavelength_nm)
+	{
+		std::size_t index = 0;
+		float diff = std::abs(wavelengths_nm[0] - wavelength_nm);
+
+		for (std::size_t i = 1; i < wavelengths_nm.size(); ++i)
+		{
+			if (std::abs(wavelengths_nm[i] - wavelength_nm) < diff)
+			{
+				diff = std::abs(wavelengths_nm[i] - wavelength_nm);
+				index = i;
+			}
+		}
+
+		return index;
+	}
+}
+
+
+double sBandStatistics::stddev() const
+{
+	return std::sqrt(variance());
+}
+
+void cBandStatistics::setMaxPixelValue(uint16_t maxPixelValue)
+{
+	mSaturation = (maxPixelValue > 0) ? maxPixelValue : UINT16_MAX;
+}
+
+void cBandStatistics::clear()
+{
+	mSpatialSize = 0;
+	mNumLines = 0;
+	mBands.clear();
+	mIndices.clear();
+}
+
+void cBandStatistics::addFrame(const uint16_t* frame, std::size_t spatialSize, std::size_t spectralSize)
+{
+	if ((spatialSize == 0) || (spectralSize == 0))
+		return;
+
+	if (mBands.empty())
+	{
+		mSpatialSize = spatialSize;
+		mBands.resize(spectralSize);
+		selectIndices();
+	}
+
+	if ((spatialSize != mSpatialSize) || (spectralSize != mBands.size()))
+		throw std::runtime_error("The frame size changed during the recording.");
+
+	for (std::size_t band = 0; band < spectralSize; ++band)
+	{
+		auto summary = nStatistics::summarize(frame + band * spatialSize, spatialSize, mSaturation);
+
+		auto& stats = mBands[band];
+
+		stats.min = std::min(stats.min, summary.min);
+		stats.max = std::max(stats.max, summary.max);
+		stats.saturated += summary.saturated;
+
+		// Merge the line into the running mean and variance
+		const double n = static_cast<double>(spatialSize);
+		const double mean = summary.sum / n;
+		const double m2 = std::max(static_cast<double>(summary.sumOfSquares) - summary.sum * mean, 0.0);
+
+		const double total = static_cast<double>(stats.count) + n;
+		const double delta = mean - stats.mean;
+
+		stats.mean += delta * n / total;
+		stats.m2 += m2 + delta * delta * stats.count * n / total;
+		stats.count += spatialSize;
+	}
+
+	addIndices(frame, spatialSize);
+
+	++mNumLines;
+}
+
+void cBandStatistics::selectIndices()
+{
+	mIndices.clear();
+
+	if (mWavelengths_nm.size() != mBands.size())
+		return;
+
+	auto [first, last] = std::minmax_element(mWavelengths_nm.begin(), mWavelengths_nm.end());
+
+	auto covered = [first, last](float wavelength_nm)
+	{
+		return (wavelength_nm >= *first - WAVELENGTH_TOLERANCE_NM) && (wavelength_nm <= *last + WAVELENGTH_TOLERANCE_NM);
+	};
+
+	for (const auto& definition : INDICES)
+	{
+		if (!covered(definition.a_nm) || !covered(definition.b_nm))
+			continue;
+
+		sSpectralIndex index;
+		index.name = definition.name;
+		index.a_nm = definition.a_nm;
+		index.b_nm = definition.b_nm;
+		index.a = nearest_band(mWavelengths_nm, definition.a_nm);
+		index.b = nearest_band(mWavelengths_nm, definition.b_nm);
+
+		mIndices.push_back(std::move(index));
+	}
+}
+
+void cBandStatistics::addIndices(const uint16_t* frame, std::size_t spatialSize)
+{
+	for (auto& index : mIndices)
+	{
+		const uint16_t* a = frame + index.a * spatialSize;
+		const uint16_t* b = frame + index.b * spatialSize;
+
+		auto offset = index.raster.size();
+		index.raster.resize(offset + spatialSize);
+
+		uint8_t* row = index.raster.data() + offset;
+
+		for (std::size_t i = 0; i < spatialSize; ++i)
+		{
+			const float sum = static_cast<float>(a[i]) + b[i];
+			const float value = (sum > 0.0f) ? (static_cast<float>(a[i]) - b[i]) / sum : 0.0f;
+
+			row[i] = static_cast<uint8_t>(std::lround((value + 1.0f) * 127.5f));
+
+			index.sum += value;
+		}
+
+		index.count += spatialSize;
+	}
+}
+
+std::vector<std::string> cBandStatistics::suffixes() const
+{
+	std::vector<std::string> suffixes = { ".stats.json" };
+
+	for (const auto& index : mIndices)
+		suffixes.push_back("." + index.name + ".png");
+
+	return suffixes;
+}
+
+void cBandStatistics::write(const std::filesystem::path& base) const
+{
+	using nlohmann::json;
+
+	json doc;
+	doc["lines"] = mNumLines;
+	doc["samples"] = mSpatialSize;
+	doc["saturation value"] = mSaturation;
+
+	json bands = json::array();
+
+	for (std::size_t i = 0; i < mBands.size(); ++i)
+	{
+		const auto& stats = mBands[i];
+
+		json band;
+		band["band"] = i;
+
+		if (i < mWavelengths_nm.size())
+			band["wavelength_nm"] = mWavelengths_nm[i];
+
+		band["min"] = stats.min;
+		band["max"] = stats.max;
+		band["mean"] = stats.mean;
+		band["stddev"] = stats.stddev();
+		band["saturated"] = stats.saturated;
+
+		bands.push_back(band);
+	}
+
+	doc["bands"] = bands;
+
+	json indices = json::array();
+
+	for (const auto& index : mIndices)
+	{
+		auto filename = base;
+		filename += "." + index.name + ".png";
+
+		json entry;
+		entry["name"] = index.name;
+		entry["a_nm"] = mWavelengths_nm[index.a];
+		entry["b_nm"] = mWavelengths_nm[index.b];
+		entry["mean"] = (index.count > 0) ? index.sum / index.count : 0.0;
+		entry["image"] = filename.filename().string();
+		entry["image scale"] = "index = pixel / 127.5 - 1";
+
+		indices.push_back(entry);
+
+		if (mNumLines > 0)
+		{
+			cv::Mat raster(static_cast<int>(mNumLines), static_cast<int>(mSpatialSize), CV_8UC1,
+				const_cast<uint8_t*>(index.raster.data()));
+
+			cv::imwrite(filename.string(), raster);
+		}
+	}
+
+	doc["indices"] = indices;
+
+	auto filename = base;
+	filename += ".stats.json";
+
+	std::ofstream out(filename);
+
+	if (!out.is_open())
+		throw std::runtime_error("Could not open: " + filename.string());
+
+	out << doc.dump(4) << std::endl;
+}
+
+
+nStatistics::sSummary nStatistics::summarize(const uint16_t* samples, std::size_t count, uint16_t saturation)
+{
+	sSummary summary;
+
+	std::size_t i = 0;
+
+#ifdef USE_SSE2
+	// SSE2 only compares signed 16-bit values, so the samples are biased
+	const __m128i bias = _mm_set1_epi16(static_cast<short>(0x8000));
+	const __m128i threshold = _mm_set1_epi16(static_cast<short>((saturation ^ 0x8000) - 1));
+	const __m128i zero = _mm_setzero_si128();
+
+	__m128i vmin = _mm_set1_epi16(0x7FFF);
+	__m128i vmax = _mm_set1_epi16(static_cast<short>(0x8000));
+
+	// Blocks keep the 32-bit sums and 16-bit counts from overflowing
+	const std::size_t BLOCK = 8 * 4096;
+
+	while (i + 8 <= count)
+	{
+		const std::size_t end = std::min(count - (count - i) % 8, i + BLOCK);
+
+		__m128i sum = zero;
+		__m128i squares = zero;
+		__m128i saturated = zero;
+
+		for (; i < end; i += 8)
+		{
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+			__m128i biased = _mm_xor_si128(v, bias);
+
+			vmin = _mm_min_epi16(vmin, biased);
+			vmax = _mm_max_epi16(vmax, biased);
+
+			// Each match is -1
+			saturated = _mm_sub_epi16(saturated, _mm_cmpgt_epi16(biased, threshold));
+
+			__m128i lo = _mm_unpacklo_epi16(v, zero);
+			__m128i hi = _mm_unpackhi_epi16(v, zero);
+
+			sum = _mm_add_epi32(sum, _mm_add_epi32(lo, hi));
+
+			squares = _mm_add_epi64(squares, _mm_mul_epu32(lo, lo));
+			squares = _mm_add_epi64(squares, _mm_mul_epu32(_mm_srli_epi64(lo, 32), _mm_srli_epi64(lo, 32)));
+			squares = _mm_add_epi64(squares, _mm_mul_epu32(hi, hi));
+			squares = _mm_add_epi64(squares, _mm_mul_epu32(_mm_srli_epi64(hi, 32), _mm_srli_epi64(hi, 32)));
+		}
+
+		alignas(16) uint32_t sums[4];
+		alignas(16) uint64_t sumsOfSquares[2];
+		alignas(16) uint16_t counts[8];
+
+		_mm_store_si128(reinterpret_cast<__m128i*>(sums), sum);
+		_mm_store_si128(reinterpret_cast<__m128i*>(sumsOfSquares), squares);
+		_mm_store_si128(reinterpret_cast<__m128i*>(counts), saturated);
+
+		summary.sum += uint64_t(sums[0]) + sums[1] + sums[2] + sums[3];
+		summary.sumOfSquares += sumsOfSquares[0] + sumsOfSquares[1];
+
+		for (auto n : counts)
+			summary.saturated += n;
+	}
+
+	alignas(16) uint16_t mins[8];
+	alignas(16) uint16_t maxs[8];
+
+	_mm_store_si128(reinterpret_cast<__m128i*>(mins), _mm_xor_si128(vmin, bias));
+	_mm_store_si128(reinterpret_cast<__m128i*>(maxs), _mm_xor_si128(vmax, bias));
+
+	if (i > 0)
+	{
+		summary.min = *std::min_element(mins, mins + 8);
+		summary.max = *std::max_element(maxs, maxs + 8);
+	}
+#endif
+
+	for (; i < count; ++i)
+	{
+		const uint16_t v = samples[i];
+
+		summary.min = std::min(summary.min, v);
+		summary.max = std::max(summary.max, v);
+		summary.sum += v;
+		summary.sumOfSquares += uint64_t(v) * v;
+
+		if (v >= saturation)
+			++summary.saturated;
+	}
+
+	return summary;
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+
+/**
+ * The running statistics of one band.
+ */
+struct sBandStatistics
+{
+	uint64_t count = 0;
+	uint16_t min = UINT16_MAX;
+	uint16_t max = 0;
+	double   mean = 0.0;
+	double   m2 = 0.0;
+	uint64_t saturated = 0;
+
+	double variance() const { return (count > 1) ? m2 / (count - 1) : 0.0; }
+	double stddev() const;
+};
+
+
+/**
+ * A normalized difference index, (A - B) / (A + B), of the bands nearest
+ * to two wavelengths.  One row of the index raster is kept per line.
+ */
+struct sSpectralIndex
+{
+	std::string name;
+	float a_nm = 0.0f;
+	float b_nm = 0.0f;
+
+	std::size_t a = 0;
+	std::size_t b = 0;
+
+	/// The index mapped from [-1, 1] to [0, 255]
+	std::vector<uint8_t> raster;
+
+	double sum = 0.0;
+	uint64_t count = 0;
+};
+
+
+/**
+ * Collects the per-band statistics and spectral indices of a HySpex
+ * recording while it is being converted, so that no extra read of the
+ * exported cube is needed for quality checks.
+ *
+ * Each line of a band is summarized in one pass (min, max, sum, sum of
+ * squares and saturated samples) and merged into the running mean and
+ * variance with the parallel form of Welford's update.
+ */
+class cBandStatistics
+{
+public:
+	void enable(bool enable = true) { mEnabled = enable; }
+	bool enabled() const { return mEnabled; }
+
+	void setMaxPixelValue(uint16_t maxPixelValue);
+
+	template<class SPECTRA>
+	void setWavelengths(const SPECTRA& wavelengths_nm)
+	{
+		mWavelengths_nm.clear();
+
+		for (std::size_t i = 0; i < wavelengths_nm.size(); ++i)
+			mWavelengths_nm.push_back(wavelengths_nm[i]);
+	}
+
+	/**
+	 * Start a new recording.
+	 */
+	void clear();
+
+	std::size_t lines() const { return mNumLines; }
+	std::size_t samples() const { return mSpatialSize; }
+
+	const std::vector<sBandStatistics>& bands() const { return mBands; }
+	const std::vector<sSpectralIndex>& indices() const { return mIndices; }
+
+	template<class IMAGE>
+	void addFrame(const IMAGE& image)
+	{
+		const auto& data = image.image();
+
+		mFrame.clear();
+
+		for (std::size_t band = 0; band < image.spectralSize(); ++band)
+		{
+			const auto& samples = data.band(band);
+			mFrame.insert(mFrame.end(), samples.begin(), samples.end());
+		}
+
+		addFrame(mFrame.data(), image.spatialSize(), image.spectralSize());
+	}
+
+	/**
+	 * Add a frame that holds spectralSize bands of spatialSize samples,
+	 * one band after another.
+	 */
+	void addFrame(const uint16_t* frame, std::size_t spatialSize, std::size_t spectralSize);
+
+	/**
+	 * Write the statistics to <base>.stats.json and each index to
+	 * <base>.<index>.png.
+	 */
+	void write(const std::filesystem::path& base) const;
+
+	/**
+	 * The suffixes of the files written for the base name.
+	 */
+	std::vector<std::string> suffixes() const;
+
+private:
+	void selectIndices();
+	void addIndices(const uint16_t* frame, std::size_t spatialSize);
+
+private:
+	bool mEnabled = false;
+
+	uint16_t mSaturation = UINT16_MAX;
+	std::vector<float> mWavelengths_nm;
+
+	std::size_t mSpatialSize = 0;
+	std::size_t mNumLines = 0;
+
+	std::vector<sBandStatistics> mBands;
+	std::vector<sSpectralIndex> mIndices;
+
+	std::vector<uint16_t> mFrame;
+};
+
+
+namespace nStatistics
+{
+	struct sSummary
+	{
+		uint16_t min = UINT16_MAX;
+		uint16_t max = 0;
+		uint64_t sum = 0;
+		uint64_t sumOfSquares = 0;
+		uint64_t saturated = 0;
+	};
+
+	/**
+	 * Summarize count samples in one pass.  Samples at or above saturation
+	 * are counted as saturated.
+	 */
+	sSummary summarize(const uint16_t* samples, std::size_t count, uint16_t saturation);
+}
@@ -4,11 +4,13 @@
 #include "HySpexVNIR3000N_BIL.hpp"
 #include "HySpexSWIR384_BIL.hpp"
 #include "FileProcessor.hpp"
+#include "PlotConfigFile.hpp"
 #include "StringUtils.hpp"
 
 #include <lyra/lyra.hpp>
 
 #include <filesystem>
+#include <memory>
 #include <string>
 #include <vector>
 #include <iostream>
@@ -45,9 +47,22 @@ int main(int argc, char** argv)
 
 	int num_of_threads = 1;
 
-	std::string export_string;
+	std::vector<std::string> export_strings;
 	std::string header_string;
 
+	int spatial_skip = 1;
+	int spectral_skip = 1;
+	bool average = false;
+
+	std::string calibrate_string;
+	float reflectance_scale = cRadiometricCalibration::DEFAULT_SCALE;
+
+	bool statistics = false;
+
+	double line_spacing_mm = 0.0;
+
+	std::string plot_filename;
+
 	std::string input_directory = current_path().string();
 	std::string output_directory = current_path().string();
 
@@ -61,14 +76,46 @@ int main(int argc, char** argv)
 		["-t"]["--threads"]
 		("The number of threads to use for converting data files.")
 		.optional()
-		| lyra::opt(export_string, "export format")
+		| lyra::opt(export_strings, "export format")
 		["-e"]["--export_format"]
-		("The export format: BIL, BIP or BSQ.")
+		("The export format: BIL, BIP or BSQ.  Repeat to export several formats from one read of each file.")
 		.optional()
 		| lyra::opt(header_string, "header format")
 		["-f"]["--header_format"]
 		("The format of the header file: ENVI or ArcMap.")
 		.optional()
+		| lyra::opt(spatial_skip, "pixels")
+		["--spatial_skip"]
+		("Export a quick-look cube that keeps every Nth pixel.")
+		.optional()
+		| lyra::opt(spectral_skip, "bands")
+		["--spectral_skip"]
+		("Export a quick-look cube that keeps every Nth band.")
+		.optional()
+		| lyra::opt(average)
+		["--average"]
+		("Average the skipped pixels and bands instead of dropping them.")
+		.optional()
+		| lyra::opt(calibrate_string, "sample format")
+		["--calibrate"]
+		("Export radiance, or reflectance after a white reference, as float or uint16 samples.")
+		.optional()
+		| lyra::opt(reflectance_scale, "scale")
+		["--reflectance_scale"]
+		("The factor that uint16 reflectance is multiplied by (default 10000).")
+		.optional()
+		| lyra::opt(statistics)
+		["--statistics"]
+		("Write the band statistics and vegetation indices of each recording.")
+		.optional()
+		| lyra::opt(line_spacing_mm, "mm")
+		["--register"]
+		("Resample the lines to a fixed spacing along the dolly track and write the position of each line.")
+		.optional()
+		| lyra::opt(plot_filename, "plot file")
+		["--plot_file"]
+		("Write a cube and the summary spectra of each plot in the plot file.  Requires --register.")
+		.optional()
 		| lyra::arg(input_directory, "input directory")
 		("The path to input directory/file for converting hyperspectral data to a multiband image file(s).")
 		.required()
@@ -93,19 +140,22 @@ int main(int argc, char** argv)
 	}
 
 
-	eExportFormat export_format = eExportFormat::BIL;
+	std::vector<eExportFormat> export_formats;
 	eHeaderFormat header_format = eHeaderFormat::ENVI;
 
-	if (!export_string.empty())
+	for (const auto& export_string : export_strings)
 	{
 		if (nStringUtils::iequal(export_string, "BIL"))
-			export_format = eExportFormat::BIL;
+			export_formats.push_back(eExportFormat::BIL);
 		else if (nStringUtils::iequal(export_string, "BIP"))
-			export_format = eExportFormat::BIP;
+			export_formats.push_back(eExportFormat::BIP);
 		else if (nStringUtils::iequal(export_string, "BSQ"))
-			export_format = eExportFormat::BSQ;
+			export_formats.push_back(eExportFormat::BSQ);
 	}
 
+	if (export_formats.empty())
+		export_formats.push_back(eExportFormat::BIL);
+
 	if (!header_string.empty())
 	{
 		if (nStringUtils::iequal(header_string, "ENVI"))
@@ -114,6 +164,73 @@ int main(int argc, char** argv)
 			header_format = eHeaderFormat::ArcMap;
 	}
 
+	if ((spatial_skip < 1) || (spectral_skip < 1))
+	{
+		std::cerr << "Error in command line: the skip factors must be at least one." << std::endl;
+		return 1;
+	}
+
+	eDecimation decimation = average ? eDecimation::AVERAGE : eDecimation::SKIP;
+
+	bool calibrate = !calibrate_string.empty();
+	eCalibratedFormat calibrated_format = eCalibratedFormat::FLOAT32;
+
+	if (calibrate)
+	{
+		if (nStringUtils::iequal(calibrate_string, "float"))
+			calibrated_format = eCalibratedFormat::FLOAT32;
+		else if (nStringUtils::iequal(calibrate_string, "uint16"))
+			calibrated_format = eCalibratedFormat::UINT16;
+		else
+		{
+			std::cerr << "Error in command line: the calibrated format must be float or uint16." << std::endl;
+			return 1;
+		}
+
+		if ((spatial_skip > 1) || (spectral_skip > 1))
+		{
+			std::cerr << "Error in command line: calibrated data can not be exported as a quick-look cube." << std::endl;
+			return 1;
+		}
+
+		if (reflectance_scale <= 0.0f)
+		{
+			std::cerr << "Error in command line: the reflectance scale must be positive." << std::endl;
+			return 1;
+		}
+	}
+
+	if (line_spacing_mm < 0.0)
+	{
+		std::cerr << "Error in command line: the line spacing must be positive." << std::endl;
+		return 1;
+	}
+
+	if ((line_spacing_mm > 0.0) && calibrate && (calibrated_format == eCalibratedFormat::FLOAT32))
+	{
+		std::cerr << "Error in command line: registered lines must be exported as uint16 samples." << std::endl;
+		return 1;
+	}
+
+	std::shared_ptr<cPlotConfigFile> plot_file;
+
+	if (!plot_filename.empty())
+	{
+		if (line_spacing_mm <= 0.0)
+		{
+			std::cerr << "Error in command line: the plots are cut from registered lines, use --register." << std::endl;
+			return 1;
+		}
+
+		plot_file = std::make_shared<cPlotConfigFile>();
+
+		if (!plot_file->open(plot_filename))
+		{
+			std::cerr << "Error: could not open the plot file: " << plot_filename << std::endl;
+			return 1;
+		}
+	}
+
 	const std::filesystem::path input{ input_directory };
 
 	std::vector<directory_entry> files_to_process;
@@ -218,7 +335,21 @@ int main(int argc, char** argv)
 
 		cFileProcessor* fp = new cFileProcessor(numFilesToProcess++, in_file, out_file);
 
-		fp->setFormat(export_format, header_format);
+		for (auto export_format : export_formats)
+			fp->addFormat(export_format, header_format);
+
+		fp->setDecimation(spatial_skip, spectral_skip, decimation);
+
+		if (calibrate)
+			fp->setCalibration(calibrated_format, reflectance_scale);
+
+		fp->setStatistics(statistics);
+
+		if (line_spacing_mm > 0.0)
+			fp->setRegistration(line_spacing_mm);
+
+		if (plot_file)
+			fp->setPlotFile(plot_file);
 
 		pool.push_task(&cFileProcessor::process_file, fp);
 
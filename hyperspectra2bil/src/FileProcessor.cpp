@@ -17,8 +17,15 @@
 #include "HySpexSWIR384_BIP_ENVI.hpp"
 #include "HySpexSWIR384_BSQ_ENVI.hpp"
 
+#include "HySpexVNIR3000N_FanOut.hpp"
+#include "HySpexSWIR384_FanOut.hpp"
+
+#include "PlotExtractor.hpp"
+#include "PlotConfigFile.hpp"
+
 #include <cbdf/BlockDataFileExceptions.hpp>
 
+#include <algorithm>
 #include <filesystem>
 #include <string>
 #include <vector>
@@ -48,18 +55,33 @@ cFileProcessor::~cFileProcessor()
 
 void cFileProcessor::setFormat(eExportFormat file_format, eHeaderFormat header_format)
 {
+    mFormats.clear();
+    mVnirConverters.clear();
+    mSwirConverters.clear();
+
+    addFormat(file_format, header_format);
+}
+
+void cFileProcessor::addFormat(eExportFormat file_format, eHeaderFormat header_format)
+{
+    if (std::find(mFormats.begin(), mFormats.end(), file_format) != mFormats.end())
+        return;
+
+    std::unique_ptr<cHySpexVNIR3000N_File> vnir;
+    std::unique_ptr<cHySpexSWIR384_File>   swir;
+
     switch (file_format)
     {
     case eExportFormat::BIL:
         switch (header_format)
         {
         case eHeaderFormat::ArcMap:
-            mVnirConverter.reset(new cHySpexVNIR3000N_BIL_ArcMap());
-            mSwirConverter.reset(new cHySpexSWIR384_BIL_ArcMap());
+            vnir.reset(new cHySpexVNIR3000N_BIL_ArcMap());
+            swir.reset(new cHySpexSWIR384_BIL_ArcMap());
             break;
         case eHeaderFormat::ENVI:
-            mVnirConverter.reset(new cHySpexVNIR3000N_BIL_ENVI());
-            mSwirConverter.reset(new cHySpexSWIR384_BIL_ENVI());
+            vnir.reset(new cHySpexVNIR3000N_BIL_ENVI());
+            swir.reset(new cHySpexSWIR384_BIL_ENVI());
             break;
         }
         break;
@@ -67,12 +89,12 @@ void cFileProcessor::setFormat(eExportFormat file_format, eHeaderFormat header_f
         switch (header_format)
         {
         case eHeaderFormat::ArcMap:
-            mVnirConverter.reset(new cHySpexVNIR3000N_BIP_ArcMap());
-            mSwirConverter.reset(new cHySpexSWIR384_BIP_ArcMap());
+            vnir.reset(new cHySpexVNIR3000N_BIP_ArcMap());
+            swir.reset(new cHySpexSWIR384_BIP_ArcMap());
             break;
         case eHeaderFormat::ENVI:
-            mVnirConverter.reset(new cHySpexVNIR3000N_BIP_ENVI());
-            mSwirConverter.reset(new cHySpexSWIR384_BIP_ENVI());
+            vnir.reset(new cHySpexVNIR3000N_BIP_ENVI());
+            swir.reset(new cHySpexSWIR384_BIP_ENVI());
             break;
         }
         break;
@@ -80,16 +102,49 @@ void cFileProcessor::setFormat(eExportFormat file_format, eHeaderFormat header_f
         switch (header_format)
         {
         case eHeaderFormat::ArcMap:
-            mVnirConverter.reset(new cHySpexVNIR3000N_BSQ_ArcMap());
-            mSwirConverter.reset(new cHySpexSWIR384_BSQ_ArcMap());
+            vnir.reset(new cHySpexVNIR3000N_BSQ_ArcMap());
+            swir.reset(new cHySpexSWIR384_BSQ_ArcMap());
             break;
         case eHeaderFormat::ENVI:
-            mVnirConverter.reset(new cHySpexVNIR3000N_BSQ_ENVI());
-            mSwirConverter.reset(new cHySpexSWIR384_BSQ_ENVI());
+            vnir.reset(new cHySpexVNIR3000N_BSQ_ENVI());
+            swir.reset(new cHySpexSWIR384_BSQ_ENVI());
             break;
         }
         break;
     };
+
+    mFormats.push_back(file_format);
+    mVnirConverters.push_back(std::move(vnir));
+    mSwirConverters.push_back(std::move(swir));
+}
+
+void cFileProcessor::setDecimation(std::size_t spatialFactor, std::size_t spectralFactor, eDecimation mode)
+{
+    mSpatialFactor = spatialFactor;
+    mSpectralFactor = spectralFactor;
+    mDecimation = mode;
+}
+
+void cFileProcessor::setCalibration(eCalibratedFormat format, float scale)
+{
+    mCalibrate = true;
+    mCalibratedFormat = format;
+    mReflectanceScale = scale;
+}
+
+void cFileProcessor::setStatistics(bool enable)
+{
+    mStatistics = enable;
+}
+
+void cFileProcessor::setRegistration(double spacing_mm)
+{
+    mLineSpacing_mm = spacing_mm;
+}
+
+void cFileProcessor::setPlotFile(std::shared_ptr<cPlotConfigFile> plot_file)
+{
+    mPlotFile = plot_file;
 }
 
 bool cFileProcessor::open(std::filesystem::path out)
@@ -102,8 +157,57 @@ bool cFileProcessor::open(std::filesystem::path out)
         return false;
     }
 
-    mVnirConverter->setOutputPath(outFile);
-    mSwirConverter->setOutputPath(outFile);
+    for (std::size_t i = 0; i < mFormats.size(); ++i)
+    {
+        auto path = outFile;
+
+        // The header files of the formats would have the same name
+        if (mFormats.size() > 1)
+        {
+            switch (mFormats[i])
+            {
+            case eExportFormat::BIL:
+                path += "_bil";
+                break;
+            case eExportFormat::BIP:
+                path += "_bip";
+                break;
+            case eExportFormat::BSQ:
+                path += "_bsq";
+                break;
+            }
+        }
+
+        mVnirConverters[i]->setOutputPath(path);
+        mSwirConverters[i]->setOutputPath(path);
+
+        mVnirConverters[i]->setDecimation(mSpatialFactor, mSpectralFactor, mDecimation);
+        mSwirConverters[i]->setDecimation(mSpatialFactor, mSpectralFactor, mDecimation);
+
+        if (mCalibrate)
+        {
+            mVnirConverters[i]->setCalibration(mCalibratedFormat, mReflectanceScale);
+            mSwirConverters[i]->setCalibration(mCalibratedFormat, mReflectanceScale);
+        }
+
+        if (mLineSpacing_mm > 0.0)
+        {
+            mVnirConverters[i]->setRegistration(mLineSpacing_mm);
+            mSwirConverters[i]->setRegistration(mLineSpacing_mm);
+        }
+    }
+
+    if (mStatistics && !mFormats.empty())
+    {
+        mVnirConverters.front()->setStatistics(true);
+        mSwirConverters.front()->setStatistics(true);
+    }
+
+    if (mPlotFile && (mLineSpacing_mm > 0.0) && !mFormats.empty())
+    {
+        mVnirConverters.front()->setPlotExtraction(true);
+        mSwirConverters.front()->setPlotExtraction(true);
+    }
 
     mFileReader.open(mInputFile.string());
     mFileSize = mFileReader.file_size();
@@ -113,7 +217,7 @@ bool cFileProcessor::open(std::filesystem::path out)
 
 void cFileProcessor::process_file()
 {
-    if (!mVnirConverter || !mSwirConverter)
+    if (mFormats.empty())
     {
         throw std::logic_error("File format was not set.");
     }
@@ -136,11 +240,18 @@ void cFileProcessor::run()
     mFileReader.attach(static_cast<cExperimentParser*>(this));
     mFileReader.attach(static_cast<cSpidercamParser*>(this));
 
-    cHySpexVNIR3000N_File* pVnir = mVnirConverter.get();
-	mFileReader.attach(static_cast<cHySpexVNIR_3000N_Parser*>(pVnir));
+    // The blocks are decoded once, on this thread, and every converter
+    // writes its file on a thread of its own.
+    mVnirFanOut = std::make_unique<cHySpexVNIR3000N_FanOut>();
+    for (auto& converter : mVnirConverters)
+        mVnirFanOut->addSink(converter.get());
 
-    cHySpexSWIR384_File* pSwir = mSwirConverter.get();
-    mFileReader.attach(static_cast<cHySpexSWIR_384_Parser*>(pSwir));
+    mSwirFanOut = std::make_unique<cHySpexSWIR384_FanOut>();
+    for (auto& converter : mSwirConverters)
+        mSwirFanOut->addSink(converter.get());
+
+	mFileReader.attach(static_cast<cHySpexVNIR_3000N_Parser*>(mVnirFanOut.get()));
+    mFileReader.attach(static_cast<cHySpexSWIR_384_Parser*>(mSwirFanOut.get()));
 
 
 	try
@@ -150,6 +261,7 @@ void cFileProcessor::run()
             if (mFileReader.fail())
             {
                 mFileReader.close();
+                finishWriters();
                 return;
             }
 
@@ -185,9 +297,78 @@ void cFileProcessor::run()
         console_message(msg);
     }
 
+    finishWriters();
+
     update_file_progress(mID, 100);
 }
 
+void cFileProcessor::finishWriters()
+{
+    try
+    {
+        mVnirFanOut->finish();
+    }
+    catch (const std::exception& e)
+    {
+        std::string msg = "VNIR Write Error: ";
+        msg += e.what();
+        console_message(msg);
+    }
+
+    try
+    {
+        mSwirFanOut->finish();
+    }
+    catch (const std::exception& e)
+    {
+        std::string msg = "SWIR Write Error: ";
+        msg += e.what();
+        console_message(msg);
+    }
+}
+
+
+void cFileProcessor::sendPlots()
+{
+    mPlotsSent = true;
+
+    auto it = mPlotFile->find_by_measurement_name(mMeasurementTitle);
+
+    if (it == mPlotFile->end())
+        it = mPlotFile->find_by_measurement_name(mExperimentTitle);
+
+    if (it == mPlotFile->end())
+        it = mPlotFile->find_by_measurement_name(mInputFile.stem().string());
+
+    if (it == mPlotFile->end())
+    {
+        console_message("No plots were found for: " + mInputFile.filename().string());
+        return;
+    }
+
+    auto plots = std::make_shared<std::vector<sPlotRegion>>();
+
+    for (const auto& plot : *it)
+    {
+        auto* bounds = plot.getBounds(mFileDate);
+
+        if (!bounds || bounds->empty())
+            continue;
+
+        sPlotRegion region;
+        region.number = plot.getPlotNumber();
+        region.name = plot.getPlotName();
+        region.bounds = *bounds;
+
+        plots->push_back(region);
+    }
+
+    double groundLevel_mm = it->getGroundLevel_mm().value_or(0);
+
+    mVnirFanOut->setPlots(plots, groundLevel_mm);
+    mSwirFanOut->setPlots(plots, groundLevel_mm);
+}
+
 
 void cFileProcessor::onBeginHeader() {}
 void cFileProcessor::onEndOfHeader() {}
@@ -195,8 +376,16 @@ void cFileProcessor::onEndOfHeader() {}
 void cFileProcessor::onBeginFooter() {}
 void cFileProcessor::onEndOfFooter() {}
 
-void cFileProcessor::onExperimentTitle(const std::string& title) {}
-void cFileProcessor::onMeasurementTitle(const std::string& title) {}
+void cFileProcessor::onExperimentTitle(const std::string& title)
+{
+    mExperimentTitle = title;
+}
+
+void cFileProcessor::onMeasurementTitle(const std::string& title)
+{
+    mMeasurementTitle = title;
+}
+
 void cFileProcessor::onPrincipalInvestigator(const std::string& investigator) {}
 
 void cFileProcessor::onBeginResearcherList() {}
@@ -232,7 +421,11 @@ void cFileProcessor::onBeginCustomInfoList() {}
 void cFileProcessor::onEndOfCustomInfoList() {}
 void cFileProcessor::onCustomInfo(const std::string& tag, const std::string& info) {}
 
-void cFileProcessor::onFileDate(std::uint16_t year, std::uint8_t month, std::uint8_t day) {}
+void cFileProcessor::onFileDate(std::uint16_t year, std::uint8_t month, std::uint8_t day)
+{
+    mFileDate = (month * 100) + day;
+}
+
 void cFileProcessor::onFileTime(std::uint8_t hour, std::uint8_t minute, std::uint8_t seconds) {}
 
 void cFileProcessor::onDayOfYear(std::uint16_t day_of_year) {}
@@ -248,14 +441,17 @@ void cFileProcessor::onEndTime(sExperimentTime_t time) {}
 
 void cFileProcessor::onStartRecordingTimestamp(uint64_t timestamp_ns)
 {
-    mVnirConverter->onStartRecordingTimestamp(timestamp_ns);
-    mSwirConverter->onStartRecordingTimestamp(timestamp_ns);
+    if (mPlotFile && !mPlotsSent)
+        sendPlots();
+
+    mVnirFanOut->onStartRecordingTimestamp(timestamp_ns);
+    mSwirFanOut->onStartRecordingTimestamp(timestamp_ns);
 }
 
 void cFileProcessor::onEndRecordingTimestamp(uint64_t timestamp_ns)
 {
-    mVnirConverter->onEndRecordingTimestamp(timestamp_ns);
-    mSwirConverter->onEndRecordingTimestamp(timestamp_ns);
+    mVnirFanOut->onEndRecordingTimestamp(timestamp_ns);
+    mSwirFanOut->onEndRecordingTimestamp(timestamp_ns);
 }
 
 void cFileProcessor::onHeartbeatTimestamp(uint64_t timestamp_ns) {}
@@ -263,8 +459,8 @@ void cFileProcessor::onHeartbeatTimestamp(uint64_t timestamp_ns) {}
 
 void cFileProcessor::onPosition(spidercam::sPosition_1_t pos)
 {
-    mVnirConverter->onPosition(pos.X_mm, pos.Y_mm, pos.Z_mm, pos.speed_mmps);
-    mSwirConverter->onPosition(pos.X_mm, pos.Y_mm, pos.Z_mm, pos.speed_mmps);
+    mVnirFanOut->onPosition(pos.X_mm, pos.Y_mm, pos.Z_mm, pos.speed_mmps);
+    mSwirFanOut->onPosition(pos.X_mm, pos.Y_mm, pos.Z_mm, pos.speed_mmps);
 }
 
 void cFileProcessor::onStartPosition(spidercam::sPosition_1_t position)
@@ -8,10 +8,18 @@
 #include <filesystem>
 #include <string>
 #include <memory>
+#include <vector>
+
+#include "FrameDecimator.hpp"
+#include "RadiometricCalibration.hpp"
 
 // Forward Declarations
+class cPlotConfigFile;
+struct sPlotRegion;
 class cHySpexVNIR3000N_File;
 class cHySpexSWIR384_File;
+class cHySpexVNIR3000N_FanOut;
+class cHySpexSWIR384_FanOut;
 
 enum class eExportFormat {BIL, BIP, BSQ};
 enum class eHeaderFormat {ArcMap, ENVI};
@@ -25,11 +33,41 @@ public:
 
 	void setFormat(eExportFormat file_format, eHeaderFormat header_format);
 
+	/**
+	 * Also export the data in another format.  All of the formats are
+	 * written from a single read of the file.
+	 */
+	void addFormat(eExportFormat file_format, eHeaderFormat header_format);
+
+	void setDecimation(std::size_t spatialFactor, std::size_t spectralFactor, eDecimation mode);
+	void setCalibration(eCalibratedFormat format, float scale);
+
+	/**
+	 * Write the band statistics and spectral indices of the recordings.
+	 * They are collected by the first export format only.
+	 */
+	void setStatistics(bool enable);
+
+	/**
+	 * Resample the lines of the recordings to one line every spacing_mm
+	 * along the dolly track.
+	 */
+	void setRegistration(double spacing_mm);
+
+	/**
+	 * Cut the registered lines into one cube per plot of the plot file.
+	 * The plots are looked up by the measurement title, the experiment
+	 * title or the name of the data file.
+	 */
+	void setPlotFile(std::shared_ptr<cPlotConfigFile> plot_file);
+
 	void process_file();
 	void run();
 
 protected:
 	bool open(std::filesystem::path out);
+	void finishWriters();
+	void sendPlots();
 
 protected:
 	void onBeginHeader() override;
@@ -107,6 +145,30 @@ private:
 	std::filesystem::path mInputFile;
 	std::filesystem::path mOutputFile;
 
-	std::unique_ptr<cHySpexVNIR3000N_File> mVnirConverter;
-	std::unique_ptr<cHySpexSWIR384_File>   mSwirConverter;
+	std::size_t mSpatialFactor = 1;
+	std::size_t mSpectralFactor = 1;
+	eDecimation mDecimation = eDecimation::SKIP;
+
+	bool mCalibrate = false;
+	eCalibratedFormat mCalibratedFormat = eCalibratedFormat::FLOAT32;
+	float mReflectanceScale = cRadiometricCalibration::DEFAULT_SCALE;
+
+	bool mStatistics = false;
+
+	double mLineSpacing_mm = 0.0;
+
+	std::shared_ptr<cPlotConfigFile> mPlotFile;
+	bool mPlotsSent = false;
+
+	std::string mExperimentTitle;
+	std::string mMeasurementTitle;
+	int mFileDate = 0;
+
+	std::vector<eExportFormat> mFormats;
+
+	std::vector<std::unique_ptr<cHySpexVNIR3000N_File>> mVnirConverters;
+	std::vector<std::unique_ptr<cHySpexSWIR384_File>>   mSwirConverters;
+
+	std::unique_ptr<cHySpexVNIR3000N_FanOut> mVnirFanOut;
+	std::unique_ptr<cHySpexSWIR384_FanOut>   mSwirFanOut;
 };
@@ -0,0 +1,33 @@
+#include "FrameDecimator.hpp"
+
+
+void cFrameDecimator::setFactors(std::size_t spatialFactor, std::size_t spectralFactor, eDecimation mode)
+{
+	mSpatialFactor = std::max<std::size_t>(spatialFactor, 1);
+	mSpectralFactor = std::max<std::size_t>(spectralFactor, 1);
+	mMode = mode;
+}
+
+const uint16_t* cFrameDecimator::reduce(const uint16_t* frame, std::size_t spatialSize, std::size_t spectralSize)
+{
+	return reduceBands([frame, spatialSize](std::size_t band) { return frame + band * spatialSize; },
+		spatialSize, spectralSize);
+}
+
+void cFrameDecimator::binPixels(std::size_t n, std::size_t numBands, uint16_t* out) const
+{
+	const uint32_t* sum = mSum.data();
+
+	for (std::size_t first = 0; first < n; first += mSpatialFactor)
+	{
+		const std::size_t last = std::min(first + mSpatialFactor, n);
+
+		uint64_t total = 0;
+		for (std::size_t j = first; j < last; ++j)
+			total += sum[j];
+
+		const uint64_t count = (last - first) * numBands;
+
+		*out++ = static_cast<uint16_t>((total + count / 2) / count);
+	}
+}
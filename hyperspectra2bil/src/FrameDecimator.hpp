@@ -0,0 +1,144 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+enum class eDecimation {SKIP, AVERAGE};
+
+/**
+ * Reduces HySpex frames for quick-look exports by keeping every Nth pixel
+ * and band (SKIP) or by averaging N x M blocks of pixels and bands (AVERAGE).
+ *
+ * The reduced frame holds its bands one after another, ready for the raw
+ * frame overloads of the writers.  With SKIP, bands that are not kept are
+ * never read.  A partial block at the end of a frame is reduced from the
+ * pixels or bands it has.
+ */
+class cFrameDecimator
+{
+public:
+	void setFactors(std::size_t spatialFactor, std::size_t spectralFactor, eDecimation mode);
+
+	bool enabled() const { return (mSpatialFactor > 1) || (mSpectralFactor > 1); }
+
+	std::size_t reducedSpatialSize(std::size_t spatialSize) const
+	{
+		return (spatialSize + mSpatialFactor - 1) / mSpatialFactor;
+	}
+
+	std::size_t reducedSpectralSize(std::size_t spectralSize) const
+	{
+		return (spectralSize + mSpectralFactor - 1) / mSpectralFactor;
+	}
+
+	/**
+	 * The size of the last reduced frame.
+	 */
+	std::size_t spatialSize() const { return mSpatialSize; }
+	std::size_t spectralSize() const { return mSpectralSize; }
+
+	template<class IMAGE>
+	const uint16_t* reduce(const IMAGE& image)
+	{
+		const auto& data = image.image();
+
+		return reduceBands([&data](std::size_t band) { return data.band(band); },
+			image.spatialSize(), image.spectralSize());
+	}
+
+	/**
+	 * Reduce a frame that holds spectralSize bands of spatialSize samples,
+	 * one band after another.
+	 */
+	const uint16_t* reduce(const uint16_t* frame, std::size_t spatialSize, std::size_t spectralSize);
+
+	/**
+	 * The wavelengths of the reduced bands.
+	 */
+	template<class WAVELENGTHS>
+	std::vector<float> reduceWavelengths(const WAVELENGTHS& wavelengths) const
+	{
+		const std::size_t m = wavelengths.size();
+
+		std::vector<float> result;
+		result.reserve(reducedSpectralSize(m));
+
+		for (std::size_t first = 0; first < m; first += mSpectralFactor)
+		{
+			if (mMode == eDecimation::SKIP)
+			{
+				result.push_back(wavelengths[first]);
+				continue;
+			}
+
+			const std::size_t last = std::min(first + mSpectralFactor, m);
+
+			double sum = 0.0;
+			for (std::size_t band = first; band < last; ++band)
+				sum += wavelengths[band];
+
+			result.push_back(static_cast<float>(sum / (last - first)));
+		}
+
+		return result;
+	}
+
+private:
+	template<class BANDS>
+	const uint16_t* reduceBands(BANDS band, std::size_t n, std::size_t m)
+	{
+		mSpatialSize = reducedSpatialSize(n);
+		mSpectralSize = reducedSpectralSize(m);
+
+		mReduced.resize(mSpatialSize * mSpectralSize);
+
+		auto* out = mReduced.data();
+
+		for (std::size_t first = 0; first < m; first += mSpectralFactor, out += mSpatialSize)
+		{
+			if (mMode == eDecimation::SKIP)
+			{
+				const auto& samples = band(first);
+
+				for (std::size_t i = 0, j = 0; i < mSpatialSize; ++i, j += mSpatialFactor)
+					out[i] = samples[j];
+
+				continue;
+			}
+
+			const std::size_t last = std::min(first + mSpectralFactor, m);
+
+			mSum.assign(n, 0);
+
+			for (std::size_t b = first; b < last; ++b)
+			{
+				const auto& samples = band(b);
+
+				for (std::size_t j = 0; j < n; ++j)
+					mSum[j] += samples[j];
+			}
+
+			binPixels(n, last - first, out);
+		}
+
+		return mReduced.data();
+	}
+
+	void binPixels(std::size_t n, std::size_t numBands, uint16_t* out) const;
+
+private:
+	std::size_t mSpatialFactor = 1;
+	std::size_t mSpectralFactor = 1;
+	eDecimation mMode = eDecimation::SKIP;
+
+	std::size_t mSpatialSize = 0;
+	std::size_t mSpectralSize = 0;
+
+	/// The per pixel sum of the bands in a block
+	std::vector<uint32_t> mSum;
+
+	std::vector<uint16_t> mReduced;
+};
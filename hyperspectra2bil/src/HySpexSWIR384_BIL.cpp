@@ -39,35 +39,43 @@ std::filesystem::path cHySpexSWIR384_BIL::createDataFilename(char plotID)
     return filename;
 }
 
-void cHySpexSWIR384_BIL::onImage(uint8_t device_id, HySpexConnect::cImageData<uint16_t> image)
+void cHySpexSWIR384_BIL::writeFrame(const uint16_t* frame, std::size_t spatialSize, std::size_t spectralSize)
 {
-    ++mActiveRow;
-
-    auto n = image.spatialSize();
-    auto m = image.spectralSize();
-    auto data = image.image();
+    mInterleaver.writeBIL(mOutputFile, frame, spatialSize, spectralSize);
+}
 
-    if (!mOutputFile.is_open())
+void cHySpexSWIR384_BIL::writeImage(uint8_t device_id, const HySpexConnect::cImageData<uint16_t>& image)
+{
+    if (collectReference(image))
         return;
 
-    for (int band = 0; band < m; ++band)
+    accumulateStatistics(image);
+
+    if (mRegistration.enabled())
     {
-        auto channels = data.band(band);
-        for (auto pixel : channels)
-        {
-            mOutputFile.write(reinterpret_cast<char*>(&pixel), sizeof pixel);
-        }
+        registerFrame(image);
+        return;
     }
-}
 
-void cHySpexSWIR384_BIL::onImage(uint8_t device_id, HySpexConnect::cImageData<uint16_t> image, uint8_t spatialSkip, uint8_t spectralSkip)
-{
     ++mActiveRow;
 
-    for (int i = 0; image.spatialSize(); ++i)
+    if (!mOutputFile.is_open())
+        return;
+
+    if (mCalibration.enabled())
     {
-        //        mImage[i] = { 128,128,128 };
+        if (mCalibration.format() == eCalibratedFormat::FLOAT32)
+            mInterleaver.writeBIL(mOutputFile, mCalibration.calibrate(image), image.spatialSize(), image.spectralSize());
+        else
+            mInterleaver.writeBIL(mOutputFile, mCalibration.calibrateScaled(image), image.spatialSize(), image.spectralSize());
     }
+    else if (mDecimator.enabled())
+    {
+        auto* frame = mDecimator.reduce(image);
+        mInterleaver.writeBIL(mOutputFile, frame, mDecimator.spatialSize(), mDecimator.spectralSize());
+    }
+    else
+        mInterleaver.writeBIL(mOutputFile, image);
 }
 
 
@@ -2,6 +2,7 @@
 #pragma once
 
 #include "HySpexSWIR384_File.hpp"
+#include "BandInterleaver.hpp"
 
 #include <deque>
 #include <list>
@@ -14,9 +15,12 @@ public:
 	virtual ~cHySpexSWIR384_BIL();
 
 protected:
-	void onImage(uint8_t device_id, HySpexConnect::cImageData<uint16_t> image) override;
-	void onImage(uint8_t device_id, HySpexConnect::cImageData<uint16_t> image, uint8_t spatialSkip, uint8_t spectralSkip) override;
+	void writeImage(uint8_t device_id, const HySpexConnect::cImageData<uint16_t>& image) override;
 
 protected:
 	std::filesystem::path createDataFilename(char plotID) override;
+	void writeFrame(const uint16_t* frame, std::size_t spatialSize, std::size_t spectralSize) override;
+
+private:
+	cBandInterleaver mInterleaver;
 };
@@ -38,30 +38,40 @@ std::filesystem::path cHySpexSWIR384_BIP::createDataFilename(char plotID)
     return filename;
 }
 
-void cHySpexSWIR384_BIP::onImage(uint8_t device_id, HySpexConnect::cImageData<uint16_t> image)
+void cHySpexSWIR384_BIP::writeFrame(const uint16_t* frame, std::size_t spatialSize, std::size_t spectralSize)
 {
-    ++mActiveRow;
+    mInterleaver.writeBIP(mOutputFile, frame, spatialSize, spectralSize);
+}
 
-    auto n = image.spatialSize();
-    auto m = image.spectralSize();
-    auto data = image.image();
+void cHySpexSWIR384_BIP::writeImage(uint8_t device_id, const HySpexConnect::cImageData<uint16_t>& image)
+{
+    if (collectReference(image))
+        return;
 
-    for (int channel = 0; channel < n; ++channel)
+    accumulateStatistics(image);
+
+    if (mRegistration.enabled())
     {
-        auto bands = data.channel(channel);
-        for (auto pixel : bands)
-            mOutputFile.write(reinterpret_cast<char*>(&pixel), sizeof pixel);
+        registerFrame(image);
+        return;
     }
-}
 
-void cHySpexSWIR384_BIP::onImage(uint8_t device_id, HySpexConnect::cImageData<uint16_t> image, uint8_t spatialSkip, uint8_t spectralSkip)
-{
     ++mActiveRow;
 
-    for (int i = 0; image.spatialSize(); ++i)
+    if (mCalibration.enabled())
+    {
+        if (mCalibration.format() == eCalibratedFormat::FLOAT32)
+            mInterleaver.writeBIP(mOutputFile, mCalibration.calibrate(image), image.spatialSize(), image.spectralSize());
+        else
+            mInterleaver.writeBIP(mOutputFile, mCalibration.calibrateScaled(image), image.spatialSize(), image.spectralSize());
+    }
+    else if (mDecimator.enabled())
     {
-        //        mImage[i] = { 128,128,128 };
+        auto* frame = mDecimator.reduce(image);
+        mInterleaver.writeBIP(mOutputFile, frame, mDecimator.spatialSize(), mDecimator.spectralSize());
     }
+    else
+        mInterleaver.writeBIP(mOutputFile, image);
 }
 
 
@@ -2,6 +2,11 @@
 #include "HySpexSWIR384_BSQ.hpp"
 
 #include <iostream>
+#include <stdexcept>
+#include <string>
+
+
+extern void console_message(const std::string& msg);
 
 
 cHySpexSWIR384_BSQ::cHySpexSWIR384_BSQ() : cHySpexSWIR384_File()
@@ -9,6 +14,24 @@ cHySpexSWIR384_BSQ::cHySpexSWIR384_BSQ() : cHySpexSWIR384_File()
 
 cHySpexSWIR384_BSQ::~cHySpexSWIR384_BSQ()
 {
+    // A recording without an end timestamp is still written out, but an
+    // error must not escape the destructor
+    if (mOutputFile.is_open())
+    {
+        try
+        {
+            mCube.write(mOutputFile);
+        }
+        catch (const std::exception& e)
+        {
+            std::string msg = "Could not write ";
+            msg += mDataFilename.string();
+            msg += ": ";
+            msg += e.what();
+            console_message(msg);
+        }
+    }
+
     mOutputFile.close();
 
     if (mPlotID == 'B')
@@ -38,27 +61,53 @@ std::filesystem::path cHySpexSWIR384_BSQ::createDataFilename(char plotID)
     return filename;
 }
 
-void cHySpexSWIR384_BSQ::onImage(uint8_t device_id, HySpexConnect::cImageData<uint16_t> image)
+void cHySpexSWIR384_BSQ::closeDataFile()
 {
-    ++mActiveRow;
+    mCube.write(mOutputFile);
+    mOutputFile.close();
+}
 
-    auto n = image.spatialSize();
-    auto m = image.spectralSize();
-    auto data = image.image();
-    //    mImage = image.image().data();
+void cHySpexSWIR384_BSQ::writeFrame(const uint16_t* frame, std::size_t spatialSize, std::size_t spectralSize)
+{
+    mCube.addFrame(frame, spatialSize, spectralSize);
 }
 
-void cHySpexSWIR384_BSQ::onImage(uint8_t device_id, HySpexConnect::cImageData<uint16_t> image, uint8_t spatialSkip, uint8_t spectralSkip)
+void cHySpexSWIR384_BSQ::writeImage(uint8_t device_id, const HySpexConnect::cImageData<uint16_t>& image)
 {
-    if (!mOutputFile.is_open())
+    if (!mOutputFile.is_open() || collectReference(image))
         return;
 
-    ++mActiveRow;
+    accumulateStatistics(image);
+
+    if (!mCube.isOpen())
+    {
+        auto scratch = mDataFilename;
+        scratch += ".tmp";
+        mCube.open(scratch);
+    }
+
+    if (mRegistration.enabled())
+    {
+        registerFrame(image);
+        return;
+    }
 
-    for (int i = 0; image.spatialSize(); ++i)
+    if (mCalibration.enabled())
     {
-        //        mImage[i] = { 128,128,128 };
+        if (mCalibration.format() == eCalibratedFormat::FLOAT32)
+            mCube.addFrame(mCalibration.calibrate(image), image.spatialSize(), image.spectralSize());
+        else
+            mCube.addFrame(mCalibration.calibrateScaled(image), image.spatialSize(), image.spectralSize());
     }
+    else if (mDecimator.enabled())
+    {
+        auto* frame = mDecimator.reduce(image);
+        mCube.addFrame(frame, mDecimator.spatialSize(), mDecimator.spectralSize());
+    }
+    else
+        mCube.addFrame(image);
+
+    ++mActiveRow;
 }
 
 
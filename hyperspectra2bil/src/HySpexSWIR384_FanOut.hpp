@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cbdf/HySpexSWIR_384_Parser.hpp>
+
+#include "WriterThread.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Forward Declarations
+class cHySpexSWIR384_File;
+struct sPlotRegion;
+
+
+/**
+ * Decodes the HySpex blocks once and hands the data to any number of
+ * converters, each running on a writer thread of its own.
+ *
+ * Every callback is queued to every converter in the order it was
+ * received, so each converter sees the same calls as if it had been
+ * attached to the file reader itself.
+ */
+class cHySpexSWIR384_FanOut : public cHySpexSWIR_384_Parser
+{
+public:
+	static constexpr std::size_t DEFAULT_QUEUE_DEPTH = 32;
+
+public:
+	explicit cHySpexSWIR384_FanOut(std::size_t queueDepth = DEFAULT_QUEUE_DEPTH);
+	~cHySpexSWIR384_FanOut();
+
+	void addSink(cHySpexSWIR384_File* sink);
+
+	/**
+	 * Wait for the converters to process all of the queued data.  Throws
+	 * the error of the first converter that failed.
+	 */
+	void finish();
+
+	/**
+	 * Hand the plots of the recording to the converters.
+	 */
+	void setPlots(std::shared_ptr<const std::vector<sPlotRegion>> plots, double groundLevel_mm);
+
+	// Spidercam Parser Data
+	void onPosition(double x_mm, double y_mm, double z_mm, double speed_mmps);
+
+	// Experiment Info Parser Data
+	void onStartRecordingTimestamp(uint64_t timestamp_ns);
+	void onEndRecordingTimestamp(uint64_t timestamp_ns);
+
+private:
+	void onBeginReference(uint8_t device_id) override;
+	void onEndOfReference(uint8_t device_id) override;
+
+	void onID(uint8_t device_id, std::string id) override;
+	void onSerialNumber(uint8_t device_id, std::string serialNumber) override;
+	void onWavelengthRange_nm(uint8_t device_id, uint16_t minWavelength_nm, uint16_t maxWavelength_nm) override;
+	void onSpatialSize(uint8_t device_id, uint64_t spatialSize) override;
+	void onSpectralSize(uint8_t device_id, uint64_t spectralSize) override;
+	void onMaxSpatialSize(uint8_t device_id, uint64_t maxSpatialSize) override;
+	void onMaxSpectralSize(uint8_t device_id, uint64_t maxSpectralSize) override;
+	void onMaxPixelValue(uint8_t device_id, uint16_t maxPixelValue) override;
+
+	void onResponsivityMatrix(uint8_t device_id, HySpexConnect::cSpatialMajorData<float> re) override;
+	void onQuantumEfficiencyData(uint8_t device_id, HySpexConnect::cSpectralData<float> qe) override;
+	void onLensName(uint8_t device_id, std::string name) override;
+	void onLensWorkingDistance_cm(uint8_t device_id, double workingDistance_cm) override;
+	void onLensFieldOfView_rad(uint8_t device_id, double fieldOfView_rad) override;
+	void onLensFieldOfView_deg(uint8_t device_id, double fieldOfView_deg) override;
+
+	void onAverageFrames(uint8_t device_id, uint16_t averageFrames) override;
+	void onFramePeriod_us(uint8_t device_id, uint32_t framePeriod_us) override;
+	void onIntegrationTime_us(uint8_t device_id, uint32_t integrationTime_us) override;
+
+	void onBadPixels(uint8_t device_id, HySpexConnect::cBadPixelData bad_pixels) override;
+	void onBadPixelCorrection(uint8_t device_id, HySpexConnect::cBadPixelCorrectionData corrections) override;
+	void onBadPixelMatrix(uint8_t device_id, HySpexConnect::cSpatialMajorData<uint8_t> matrix) override;
+
+	void onAmbientTemperature_C(uint8_t device_id, float temp_C) override;
+
+	void onSpectralCalibration(uint8_t device_id, HySpexConnect::cSpectralData<float> wavelengths_nm) override;
+
+	void onBackgroundMatrixAge_ms(uint8_t device_id, int64_t age_ms) override;
+	void onNumOfBackgrounds(uint8_t device_id, uint32_t numOfBackgrounds) override;
+	void onBackgroundMatrix(uint8_t device_id, HySpexConnect::cSpatialMajorData<float> background) override;
+
+	void onSensorTemperature_K(uint8_t device_id, float temp_K) override;
+
+	void onImage(uint8_t device_id, HySpexConnect::cImageData<uint16_t> image) override;
+	void onImage(uint8_t device_id, HySpexConnect::cImageData<uint16_t> image, uint8_t spatialSkip, uint8_t spectralSkip) override;
+
+private:
+	void dispatch(std::function<void(cHySpexSWIR384_File*)> task);
+
+private:
+	const std::size_t mQueueDepth;
+
+	std::vector<cHySpexSWIR384_File*> mSinks;
+	std::vector<std::unique_ptr<cWriterThread>> mWriters;
+};
@@ -2,10 +2,48 @@
 #include "HySpexSWIR384_File.hpp"
 
 #include <iostream>
+#include <numbers>
+#include <string>
+#include <system_error>
+
+
+extern void console_message(const std::string& msg);
+
+namespace
+{
+    /**
+     * Rename from to to, replacing a file or directory left there by an
+     * earlier run.  Only used from the destructor, so an error is reported
+     * instead of thrown.
+     */
+    void replaceFile(const std::filesystem::path& from, const std::filesystem::path& to)
+    {
+        std::error_code ec;
+
+        // A directory can only be renamed over an empty one
+        if (std::filesystem::is_directory(from, ec) && std::filesystem::exists(to, ec))
+            std::filesystem::remove_all(to, ec);
+
+        if (!ec)
+            std::filesystem::rename(from, to, ec);
+
+        if (ec)
+            console_message("Could not rename " + from.string() + " to " + to.string() + ": " + ec.message());
+    }
+}
 
 
 cHySpexSWIR384_File::cHySpexSWIR384_File() : cHySpexSWIR_384_Parser()
-{}
+{
+    mRegistration.setWriter([this](const uint16_t* frame, std::size_t spatialSize, std::size_t spectralSize)
+        {
+            writeFrame(frame, spatialSize, spectralSize);
+            ++mActiveRow;
+
+            if (mPlotExtractor.enabled())
+                mPlotExtractor.addLine(frame, spatialSize, spectralSize, mRegistration.positions().back());
+        });
+}
 
 cHySpexSWIR384_File::~cHySpexSWIR384_File()
 {
@@ -13,8 +51,37 @@ cHySpexSWIR384_File::~cHySpexSWIR384_File()
 
     if (mPlotID == 'B')
     {
-        auto filename = createHeaderFilename('\0');
-        std::filesystem::rename(mHeaderFilename, filename);
+        replaceFile(mHeaderFilename, createHeaderFilename('\0'));
+
+        std::vector<std::string> suffixes;
+
+        if (mStatistics.enabled())
+            suffixes = mStatistics.suffixes();
+
+        if (mRegistration.enabled())
+        {
+            auto lines = mRegistration.suffixes();
+            suffixes.insert(suffixes.end(), lines.begin(), lines.end());
+        }
+
+        if (mPlotExtractor.enabled())
+        {
+            auto plots = mPlotExtractor.suffixes();
+            suffixes.insert(suffixes.end(), plots.begin(), plots.end());
+        }
+
+        for (const auto& suffix : suffixes)
+        {
+            auto from = createSidecarBasename('A');
+            from += suffix;
+
+            auto to = createSidecarBasename('\0');
+            to += suffix;
+
+            std::error_code ec;
+            if (std::filesystem::exists(from, ec))
+                replaceFile(from, to);
+        }
     }
 }
 
@@ -23,6 +90,102 @@ void cHySpexSWIR384_File::setOutputPath(std::filesystem::path out)
     mOutputPath = out;
 }
 
+void cHySpexSWIR384_File::setDecimation(std::size_t spatialFactor, std::size_t spectralFactor, eDecimation mode)
+{
+    mDecimator.setFactors(spatialFactor, spectralFactor, mode);
+}
+
+void cHySpexSWIR384_File::setCalibration(eCalibratedFormat format, float scale)
+{
+    mCalibration.enable(format, scale);
+}
+
+void cHySpexSWIR384_File::setStatistics(bool enable)
+{
+    mStatistics.enable(enable);
+}
+
+void cHySpexSWIR384_File::setRegistration(double spacing_mm)
+{
+    if (mCalibration.enabled() && (mCalibration.format() == eCalibratedFormat::FLOAT32))
+    {
+        throw std::logic_error("Line registration needs 16-bit samples.");
+    }
+
+    mRegistration.enable(spacing_mm);
+}
+
+void cHySpexSWIR384_File::setPlotExtraction(bool enable)
+{
+    mPlotExtractor.enable(enable);
+}
+
+void cHySpexSWIR384_File::setPlots(std::shared_ptr<const std::vector<sPlotRegion>> plots, double groundLevel_mm)
+{
+    mPlotExtractor.setPlots(std::move(plots), groundLevel_mm);
+}
+
+std::size_t cHySpexSWIR384_File::samples() const
+{
+    return mDecimator.reducedSpatialSize(mSpatialSize);
+}
+
+std::size_t cHySpexSWIR384_File::bands() const
+{
+    return mDecimator.reducedSpectralSize(mSpectralSize);
+}
+
+std::vector<float> cHySpexSWIR384_File::wavelengths() const
+{
+    return mDecimator.reduceWavelengths(mSpectralCalibration);
+}
+
+int cHySpexSWIR384_File::bitsPerSample() const
+{
+    if (!mCalibration.enabled())
+        return static_cast<int>(mNumBits);
+
+    return (mCalibration.format() == eCalibratedFormat::FLOAT32) ? 32 : 16;
+}
+
+int cHySpexSWIR384_File::enviDataType() const
+{
+    if (mCalibration.enabled() && (mCalibration.format() == eCalibratedFormat::FLOAT32))
+        return 4;
+
+    return 12;
+}
+
+bool cHySpexSWIR384_File::collectReference(const HySpexConnect::cImageData<uint16_t>& image)
+{
+    if (!mCalibration.enabled() || !mCalibration.inReference())
+        return false;
+
+    mCalibration.addReference(image);
+    return true;
+}
+
+void cHySpexSWIR384_File::accumulateStatistics(const HySpexConnect::cImageData<uint16_t>& image)
+{
+    if (mStatistics.enabled())
+        mStatistics.addFrame(image);
+}
+
+void cHySpexSWIR384_File::registerFrame(const HySpexConnect::cImageData<uint16_t>& image)
+{
+    if (mCalibration.enabled())
+    {
+        mRegistration.addFrame(mCalibration.calibrateScaled(image), image.spatialSize(), image.spectralSize());
+    }
+    else if (mDecimator.enabled())
+    {
+        auto* frame = mDecimator.reduce(image);
+        mRegistration.addFrame(frame, mDecimator.spatialSize(), mDecimator.spectralSize());
+    }
+    else
+        mRegistration.addFrame(image);
+}
+
 std::filesystem::path cHySpexSWIR384_File::createHeaderFilename(char plotID)
 {
     std::filesystem::path filename = mOutputPath;
@@ -43,6 +206,26 @@ std::filesystem::path cHySpexSWIR384_File::createHeaderFilename(char plotID)
     return filename;
 }
 
+std::filesystem::path cHySpexSWIR384_File::createSidecarBasename(char plotID)
+{
+    std::filesystem::path filename = mOutputPath;
+
+    std::string ext;
+
+    if (plotID > '@')
+    {
+        ext = ".";
+        ext += plotID;
+        ext += ".swir";
+    }
+    else
+        ext = ".swir";
+
+    filename += ext;
+
+    return filename;
+}
+
 void cHySpexSWIR384_File::openDataFile()
 {
     mDataFilename = createDataFilename(mPlotID);
@@ -57,6 +240,11 @@ void cHySpexSWIR384_File::openDataFile()
     }
 }
 
+void cHySpexSWIR384_File::closeDataFile()
+{
+    mOutputFile.close();
+}
+
 void cHySpexSWIR384_File::onPosition(double x_mm, double y_mm, double z_mm, double speed_mmps)
 {
     mResyncTimestamp = true;
@@ -68,30 +256,67 @@ void cHySpexSWIR384_File::onPosition(double x_mm, double y_mm, double z_mm, doub
     xyz.s = speed_mmps / 1000.0;
 
     mPositions.push_back(xyz);
+
+    if (mRegistration.enabled())
+        mRegistration.addPosition(x_mm, y_mm, z_mm);
 }
 
 void cHySpexSWIR384_File::onStartRecordingTimestamp(uint64_t timestamp_ns)
 {
     openDataFile();
 
+    mStatistics.clear();
+    mRegistration.clear();
+    mPlotExtractor.begin(createSidecarBasename(mPlotID));
+
     mActiveRow = 0;
 }
 
 void cHySpexSWIR384_File::onEndRecordingTimestamp(uint64_t timestamp_ns)
 {
-    mOutputFile.close();
+    if (mRegistration.enabled())
+        mRegistration.flush();
+
+    closeDataFile();
 
     mHeaderFilename = createHeaderFilename(mPlotID);
 
     writeHeader(mHeaderFilename);
 
+    if (mStatistics.enabled())
+        mStatistics.write(createSidecarBasename(mPlotID));
+
+    if (mRegistration.enabled())
+        mRegistration.write(createSidecarBasename(mPlotID));
+
+    if (mPlotExtractor.enabled())
+        mPlotExtractor.write(wavelengths());
+
     ++mPlotID;
 
     mActiveRow = 0;
 }
 
-void cHySpexSWIR384_File::onBeginReference(uint8_t device_id) {};
-void cHySpexSWIR384_File::onEndOfReference(uint8_t device_id) {};
+void cHySpexSWIR384_File::onImage(uint8_t device_id, HySpexConnect::cImageData<uint16_t> image)
+{
+    writeImage(device_id, image);
+}
+
+void cHySpexSWIR384_File::onImage(uint8_t device_id, HySpexConnect::cImageData<uint16_t> image, uint8_t spatialSkip, uint8_t spectralSkip)
+{
+    // The frame holds the pixels and bands that were recorded
+    writeImage(device_id, image);
+}
+
+void cHySpexSWIR384_File::onBeginReference(uint8_t device_id)
+{
+    mCalibration.beginReference();
+}
+
+void cHySpexSWIR384_File::onEndOfReference(uint8_t device_id)
+{
+    mCalibration.endReference();
+}
 
 void cHySpexSWIR384_File::onID(uint8_t device_id, std::string id) {}
 void cHySpexSWIR384_File::onSerialNumber(uint8_t device_id, std::string serialNumber) {}
@@ -111,6 +336,7 @@ void cHySpexSWIR384_File::onMaxSpectralSize(uint8_t device_id, uint64_t maxSpect
 void cHySpexSWIR384_File::onMaxPixelValue(uint8_t device_id, uint16_t maxPixelValue)
 {
     mMaxPixelValue = maxPixelValue;
+    mStatistics.setMaxPixelValue(maxPixelValue);
 
     if (mMaxPixelValue < 2)
     {
@@ -130,16 +356,39 @@ void cHySpexSWIR384_File::onMaxPixelValue(uint8_t device_id, uint16_t maxPixelVa
     }
 }
 
-void cHySpexSWIR384_File::onResponsivityMatrix(uint8_t device_id, HySpexConnect::cSpatialMajorData<float> re) {}
+void cHySpexSWIR384_File::onResponsivityMatrix(uint8_t device_id, HySpexConnect::cSpatialMajorData<float> re)
+{
+    if (mCalibration.enabled())
+        mCalibration.setResponsivity(re, mSpatialSize, mSpectralSize);
+}
+
 void cHySpexSWIR384_File::onQuantumEfficiencyData(uint8_t device_id, HySpexConnect::cSpectralData<float> qe) {}
 void cHySpexSWIR384_File::onLensName(uint8_t device_id, std::string name) {}
 void cHySpexSWIR384_File::onLensWorkingDistance_cm(uint8_t device_id, double workingDistance_cm) {}
-void cHySpexSWIR384_File::onLensFieldOfView_rad(uint8_t device_id, double fieldOfView_rad) {}
-void cHySpexSWIR384_File::onLensFieldOfView_deg(uint8_t device_id, double fieldOfView_deg) {}
+void cHySpexSWIR384_File::onLensFieldOfView_rad(uint8_t device_id, double fieldOfView_rad)
+{
+    mFieldOfView_rad = fieldOfView_rad;
+    mPlotExtractor.setFieldOfView_rad(fieldOfView_rad);
+}
+
+void cHySpexSWIR384_File::onLensFieldOfView_deg(uint8_t device_id, double fieldOfView_deg)
+{
+    onLensFieldOfView_rad(device_id, fieldOfView_deg * std::numbers::pi / 180.0);
+}
+
 
 void cHySpexSWIR384_File::onAverageFrames(uint8_t device_id, uint16_t averageFrames) {}
-void cHySpexSWIR384_File::onFramePeriod_us(uint8_t device_id, uint32_t framePeriod_us) { mFramePeriod_us = framePeriod_us; }
-void cHySpexSWIR384_File::onIntegrationTime_us(uint8_t device_id, uint32_t integrationTime_us) { mIntegrationTime_us = integrationTime_us; }
+void cHySpexSWIR384_File::onFramePeriod_us(uint8_t device_id, uint32_t framePeriod_us)
+{
+    mFramePeriod_us = framePeriod_us;
+    mRegistration.setLinePeriod_us(framePeriod_us);
+}
+
+void cHySpexSWIR384_File::onIntegrationTime_us(uint8_t device_id, uint32_t integrationTime_us)
+{
+    mIntegrationTime_us = integrationTime_us;
+    mCalibration.setIntegrationTime_us(integrationTime_us);
+}
 
 void cHySpexSWIR384_File::onBadPixels(uint8_t device_id, HySpexConnect::cBadPixelData bad_pixels) {}
 void cHySpexSWIR384_File::onBadPixelCorrection(uint8_t device_id, HySpexConnect::cBadPixelCorrectionData corrections) {}
@@ -150,11 +399,16 @@ void cHySpexSWIR384_File::onAmbientTemperature_C(uint8_t device_id, float temp_C
 void cHySpexSWIR384_File::onSpectralCalibration(uint8_t device_id, HySpexConnect::cSpectralData<float> wavelengths_nm)
 {
     mSpectralCalibration = wavelengths_nm;
+    mStatistics.setWavelengths(mSpectralCalibration);
 }
 
 void cHySpexSWIR384_File::onBackgroundMatrixAge_ms(uint8_t device_id, int64_t age_ms) {}
 void cHySpexSWIR384_File::onNumOfBackgrounds(uint8_t device_id, uint32_t numOfBackgrounds) {}
-void cHySpexSWIR384_File::onBackgroundMatrix(uint8_t device_id, HySpexConnect::cSpatialMajorData<float> background) {}
+void cHySpexSWIR384_File::onBackgroundMatrix(uint8_t device_id, HySpexConnect::cSpatialMajorData<float> background)
+{
+    if (mCalibration.enabled())
+        mCalibration.setBackground(background, mSpatialSize, mSpectralSize);
+}
 
 void cHySpexSWIR384_File::onSensorTemperature_K(uint8_t device_id, float temp_K) {}
 
@@ -41,35 +41,39 @@ std::filesystem::path cHySpexVNIR3000N_BIL::createDataFilename(char plotID)
     return filename;
 }
 
-void cHySpexVNIR3000N_BIL::onImage(uint8_t device_id, HySpexConnect::cImageData<uint16_t> image)
+void cHySpexVNIR3000N_BIL::writeFrame(const uint16_t* frame, std::size_t spatialSize, std::size_t spectralSize)
 {
-    if (!mOutputFile.is_open())
-        return;
+    mInterleaver.writeBIL(mOutputFile, frame, spatialSize, spectralSize);
+}
 
-    ++mActiveRow;
+void cHySpexVNIR3000N_BIL::writeImage(uint8_t device_id, const HySpexConnect::cImageData<uint16_t>& image)
+{
+    if (!mOutputFile.is_open() || collectReference(image))
+        return;
 
-    auto n = image.spatialSize();
-    auto m = image.spectralSize();
-    auto data = image.image();
+    accumulateStatistics(image);
 
-    for (int band = 0; band < m; ++band)
+    if (mRegistration.enabled())
     {
-        auto channels = data.band(band);
-        for (auto pixel : channels)
-            mOutputFile.write(reinterpret_cast<char*>(&pixel), sizeof pixel);
-    }
-}
-
-void cHySpexVNIR3000N_BIL::onImage(uint8_t device_id, HySpexConnect::cImageData<uint16_t> image, uint8_t spatialSkip, uint8_t spectralSkip)
-{
-    if (!mOutputFile.is_open())
+        registerFrame(image);
         return;
+    }
 
     ++mActiveRow;
 
-    for (int i = 0; image.spatialSize(); ++i)
+    if (mCalibration.enabled())
     {
-        //        mImage[i] = { 128,128,128 };
+        if (mCalibration.format() == eCalibratedFormat::FLOAT32)
+            mInterleaver.writeBIL(mOutputFile, mCalibration.calibrate(image), image.spatialSize(), image.spectralSize());
+        else
+            mInterleaver.writeBIL(mOutputFile, mCalibration.calibrateScaled(image), image.spatialSize(), image.spectralSize());
     }
+    else if (mDecimator.enabled())
+    {
+        auto* frame = mDecimator.reduce(image);
+        mInterleaver.writeBIL(mOutputFile, frame, mDecimator.spatialSize(), mDecimator.spectralSize());
+    }
+    else
+        mInterleaver.writeBIL(mOutputFile, image);
 }
 
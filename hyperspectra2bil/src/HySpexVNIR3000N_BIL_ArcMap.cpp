@@ -24,15 +24,19 @@ void cHySpexVNIR3000N_BIL_ArcMap::writeHeader(std::filesystem::path filename)
     if (!header.is_open())
         return;
 
-    int bandrowbytes = (mSpatialSize * static_cast<int>(mNumBits)) / 8;
-    int totalrowbytes = mSpectralSize * bandrowbytes;
+    int bandrowbytes = (samples() * bitsPerSample()) / 8;
+    int totalrowbytes = bands() * bandrowbytes;
 
     header << "BYTEORDER      I" << std::endl;
     header << "LAYOUT         BIL" << std::endl;
     header << "NROWS          " << mActiveRow << std::endl;
-    header << "NCOLS          " << mSpatialSize << std::endl;
-    header << "NBANDS         " << mSpectralSize << std::endl;
-    header << "NBITS          " << static_cast<int>(mNumBits) << std::endl;
+    header << "NCOLS          " << samples() << std::endl;
+    header << "NBANDS         " << bands() << std::endl;
+    header << "NBITS          " << bitsPerSample() << std::endl;
+
+    if (bitsPerSample() == 32)
+        header << "PIXELTYPE      FLOAT" << std::endl;
+
     header << "BANDROWBYTES   " << bandrowbytes << std::endl;
     header << "TOTALROWBYTES  " << totalrowbytes << std::endl;
     header << "ULXMAP         0" << std::endl;
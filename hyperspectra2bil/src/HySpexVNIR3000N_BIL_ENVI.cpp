@@ -29,23 +29,28 @@ void cHySpexVNIR3000N_BIL_ENVI::writeHeader(std::filesystem::path filename)
 
     header << "header offset = 0" << std::endl;
     header << "file type = ENVI Standard" << std::endl;
-    header << "data type = 12" << std::endl;
+    header << "data type = " << enviDataType() << std::endl;
     header << "byte order = 0" << std::endl;
-    header << "bands = " << mSpectralSize << std::endl;
+    header << "bands = " << bands() << std::endl;
     header << "lines = " << mActiveRow << std::endl;
-    header << "samples = " << mSpatialSize << std::endl;
+    header << "samples = " << samples() << std::endl;
     header << "wavelength units = nm" << std::endl;
 
-    auto n = mSpectralCalibration.size();
+    if (mCalibration.enabled() && (mCalibration.format() == eCalibratedFormat::UINT16))
+        header << "reflectance scale factor = " << mCalibration.scale() << std::endl;
+
+    auto wavelengths = this->wavelengths();
+
+    auto n = wavelengths.size();
     if (n > 0)
     {
         --n;
         header << "wavelength = {" << std::endl;
 
         for (std::size_t i = 0; i < n; ++i)
-            header << mSpectralCalibration[i] << ", ";
+            header << wavelengths[i] << ", ";
 
-        header << *mSpectralCalibration.rbegin() << "}" << std::endl;
+        header << *wavelengths.rbegin() << "}" << std::endl;
     }
 }
 
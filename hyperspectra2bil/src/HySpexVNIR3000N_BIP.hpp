@@ -2,6 +2,7 @@
 #pragma once
 
 #include "HySpexVNIR3000N_File.hpp"
+#include "BandInterleaver.hpp"
 
 
 class cHySpexVNIR3000N_BIP : public cHySpexVNIR3000N_File
@@ -11,9 +12,12 @@ public:
 	virtual ~cHySpexVNIR3000N_BIP();
 
 protected:
-	void onImage(uint8_t device_id, HySpexConnect::cImageData<uint16_t> image) override;
-	void onImage(uint8_t device_id, HySpexConnect::cImageData<uint16_t> image, uint8_t spatialSkip, uint8_t spectralSkip) override;
+	void writeImage(uint8_t device_id, const HySpexConnect::cImageData<uint16_t>& image) override;
 
 protected:
 	std::filesystem::path createDataFilename(char plotID) override;
+	void writeFrame(const uint16_t* frame, std::size_t spatialSize, std::size_t spectralSize) override;
+
+private:
+	cBandInterleaver mInterleaver;
 };
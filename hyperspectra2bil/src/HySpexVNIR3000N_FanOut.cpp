@@ -0,0 +1,224 @@
+#include "HySpexVNIR3000N_FanOut.hpp"
+
+#include "HySpexVNIR3000N_File.hpp"
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+
+cHySpexVNIR3000N_FanOut::cHySpexVNIR3000N_FanOut(std::size_t queueDepth)
+:
+    cHySpexVNIR_3000N_Parser(), mQueueDepth(queueDepth)
+{
+}
+
+cHySpexVNIR3000N_FanOut::~cHySpexVNIR3000N_FanOut()
+{
+    for (auto& writer : mWriters)
+        writer->finish();
+}
+
+void cHySpexVNIR3000N_FanOut::addSink(cHySpexVNIR3000N_File* sink)
+{
+    mSinks.push_back(sink);
+    mWriters.push_back(std::make_unique<cWriterThread>(mQueueDepth));
+}
+
+void cHySpexVNIR3000N_FanOut::finish()
+{
+    for (auto& writer : mWriters)
+        writer->finish();
+
+    for (auto& writer : mWriters)
+    {
+        if (writer->failed())
+            throw std::runtime_error(writer->error());
+    }
+}
+
+void cHySpexVNIR3000N_FanOut::dispatch(std::function<void(cHySpexVNIR3000N_File*)> task)
+{
+    // The task is shared so that its data is not copied for each converter
+    auto shared = std::make_shared<const std::function<void(cHySpexVNIR3000N_File*)>>(std::move(task));
+
+    for (std::size_t i = 0; i < mSinks.size(); ++i)
+    {
+        auto* sink = mSinks[i];
+        mWriters[i]->push([sink, shared]() { (*shared)(sink); });
+    }
+}
+
+void cHySpexVNIR3000N_FanOut::setPlots(std::shared_ptr<const std::vector<sPlotRegion>> plots, double groundLevel_mm)
+{
+    dispatch([plots, groundLevel_mm](cHySpexVNIR3000N_File* sink) { sink->setPlots(plots, groundLevel_mm); });
+}
+
+void cHySpexVNIR3000N_FanOut::onPosition(double x_mm, double y_mm, double z_mm, double speed_mmps)
+{
+    dispatch([x_mm, y_mm, z_mm, speed_mmps](cHySpexVNIR3000N_File* sink) { sink->onPosition(x_mm, y_mm, z_mm, speed_mmps); });
+}
+
+void cHySpexVNIR3000N_FanOut::onStartRecordingTimestamp(uint64_t timestamp_ns)
+{
+    dispatch([timestamp_ns](cHySpexVNIR3000N_File* sink) { sink->onStartRecordingTimestamp(timestamp_ns); });
+}
+
+void cHySpexVNIR3000N_FanOut::onEndRecordingTimestamp(uint64_t timestamp_ns)
+{
+    dispatch([timestamp_ns](cHySpexVNIR3000N_File* sink) { sink->onEndRecordingTimestamp(timestamp_ns); });
+}
+
+void cHySpexVNIR3000N_FanOut::onBeginReference(uint8_t device_id)
+{
+    dispatch([device_id](cHySpexVNIR3000N_File* sink) { sink->onBeginReference(device_id); });
+}
+
+void cHySpexVNIR3000N_FanOut::onEndOfReference(uint8_t device_id)
+{
+    dispatch([device_id](cHySpexVNIR3000N_File* sink) { sink->onEndOfReference(device_id); });
+}
+
+void cHySpexVNIR3000N_FanOut::onID(uint8_t device_id, std::string id)
+{
+    dispatch([device_id, id = std::move(id)](cHySpexVNIR3000N_File* sink) { sink->onID(device_id, id); });
+}
+
+void cHySpexVNIR3000N_FanOut::onSerialNumber(uint8_t device_id, std::string serialNumber)
+{
+    dispatch([device_id, serialNumber = std::move(serialNumber)](cHySpexVNIR3000N_File* sink) { sink->onSerialNumber(device_id, serialNumber); });
+}
+
+void cHySpexVNIR3000N_FanOut::onWavelengthRange_nm(uint8_t device_id, uint16_t minWavelength_nm, uint16_t maxWavelength_nm)
+{
+    dispatch([device_id, minWavelength_nm, maxWavelength_nm](cHySpexVNIR3000N_File* sink) { sink->onWavelengthRange_nm(device_id, minWavelength_nm, maxWavelength_nm); });
+}
+
+void cHySpexVNIR3000N_FanOut::onSpatialSize(uint8_t device_id, uint64_t spatialSize)
+{
+    dispatch([device_id, spatialSize](cHySpexVNIR3000N_File* sink) { sink->onSpatialSize(device_id, spatialSize); });
+}
+
+void cHySpexVNIR3000N_FanOut::onSpectralSize(uint8_t device_id, uint64_t spectralSize)
+{
+    dispatch([device_id, spectralSize](cHySpexVNIR3000N_File* sink) { sink->onSpectralSize(device_id, spectralSize); });
+}
+
+void cHySpexVNIR3000N_FanOut::onMaxSpatialSize(uint8_t device_id, uint64_t maxSpatialSize)
+{
+    dispatch([device_id, maxSpatialSize](cHySpexVNIR3000N_File* sink) { sink->onMaxSpatialSize(device_id, maxSpatialSize); });
+}
+
+void cHySpexVNIR3000N_FanOut::onMaxSpectralSize(uint8_t device_id, uint64_t maxSpectralSize)
+{
+    dispatch([device_id, maxSpectralSize](cHySpexVNIR3000N_File* sink) { sink->onMaxSpectralSize(device_id, maxSpectralSize); });
+}
+
+void cHySpexVNIR3000N_FanOut::onMaxPixelValue(uint8_t device_id, uint16_t maxPixelValue)
+{
+    dispatch([device_id, maxPixelValue](cHySpexVNIR3000N_File* sink) { sink->onMaxPixelValue(device_id, maxPixelValue); });
+}
+
+void cHySpexVNIR3000N_FanOut::onResponsivityMatrix(uint8_t device_id, HySpexConnect::cSpatialMajorData<float> re)
+{
+    dispatch([device_id, re = std::move(re)](cHySpexVNIR3000N_File* sink) { sink->onResponsivityMatrix(device_id, re); });
+}
+
+void cHySpexVNIR3000N_FanOut::onQuantumEfficiencyData(uint8_t device_id, HySpexConnect::cSpectralData<float> qe)
+{
+    dispatch([device_id, qe = std::move(qe)](cHySpexVNIR3000N_File* sink) { sink->onQuantumEfficiencyData(device_id, qe); });
+}
+
+void cHySpexVNIR3000N_FanOut::onLensName(uint8_t device_id, std::string name)
+{
+    dispatch([device_id, name = std::move(name)](cHySpexVNIR3000N_File* sink) { sink->onLensName(device_id, name); });
+}
+
+void cHySpexVNIR3000N_FanOut::onLensWorkingDistance_cm(uint8_t device_id, double workingDistance_cm)
+{
+    dispatch([device_id, workingDistance_cm](cHySpexVNIR3000N_File* sink) { sink->onLensWorkingDistance_cm(device_id, workingDistance_cm); });
+}
+
+void cHySpexVNIR3000N_FanOut::onLensFieldOfView_rad(uint8_t device_id, double fieldOfView_rad)
+{
+    dispatch([device_id, fieldOfView_rad](cHySpexVNIR3000N_File* sink) { sink->onLensFieldOfView_rad(device_id, fieldOfView_rad); });
+}
+
+void cHySpexVNIR3000N_FanOut::onLensFieldOfView_deg(uint8_t device_id, double fieldOfView_deg)
+{
+    dispatch([device_id, fieldOfView_deg](cHySpexVNIR3000N_File* sink) { sink->onLensFieldOfView_deg(device_id, fieldOfView_deg); });
+}
+
+void cHySpexVNIR3000N_FanOut::onAverageFrames(uint8_t device_id, uint16_t averageFrames)
+{
+    dispatch([device_id, averageFrames](cHySpexVNIR3000N_File* sink) { sink->onAverageFrames(device_id, averageFrames); });
+}
+
+void cHySpexVNIR3000N_FanOut::onFramePeriod_us(uint8_t device_id, uint32_t framePeriod_us)
+{
+    dispatch([device_id, framePeriod_us](cHySpexVNIR3000N_File* sink) { sink->onFramePeriod_us(device_id, framePeriod_us); });
+}
+
+void cHySpexVNIR3000N_FanOut::onIntegrationTime_us(uint8_t device_id, uint32_t integrationTime_us)
+{
+    dispatch([device_id, integrationTime_us](cHySpexVNIR3000N_File* sink) { sink->onIntegrationTime_us(device_id, integrationTime_us); });
+}
+
+void cHySpexVNIR3000N_FanOut::onBadPixels(uint8_t device_id, HySpexConnect::cBadPixelData bad_pixels)
+{
+    dispatch([device_id, bad_pixels = std::move(bad_pixels)](cHySpexVNIR3000N_File* sink) { sink->onBadPixels(device_id, bad_pixels); });
+}
+
+void cHySpexVNIR3000N_FanOut::onBadPixelCorrection(uint8_t device_id, HySpexConnect::cBadPixelCorrectionData corrections)
+{
+    dispatch([device_id, corrections = std::move(corrections)](cHySpexVNIR3000N_File* sink) { sink->onBadPixelCorrection(device_id, corrections); });
+}
+
+void cHySpexVNIR3000N_FanOut::onBadPixelMatrix(uint8_t device_id, HySpexConnect::cSpatialMajorData<uint8_t> matrix)
+{
+    dispatch([device_id, matrix = std::move(matrix)](cHySpexVNIR3000N_File* sink) { sink->onBadPixelMatrix(device_id, matrix); });
+}
+
+void cHySpexVNIR3000N_FanOut::onAmbientTemperature_C(uint8_t device_id, float temp_C)
+{
+    dispatch([device_id, temp_C](cHySpexVNIR3000N_File* sink) { sink->onAmbientTemperature_C(device_id, temp_C); });
+}
+
+void cHySpexVNIR3000N_FanOut::onSpectralCalibration(uint8_t device_id, HySpexConnect::cSpectralData<float> wavelengths_nm)
+{
+    dispatch([device_id, wavelengths_nm = std::move(wavelengths_nm)](cHySpexVNIR3000N_File* sink) { sink->onSpectralCalibration(device_id, wavelengths_nm); });
+}
+
+void cHySpexVNIR3000N_FanOut::onBackgroundMatrixAge_ms(uint8_t device_id, int64_t age_ms)
+{
+    dispatch([device_id, age_ms](cHySpexVNIR3000N_File* sink) { sink->onBackgroundMatrixAge_ms(device_id, age_ms); });
+}
+
+void cHySpexVNIR3000N_FanOut::onNumOfBackgrounds(uint8_t device_id, uint32_t numOfBackgrounds)
+{
+    dispatch([device_id, numOfBackgrounds](cHySpexVNIR3000N_File* sink) { sink->onNumOfBackgrounds(device_id, numOfBackgrounds); });
+}
+
+void cHySpexVNIR3000N_FanOut::onBackgroundMatrix(uint8_t device_id, HySpexConnect::cSpatialMajorData<float> background)
+{
+    dispatch([device_id, background = std::move(background)](cHySpexVNIR3000N_File* sink) { sink->onBackgroundMatrix(device_id, background); });
+}
+
+void cHySpexVNIR3000N_FanOut::onSensorTemperature_C(uint8_t device_id, float temp_C)
+{
+    dispatch([device_id, temp_C](cHySpexVNIR3000N_File* sink) { sink->onSensorTemperature_C(device_id, temp_C); });
+}
+
+void cHySpexVNIR3000N_FanOut::onImage(uint8_t device_id, HySpexConnect::cImageData<uint16_t> image)
+{
+    // The writer threads of every sink share one copy of the frame
+    auto frame = std::make_shared<const HySpexConnect::cImageData<uint16_t>>(std::move(image));
+    dispatch([device_id, frame](cHySpexVNIR3000N_File* sink) { sink->writeImage(device_id, *frame); });
+}
+
+void cHySpexVNIR3000N_FanOut::onImage(uint8_t device_id, HySpexConnect::cImageData<uint16_t> image, uint8_t spatialSkip, uint8_t spectralSkip)
+{
+    auto frame = std::make_shared<const HySpexConnect::cImageData<uint16_t>>(std::move(image));
+    dispatch([device_id, frame](cHySpexVNIR3000N_File* sink) { sink->writeImage(device_id, *frame); });
+}
@@ -4,10 +4,47 @@
 #include <opencv2/opencv.hpp>
 
 #include <iostream>
+#include <numbers>
+#include <string>
+#include <system_error>
+
+
+extern void console_message(const std::string& msg);
+
+namespace
+{
+    /**
+     * Rename from to to, replacing a file or directory left there by an
+     * earlier run.  Only used from the destructor, so an error is reported
+     * instead of thrown.
+     */
+    void replaceFile(const std::filesystem::path& from, const std::filesystem::path& to)
+    {
+        std::error_code ec;
+
+        // A directory can only be renamed over an empty one
+        if (std::filesystem::is_directory(from, ec) && std::filesystem::exists(to, ec))
+            std::filesystem::remove_all(to, ec);
+
+        if (!ec)
+            std::filesystem::rename(from, to, ec);
+
+        if (ec)
+            console_message("Could not rename " + from.string() + " to " + to.string() + ": " + ec.message());
+    }
+}
 
 
 cHySpexVNIR3000N_File::cHySpexVNIR3000N_File() : cHySpexVNIR_3000N_Parser()
 {
+    mRegistration.setWriter([this](const uint16_t* frame, std::size_t spatialSize, std::size_t spectralSize)
+        {
+            writeFrame(frame, spatialSize, spectralSize);
+            ++mActiveRow;
+
+            if (mPlotExtractor.enabled())
+                mPlotExtractor.addLine(frame, spatialSize, spectralSize, mRegistration.positions().back());
+        });
 }
 
 cHySpexVNIR3000N_File::~cHySpexVNIR3000N_File()
@@ -16,8 +53,37 @@ cHySpexVNIR3000N_File::~cHySpexVNIR3000N_File()
 
     if (mPlotID == 'B')
     {
-        auto filename = createHeaderFilename('\0');
-        std::filesystem::rename(mHeaderFilename, filename);
+        replaceFile(mHeaderFilename, createHeaderFilename('\0'));
+
+        std::vector<std::string> suffixes;
+
+        if (mStatistics.enabled())
+            suffixes = mStatistics.suffixes();
+
+        if (mRegistration.enabled())
+        {
+            auto lines = mRegistration.suffixes();
+            suffixes.insert(suffixes.end(), lines.begin(), lines.end());
+        }
+
+        if (mPlotExtractor.enabled())
+        {
+            auto plots = mPlotExtractor.suffixes();
+            suffixes.insert(suffixes.end(), plots.begin(), plots.end());
+        }
+
+        for (const auto& suffix : suffixes)
+        {
+            auto from = createSidecarBasename('A');
+            from += suffix;
+
+            auto to = createSidecarBasename('\0');
+            to += suffix;
+
+            std::error_code ec;
+            if (std::filesystem::exists(from, ec))
+                replaceFile(from, to);
+        }
     }
 }
 
@@ -26,6 +92,102 @@ void cHySpexVNIR3000N_File::setOutputPath(std::filesystem::path out)
     mOutputPath = out;
 }
 
+void cHySpexVNIR3000N_File::setDecimation(std::size_t spatialFactor, std::size_t spectralFactor, eDecimation mode)
+{
+    mDecimator.setFactors(spatialFactor, spectralFactor, mode);
+}
+
+void cHySpexVNIR3000N_File::setCalibration(eCalibratedFormat format, float scale)
+{
+    mCalibration.enable(format, scale);
+}
+
+void cHySpexVNIR3000N_File::setStatistics(bool enable)
+{
+    mStatistics.enable(enable);
+}
+
+void cHySpexVNIR3000N_File::setRegistration(double spacing_mm)
+{
+    if (mCalibration.enabled() && (mCalibration.format() == eCalibratedFormat::FLOAT32))
+    {
+        throw std::logic_error("Line registration needs 16-bit samples.");
+    }
+
+    mRegistration.enable(spacing_mm);
+}
+
+void cHySpexVNIR3000N_File::setPlotExtraction(bool enable)
+{
+    mPlotExtractor.enable(enable);
+}
+
+void cHySpexVNIR3000N_File::setPlots(std::shared_ptr<const std::vector<sPlotRegion>> plots, double groundLevel_mm)
+{
+    mPlotExtractor.setPlots(std::move(plots), groundLevel_mm);
+}
+
+std::size_t cHySpexVNIR3000N_File::samples() const
+{
+    return mDecimator.reducedSpatialSize(mSpatialSize);
+}
+
+std::size_t cHySpexVNIR3000N_File::bands() const
+{
+    return mDecimator.reducedSpectralSize(mSpectralSize);
+}
+
+std::vector<float> cHySpexVNIR3000N_File::wavelengths() const
+{
+    return mDecimator.reduceWavelengths(mSpectralCalibration);
+}
+
+int cHySpexVNIR3000N_File::bitsPerSample() const
+{
+    if (!mCalibration.enabled())
+        return static_cast<int>(mNumBits);
+
+    return (mCalibration.format() == eCalibratedFormat::FLOAT32) ? 32 : 16;
+}
+
+int cHySpexVNIR3000N_File::enviDataType() const
+{
+    if (mCalibration.enabled() && (mCalibration.format() == eCalibratedFormat::FLOAT32))
+        return 4;
+
+    return 12;
+}
+
+bool cHySpexVNIR3000N_File::collectReference(const HySpexConnect::cImageData<uint16_t>& image)
+{
+    if (!mCalibration.enabled() || !mCalibration.inReference())
+        return false;
+
+    mCalibration.addReference(image);
+    return true;
+}
+
+void cHySpexVNIR3000N_File::accumulateStatistics(const HySpexConnect::cImageData<uint16_t>& image)
+{
+    if (mStatistics.enabled())
+        mStatistics.addFrame(image);
+}
+
+void cHySpexVNIR3000N_File::registerFrame(const HySpexConnect::cImageData<uint16_t>& image)
+{
+    if (mCalibration.enabled())
+    {
+        mRegistration.addFrame(mCalibration.calibrateScaled(image), image.spatialSize(), image.spectralSize());
+    }
+    else if (mDecimator.enabled())
+    {
+        auto* frame = mDecimator.reduce(image);
+        mRegistration.addFrame(frame, mDecimator.spatialSize(), mDecimator.spectralSize());
+    }
+    else
+        mRegistration.addFrame(image);
+}
+
 std::filesystem::path cHySpexVNIR3000N_File::createHeaderFilename(char plotID)
 {
     std::filesystem::path filename = mOutputPath;
@@ -46,6 +208,26 @@ std::filesystem::path cHySpexVNIR3000N_File::createHeaderFilename(char plotID)
     return filename;
 }
 
+std::filesystem::path cHySpexVNIR3000N_File::createSidecarBasename(char plotID)
+{
+    std::filesystem::path filename = mOutputPath;
+
+    std::string ext;
+
+    if (plotID > '@')
+    {
+        ext = ".";
+        ext += plotID;
+        ext += ".vnir";
+    }
+    else
+        ext = ".vnir";
+
+    filename += ext;
+
+    return filename;
+}
+
 void cHySpexVNIR3000N_File::openDataFile()
 {
     mDataFilename = createDataFilename(mPlotID);
@@ -60,6 +242,11 @@ void cHySpexVNIR3000N_File::openDataFile()
     }
 }
 
+void cHySpexVNIR3000N_File::closeDataFile()
+{
+    mOutputFile.close();
+}
+
 void cHySpexVNIR3000N_File::onPosition(double x_mm, double y_mm, double z_mm, double speed_mmps)
 {
     mResyncTimestamp = true;
@@ -71,30 +258,67 @@ void cHySpexVNIR3000N_File::onPosition(double x_mm, double y_mm, double z_mm, do
     xyz.s = speed_mmps / 1000.0;
 
     mPositions.push_back(xyz);
+
+    if (mRegistration.enabled())
+        mRegistration.addPosition(x_mm, y_mm, z_mm);
 }
 
 void cHySpexVNIR3000N_File::onStartRecordingTimestamp(uint64_t timestamp_ns)
 {
     openDataFile();
 
+    mStatistics.clear();
+    mRegistration.clear();
+    mPlotExtractor.begin(createSidecarBasename(mPlotID));
+
     mActiveRow = 0;
 }
 
 void cHySpexVNIR3000N_File::onEndRecordingTimestamp(uint64_t timestamp_ns)
 {
-    mOutputFile.close();
+    if (mRegistration.enabled())
+        mRegistration.flush();
+
+    closeDataFile();
 
     mHeaderFilename = createHeaderFilename(mPlotID);
 
     writeHeader(mHeaderFilename);
 
+    if (mStatistics.enabled())
+        mStatistics.write(createSidecarBasename(mPlotID));
+
+    if (mRegistration.enabled())
+        mRegistration.write(createSidecarBasename(mPlotID));
+
+    if (mPlotExtractor.enabled())
+        mPlotExtractor.write(wavelengths());
+
     ++mPlotID;
 
     mActiveRow = 0;
 }
 
-void cHySpexVNIR3000N_File::onBeginReference(uint8_t device_id) {};
-void cHySpexVNIR3000N_File::onEndOfReference(uint8_t device_id) {};
+void cHySpexVNIR3000N_File::onImage(uint8_t device_id, HySpexConnect::cImageData<uint16_t> image)
+{
+    writeImage(device_id, image);
+}
+
+void cHySpexVNIR3000N_File::onImage(uint8_t device_id, HySpexConnect::cImageData<uint16_t> image, uint8_t spatialSkip, uint8_t spectralSkip)
+{
+    // The frame holds the pixels and bands that were recorded
+    writeImage(device_id, image);
+}
+
+void cHySpexVNIR3000N_File::onBeginReference(uint8_t device_id)
+{
+    mCalibration.beginReference();
+}
+
+void cHySpexVNIR3000N_File::onEndOfReference(uint8_t device_id)
+{
+    mCalibration.endReference();
+}
 
 void cHySpexVNIR3000N_File::onID(uint8_t device_id, std::string id) {}
 void cHySpexVNIR3000N_File::onSerialNumber(uint8_t device_id, std::string serialNumber) {}
@@ -114,6 +338,7 @@ void cHySpexVNIR3000N_File::onMaxSpectralSize(uint8_t device_id, uint64_t maxSpe
 void cHySpexVNIR3000N_File::onMaxPixelValue(uint8_t device_id, uint16_t maxPixelValue)
 {
     mMaxPixelValue = maxPixelValue;
+    mStatistics.setMaxPixelValue(maxPixelValue);
 
     if (mMaxPixelValue < 2)
     {
@@ -133,16 +358,39 @@ void cHySpexVNIR3000N_File::onMaxPixelValue(uint8_t device_id, uint16_t maxPixel
     }
 }
 
-void cHySpexVNIR3000N_File::onResponsivityMatrix(uint8_t device_id, HySpexConnect::cSpatialMajorData<float> re) {}
+void cHySpexVNIR3000N_File::onResponsivityMatrix(uint8_t device_id, HySpexConnect::cSpatialMajorData<float> re)
+{
+    if (mCalibration.enabled())
+        mCalibration.setResponsivity(re, mSpatialSize, mSpectralSize);
+}
+
 void cHySpexVNIR3000N_File::onQuantumEfficiencyData(uint8_t device_id, HySpexConnect::cSpectralData<float> qe) {}
 void cHySpexVNIR3000N_File::onLensName(uint8_t device_id, std::string name) {}
 void cHySpexVNIR3000N_File::onLensWorkingDistance_cm(uint8_t device_id, double workingDistance_cm) {}
-void cHySpexVNIR3000N_File::onLensFieldOfView_rad(uint8_t device_id, double fieldOfView_rad) {}
-void cHySpexVNIR3000N_File::onLensFieldOfView_deg(uint8_t device_id, double fieldOfView_deg) {}
+void cHySpexVNIR3000N_File::onLensFieldOfView_rad(uint8_t device_id, double fieldOfView_rad)
+{
+    mFieldOfView_rad = fieldOfView_rad;
+    mPlotExtractor.setFieldOfView_rad(fieldOfView_rad);
+}
+
+void cHySpexVNIR3000N_File::onLensFieldOfView_deg(uint8_t device_id, double fieldOfView_deg)
+{
+    onLensFieldOfView_rad(device_id, fieldOfView_deg * std::numbers::pi / 180.0);
+}
+
 
 void cHySpexVNIR3000N_File::onAverageFrames(uint8_t device_id, uint16_t averageFrames) {}
-void cHySpexVNIR3000N_File::onFramePeriod_us(uint8_t device_id, uint32_t framePeriod_us) {}
-void cHySpexVNIR3000N_File::onIntegrationTime_us(uint8_t device_id, uint32_t integrationTime_us) {}
+void cHySpexVNIR3000N_File::onFramePeriod_us(uint8_t device_id, uint32_t framePeriod_us)
+{
+    mFramePeriod_us = framePeriod_us;
+    mRegistration.setLinePeriod_us(framePeriod_us);
+}
+
+void cHySpexVNIR3000N_File::onIntegrationTime_us(uint8_t device_id, uint32_t integrationTime_us)
+{
+    mIntegrationTime_us = integrationTime_us;
+    mCalibration.setIntegrationTime_us(integrationTime_us);
+}
 
 void cHySpexVNIR3000N_File::onBadPixels(uint8_t device_id, HySpexConnect::cBadPixelData bad_pixels) {}
 void cHySpexVNIR3000N_File::onBadPixelCorrection(uint8_t device_id, HySpexConnect::cBadPixelCorrectionData corrections) {}
@@ -153,11 +401,16 @@ void cHySpexVNIR3000N_File::onAmbientTemperature_C(uint8_t device_id, float temp
 void cHySpexVNIR3000N_File::onSpectralCalibration(uint8_t device_id, HySpexConnect::cSpectralData<float> wavelengths_nm)
 {
     mSpectralCalibration = wavelengths_nm;
+    mStatistics.setWavelengths(mSpectralCalibration);
 }
 
 void cHySpexVNIR3000N_File::onBackgroundMatrixAge_ms(uint8_t device_id, int64_t age_ms) {}
 void cHySpexVNIR3000N_File::onNumOfBackgrounds(uint8_t device_id, uint32_t numOfBackgrounds) {}
-void cHySpexVNIR3000N_File::onBackgroundMatrix(uint8_t device_id, HySpexConnect::cSpatialMajorData<float> background) {}
+void cHySpexVNIR3000N_File::onBackgroundMatrix(uint8_t device_id, HySpexConnect::cSpatialMajorData<float> background)
+{
+    if (mCalibration.enabled())
+        mCalibration.setBackground(background, mSpatialSize, mSpectralSize);
+}
 
 void cHySpexVNIR3000N_File::onSensorTemperature_C(uint8_t device_id, float temp_C) {}
 
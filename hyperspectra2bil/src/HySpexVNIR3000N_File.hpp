@@ -5,22 +5,65 @@
 
 #include <cbdf/SpidercamParser.hpp>
 
+#include "FrameDecimator.hpp"
+#include "RadiometricCalibration.hpp"
+#include "BandStatistics.hpp"
+#include "LineRegistration.hpp"
+#include "PlotExtractor.hpp"
+
 #include <opencv2/core.hpp>
 
 #include <filesystem>
 #include <string>
 #include <fstream>
+#include <memory>
+#include <vector>
 
 
 
 class cHySpexVNIR3000N_File : public cHySpexVNIR_3000N_Parser
 {
+	friend class cHySpexVNIR3000N_FanOut;
+
 public:
 	cHySpexVNIR3000N_File();
 	virtual ~cHySpexVNIR3000N_File();
 
     void setOutputPath(std::filesystem::path out);
 
+	/**
+	 * Export a quick-look cube that keeps (SKIP) or averages (AVERAGE)
+	 * every spatialFactor pixels and spectralFactor bands.
+	 */
+	void setDecimation(std::size_t spatialFactor, std::size_t spectralFactor, eDecimation mode);
+
+	/**
+	 * Export radiance, or reflectance once a white reference has been
+	 * recorded, instead of the raw sensor values.  The UINT16 format
+	 * stores reflectance multiplied by scale.
+	 */
+	void setCalibration(eCalibratedFormat format, float scale = cRadiometricCalibration::DEFAULT_SCALE);
+
+	/**
+	 * Write the band statistics and spectral indices of each recording
+	 * next to its header.
+	 */
+	void setStatistics(bool enable);
+
+	/**
+	 * Resample the lines of each recording to one line every spacing_mm
+	 * along the dolly track and write the position of each line next to
+	 * its header.
+	 */
+	void setRegistration(double spacing_mm);
+
+	/**
+	 * Cut the registered lines into one cube per plot and summarize the
+	 * spectra of each plot.  The plots are given with setPlots().
+	 */
+	void setPlotExtraction(bool enable);
+	void setPlots(std::shared_ptr<const std::vector<sPlotRegion>> plots, double groundLevel_mm);
+
 	// Spidercam Parser Data
 	void onPosition(double x_mm, double y_mm, double z_mm, double speed_mmps);
 
@@ -29,6 +72,9 @@ public:
 	void onEndRecordingTimestamp(uint64_t timestamp_ns);
 
 private:
+	void onImage(uint8_t device_id, HySpexConnect::cImageData<uint16_t> image) override;
+	void onImage(uint8_t device_id, HySpexConnect::cImageData<uint16_t> image, uint8_t spatialSkip, uint8_t spectralSkip) override;
+
 	void onBeginReference(uint8_t device_id) override;
 	void onEndOfReference(uint8_t device_id) override;
 
@@ -68,11 +114,59 @@ private:
 
 protected:
 	virtual std::filesystem::path createHeaderFilename(char plotID);
+	std::filesystem::path createSidecarBasename(char plotID);
+
+	/**
+	 * The size and wavelengths of the exported lines, after decimation.
+	 */
+	std::size_t samples() const;
+	std::size_t bands() const;
+	std::vector<float> wavelengths() const;
+
+	/**
+	 * The sample type of the exported cube.
+	 */
+	int bitsPerSample() const;
+	int enviDataType() const;
+
+	/**
+	 * Returns true if the frame was taken as part of a white reference,
+	 * in which case it is not exported.
+	 */
+	bool collectReference(const HySpexConnect::cImageData<uint16_t>& image);
+
+	/**
+	 * Add a frame to the statistics of the recording, if they are enabled.
+	 */
+	void accumulateStatistics(const HySpexConnect::cImageData<uint16_t>& image);
+
+	/**
+	 * Pass a frame to the line registration.  The registered lines are
+	 * written with writeFrame().
+	 */
+	void registerFrame(const HySpexConnect::cImageData<uint16_t>& image);
 
 protected:
+	/**
+	 * Export a frame.  The frame holds the pixels and bands that were
+	 * recorded, and may be shared with the other outputs of a fan-out.
+	 */
+	virtual void writeImage(uint8_t device_id, const HySpexConnect::cImageData<uint16_t>& image) = 0;
+
 	virtual std::filesystem::path createDataFilename(char plotID) = 0;
 	virtual void writeHeader(std::filesystem::path filename) = 0;
 
+	/**
+	 * Write a frame that holds spectralSize bands of spatialSize samples,
+	 * one band after another.
+	 */
+	virtual void writeFrame(const uint16_t* frame, std::size_t spatialSize, std::size_t spectralSize) = 0;
+
+	/**
+	 * Called at the end of a recording, before the header is written.
+	 */
+	virtual void closeDataFile();
+
 private:
 	void openDataFile();
 
@@ -80,6 +174,12 @@ protected:
     std::filesystem::path mOutputPath;
 	std::ofstream mOutputFile;
 
+	cFrameDecimator mDecimator;
+	cRadiometricCalibration mCalibration;
+	cBandStatistics mStatistics;
+	cLineRegistration mRegistration;
+	cPlotExtractor mPlotExtractor;
+
 	std::filesystem::path mDataFilename;
 	std::filesystem::path mHeaderFilename;
 
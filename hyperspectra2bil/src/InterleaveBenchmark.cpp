@@ -0,0 +1,142 @@
+/**
+ * Measures how fast HySpex frames can be written in BIL and BIP order,
+ * raw and radiometrically calibrated.
+ *
+ * Usage: hyperspectra2bil_benchmark [number of frames]
+ */
+
+#include "BandInterleaver.hpp"
+#include "RadiometricCalibration.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+	struct sSensor_t
+	{
+		std::string name;
+		std::size_t spatialSize;
+		std::size_t spectralSize;
+	};
+
+	/// Calibration data stored one band after another
+	struct sMatrix_t
+	{
+		std::vector<float> values;
+		std::size_t spatialSize;
+
+		const float* band(std::size_t b) const { return values.data() + b * spatialSize; }
+	};
+
+	template<class WRITER>
+	void measure(const std::string& label, const std::filesystem::path& filename,
+		const std::vector<uint16_t>& frame, int num_frames, WRITER writer)
+	{
+		std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+
+		auto start = std::chrono::steady_clock::now();
+
+		for (int i = 0; i < num_frames; ++i)
+			writer(out, frame);
+
+		out.close();
+
+		auto end = std::chrono::steady_clock::now();
+
+		std::chrono::duration<double> elapsed = end - start;
+
+		double mb = static_cast<double>(frame.size() * sizeof(uint16_t)) * num_frames / (1024.0 * 1024.0);
+
+		std::cout << std::setw(12) << label << ": " << std::fixed << std::setprecision(1)
+			<< mb / elapsed.count() << " MB/s" << std::endl;
+	}
+}
+
+
+int main(int argc, char** argv)
+{
+	int num_frames = 500;
+
+	if (argc > 1)
+		num_frames = std::max(std::stoi(argv[1]), 1);
+
+	const std::vector<sSensor_t> sensors = { {"VNIR 3000N", 1920, 186}, {"SWIR 384", 384, 288} };
+
+	auto filename = std::filesystem::temp_directory_path() / "hyperspectra2bil_benchmark.dat";
+
+	for (const auto& sensor : sensors)
+	{
+		const auto n = sensor.spatialSize;
+		const auto m = sensor.spectralSize;
+
+		// A synthetic frame with its bands one after another
+		std::vector<uint16_t> frame(n * m);
+		for (std::size_t i = 0; i < frame.size(); ++i)
+			frame[i] = static_cast<uint16_t>(i * 2654435761u >> 16);
+
+		std::cout << sensor.name << " (" << n << " x " << m << "), " << num_frames << " frames" << std::endl;
+
+		measure("per sample", filename, frame, num_frames,
+			[n, m](std::ostream& out, const std::vector<uint16_t>& frame)
+			{
+				for (std::size_t band = 0; band < m; ++band)
+				{
+					for (std::size_t i = 0; i < n; ++i)
+					{
+						auto pixel = frame[band * n + i];
+						out.write(reinterpret_cast<char*>(&pixel), sizeof pixel);
+					}
+				}
+			});
+
+		cBandInterleaver interleaver;
+
+		measure("BIL", filename, frame, num_frames,
+			[&interleaver, n, m](std::ostream& out, const std::vector<uint16_t>& frame)
+			{
+				interleaver.writeBIL(out, frame.data(), n, m);
+			});
+
+		measure("BIP", filename, frame, num_frames,
+			[&interleaver, n, m](std::ostream& out, const std::vector<uint16_t>& frame)
+			{
+				interleaver.writeBIP(out, frame.data(), n, m);
+			});
+
+		cRadiometricCalibration calibration;
+		calibration.setBackground(sMatrix_t{ std::vector<float>(n * m, 100.0f), n }, n, m);
+		calibration.setResponsivity(sMatrix_t{ std::vector<float>(n * m, 0.25f), n }, n, m);
+		calibration.setIntegrationTime_us(5000);
+
+		calibration.enable(eCalibratedFormat::FLOAT32);
+
+		measure("BIL float32", filename, frame, num_frames,
+			[&interleaver, &calibration, n, m](std::ostream& out, const std::vector<uint16_t>& frame)
+			{
+				interleaver.writeBIL(out, calibration.calibrate(frame.data(), n, m), n, m);
+			});
+
+		calibration.enable(eCalibratedFormat::UINT16);
+
+		measure("BIL uint16", filename, frame, num_frames,
+			[&interleaver, &calibration, n, m](std::ostream& out, const std::vector<uint16_t>& frame)
+			{
+				interleaver.writeBIL(out, calibration.calibrateScaled(frame.data(), n, m), n, m);
+			});
+
+		std::cout << std::endl;
+	}
+
+	std::filesystem::remove(filename);
+
+	return 0;
+}
@@ -0,0 +1,302 @@
+#include "LineRegistration.hpp"
+
+#include "KinematicUtils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <numbers>
+#include <stdexcept>
+#include <utility>
+
+
+void cLineRegistration::enable(double spacing_mm)
+{
+	mSpacing_mm = (spacing_mm > 0.0) ? spacing_mm : 0.0;
+}
+
+void cLineRegistration::setLinePeriod_us(double period_us)
+{
+	// Without a frame period the lines are still in order, one unit apart
+	mLinePeriod_us = (period_us > 0.0) ? period_us : 1.0;
+}
+
+void cLineRegistration::setWriter(Writer writer)
+{
+	mWriter = std::move(writer);
+}
+
+void cLineRegistration::clear()
+{
+	mClock_us = 0.0;
+
+	mHasPosition = false;
+	mLastPositionTime_us = 0.0;
+
+	mHasVelocity = false;
+	mVx_mmps = 0.0;
+	mVy_mmps = 0.0;
+	mVz_mmps = 0.0;
+	mHeading_rad = 0.0;
+
+	while (!mPending.empty())
+	{
+		recycle(mPending.front());
+		mPending.pop_front();
+	}
+
+	mHasPrevious = false;
+	mPreviousDistance_mm = 0.0;
+
+	mPositions.clear();
+}
+
+void cLineRegistration::addPosition(double x_mm, double y_mm, double z_mm)
+{
+	nSpiderCamTypes::sPosition_t position;
+	position.X_mm = static_cast<decltype(position.X_mm)>(x_mm);
+	position.Y_mm = static_cast<decltype(position.Y_mm)>(y_mm);
+	position.Z_mm = static_cast<decltype(position.Z_mm)>(z_mm);
+
+	// The kinematics use timestamps in units of 0.1 us
+	position.timestamp = static_cast<decltype(position.timestamp)>(std::llround(mClock_us * 10.0));
+
+	if (!mHasPosition)
+	{
+		// The lines before the first position cannot be located
+		while (!mPending.empty())
+		{
+			recycle(mPending.front());
+			mPending.pop_front();
+		}
+
+		mHasPosition = true;
+		mLastPosition = position;
+		mLastPositionTime_us = mClock_us;
+		return;
+	}
+
+	// No lines were recorded since the last position, keep the newest one
+	if (mClock_us <= mLastPositionTime_us)
+	{
+		mLastPosition = position;
+		return;
+	}
+
+	std::deque<nSpiderCamTypes::sPosition_t> segment = { mLastPosition, position };
+
+	auto dolly = computeDollyKinematics(segment, 0, 1);
+
+	if (dolly.size() == 2)
+	{
+		mHasVelocity = true;
+		mVx_mmps = dolly.front().vx_mmps;
+		mVy_mmps = dolly.front().vy_mmps;
+		mVz_mmps = dolly.front().vz_mmps;
+
+		// Keep the last heading while the dolly is stopped
+		if ((mVx_mmps != 0.0) || (mVy_mmps != 0.0))
+			mHeading_rad = std::atan2(mVy_mmps, mVx_mmps);
+	}
+
+	const auto& start = dolly.front();
+
+	while (!mPending.empty())
+	{
+		auto& line = mPending.front();
+
+		double dt_sec = (line.time_us - mLastPositionTime_us) * 1.0e-6;
+
+		sLinePosition where;
+		where.x_mm = start.x_mm + mVx_mmps * dt_sec;
+		where.y_mm = start.y_mm + mVy_mmps * dt_sec;
+		where.z_mm = start.z_mm + mVz_mmps * dt_sec;
+
+		locate(line, where);
+		recycle(line);
+		mPending.pop_front();
+	}
+
+	mLastPosition = position;
+	mLastPositionTime_us = mClock_us;
+}
+
+void cLineRegistration::addFrame(const uint16_t* frame, std::size_t spatialSize, std::size_t spectralSize)
+{
+	if (mHasPrevious && ((spatialSize != mSpatialSize) || (spectralSize != mSpectralSize)))
+	{
+		throw std::runtime_error("The frame size changed during a registered recording.");
+	}
+
+	mSpatialSize = spatialSize;
+	mSpectralSize = spectralSize;
+
+	const std::size_t n = spatialSize * spectralSize;
+
+	sPendingLine line;
+	line.time_us = mClock_us;
+
+	if (!mFreeFrames.empty())
+	{
+		line.frame = std::move(mFreeFrames.back());
+		mFreeFrames.pop_back();
+	}
+
+	line.frame.assign(frame, frame + n);
+
+	mPending.push_back(std::move(line));
+
+	mClock_us += mLinePeriod_us;
+}
+
+void cLineRegistration::flush()
+{
+	if (mHasPosition && mHasVelocity)
+	{
+		while (!mPending.empty())
+		{
+			auto& line = mPending.front();
+
+			double dt_sec = (line.time_us - mLastPositionTime_us) * 1.0e-6;
+
+			sLinePosition where;
+			where.x_mm = mLastPosition.X_mm + mVx_mmps * dt_sec;
+			where.y_mm = mLastPosition.Y_mm + mVy_mmps * dt_sec;
+			where.z_mm = mLastPosition.Z_mm + mVz_mmps * dt_sec;
+
+			locate(line, where);
+			recycle(line);
+			mPending.pop_front();
+		}
+	}
+
+	while (!mPending.empty())
+	{
+		recycle(mPending.front());
+		mPending.pop_front();
+	}
+}
+
+void cLineRegistration::locate(sPendingLine& line, const sLinePosition& position)
+{
+	if (!mHasPrevious)
+	{
+		emit(line.frame.data(), position);
+
+		mPrevious.swap(line.frame);
+		mPreviousPosition = position;
+		mPreviousDistance_mm = 0.0;
+		mHasPrevious = true;
+		return;
+	}
+
+	double dx = position.x_mm - mPreviousPosition.x_mm;
+	double dy = position.y_mm - mPreviousPosition.y_mm;
+	double dz = position.z_mm - mPreviousPosition.z_mm;
+
+	double step_mm = std::sqrt(dx * dx + dy * dy);
+
+	// The dolly has not moved along the track since the last line
+	if (step_mm < 1.0e-6)
+		return;
+
+	const double distance_mm = mPreviousDistance_mm + step_mm;
+
+	if (mBlended.size() != line.frame.size())
+		mBlended.resize(line.frame.size());
+
+	// Row k of the registered cube is k x spacing along the track
+	double next_mm = mPositions.size() * mSpacing_mm;
+
+	while (next_mm <= distance_mm)
+	{
+		double weight = (next_mm - mPreviousDistance_mm) / step_mm;
+
+		nRegistration::blend(mPrevious.data(), line.frame.data(), mBlended.size(), weight, mBlended.data());
+
+		sLinePosition where;
+		where.x_mm = mPreviousPosition.x_mm + weight * dx;
+		where.y_mm = mPreviousPosition.y_mm + weight * dy;
+		where.z_mm = mPreviousPosition.z_mm + weight * dz;
+
+		emit(mBlended.data(), where);
+
+		next_mm = mPositions.size() * mSpacing_mm;
+	}
+
+	mPrevious.swap(line.frame);
+	mPreviousPosition = position;
+	mPreviousDistance_mm = distance_mm;
+}
+
+void cLineRegistration::emit(const uint16_t* frame, const sLinePosition& position)
+{
+	mPositions.push_back(position);
+	mPositions.back().heading_rad = mHeading_rad;
+
+	if (mWriter)
+		mWriter(frame, mSpatialSize, mSpectralSize);
+}
+
+void cLineRegistration::recycle(sPendingLine& line)
+{
+	if (line.frame.capacity() > 0)
+		mFreeFrames.push_back(std::move(line.frame));
+}
+
+void cLineRegistration::write(const std::filesystem::path& base) const
+{
+	auto filename = base;
+	filename += ".lines.csv";
+
+	std::ofstream out(filename);
+
+	if (!out.is_open())
+	{
+		std::string msg = "Could not open: ";
+		msg += filename.string();
+		throw std::runtime_error(msg);
+	}
+
+	out << "line,x_mm,y_mm,z_mm,heading_deg\n";
+	out << std::fixed << std::setprecision(1);
+
+	constexpr double RAD_TO_DEG = 180.0 / std::numbers::pi;
+
+	for (std::size_t i = 0; i < mPositions.size(); ++i)
+	{
+		const auto& p = mPositions[i];
+		out << i << "," << p.x_mm << "," << p.y_mm << "," << p.z_mm << "," << p.heading_rad * RAD_TO_DEG << "\n";
+	}
+}
+
+std::vector<std::string> cLineRegistration::suffixes() const
+{
+	return { ".lines.csv" };
+}
+
+
+void nRegistration::blend(const uint16_t* a, const uint16_t* b, std::size_t count, double weight, uint16_t* out)
+{
+	if (weight <= 0.0)
+	{
+		std::copy(a, a + count, out);
+		return;
+	}
+
+	if (weight >= 1.0)
+	{
+		std::copy(b, b + count, out);
+		return;
+	}
+
+	// An 8-bit weight keeps the products in 32 bits
+	const uint32_t wb = static_cast<uint32_t>(std::lround(weight * 256.0));
+	const uint32_t wa = 256 - wb;
+
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		out[i] = static_cast<uint16_t>((a[i] * wa + b[i] * wb + 128) >> 8);
+	}
+}
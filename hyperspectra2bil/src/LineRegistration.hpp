@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cbdf/SpiderCamInfoTypes.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+
+/**
+ * The location of a registered line in the RAPP south/east/up frame and
+ * the direction of travel, measured from the x (south) axis toward the
+ * y (east) axis.
+ */
+struct sLinePosition
+{
+	double x_mm = 0.0;
+	double y_mm = 0.0;
+	double z_mm = 0.0;
+	double heading_rad = 0.0;
+};
+
+
+/**
+ * Places the lines of a push-broom recording on the ground track of the
+ * dolly and resamples them to a fixed along-track spacing.
+ *
+ * Each line is timed by the line clock (line number x frame period) and
+ * each spidercam position is stamped with the clock of the line that
+ * follows it.  The dolly velocity between two positions comes from
+ * computeDollyKinematics(), so the lines between them are located as soon
+ * as the second position arrives and at most the frames of one position
+ * interval are kept in memory.
+ *
+ * A registered line is blended from the two recorded lines on either side
+ * of its ground position.  Lines recorded while the dolly is stopped do
+ * not add rows.  Lines before the first position are dropped and the lines
+ * after the last one are extrapolated when the recording is flushed.
+ */
+class cLineRegistration
+{
+public:
+	typedef std::function<void(const uint16_t* frame, std::size_t spatialSize, std::size_t spectralSize)> Writer;
+
+	void enable(double spacing_mm);
+	bool enabled() const { return mSpacing_mm > 0.0; }
+
+	double spacing_mm() const { return mSpacing_mm; }
+
+	void setLinePeriod_us(double period_us);
+
+	/**
+	 * Called with each registered line, in order.
+	 */
+	void setWriter(Writer writer);
+
+	/**
+	 * Start a new recording.
+	 */
+	void clear();
+
+	void addPosition(double x_mm, double y_mm, double z_mm);
+
+	template<class IMAGE>
+	void addFrame(const IMAGE& image)
+	{
+		const auto& data = image.image();
+
+		mFrame.clear();
+
+		for (std::size_t band = 0; band < image.spectralSize(); ++band)
+		{
+			const auto& samples = data.band(band);
+			mFrame.insert(mFrame.end(), samples.begin(), samples.end());
+		}
+
+		addFrame(mFrame.data(), image.spatialSize(), image.spectralSize());
+	}
+
+	/**
+	 * Add a frame that holds spectralSize bands of spatialSize samples,
+	 * one band after another.
+	 */
+	void addFrame(const uint16_t* frame, std::size_t spatialSize, std::size_t spectralSize);
+
+	/**
+	 * Register the lines recorded after the last position.
+	 */
+	void flush();
+
+	/**
+	 * The ground position of each registered line.
+	 */
+	const std::vector<sLinePosition>& positions() const { return mPositions; }
+
+	/**
+	 * Write the position of each registered line to <base>.lines.csv.
+	 */
+	void write(const std::filesystem::path& base) const;
+
+	/**
+	 * The suffixes of the files written for the base name.
+	 */
+	std::vector<std::string> suffixes() const;
+
+private:
+	struct sPendingLine
+	{
+		double time_us = 0.0;
+		std::vector<uint16_t> frame;
+	};
+
+	void locate(sPendingLine& line, const sLinePosition& position);
+	void emit(const uint16_t* frame, const sLinePosition& position);
+	void recycle(sPendingLine& line);
+
+private:
+	double mSpacing_mm = 0.0;
+	double mLinePeriod_us = 1.0;
+
+	Writer mWriter;
+
+	std::size_t mSpatialSize = 0;
+	std::size_t mSpectralSize = 0;
+
+	/// The line clock of the next frame
+	double mClock_us = 0.0;
+
+	bool mHasPosition = false;
+	nSpiderCamTypes::sPosition_t mLastPosition;
+	double mLastPositionTime_us = 0.0;
+
+	bool mHasVelocity = false;
+	double mVx_mmps = 0.0;
+	double mVy_mmps = 0.0;
+	double mVz_mmps = 0.0;
+	double mHeading_rad = 0.0;
+
+	/// The lines recorded since the last position
+	std::deque<sPendingLine> mPending;
+	std::vector<std::vector<uint16_t>> mFreeFrames;
+
+	/// The last located line
+	bool mHasPrevious = false;
+	std::vector<uint16_t> mPrevious;
+	sLinePosition mPreviousPosition;
+	double mPreviousDistance_mm = 0.0;
+
+	std::vector<uint16_t> mBlended;
+	std::vector<sLinePosition> mPositions;
+
+	std::vector<uint16_t> mFrame;
+};
+
+
+namespace nRegistration
+{
+	/**
+	 * out = (1 - weight) * a + weight * b, rounded to the nearest integer.
+	 */
+	void blend(const uint16_t* a, const uint16_t* b, std::size_t count, double weight, uint16_t* out);
+}
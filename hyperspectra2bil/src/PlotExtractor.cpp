@@ -0,0 +1,566 @@
+#include "PlotExtractor.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+
+namespace
+{
+	/// The smallest grid cell, so that tiny plots do not create a huge grid
+	constexpr double MIN_CELL_SIZE_MM = 100.0;
+
+	/// The memory for the samples of the bands summarized in one pass
+	constexpr std::size_t SUMMARY_BUFFER_SIZE = 64 * 1024 * 1024;
+
+	std::size_t to_cell(double value, double origin, double size, std::size_t count)
+	{
+		double cell = std::floor((value - origin) / size);
+
+		if (cell < 0.0)
+			return 0;
+
+		return std::min(static_cast<std::size_t>(cell), count - 1);
+	}
+}
+
+
+void cPlotExtractor::setPlots(std::shared_ptr<const std::vector<sPlotRegion>> plots, double groundLevel_mm)
+{
+	for (auto& state : mStates)
+		state.scratch.reset();
+
+	mPlots = std::move(plots);
+	mGroundLevel_mm = groundLevel_mm;
+
+	mOpen.clear();
+	mStates.clear();
+
+	if (mPlots)
+		mStates.resize(mPlots->size());
+
+	buildGrid();
+}
+
+void cPlotExtractor::setFieldOfView_rad(double fieldOfView_rad)
+{
+	mFieldOfView_rad = fieldOfView_rad;
+	mOffsets.clear();
+}
+
+void cPlotExtractor::begin(const std::filesystem::path& base)
+{
+	mBasename = base;
+
+	mDirectory = base;
+	mDirectory += ".plots";
+
+	mNumLines = 0;
+	mOpen.clear();
+
+	for (auto& state : mStates)
+		state = sPlotState();
+}
+
+void cPlotExtractor::buildGrid()
+{
+	mCells.clear();
+	mBoxes.clear();
+	mNumCellsX = 0;
+	mNumCellsY = 0;
+
+	if (!mPlots || mPlots->empty())
+		return;
+
+	double minX = std::numeric_limits<double>::max();
+	double minY = std::numeric_limits<double>::max();
+	double maxX = std::numeric_limits<double>::lowest();
+	double maxY = std::numeric_limits<double>::lowest();
+
+	double extent_mm = 0.0;
+
+	for (const auto& plot : *mPlots)
+	{
+		const rfm::rappPoint2D_t corners[] =
+		{
+			plot.bounds.getNorthEastCorner(), plot.bounds.getNorthWestCorner(),
+			plot.bounds.getSouthEastCorner(), plot.bounds.getSouthWestCorner()
+		};
+
+		sBox box;
+		box.minX_mm = box.maxX_mm = corners[0].x_mm;
+		box.minY_mm = box.maxY_mm = corners[0].y_mm;
+
+		for (const auto& corner : corners)
+		{
+			box.minX_mm = std::min(box.minX_mm, static_cast<double>(corner.x_mm));
+			box.minY_mm = std::min(box.minY_mm, static_cast<double>(corner.y_mm));
+			box.maxX_mm = std::max(box.maxX_mm, static_cast<double>(corner.x_mm));
+			box.maxY_mm = std::max(box.maxY_mm, static_cast<double>(corner.y_mm));
+		}
+
+		minX = std::min(minX, box.minX_mm);
+		minY = std::min(minY, box.minY_mm);
+		maxX = std::max(maxX, box.maxX_mm);
+		maxY = std::max(maxY, box.maxY_mm);
+
+		extent_mm += std::max(box.maxX_mm - box.minX_mm, box.maxY_mm - box.minY_mm);
+
+		mBoxes.push_back(box);
+	}
+
+	// A cell about the size of a plot keeps the lists of each cell short
+	mCellSize_mm = std::max(extent_mm / mBoxes.size(), MIN_CELL_SIZE_MM);
+
+	mMinX_mm = minX;
+	mMinY_mm = minY;
+	mNumCellsX = static_cast<std::size_t>((maxX - minX) / mCellSize_mm) + 1;
+	mNumCellsY = static_cast<std::size_t>((maxY - minY) / mCellSize_mm) + 1;
+
+	mCells.resize(mNumCellsX * mNumCellsY);
+
+	for (std::size_t i = 0; i < mBoxes.size(); ++i)
+	{
+		const auto& box = mBoxes[i];
+
+		auto x0 = to_cell(box.minX_mm, mMinX_mm, mCellSize_mm, mNumCellsX);
+		auto x1 = to_cell(box.maxX_mm, mMinX_mm, mCellSize_mm, mNumCellsX);
+		auto y0 = to_cell(box.minY_mm, mMinY_mm, mCellSize_mm, mNumCellsY);
+		auto y1 = to_cell(box.maxY_mm, mMinY_mm, mCellSize_mm, mNumCellsY);
+
+		for (auto x = x0; x <= x1; ++x)
+		{
+			for (auto y = y0; y <= y1; ++y)
+				mCells[x * mNumCellsY + y].push_back(static_cast<uint32_t>(i));
+		}
+	}
+}
+
+void cPlotExtractor::updateOffsets(std::size_t spatialSize)
+{
+	if (mOffsets.size() == spatialSize)
+		return;
+
+	mOffsets.resize(spatialSize);
+
+	for (std::size_t i = 0; i < spatialSize; ++i)
+	{
+		double angle = ((i + 0.5) / spatialSize - 0.5) * mFieldOfView_rad;
+		mOffsets[i] = std::tan(angle);
+	}
+}
+
+void cPlotExtractor::addLine(const uint16_t* frame, std::size_t spatialSize, std::size_t spectralSize, const sLinePosition& position)
+{
+	if (!mEnabled || mCells.empty() || (spatialSize == 0))
+		return;
+
+	++mNumLines;
+	mSpectralSize = spectralSize;
+
+	updateOffsets(spatialSize);
+
+	const double height_mm = std::max(position.z_mm - mGroundLevel_mm, 0.0);
+
+	// The line lies across the direction of travel
+	const double cx = -std::sin(position.heading_rad);
+	const double cy = std::cos(position.heading_rad);
+
+	const double t0 = height_mm * mOffsets.front();
+	const double t1 = height_mm * mOffsets.back();
+
+	const double x0 = position.x_mm + cx * t0;
+	const double y0 = position.y_mm + cy * t0;
+	const double x1 = position.x_mm + cx * t1;
+	const double y1 = position.y_mm + cy * t1;
+
+	mCandidates.clear();
+
+	const double gridMaxX = mMinX_mm + mNumCellsX * mCellSize_mm;
+	const double gridMaxY = mMinY_mm + mNumCellsY * mCellSize_mm;
+
+	if ((std::max(x0, x1) >= mMinX_mm) && (std::min(x0, x1) <= gridMaxX)
+		&& (std::max(y0, y1) >= mMinY_mm) && (std::min(y0, y1) <= gridMaxY))
+	{
+		auto cx0 = to_cell(std::min(x0, x1), mMinX_mm, mCellSize_mm, mNumCellsX);
+		auto cx1 = to_cell(std::max(x0, x1), mMinX_mm, mCellSize_mm, mNumCellsX);
+		auto cy0 = to_cell(std::min(y0, y1), mMinY_mm, mCellSize_mm, mNumCellsY);
+		auto cy1 = to_cell(std::max(y0, y1), mMinY_mm, mCellSize_mm, mNumCellsY);
+
+		for (auto x = cx0; x <= cx1; ++x)
+		{
+			for (auto y = cy0; y <= cy1; ++y)
+			{
+				const auto& cell = mCells[x * mNumCellsY + y];
+				mCandidates.insert(mCandidates.end(), cell.begin(), cell.end());
+			}
+		}
+
+		std::sort(mCandidates.begin(), mCandidates.end());
+		mCandidates.erase(std::unique(mCandidates.begin(), mCandidates.end()), mCandidates.end());
+	}
+
+	for (auto plot : mCandidates)
+	{
+		const auto& box = mBoxes[plot];
+
+		// The part of the footprint, px + c * t, inside of the bounding box
+		double tmin = std::numeric_limits<double>::lowest();
+		double tmax = std::numeric_limits<double>::max();
+
+		const double p[2] = { position.x_mm, position.y_mm };
+		const double c[2] = { cx, cy };
+		const double lo[2] = { box.minX_mm, box.minY_mm };
+		const double hi[2] = { box.maxX_mm, box.maxY_mm };
+
+		for (int axis = 0; axis < 2; ++axis)
+		{
+			if (std::abs(c[axis]) < 1.0e-12)
+			{
+				if ((p[axis] < lo[axis]) || (p[axis] > hi[axis]))
+					tmin = std::numeric_limits<double>::max();
+
+				continue;
+			}
+
+			double a = (lo[axis] - p[axis]) / c[axis];
+			double b = (hi[axis] - p[axis]) / c[axis];
+
+			tmin = std::max(tmin, std::min(a, b));
+			tmax = std::min(tmax, std::max(a, b));
+		}
+
+		if (tmin > tmax)
+			continue;
+
+		std::size_t first = 0;
+		std::size_t last = spatialSize - 1;
+
+		if (height_mm > 0.0)
+		{
+			first = std::lower_bound(mOffsets.begin(), mOffsets.end(), tmin / height_mm) - mOffsets.begin();
+			auto end = std::upper_bound(mOffsets.begin(), mOffsets.end(), tmax / height_mm) - mOffsets.begin();
+
+			if (end == 0)
+				continue;
+
+			last = end - 1;
+		}
+		else if ((tmin > 0.0) || (tmax < 0.0))
+			continue;
+
+		const auto& bounds = (*mPlots)[plot].bounds;
+
+		auto inside = [&](std::size_t i)
+			{
+				double t = height_mm * mOffsets[i];
+				auto x = static_cast<std::int32_t>(std::lround(position.x_mm + cx * t));
+				auto y = static_cast<std::int32_t>(std::lround(position.y_mm + cy * t));
+				return bounds.contains(x, y);
+			};
+
+		while ((first <= last) && !inside(first))
+			++first;
+
+		while ((last > first) && !inside(last))
+			--last;
+
+		if ((first > last) || !inside(first))
+			continue;
+
+		appendLine(plot, frame, spatialSize, spectralSize, first, last);
+	}
+
+	// Close the scratch files of the plots that the line has left
+	auto it = std::remove_if(mOpen.begin(), mOpen.end(), [this](std::size_t plot)
+		{
+			auto& state = mStates[plot];
+
+			if (state.stamp == mNumLines)
+				return false;
+
+			state.scratch.reset();
+			return true;
+		});
+
+	mOpen.erase(it, mOpen.end());
+}
+
+void cPlotExtractor::appendLine(std::size_t plot, const uint16_t* frame, std::size_t spatialSize, std::size_t spectralSize,
+	std::size_t first, std::size_t last)
+{
+	auto& state = mStates[plot];
+
+	if (!state.scratch)
+	{
+		std::filesystem::create_directories(mDirectory);
+
+		auto filename = scratchFilename(plot);
+
+		// A plot that left the lines and came back is appended to, anything
+		// else in the file is left from an earlier run
+		auto mode = std::ios_base::binary | ((state.lines > 0) ? std::ios_base::app : std::ios_base::trunc);
+
+		state.scratch = std::make_unique<std::ofstream>(filename, mode);
+
+		if (!state.scratch->is_open())
+		{
+			std::string msg = "Could not open: ";
+			msg += filename.string();
+			throw std::runtime_error(msg);
+		}
+
+		mOpen.push_back(plot);
+	}
+
+	const uint32_t header[2] = { static_cast<uint32_t>(first), static_cast<uint32_t>(last - first + 1) };
+	state.scratch->write(reinterpret_cast<const char*>(header), sizeof(header));
+
+	for (std::size_t band = 0; band < spectralSize; ++band)
+	{
+		const uint16_t* samples = frame + band * spatialSize + first;
+		state.scratch->write(reinterpret_cast<const char*>(samples), header[1] * sizeof(uint16_t));
+	}
+
+	++state.lines;
+	state.pixels += header[1];
+	state.firstSample = std::min(state.firstSample, first);
+	state.lastSample = std::max(state.lastSample, last);
+	state.stamp = mNumLines;
+}
+
+std::filesystem::path cPlotExtractor::scratchFilename(std::size_t plot) const
+{
+	return mDirectory / ("plot_" + std::to_string((*mPlots)[plot].number) + ".tmp");
+}
+
+std::filesystem::path cPlotExtractor::cubeFilename(std::size_t plot) const
+{
+	return mDirectory / ("plot_" + std::to_string((*mPlots)[plot].number) + ".bil");
+}
+
+void cPlotExtractor::write(const std::vector<float>& wavelengths_nm)
+{
+	if (!mEnabled || !mPlots)
+		return;
+
+	for (auto plot : mOpen)
+		mStates[plot].scratch.reset();
+
+	mOpen.clear();
+
+	bool found = std::any_of(mStates.begin(), mStates.end(), [](const sPlotState& state) { return state.lines > 0; });
+
+	if (!found)
+		return;
+
+	auto filename = mBasename;
+	filename += ".plots.csv";
+
+	std::ofstream summary(filename);
+
+	if (!summary.is_open())
+	{
+		std::string msg = "Could not open: ";
+		msg += filename.string();
+		throw std::runtime_error(msg);
+	}
+
+	summary << "plot,name,statistic,pixels";
+
+	for (std::size_t band = 0; band < mSpectralSize; ++band)
+	{
+		if (wavelengths_nm.size() == mSpectralSize)
+			summary << "," << wavelengths_nm[band];
+		else
+			summary << ",band " << band + 1;
+	}
+
+	summary << "\n";
+
+	for (std::size_t plot = 0; plot < mStates.size(); ++plot)
+	{
+		if (mStates[plot].lines == 0)
+			continue;
+
+		writePlot(plot, summary, wavelengths_nm);
+
+		std::filesystem::remove(scratchFilename(plot));
+	}
+}
+
+void cPlotExtractor::writePlot(std::size_t plot, std::ostream& summary, const std::vector<float>& wavelengths_nm)
+{
+	const auto& info = (*mPlots)[plot];
+	const auto& state = mStates[plot];
+
+	const std::size_t bands = mSpectralSize;
+	const std::size_t samples = state.lastSample - state.firstSample + 1;
+
+	std::ifstream in(scratchFilename(plot), std::ios_base::binary);
+
+	auto filename = cubeFilename(plot);
+	std::ofstream cube(filename, std::ios_base::binary);
+
+	if (!in.is_open() || !cube.is_open())
+	{
+		std::string msg = "Could not open: ";
+		msg += filename.string();
+		throw std::runtime_error(msg);
+	}
+
+	// The samples of the plot are kept for a group of bands at a time, so the
+	// scratch file is read once for each group.  The cube is written during
+	// the first pass.
+	const std::size_t pixels = state.pixels;
+	const std::size_t bandsPerPass = std::clamp<std::size_t>(SUMMARY_BUFFER_SIZE / (pixels * sizeof(uint16_t)), 1, bands);
+
+	std::vector<uint16_t> row(samples * bands);
+	std::vector<uint16_t> segment;
+	std::vector<uint16_t> values;
+
+	std::vector<nPlotExtraction::sSummary> spectra(bands);
+
+	for (std::size_t firstBand = 0; firstBand < bands; firstBand += bandsPerPass)
+	{
+		const std::size_t passBands = std::min(bandsPerPass, bands - firstBand);
+
+		values.resize(passBands * pixels);
+
+		in.clear();
+		in.seekg(0);
+
+		std::size_t pixel = 0;
+
+		for (std::size_t line = 0; line < state.lines; ++line)
+		{
+			uint32_t header[2] = { 0, 0 };
+			in.read(reinterpret_cast<char*>(header), sizeof(header));
+
+			const std::size_t count = header[1];
+			const std::size_t offset = header[0] - state.firstSample;
+
+			segment.resize(count * bands);
+			in.read(reinterpret_cast<char*>(segment.data()), segment.size() * sizeof(uint16_t));
+
+			if (!in || (pixel + count > pixels))
+				throw std::runtime_error("Unexpected end of plot data: " + scratchFilename(plot).string());
+
+			for (std::size_t band = 0; band < passBands; ++band)
+			{
+				auto begin = segment.begin() + (firstBand + band) * count;
+				std::copy(begin, begin + count, values.begin() + band * pixels + pixel);
+			}
+
+			pixel += count;
+
+			if (firstBand > 0)
+				continue;
+
+			std::fill(row.begin(), row.end(), 0);
+
+			for (std::size_t band = 0; band < bands; ++band)
+			{
+				auto begin = segment.begin() + band * count;
+				std::copy(begin, begin + count, row.begin() + band * samples + offset);
+			}
+
+			cube.write(reinterpret_cast<const char*>(row.data()), row.size() * sizeof(uint16_t));
+		}
+
+		for (std::size_t band = 0; band < passBands; ++band)
+			spectra[firstBand + band] = nPlotExtraction::summarize(values.data() + band * pixels, pixels);
+	}
+
+	auto header_filename = filename;
+	header_filename.replace_extension(".hdr");
+
+	std::ofstream header(header_filename, std::ios_base::binary);
+
+	if (header.is_open())
+	{
+		header << "ENVI" << std::endl;
+		header << "description = {plot " << info.number << " " << info.name << "}" << std::endl;
+		header << "interleave = bil" << std::endl;
+		header << "header offset = 0" << std::endl;
+		header << "file type = ENVI Standard" << std::endl;
+		header << "data type = 12" << std::endl;
+		header << "byte order = 0" << std::endl;
+		header << "bands = " << bands << std::endl;
+		header << "lines = " << state.lines << std::endl;
+		header << "samples = " << samples << std::endl;
+		header << "data ignore value = 0" << std::endl;
+		header << "wavelength units = nm" << std::endl;
+
+		auto n = wavelengths_nm.size();
+		if (n == bands && n > 0)
+		{
+			--n;
+			header << "wavelength = {" << std::endl;
+
+			for (std::size_t i = 0; i < n; ++i)
+				header << wavelengths_nm[i] << ", ";
+
+			header << *wavelengths_nm.rbegin() << "}" << std::endl;
+		}
+	}
+
+	auto write_row = [&](const char* statistic, auto value)
+		{
+			summary << info.number << ",\"" << info.name << "\"," << statistic << "," << pixels;
+
+			for (const auto& spectrum : spectra)
+				summary << "," << value(spectrum);
+
+			summary << "\n";
+		};
+
+	write_row("mean", [](const nPlotExtraction::sSummary& s) { return s.mean; });
+	write_row("p10", [](const nPlotExtraction::sSummary& s) { return s.p10; });
+	write_row("median", [](const nPlotExtraction::sSummary& s) { return s.median; });
+	write_row("p90", [](const nPlotExtraction::sSummary& s) { return s.p90; });
+}
+
+std::vector<std::string> cPlotExtractor::suffixes() const
+{
+	return { ".plots", ".plots.csv" };
+}
+
+
+nPlotExtraction::sSummary nPlotExtraction::summarize(uint16_t* samples, std::size_t count)
+{
+	sSummary result;
+
+	if (count == 0)
+		return result;
+
+	uint64_t sum = 0;
+	for (std::size_t i = 0; i < count; ++i)
+		sum += samples[i];
+
+	result.mean = static_cast<double>(sum) / count;
+
+	auto rank = [count](double q) { return static_cast<std::size_t>(std::lround(q * (count - 1))); };
+
+	const auto median = rank(0.5);
+	const auto p10 = rank(0.1);
+	const auto p90 = rank(0.9);
+
+	// Each selection leaves the smaller samples before and the larger after
+	std::nth_element(samples, samples + median, samples + count);
+	result.median = samples[median];
+
+	std::nth_element(samples, samples + p10, samples + median);
+	result.p10 = (p10 < median) ? samples[p10] : result.median;
+
+	if (p90 > median)
+	{
+		std::nth_element(samples + median + 1, samples + p90, samples + count);
+		result.p90 = samples[p90];
+	}
+	else
+		result.p90 = result.median;
+
+	return result;
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "LineRegistration.hpp"
+
+#include "PlotConfigBoundary.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+/**
+ * A plot of the field and its boundary on the day of the recording.
+ */
+struct sPlotRegion
+{
+	uint32_t number = 0;
+	std::string name;
+	cPlotConfigBoundary bounds;
+};
+
+
+/**
+ * Cuts the registered lines of a recording into one cube per plot and
+ * summarizes the spectra of each plot, while the recording is converted.
+ *
+ * The ground position of every sample is found from the line position,
+ * the direction of travel, the height above ground and the field of view
+ * of the lens.  The plots are binned into a uniform grid, so a line only
+ * tests the plots in the cells that its footprint crosses, and only the
+ * samples inside a plot's bounding box are tested against its corners.
+ *
+ * The part of a line that falls in a plot is appended to a scratch file
+ * of that plot.  At the end of the recording each scratch file is turned
+ * into an ENVI BIL cube, with the samples of the plot at the same offsets
+ * as in the lines and zero as the no data value, and the mean, 10th, 50th
+ * and 90th percentile spectra of the plot are written to one CSV file.
+ */
+class cPlotExtractor
+{
+public:
+	void enable(bool enable = true) { mEnabled = enable; }
+	bool enabled() const { return mEnabled; }
+
+	void setPlots(std::shared_ptr<const std::vector<sPlotRegion>> plots, double groundLevel_mm);
+	void setFieldOfView_rad(double fieldOfView_rad);
+
+	/**
+	 * Start a new recording.  The plot cubes are written to the <base>.plots
+	 * directory and the summaries to <base>.plots.csv.
+	 */
+	void begin(const std::filesystem::path& base);
+
+	/**
+	 * Add a line that holds spectralSize bands of spatialSize samples, one
+	 * band after another.
+	 */
+	void addLine(const uint16_t* frame, std::size_t spatialSize, std::size_t spectralSize, const sLinePosition& position);
+
+	/**
+	 * Write the plot cubes and their spectral summaries.
+	 */
+	void write(const std::vector<float>& wavelengths_nm);
+
+	/**
+	 * The suffixes of the files written for the base name.
+	 */
+	std::vector<std::string> suffixes() const;
+
+private:
+	struct sBox
+	{
+		double minX_mm = 0.0;
+		double minY_mm = 0.0;
+		double maxX_mm = 0.0;
+		double maxY_mm = 0.0;
+	};
+
+	struct sPlotState
+	{
+		std::size_t lines = 0;
+		std::size_t pixels = 0;
+		std::size_t firstSample = SIZE_MAX;
+		std::size_t lastSample = 0;
+
+		/// The line that last touched the plot
+		std::size_t stamp = 0;
+
+		std::unique_ptr<std::ofstream> scratch;
+	};
+
+	void buildGrid();
+	void updateOffsets(std::size_t spatialSize);
+
+	std::filesystem::path scratchFilename(std::size_t plot) const;
+	std::filesystem::path cubeFilename(std::size_t plot) const;
+
+	void appendLine(std::size_t plot, const uint16_t* frame, std::size_t spatialSize, std::size_t spectralSize,
+		std::size_t first, std::size_t last);
+
+	void writePlot(std::size_t plot, std::ostream& summary, const std::vector<float>& wavelengths_nm);
+
+private:
+	bool mEnabled = false;
+
+	std::shared_ptr<const std::vector<sPlotRegion>> mPlots;
+	double mGroundLevel_mm = 0.0;
+	double mFieldOfView_rad = 0.0;
+
+	std::filesystem::path mBasename;
+	std::filesystem::path mDirectory;
+
+	std::size_t mSpectralSize = 0;
+	std::size_t mNumLines = 0;
+
+	/// tan() of the view angle of each sample
+	std::vector<double> mOffsets;
+
+	/// The plots that overlap each cell of the grid
+	double mMinX_mm = 0.0;
+	double mMinY_mm = 0.0;
+	double mCellSize_mm = 1.0;
+	std::size_t mNumCellsX = 0;
+	std::size_t mNumCellsY = 0;
+	std::vector<std::vector<uint32_t>> mCells;
+	std::vector<sBox> mBoxes;
+
+	std::vector<sPlotState> mStates;
+	std::vector<std::size_t> mOpen;
+	std::vector<std::size_t> mCandidates;
+};
+
+
+namespace nPlotExtraction
+{
+	/**
+	 * The mean and the 10th, 50th and 90th percentiles of count samples.
+	 * The samples are reordered.
+	 */
+	struct sSummary
+	{
+		double mean = 0.0;
+		uint16_t p10 = 0;
+		uint16_t median = 0;
+		uint16_t p90 = 0;
+	};
+
+	sSummary summarize(uint16_t* samples, std::size_t count);
+}
@@ -0,0 +1,201 @@
+#include "RadiometricCalibration.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+	#define USE_SSE2
+	#include <emmintrin.h>
+#endif
+
+
+void cRadiometricCalibration::enable(eCalibratedFormat format, float scale)
+{
+	mEnabled = true;
+	mFormat = format;
+	mScale = (scale > 0.0f) ? scale : DEFAULT_SCALE;
+	mDirty = true;
+}
+
+void cRadiometricCalibration::setIntegrationTime_us(uint32_t integrationTime_us)
+{
+	mIntegrationTime_s = integrationTime_us * 1.0e-6;
+	mDirty = true;
+}
+
+void cRadiometricCalibration::beginReference()
+{
+	mInReference = true;
+	mNumReferenceFrames = 0;
+	mReferenceSum.clear();
+}
+
+void cRadiometricCalibration::endReference()
+{
+	mInReference = false;
+
+	if (mNumReferenceFrames == 0)
+		return;
+
+	mWhite.resize(mReferenceSum.size());
+
+	for (std::size_t i = 0; i < mWhite.size(); ++i)
+		mWhite[i] = static_cast<float>(mReferenceSum[i] / mNumReferenceFrames);
+
+	mReferenceSum.clear();
+	mNumReferenceFrames = 0;
+	mDirty = true;
+}
+
+void cRadiometricCalibration::addReference(const uint16_t* frame, std::size_t spatialSize, std::size_t spectralSize)
+{
+	prepare(spatialSize, spectralSize);
+
+	const std::size_t count = mRadianceFactor.size();
+
+	if (mReferenceSum.size() != count)
+	{
+		mReferenceSum.assign(count, 0.0);
+		mNumReferenceFrames = 0;
+	}
+
+	// The white reference is averaged in radiance
+	mCalibrated.resize(count);
+
+	nRadiometry::calibrate(frame, mOffset.data(), mRadianceFactor.data(), count, mCalibrated.data());
+
+	for (std::size_t i = 0; i < count; ++i)
+		mReferenceSum[i] += mCalibrated[i];
+
+	++mNumReferenceFrames;
+}
+
+const float* cRadiometricCalibration::calibrate(const uint16_t* frame, std::size_t spatialSize, std::size_t spectralSize)
+{
+	prepare(spatialSize, spectralSize);
+
+	mCalibrated.resize(mFactor.size());
+
+	nRadiometry::calibrate(frame, mOffset.data(), mFactor.data(), mFactor.size(), mCalibrated.data());
+
+	return mCalibrated.data();
+}
+
+const uint16_t* cRadiometricCalibration::calibrateScaled(const uint16_t* frame, std::size_t spatialSize, std::size_t spectralSize)
+{
+	prepare(spatialSize, spectralSize);
+
+	mScaled.resize(mFactor.size());
+
+	nRadiometry::calibrate(frame, mOffset.data(), mFactor.data(), mFactor.size(), mScaled.data());
+
+	return mScaled.data();
+}
+
+void cRadiometricCalibration::prepare(std::size_t spatialSize, std::size_t spectralSize)
+{
+	const std::size_t count = spatialSize * spectralSize;
+
+	if (!mDirty && (mFactor.size() == count))
+		return;
+
+	auto matches = [count](const std::vector<float>& values) { return values.empty() || (values.size() == count); };
+
+	if (!matches(mBackground) || !matches(mResponsivity) || !matches(mWhite))
+		throw std::runtime_error("The calibration data does not match the size of the frames.");
+
+	if (mBackground.empty())
+		mOffset.assign(count, 0.0f);
+	else
+		mOffset = mBackground;
+
+	const double integrationTime_s = (mIntegrationTime_s > 0.0) ? mIntegrationTime_s : 1.0;
+	const double scale = (mFormat == eCalibratedFormat::UINT16) ? mScale : 1.0;
+
+	mRadianceFactor.resize(count);
+	mFactor.resize(count);
+
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		double gain = 1.0 / integrationTime_s;
+
+		if (!mResponsivity.empty())
+			gain = (mResponsivity[i] > 0.0f) ? gain / mResponsivity[i] : 0.0;
+
+		mRadianceFactor[i] = static_cast<float>(gain);
+
+		if (!mWhite.empty())
+			gain = (mWhite[i] > 0.0f) ? gain / mWhite[i] : 0.0;
+
+		mFactor[i] = static_cast<float>(gain * scale);
+	}
+
+	mDirty = false;
+}
+
+
+void nRadiometry::calibrate(const uint16_t* dn, const float* offset, const float* factor, std::size_t count, float* out)
+{
+	std::size_t i = 0;
+
+#ifdef USE_SSE2
+	const __m128i zero = _mm_setzero_si128();
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dn + i));
+
+		__m128 lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero));
+		__m128 hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(v, zero));
+
+		lo = _mm_mul_ps(_mm_sub_ps(lo, _mm_loadu_ps(offset + i)), _mm_loadu_ps(factor + i));
+		hi = _mm_mul_ps(_mm_sub_ps(hi, _mm_loadu_ps(offset + i + 4)), _mm_loadu_ps(factor + i + 4));
+
+		_mm_storeu_ps(out + i, lo);
+		_mm_storeu_ps(out + i + 4, hi);
+	}
+#endif
+
+	for (; i < count; ++i)
+		out[i] = (dn[i] - offset[i]) * factor[i];
+}
+
+void nRadiometry::calibrate(const uint16_t* dn, const float* offset, const float* factor, std::size_t count, uint16_t* out)
+{
+	std::size_t i = 0;
+
+#ifdef USE_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 max = _mm_set1_ps(65535.0f);
+	const __m128 bias = _mm_set1_ps(32768.0f);
+	const __m128i unbias = _mm_set1_epi16(static_cast<short>(0x8000));
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dn + i));
+
+		__m128 lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero));
+		__m128 hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(v, zero));
+
+		lo = _mm_mul_ps(_mm_sub_ps(lo, _mm_loadu_ps(offset + i)), _mm_loadu_ps(factor + i));
+		hi = _mm_mul_ps(_mm_sub_ps(hi, _mm_loadu_ps(offset + i + 4)), _mm_loadu_ps(factor + i + 4));
+
+		lo = _mm_min_ps(_mm_max_ps(lo, _mm_setzero_ps()), max);
+		hi = _mm_min_ps(_mm_max_ps(hi, _mm_setzero_ps()), max);
+
+		// SSE2 only packs signed values, so shift the range down and back up
+		__m128i lo32 = _mm_cvtps_epi32(_mm_sub_ps(lo, bias));
+		__m128i hi32 = _mm_cvtps_epi32(_mm_sub_ps(hi, bias));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_xor_si128(_mm_packs_epi32(lo32, hi32), unbias));
+	}
+#endif
+
+	for (; i < count; ++i)
+	{
+		float value = (dn[i] - offset[i]) * factor[i];
+		value = std::min(std::max(value, 0.0f), 65535.0f);
+		out[i] = static_cast<uint16_t>(std::nearbyint(value));
+	}
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+enum class eCalibratedFormat {FLOAT32, UINT16};
+
+/**
+ * Converts raw HySpex frames into radiance, or into reflectance once a
+ * white reference has been recorded.
+ *
+ * For each pixel and band:
+ *
+ *     value = (DN - background) / (responsivity * integration time) / white
+ *
+ * The background, responsivity and white reference are folded into one
+ * offset and one factor per sample, so a frame is converted with a single
+ * subtract and multiply per sample.  Frames recorded between the begin and
+ * end of a reference are averaged into the white reference.
+ *
+ * Reflectance may also be written as 16-bit integers, scaled by a fixed
+ * factor (10000 by default).
+ */
+class cRadiometricCalibration
+{
+public:
+	static constexpr float DEFAULT_SCALE = 10000.0f;
+
+public:
+	void enable(eCalibratedFormat format, float scale = DEFAULT_SCALE);
+
+	bool enabled() const { return mEnabled; }
+	eCalibratedFormat format() const { return mFormat; }
+	float scale() const { return mScale; }
+
+	bool hasWhiteReference() const { return !mWhite.empty(); }
+
+	void setIntegrationTime_us(uint32_t integrationTime_us);
+
+	template<class MATRIX>
+	void setBackground(const MATRIX& background, std::size_t spatialSize, std::size_t spectralSize)
+	{
+		load(mBackground, background, spatialSize, spectralSize);
+	}
+
+	template<class MATRIX>
+	void setResponsivity(const MATRIX& responsivity, std::size_t spatialSize, std::size_t spectralSize)
+	{
+		load(mResponsivity, responsivity, spatialSize, spectralSize);
+	}
+
+	void beginReference();
+	void endReference();
+
+	bool inReference() const { return mInReference; }
+
+	template<class IMAGE>
+	void addReference(const IMAGE& image)
+	{
+		addReference(gather(image), image.spatialSize(), image.spectralSize());
+	}
+
+	/**
+	 * Calibrate a frame.  The result holds the bands one after another and
+	 * is valid until the next call.
+	 */
+	template<class IMAGE>
+	const float* calibrate(const IMAGE& image)
+	{
+		return calibrate(gather(image), image.spatialSize(), image.spectralSize());
+	}
+
+	template<class IMAGE>
+	const uint16_t* calibrateScaled(const IMAGE& image)
+	{
+		return calibrateScaled(gather(image), image.spatialSize(), image.spectralSize());
+	}
+
+	/**
+	 * Versions for a frame that holds spectralSize bands of spatialSize
+	 * samples, one band after another.
+	 */
+	void addReference(const uint16_t* frame, std::size_t spatialSize, std::size_t spectralSize);
+	const float* calibrate(const uint16_t* frame, std::size_t spatialSize, std::size_t spectralSize);
+	const uint16_t* calibrateScaled(const uint16_t* frame, std::size_t spatialSize, std::size_t spectralSize);
+
+private:
+	template<class IMAGE>
+	const uint16_t* gather(const IMAGE& image)
+	{
+		const auto& data = image.image();
+
+		mFrame.clear();
+
+		for (std::size_t band = 0; band < image.spectralSize(); ++band)
+		{
+			const auto& samples = data.band(band);
+			mFrame.insert(mFrame.end(), samples.begin(), samples.end());
+		}
+
+		return mFrame.data();
+	}
+
+	template<class MATRIX>
+	void load(std::vector<float>& values, const MATRIX& matrix, std::size_t spatialSize, std::size_t spectralSize)
+	{
+		values.resize(spatialSize * spectralSize);
+
+		auto* out = values.data();
+
+		for (std::size_t band = 0; band < spectralSize; ++band)
+		{
+			const auto& samples = matrix.band(band);
+
+			for (std::size_t i = 0; i < spatialSize; ++i)
+				*out++ = samples[i];
+		}
+
+		mDirty = true;
+	}
+
+	void prepare(std::size_t spatialSize, std::size_t spectralSize);
+
+private:
+	bool mEnabled = false;
+	eCalibratedFormat mFormat = eCalibratedFormat::FLOAT32;
+	float mScale = DEFAULT_SCALE;
+
+	double mIntegrationTime_s = 0.0;
+
+	std::vector<float> mBackground;
+	std::vector<float> mResponsivity;
+	std::vector<float> mWhite;
+
+	bool mInReference = false;
+	std::size_t mNumReferenceFrames = 0;
+	std::vector<double> mReferenceSum;
+
+	/// The background and the combined gain of each sample, with and
+	/// without the white reference
+	bool mDirty = true;
+	std::vector<float> mOffset;
+	std::vector<float> mRadianceFactor;
+	std::vector<float> mFactor;
+
+	std::vector<uint16_t> mFrame;
+	std::vector<float> mCalibrated;
+	std::vector<uint16_t> mScaled;
+};
+
+
+namespace nRadiometry
+{
+	/**
+	 * out[i] = (dn[i] - offset[i]) * factor[i]
+	 */
+	void calibrate(const uint16_t* dn, const float* offset, const float* factor, std::size_t count, float* out);
+
+	/**
+	 * As above, rounded and clamped to the range of a 16-bit integer.
+	 */
+	void calibrate(const uint16_t* dn, const float* offset, const float* factor, std::size_t count, uint16_t* out);
+}
@@ -0,0 +1,54 @@
+#include "WriterThread.hpp"
+
+#include <exception>
+#include <utility>
+
+
+cWriterThread::cWriterThread(std::size_t queueDepth) : mQueue(queueDepth)
+{
+	mThread = std::thread(&cWriterThread::run, this);
+}
+
+cWriterThread::~cWriterThread()
+{
+	finish();
+}
+
+bool cWriterThread::push(task_t task)
+{
+	return mQueue.push(std::move(task));
+}
+
+void cWriterThread::finish()
+{
+	mQueue.close();
+
+	if (mThread.joinable())
+		mThread.join();
+}
+
+void cWriterThread::run()
+{
+	task_t task;
+
+	try
+	{
+		while (mQueue.pop(task))
+		{
+			task();
+		}
+	}
+	catch (const std::exception& e)
+	{
+		mError = e.what();
+		mFailed = true;
+	}
+	catch (...)
+	{
+		mError = "Unknown error";
+		mFailed = true;
+	}
+
+	// Stop the reader from waiting on a writer that is no longer running
+	mQueue.close();
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "BoundedQueue.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <thread>
+
+
+/**
+ * Runs the tasks given to it, in order, on a thread of its own.
+ *
+ * The tasks are passed through a bounded queue, so a fast reader can only
+ * run a fixed number of tasks ahead of a slow writer.  If a task throws,
+ * the remaining tasks are dropped and the error is kept for finish().
+ */
+class cWriterThread
+{
+public:
+	using task_t = std::function<void()>;
+
+public:
+	explicit cWriterThread(std::size_t queueDepth);
+	~cWriterThread();
+
+	cWriterThread(const cWriterThread&) = delete;
+	cWriterThread& operator=(const cWriterThread&) = delete;
+
+	/**
+	 * Queue a task, waiting for space if needed.  Returns false once the
+	 * writer has failed or finished.
+	 */
+	bool push(task_t task);
+
+	/**
+	 * Run the remaining tasks and stop the thread.
+	 */
+	void finish();
+
+	bool failed() const { return mFailed; }
+
+	/**
+	 * The error of the task that failed.  Only valid after finish().
+	 */
+	const std::string& error() const { return mError; }
+
+private:
+	void run();
+
+private:
+	cBoundedQueue<task_t> mQueue;
+	std::thread mThread;
+
+	std::atomic<bool> mFailed = false;
+	std::string mError;
+};
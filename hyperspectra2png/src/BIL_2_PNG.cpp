@@ -1,5 +1,7 @@
 ﻿
 #include "BIL_2_PNG.hpp"
+#include "CubeReader.hpp"
+#include "BS_thread_pool.hpp"
 
 #include "Constants.hpp"
 #include "MathUtils.hpp"
@@ -71,43 +73,6 @@ bool readBILHeader(const std::string& filename, std::map<std::string, std::strin
 }
 
 
-// Reads a BIL file into a 3D vector: data[band][row][col]
-template <typename T>
-std::vector<std::vector<std::vector<T>>> readBIL(int id, const std::string& filename, size_t rows, size_t cols, size_t bands)
-{
-    // Open file in binary mode
-    std::ifstream file(filename, std::ios::binary);
-    if (!file) 
-    {
-        throw std::runtime_error("Error: Cannot open file " + filename);
-    }
-
-    // Allocate memory: bands × rows × cols
-    std::vector<std::vector<std::vector<T>>> data(
-        bands, std::vector<std::vector<T>>(rows, std::vector<T>(cols)));
-
-    // Read line by line
-    for (size_t row = 0; row < rows; ++row) 
-    {
-        for (size_t band = 0; band < bands; ++band) 
-        {
-            file.read(reinterpret_cast<char*>(data[band][row].data()), cols * sizeof(T));
-
-            if (!file) 
-            {
-                throw std::runtime_error("Error: Unexpected end of file while reading.");
-            }
-        }
-
-
-        auto file_pos = 100.0 * (static_cast<double>(row) / static_cast<double>(rows));
-        update_file_progress(id, static_cast<int>(file_pos));
-    }
-
-    return data;
-}
-
-
 std::vector<float> toArray(const std::string& in)
 {
     std::vector<float> out;
@@ -209,38 +174,69 @@ void cBIL_2_Png::setRgbWavelengths_nm(float red_nm, float green_nm, float blue_n
     }
 }
 
-void cBIL_2_Png::writeRgbImage(std::filesystem::path in, std::filesystem::path out)
+void cBIL_2_Png::setNumThreads(int numThreads)
 {
-    auto bands = std::stoi(mHeader.at("bands"));
-    auto lines = std::stoi(mHeader.at("lines"));
-    auto samples = std::stoi(mHeader.at("samples"));
-    auto data_type = std::stoi(mHeader.at("data type"));
+    mNumThreads = std::max(numThreads, 1);
+}
 
-    mImage.create(lines, samples, CV_16UC4);
+sCubeGeometry cBIL_2_Png::getGeometry() const
+{
+    using namespace nStringUtils;
 
-    int maxPixelValue = std::pow(2, data_type);
+    sCubeGeometry geometry;
 
-    mColorScale = 255.0 / maxPixelValue;
-    mColorScale = 65535.0 / maxPixelValue;
-    mColorScale *= 4.0;
+    geometry.samples = std::stoul(mHeader.at("samples"));
+    geometry.lines = std::stoul(mHeader.at("lines"));
+    geometry.bands = std::stoul(mHeader.at("bands"));
 
-    update_file_progress(mID, "Loading file...", 0);
+    if (mHeader.contains("header offset"))
+        geometry.headerOffset = std::stoul(mHeader.at("header offset"));
+
+    if (mHeader.contains("interleave"))
+    {
+        auto interleave = toLower(mHeader.at("interleave"));
+
+        if (interleave == "bip")
+            geometry.interleave = eInterleave::BIP;
+        else if (interleave == "bsq")
+            geometry.interleave = eInterleave::BSQ;
+        else
+            geometry.interleave = eInterleave::BIL;
+    }
+
+    if (mHeader.contains("byte order") && (std::stoi(mHeader.at("byte order")) != 0))
+        throw std::runtime_error("Error: Big endian cubes are not supported.");
 
-    auto bil = readBIL<unsigned short>(mID, in.string(), lines, samples, bands);
+    auto data_type = std::stoi(mHeader.at("data type"));
 
-    const auto& red_slice = bil[mRedIndex];
-    const auto& green_slice = bil[mGreenIndex];
-    const auto& blue_slice = bil[mBlueIndex];
+    // The previews are made from 16-bit samples, signed (2) or unsigned (12)
+    if ((data_type != 2) && (data_type != 12))
+        throw std::runtime_error("Error: Unsupported data type " + std::to_string(data_type));
 
-    update_file_progress(mID, "Saving PNG file...", 0);
+    geometry.bytesPerSample = sizeof(uint16_t);
+    geometry.signedSamples = (data_type == 2);
 
-    for (int l = 0; l < lines; ++l)
+    return geometry;
+}
+
+template<typename T>
+void cBIL_2_Png::convertLines(const cCubeReader& cube, std::size_t first, std::size_t last)
+{
+    const auto samples = cube.geometry().samples;
+
+    const auto red_band = cube.band<T>(mRedIndex);
+    const auto green_band = cube.band<T>(mGreenIndex);
+    const auto blue_band = cube.band<T>(mBlueIndex);
+
+    for (std::size_t l = first; l < last; ++l)
     {
-        const auto& red = red_slice[l];
-        const auto& green = green_slice[l];
-        const auto& blue = blue_slice[l];
+        const auto red = red_band.line(l);
+        const auto green = green_band.line(l);
+        const auto blue = blue_band.line(l);
 
-        for (int i = 0; i < samples; ++i)
+        auto* pixels = mImage.ptr<cv::Vec4w>(static_cast<int>(l));
+
+        for (std::size_t i = 0; i < samples; ++i)
         {
             uint16_t r = nMathUtils::bound<uint16_t>(red[i] * mColorScale);
             uint16_t g = nMathUtils::bound<uint16_t>(green[i] * mColorScale);
@@ -251,14 +247,63 @@ void cBIL_2_Png::writeRgbImage(std::filesystem::path in, std::filesystem::path o
             if (r == 0 && b == 0 && g == 0)
                 a = 0;
 
-            cv::Point p(i, l);
-            mImage.at<cv::Vec4w>(p) = { b,g,r,a };
+            pixels[i] = { b,g,r,a };
         }
+    }
+}
+
+void cBIL_2_Png::writeRgbImage(std::filesystem::path in, std::filesystem::path out)
+{
+    auto data_type = std::stoi(mHeader.at("data type"));
+
+    int maxPixelValue = std::pow(2, data_type);
+
+    mColorScale = 255.0 / maxPixelValue;
+    mColorScale = 65535.0 / maxPixelValue;
+    mColorScale *= 4.0;
+
+    update_file_progress(mID, "Loading file...", 0);
+
+    cCubeReader cube;
+    cube.open(in, getGeometry());
+
+    const auto lines = cube.geometry().lines;
+    const auto samples = cube.geometry().samples;
+
+    mImage.create(static_cast<int>(lines), static_cast<int>(samples), CV_16UC4);
+
+    // Only the pages holding these bands are read from disk
+    cube.prefetch(mRedIndex);
+    cube.prefetch(mGreenIndex);
+    cube.prefetch(mBlueIndex);
+
+    auto convert = [&](const std::size_t first, const std::size_t last)
+    {
+        if (cube.geometry().signedSamples)
+            convertLines<int16_t>(cube, first, last);
+        else
+            convertLines<uint16_t>(cube, first, last);
+    };
 
-        auto file_pos = 100.0 * (static_cast<double>(l) / static_cast<double>(lines));
+    update_file_progress(mID, "Saving PNG file...", 0);
+
+    BS::thread_pool pool(mNumThreads);
+
+    // Each range of lines is split between the threads
+    const std::size_t LINES_PER_UPDATE = 256;
+
+    for (std::size_t first = 0; first < lines; first += LINES_PER_UPDATE)
+    {
+        auto last = std::min(first + LINES_PER_UPDATE, lines);
+
+        pool.parallelize_loop(first, last, convert).wait();
+
+        auto file_pos = 100.0 * (static_cast<double>(last) / static_cast<double>(lines));
         update_file_progress(mID, static_cast<int>(file_pos));
     }
 
+    cube.close();
+
     cv::String name = out.string();
     cv::imwrite(name, mImage);
 
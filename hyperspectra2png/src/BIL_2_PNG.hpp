@@ -1,6 +1,8 @@
 
 #pragma once
 
+#include "CubeReader.hpp"
+
 #include <opencv2/core.hpp>
 
 #include <filesystem>
@@ -22,10 +24,27 @@ public:
 
 	void setRgbWavelengths_nm(float red_nm, float green_nm, float blue_nm);
 
+	/**
+	 * The number of threads used to convert the lines of the cube.
+	 */
+	void setNumThreads(int numThreads);
+
     void writeRgbImage(std::filesystem::path in, std::filesystem::path out);
 
+private:
+	sCubeGeometry getGeometry() const;
+
+	/**
+	 * Convert the lines [first, last) of the red, green and blue bands to
+	 * pixels of the image.
+	 */
+	template<typename T>
+	void convertLines(const cCubeReader& cube, std::size_t first, std::size_t last);
+
 private:
 	const int mID;
+
+	int mNumThreads = 1;
 	
 	std::filesystem::path mOutputPath;
 
@@ -108,7 +108,7 @@ int main(int argc, char** argv)
 			if (!isCeresFile(dir_entry.path().string()))
 				return 4;
 		}
-		else if ((ext == ".bil") || (ext == ".BIL"))
+		else if (cFileProcessor_BIL::isCubeFile(dir_entry.path()))
 		{
 		}
 		else
@@ -130,7 +130,7 @@ int main(int argc, char** argv)
 				if (!isCeresFile(dir_entry.path().string()))
 					continue;
 			}
-			else if ((ext == ".bil") || (ext == ".BIL"))
+			else if (cFileProcessor_BIL::isCubeFile(dir_entry.path()))
 			{
 			}
 			else
@@ -151,6 +151,9 @@ int main(int argc, char** argv)
 
 	std::cout << "Using " << n << " threads of a possible " << max_threads << std::endl;
 
+	// Threads that are not needed for a file of their own split the lines of a cube
+	int line_threads = std::max(n / std::max(static_cast<int>(files_to_process.size()), 1), 1);
+
 	/*
 	 * Make sure the output directory exists
 	 */
@@ -202,8 +205,12 @@ int main(int argc, char** argv)
 
 		cFileProcessor* fp = nullptr;
 
-		if ((fe.extension == "BIL") || (fe.extension == "bil"))
-			fp = new cFileProcessor_BIL(numFilesToProcess++, in_file, out_file);
+		if (cFileProcessor_BIL::isCubeFile(in_file.path()))
+		{
+			auto* cube = new cFileProcessor_BIL(numFilesToProcess++, in_file, out_file);
+			cube->setNumThreads(line_threads);
+			fp = cube;
+		}
 		else
 			fp = new cFileProcessor_Ceres(numFilesToProcess++, in_file, out_file);
 
@@ -0,0 +1,132 @@
+#include "CubeReader.hpp"
+
+#ifdef _WIN32
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+#include <string>
+
+
+cCubeReader::~cCubeReader()
+{
+	close();
+}
+
+void cCubeReader::open(std::filesystem::path filename, const sCubeGeometry& geometry)
+{
+	close();
+
+	const std::size_t required = geometry.headerOffset
+		+ geometry.samples * geometry.lines * geometry.bands * geometry.bytesPerSample;
+
+	if (geometry.samples * geometry.lines * geometry.bands == 0)
+		throw std::runtime_error("The cube is empty: " + filename.string());
+
+#ifdef _WIN32
+	HANDLE file = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+	if (file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("Could not open: " + filename.string());
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || (static_cast<std::size_t>(size.QuadPart) < required))
+	{
+		CloseHandle(file);
+		throw std::runtime_error("The cube is smaller than its header describes: " + filename.string());
+	}
+
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+
+	if (!data)
+	{
+		if (mapping)
+			CloseHandle(mapping);
+		CloseHandle(file);
+		throw std::runtime_error("Could not map: " + filename.string());
+	}
+
+	mFileHandle = file;
+	mMappingHandle = mapping;
+	mMappedSize = static_cast<std::size_t>(size.QuadPart);
+#else
+	int fd = ::open(filename.c_str(), O_RDONLY);
+
+	if (fd < 0)
+		throw std::runtime_error("Could not open: " + filename.string());
+
+	struct stat info;
+	if ((fstat(fd, &info) != 0) || (static_cast<std::size_t>(info.st_size) < required))
+	{
+		::close(fd);
+		throw std::runtime_error("The cube is smaller than its header describes: " + filename.string());
+	}
+
+	void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	// The mapping keeps its own reference to the file
+	::close(fd);
+
+	if (data == MAP_FAILED)
+		throw std::runtime_error("Could not map: " + filename.string());
+
+	mMappedSize = static_cast<std::size_t>(info.st_size);
+
+	// BIL and BIP previews read the cube front to back
+	if (geometry.interleave != eInterleave::BSQ)
+		madvise(data, mMappedSize, MADV_SEQUENTIAL);
+#endif
+
+	mData = static_cast<const uint8_t*>(data);
+	mGeometry = geometry;
+}
+
+void cCubeReader::close()
+{
+	if (!mData)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(mData);
+	CloseHandle(static_cast<HANDLE>(mMappingHandle));
+	CloseHandle(static_cast<HANDLE>(mFileHandle));
+
+	mMappingHandle = nullptr;
+	mFileHandle = nullptr;
+#else
+	munmap(const_cast<uint8_t*>(mData), mMappedSize);
+#endif
+
+	mData = nullptr;
+	mMappedSize = 0;
+	mGeometry = sCubeGeometry();
+}
+
+void cCubeReader::prefetch(std::size_t band) const
+{
+#ifndef _WIN32
+	if (!mData || (mGeometry.interleave != eInterleave::BSQ) || (band >= mGeometry.bands))
+		return;
+
+	const std::size_t bandSize = mGeometry.samples * mGeometry.lines * mGeometry.bytesPerSample;
+	const std::size_t offset = mGeometry.headerOffset + band * bandSize;
+
+	// madvise needs a page aligned address
+	const std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+	const std::size_t start = offset - (offset % page);
+
+	madvise(const_cast<uint8_t*>(mData) + start, offset + bandSize - start, MADV_WILLNEED);
+#endif
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+#include <type_traits>
+
+
+enum class eInterleave {BIL, BIP, BSQ};
+
+/**
+ * The layout of a cube as described by its ENVI header.
+ */
+struct sCubeGeometry
+{
+	std::size_t samples = 0;
+	std::size_t lines = 0;
+	std::size_t bands = 0;
+
+	eInterleave interleave = eInterleave::BIL;
+
+	std::size_t bytesPerSample = 2;
+	bool signedSamples = false;
+
+	std::size_t headerOffset = 0;
+};
+
+
+/**
+ * A view of every stride'th value starting at data.
+ */
+template<typename T>
+class cStridedView
+{
+public:
+	cStridedView(const T* data, std::size_t size, std::size_t stride)
+		: mData(data), mSize(size), mStride(stride)
+	{}
+
+	std::size_t size() const { return mSize; }
+
+	const T& operator[](std::size_t i) const { return mData[i * mStride]; }
+
+private:
+	const T* mData;
+	std::size_t mSize;
+	std::size_t mStride;
+};
+
+
+/**
+ * A view of one band of a cube, one line at a time.
+ */
+template<typename T>
+class cBandView
+{
+public:
+	cBandView(const T* data, std::size_t samples, std::size_t lines, std::size_t sampleStride, std::size_t lineStride)
+		: mData(data), mSamples(samples), mLines(lines), mSampleStride(sampleStride), mLineStride(lineStride)
+	{}
+
+	std::size_t samples() const { return mSamples; }
+	std::size_t lines() const { return mLines; }
+
+	cStridedView<T> line(std::size_t line) const
+	{
+		return cStridedView<T>(mData + line * mLineStride, mSamples, mSampleStride);
+	}
+
+private:
+	const T* mData;
+	std::size_t mSamples;
+	std::size_t mLines;
+	std::size_t mSampleStride;
+	std::size_t mLineStride;
+};
+
+
+/**
+ * Memory maps a BIL, BIP or BSQ cube and gives read-only views of its
+ * bands, lines and spectra without copying any data.
+ *
+ * Only the pages that hold the samples that are looked at are read from
+ * disk, so a few bands can be taken from a large BSQ cube without reading
+ * the rest of it.  The views are valid until the cube is closed and can be
+ * shared between threads.
+ */
+class cCubeReader
+{
+public:
+	cCubeReader() = default;
+	~cCubeReader();
+
+	cCubeReader(const cCubeReader&) = delete;
+	cCubeReader& operator=(const cCubeReader&) = delete;
+
+	void open(std::filesystem::path filename, const sCubeGeometry& geometry);
+	void close();
+
+	bool isOpen() const { return mData != nullptr; }
+
+	const sCubeGeometry& geometry() const { return mGeometry; }
+
+	/**
+	 * Hint that a band is about to be read.  Only a BSQ band is stored in
+	 * one range of the file, so the hint is ignored for BIL and BIP.
+	 */
+	void prefetch(std::size_t band) const;
+
+	template<typename T>
+	cBandView<T> band(std::size_t band) const
+	{
+		const auto& g = mGeometry;
+		const T* data = samples<T>();
+
+		switch (g.interleave)
+		{
+		case eInterleave::BIP:
+			return cBandView<T>(data + band, g.samples, g.lines, g.bands, g.samples * g.bands);
+		case eInterleave::BSQ:
+			return cBandView<T>(data + band * g.lines * g.samples, g.samples, g.lines, 1, g.samples);
+		case eInterleave::BIL:
+		default:
+			return cBandView<T>(data + band * g.samples, g.samples, g.lines, 1, g.bands * g.samples);
+		}
+	}
+
+	template<typename T>
+	cStridedView<T> line(std::size_t band, std::size_t line) const
+	{
+		return this->band<T>(band).line(line);
+	}
+
+	template<typename T>
+	cStridedView<T> spectrum(std::size_t sample, std::size_t line) const
+	{
+		const auto& g = mGeometry;
+		const T* data = samples<T>();
+
+		switch (g.interleave)
+		{
+		case eInterleave::BIP:
+			return cStridedView<T>(data + (line * g.samples + sample) * g.bands, g.bands, 1);
+		case eInterleave::BSQ:
+			return cStridedView<T>(data + line * g.samples + sample, g.bands, g.lines * g.samples);
+		case eInterleave::BIL:
+		default:
+			return cStridedView<T>(data + line * g.bands * g.samples + sample, g.bands, g.samples);
+		}
+	}
+
+private:
+	template<typename T>
+	const T* samples() const
+	{
+		if ((sizeof(T) != mGeometry.bytesPerSample) || (std::is_signed_v<T> != mGeometry.signedSamples))
+			throw std::runtime_error("The sample type does not match the cube.");
+
+		return reinterpret_cast<const T*>(mData + mGeometry.headerOffset);
+	}
+
+private:
+	sCubeGeometry mGeometry;
+
+	const uint8_t* mData = nullptr;
+	std::size_t mMappedSize = 0;
+
+#ifdef _WIN32
+	void* mFileHandle = nullptr;
+	void* mMappingHandle = nullptr;
+#endif
+};
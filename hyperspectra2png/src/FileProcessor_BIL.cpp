@@ -1,6 +1,8 @@
 
 #include "FileProcessor_BIL.hpp"
 
+#include "StringUtils.hpp"
+
 #include <filesystem>
 #include <string>
 #include <vector>
@@ -26,6 +28,18 @@ cFileProcessor_BIL::~cFileProcessor_BIL()
 {
 }
 
+bool cFileProcessor_BIL::isCubeFile(const std::filesystem::path& filename)
+{
+    auto ext = nStringUtils::toLower(filename.extension().string());
+
+    return (ext == ".bil") || (ext == ".bip") || (ext == ".bsq");
+}
+
+void cFileProcessor_BIL::setNumThreads(int numThreads)
+{
+    mConverter.setNumThreads(numThreads);
+}
+
 bool cFileProcessor_BIL::open(std::filesystem::path out)
 {
     std::filesystem::path headerFile = mInputFile;
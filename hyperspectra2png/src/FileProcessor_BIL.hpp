@@ -15,6 +15,13 @@ public:
 				std::filesystem::path out);
 	virtual ~cFileProcessor_BIL();
 
+	/**
+	 * Returns true for the BIL, BIP and BSQ cubes this processor reads.
+	 */
+	static bool isCubeFile(const std::filesystem::path& filename);
+
+	void setNumThreads(int numThreads);
+
 	bool open(std::filesystem::path out) override;
 
 	void process_file() override;
@@ -3,11 +3,12 @@
 
 #include <cbdf/HySpexSWIR_384_Parser.hpp>
 
-#include <opencv2/core.hpp>
+#include "StreamingPngWriter.hpp"
 
 #include <filesystem>
 #include <string>
 #include <fstream>
+#include <vector>
 
 
 
@@ -70,6 +71,7 @@ private:
 	void onSensorTemperature_K(uint8_t device_id, float temp_K) override;
 
 
+    void buildColorLut();
     void writeRgbImage(std::filesystem::path filename);
 
 private:
@@ -94,7 +96,6 @@ private:
 
 	std::size_t mSpatialSize = 0;
 	std::size_t mSpectralSize = 0;
-	std::size_t mMaxRows = 0;
 
 	float mColorScale = 1.0;
 
@@ -110,7 +111,11 @@ private:
 
 	std::size_t mActiveRow = 0;
 
-	cv::Mat mImage;
+	cStreamingPngWriter mPreview;
+	std::filesystem::path mPreviewFilename;
+
+	/// Maps a pixel value to its contrast stretched 8-bit value
+	std::vector<uint8_t> mColorLut;
 
     uint32_t    mFrameCount = 0;
 
@@ -4,13 +4,13 @@
 #include "Constants.hpp"
 #include "MathUtils.hpp"
 
-#include <opencv2/opencv.hpp>
-
+#include <algorithm>
 #include <iostream>
 
 
 cHySpexVNIR3000N_2_Png::cHySpexVNIR3000N_2_Png() : cHySpexVNIR_3000N_Parser()
 {
+    buildColorLut();
 }
 
 cHySpexVNIR3000N_2_Png::~cHySpexVNIR3000N_2_Png()
@@ -31,8 +31,6 @@ cHySpexVNIR3000N_2_Png::~cHySpexVNIR3000N_2_Png()
 
     writeRgbImage(filename);
 
-    mImage.release();
-
     mMetaData.close();
 }
 
@@ -91,8 +89,6 @@ void cHySpexVNIR3000N_2_Png::onWavelengthRange_nm(uint8_t device_id, uint16_t mi
 void cHySpexVNIR3000N_2_Png::onSpatialSize(uint8_t device_id, uint64_t spatialSize)
 {
     mSpatialSize = spatialSize;
-    mMaxRows = spatialSize;
-    mImage.create(spatialSize, spatialSize, CV_8UC3);
 }
 
 void cHySpexVNIR3000N_2_Png::onSpectralSize(uint8_t device_id, uint64_t spectralSize)
@@ -106,6 +102,8 @@ void cHySpexVNIR3000N_2_Png::onMaxPixelValue(uint8_t device_id, uint16_t maxPixe
 {
     mColorScale = 255.0 / maxPixelValue;
     mColorScale *= 4.0;
+
+    buildColorLut();
 }
 
 void cHySpexVNIR3000N_2_Png::onResponsivityMatrix(uint8_t device_id, HySpexConnect::cSpatialMajorData<float> re) {}
@@ -235,36 +233,38 @@ void cHySpexVNIR3000N_2_Png::onBackgroundMatrix(uint8_t device_id, HySpexConnect
 
 void cHySpexVNIR3000N_2_Png::onImage(uint8_t device_id, HySpexConnect::cImageData<uint16_t> image)
 {
-    if (mActiveRow >= mMaxRows)
+    if (!mPreview.isOpen())
     {
-        mImage.resize(mActiveRow + mSpatialSize);
-        mMaxRows = mActiveRow + mSpatialSize;
+        mPreviewFilename = mOutputPath;
+        mPreviewFilename += ".vnir.png.partial";
+        mPreview.open(mPreviewFilename, image.spatialSize());
     }
 
-    auto n = image.spatialSize();
+    auto n = std::min<std::size_t>(image.spatialSize(), mPreview.width());
     auto data = image.image();
     auto red = data.band(mRedIndex);
     auto green = data.band(mGreenIndex);
     auto blue = data.band(mBlueIndex);
 
-    for (int i = 0; i < n; ++i)
+    auto* row = mPreview.nextRow();
+    const auto* lut = mColorLut.data();
+
+    for (std::size_t i = 0; i < n; ++i, row += 3)
     {
-        uint8_t r = nMathUtils::bound<uint8_t>(red[i] * mColorScale);
-        uint8_t g = nMathUtils::bound<uint8_t>(green[i] * mColorScale);
-        uint8_t b = nMathUtils::bound<uint8_t>(blue[i] * mColorScale);
-        cv::Point p(i, mActiveRow);
-        mImage.at<cv::Vec3b>(p) = { b,g,r };
+        row[0] = lut[red[i]];
+        row[1] = lut[green[i]];
+        row[2] = lut[blue[i]];
     }
 
+    std::fill(row, row + 3 * (mPreview.width() - n), 0);
+
     ++mActiveRow;
 }
 
 void cHySpexVNIR3000N_2_Png::onImage(uint8_t device_id, HySpexConnect::cImageData<uint16_t> image, uint8_t spatialSkip, uint8_t spectralSkip)
 {
-    for (int i = 0; image.spatialSize(); ++i)
-    {
-//        mImage[i] = { 128,128,128 };
-    }
+    // The frame holds the pixels and bands that were recorded
+    onImage(device_id, image);
 }
 
 void cHySpexVNIR3000N_2_Png::onSensorTemperature_C(uint8_t device_id, float temp_C)
@@ -317,15 +317,21 @@ void cHySpexVNIR3000N_2_Png::onEndRecordingTimestamp(uint64_t timestamp_ns)
 }
 
 
+void cHySpexVNIR3000N_2_Png::buildColorLut()
+{
+    mColorLut.resize(65536);
+
+    for (std::size_t value = 0; value < mColorLut.size(); ++value)
+        mColorLut[value] = nMathUtils::bound<uint8_t>(value * mColorScale);
+}
+
 void cHySpexVNIR3000N_2_Png::writeRgbImage(std::filesystem::path filename)
 {
     if (mActiveRow == 0)
         return;
 
-    mImage.resize(mActiveRow);
-    mMaxRows = mActiveRow;
+    mPreview.close();
 
-    cv::String name = filename.string();
-    cv::imwrite(name, mImage);
+    std::filesystem::rename(mPreviewFilename, filename);
 }
 
@@ -6,11 +6,12 @@
 //#include <cbdf/SpidercamParser.hpp>
 //#include <spidercam/spidercam_types.hpp>
 
-#include <opencv2/core.hpp>
+#include "StreamingPngWriter.hpp"
 
 #include <filesystem>
 #include <string>
 #include <fstream>
+#include <vector>
 
 
 
@@ -74,6 +75,7 @@ private:
 	void onSensorTemperature_C(uint8_t device_id, float temp_C) override;
 
 
+    void buildColorLut();
     void writeRgbImage(std::filesystem::path filename);
 
 private:
@@ -99,7 +101,6 @@ private:
 
 	std::size_t mSpatialSize = 0;
 	std::size_t mSpectralSize = 0;
-	std::size_t mMaxRows = 0;
 
 	float mColorScale = 1.0;
 
@@ -115,7 +116,11 @@ private:
 
 	std::size_t mActiveRow = 0;
 
-	cv::Mat mImage;
+	cStreamingPngWriter mPreview;
+	std::filesystem::path mPreviewFilename;
+
+	/// Maps a pixel value to its contrast stretched 8-bit value
+	std::vector<uint8_t> mColorLut;
 
     uint32_t    mFrameCount = 0;
 
@@ -259,7 +259,7 @@ void cMainWindow::OnSourceFile(wxCommandEvent& WXUNUSED(event))
 	}
 
 	wxFileDialog dlg(this, _("Open file"), wxString(fpath.string()), wxString(fname.filename().string()),
-		"Ceres files (*.ceres)|*.ceres|Hyperspectral files (*.bil)|*.bil", wxFD_OPEN | wxFD_FILE_MUST_EXIST);
+		"Ceres files (*.ceres)|*.ceres|Hyperspectral files (*.bil;*.bip;*.bsq)|*.bil;*.bip;*.bsq", wxFD_OPEN | wxFD_FILE_MUST_EXIST);
 
 	if (dlg.ShowModal() == wxID_CANCEL)
 		return;     // the user changed their mind...
@@ -357,7 +357,7 @@ void cMainWindow::OnExport(wxCommandEvent& WXUNUSED(event))
 			if (!isCeresFile(dir_entry.path().string()))
 				return;
 		}
-		if ((ext == ".BIL") || (ext == ".bil"))
+		if (cFileProcessor_BIL::isCubeFile(dir_entry.path()))
 		{
 
 		}
@@ -380,7 +380,7 @@ void cMainWindow::OnExport(wxCommandEvent& WXUNUSED(event))
 				if (!isCeresFile(dir_entry.path().string()))
 					continue;
 			}
-			if ((ext == ".BIL") || (ext == ".bil"))
+			if (cFileProcessor_BIL::isCubeFile(dir_entry.path()))
 			{
 
 			}
@@ -420,7 +420,7 @@ void cMainWindow::OnExport(wxCommandEvent& WXUNUSED(event))
 
 		cFileProcessor* fp = nullptr;
 		
-		if ((fe.extension == "BIL") || (fe.extension == "bil"))
+		if (cFileProcessor_BIL::isCubeFile(in_file.path()))
 			fp = new cFileProcessor_BIL(mNumFilesToProcess++, in_file, out_file);
 		else
 			fp = new cFileProcessor_Ceres(mNumFilesToProcess++, in_file, out_file);
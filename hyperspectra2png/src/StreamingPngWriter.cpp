@@ -0,0 +1,198 @@
+#include "StreamingPngWriter.hpp"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+
+namespace
+{
+	constexpr uint8_t PNG_SIGNATURE[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+	constexpr std::size_t IHDR_SIZE = 13;
+
+	/// The IHDR data follows the signature, the chunk length and the chunk type
+	constexpr std::streamoff IHDR_DATA_OFFSET = 8 + 4 + 4;
+
+	constexpr uint8_t FILTER_SUB = 1;
+
+	constexpr std::size_t COMPRESSED_BUFFER_SIZE = 256 * 1024;
+
+	void put_uint32(uint8_t* buffer, uint32_t value)
+	{
+		buffer[0] = static_cast<uint8_t>(value >> 24);
+		buffer[1] = static_cast<uint8_t>(value >> 16);
+		buffer[2] = static_cast<uint8_t>(value >> 8);
+		buffer[3] = static_cast<uint8_t>(value);
+	}
+
+	void make_ihdr(uint8_t* ihdr, std::size_t width, std::size_t height)
+	{
+		put_uint32(ihdr, static_cast<uint32_t>(width));
+		put_uint32(ihdr + 4, static_cast<uint32_t>(height));
+		ihdr[8] = 8;	// bit depth
+		ihdr[9] = 2;	// color type: RGB
+		ihdr[10] = 0;	// compression
+		ihdr[11] = 0;	// filter
+		ihdr[12] = 0;	// interlace
+	}
+}
+
+
+cStreamingPngWriter::cStreamingPngWriter()
+{
+	std::memset(&mZStream, 0, sizeof(mZStream));
+}
+
+cStreamingPngWriter::~cStreamingPngWriter()
+{
+	if (mZStreamActive)
+		deflateEnd(&mZStream);
+}
+
+void cStreamingPngWriter::open(std::filesystem::path filename, std::size_t width)
+{
+	if (isOpen())
+		close();
+
+	if (width == 0)
+		throw std::invalid_argument("A PNG image must be at least one pixel wide.");
+
+	mFilename = filename;
+	mFile.open(mFilename, std::ios_base::binary | std::ios_base::trunc);
+
+	if (!mFile.is_open())
+	{
+		std::string msg = "Could not open: ";
+		msg += mFilename.string();
+		throw std::runtime_error(msg);
+	}
+
+	mWidth = width;
+	mRowSize = 1 + 3 * mWidth;
+	mNumRows = 0;
+	mRowsInStrip = 0;
+
+	mStrip.resize(mStripRows * mRowSize);
+	mCompressed.resize(COMPRESSED_BUFFER_SIZE);
+
+	std::memset(&mZStream, 0, sizeof(mZStream));
+	if (deflateInit(&mZStream, 3) != Z_OK)
+		throw std::runtime_error("Could not initialize the PNG compressor.");
+
+	mZStreamActive = true;
+
+	mFile.write(reinterpret_cast<const char*>(PNG_SIGNATURE), sizeof(PNG_SIGNATURE));
+
+	uint8_t ihdr[IHDR_SIZE];
+	make_ihdr(ihdr, mWidth, 0);
+
+	writeChunk("IHDR", ihdr, IHDR_SIZE);
+}
+
+uint8_t* cStreamingPngWriter::nextRow()
+{
+	if (mRowsInStrip == mStripRows)
+		flushStrip(Z_NO_FLUSH);
+
+	uint8_t* row = mStrip.data() + mRowsInStrip * mRowSize;
+	row[0] = FILTER_SUB;
+
+	++mRowsInStrip;
+	++mNumRows;
+
+	return row + 1;
+}
+
+void cStreamingPngWriter::close()
+{
+	if (!isOpen())
+		return;
+
+	flushStrip(Z_FINISH);
+
+	deflateEnd(&mZStream);
+	mZStreamActive = false;
+
+	writeChunk("IEND", nullptr, 0);
+
+	// Now that the height is known, patch it and the CRC of the IHDR chunk
+	uint8_t ihdr[IHDR_SIZE];
+	make_ihdr(ihdr, mWidth, mNumRows);
+
+	uint8_t crc[4];
+	put_uint32(crc, static_cast<uint32_t>(crc32(crc32(0, reinterpret_cast<const Bytef*>("IHDR"), 4), ihdr, IHDR_SIZE)));
+
+	mFile.seekp(IHDR_DATA_OFFSET);
+	mFile.write(reinterpret_cast<const char*>(ihdr), IHDR_SIZE);
+	mFile.write(reinterpret_cast<const char*>(crc), sizeof(crc));
+
+	const bool ok = static_cast<bool>(mFile);
+	mFile.close();
+
+	mStrip.clear();
+	mStrip.shrink_to_fit();
+	mCompressed.clear();
+	mCompressed.shrink_to_fit();
+
+	if (!ok)
+	{
+		std::string msg = "Could not write to: ";
+		msg += mFilename.string();
+		throw std::runtime_error(msg);
+	}
+}
+
+void cStreamingPngWriter::flushStrip(int flush)
+{
+	// Apply the sub filter, from the right so each byte still sees its unfiltered neighbour
+	for (std::size_t r = 0; r < mRowsInStrip; ++r)
+	{
+		uint8_t* row = mStrip.data() + r * mRowSize + 1;
+
+		for (std::size_t i = mRowSize - 2; i >= 3; --i)
+			row[i] = static_cast<uint8_t>(row[i] - row[i - 3]);
+	}
+
+	mZStream.next_in = mStrip.data();
+	mZStream.avail_in = static_cast<uInt>(mRowsInStrip * mRowSize);
+
+	int result = Z_OK;
+
+	do
+	{
+		mZStream.next_out = mCompressed.data();
+		mZStream.avail_out = static_cast<uInt>(mCompressed.size());
+
+		result = deflate(&mZStream, flush);
+
+		if (result == Z_STREAM_ERROR)
+			throw std::runtime_error("The PNG compressor failed.");
+
+		const std::size_t size = mCompressed.size() - mZStream.avail_out;
+		if (size > 0)
+			writeChunk("IDAT", mCompressed.data(), size);
+
+	} while ((mZStream.avail_out == 0) || ((flush == Z_FINISH) && (result != Z_STREAM_END)));
+
+	mRowsInStrip = 0;
+}
+
+void cStreamingPngWriter::writeChunk(const char* type, const uint8_t* data, std::size_t size)
+{
+	uint8_t header[8];
+	put_uint32(header, static_cast<uint32_t>(size));
+	std::memcpy(header + 4, type, 4);
+
+	uLong crc = crc32(0, header + 4, 4);
+	if (size > 0)
+		crc = crc32(crc, data, static_cast<uInt>(size));
+
+	uint8_t footer[4];
+	put_uint32(footer, static_cast<uint32_t>(crc));
+
+	mFile.write(reinterpret_cast<const char*>(header), sizeof(header));
+	if (size > 0)
+		mFile.write(reinterpret_cast<const char*>(data), size);
+	mFile.write(reinterpret_cast<const char*>(footer), sizeof(footer));
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <zlib.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+
+/**
+ * Writes an 8-bit RGB PNG image one row at a time.
+ *
+ * Rows are collected into a strip and each full strip is compressed into
+ * IDAT chunks, so only one strip is ever held in memory no matter how many
+ * rows the image has.  The height of a scan is not known until it ends, so
+ * the IHDR chunk is written with a height of zero and patched when the
+ * image is closed.
+ */
+class cStreamingPngWriter
+{
+public:
+	static constexpr std::size_t DEFAULT_STRIP_ROWS = 64;
+
+public:
+	cStreamingPngWriter();
+	~cStreamingPngWriter();
+
+	cStreamingPngWriter(const cStreamingPngWriter&) = delete;
+	cStreamingPngWriter& operator=(const cStreamingPngWriter&) = delete;
+
+	void open(std::filesystem::path filename, std::size_t width);
+	bool isOpen() const { return mFile.is_open(); }
+
+	std::size_t width() const { return mWidth; }
+	std::size_t rows() const { return mNumRows; }
+
+	/**
+	 * Returns the next row of the image to be filled in with width RGB
+	 * triplets.  The row is only valid until the next call.
+	 */
+	uint8_t* nextRow();
+
+	/**
+	 * Write the remaining rows and finish the image.
+	 */
+	void close();
+
+private:
+	void flushStrip(int flush);
+	void writeChunk(const char* type, const uint8_t* data, std::size_t size);
+
+private:
+	std::size_t mStripRows = DEFAULT_STRIP_ROWS;
+
+	std::size_t mWidth = 0;
+	std::size_t mRowSize = 0;
+	std::size_t mNumRows = 0;
+	std::size_t mRowsInStrip = 0;
+
+	std::vector<uint8_t> mStrip;
+	std::vector<uint8_t> mCompressed;
+
+	z_stream mZStream;
+	bool mZStreamActive = false;
+
+	std::filesystem::path mFilename;
+	std::ofstream mFile;
+};
@@ -0,0 +1,144 @@
+
+#include "DollyPrior.hpp"
+
+#include "KinematicUtils.hpp"
+#include "Constants.hpp"
+
+#include <cmath>
+#include <deque>
+
+
+namespace
+{
+    /// The noise of a SpiderCam position
+    const double SPIDERCAM_VARIANCE_MM2 = 5.0 * 5.0;
+
+    /// The change of the dolly velocity that the prior allows for
+    const double DOLLY_ACCELERATION_MMPS2 = 500.0;
+
+    /// Same rotation as the orientation kinematics of the dolly
+    Eigen::Matrix3d sensorToDolly(const kdt::sDollyAtitude_t& mount)
+    {
+        Eigen::AngleAxisd rollAngle(-mount.roll_deg * nConstants::DEG_TO_RAD, Eigen::Vector3d::UnitX());
+        Eigen::AngleAxisd yawAngle(-mount.yaw_deg * nConstants::DEG_TO_RAD, Eigen::Vector3d::UnitZ());
+        Eigen::AngleAxisd pitchAngle(-mount.pitch_deg * nConstants::DEG_TO_RAD, Eigen::Vector3d::UnitY());
+
+        Eigen::Quaterniond q = pitchAngle * rollAngle * yawAngle;
+        return q.matrix();
+    }
+}
+
+void cDollyPrior::clear()
+{
+    mUseGps = true;
+    mHasSample = false;
+    mHasVelocity = false;
+    mVelocity_mmps.setZero();
+    mHasFrame = false;
+    mFramePeriod_sec = 0.0;
+}
+
+void cDollyPrior::setMountAngles(const kdt::sDollyAtitude_t& mount)
+{
+    mMountRotation = sensorToDolly(mount);
+}
+
+bool cDollyPrior::addFrame(double time_sec, const std::vector<sDollySample>& samples,
+    LidarSlam::ExternalSensors::PoseMeasurement& pose)
+{
+    if (mHasFrame && (time_sec > mFrameTime_sec))
+        mFramePeriod_sec = time_sec - mFrameTime_sec;
+
+    mHasFrame = true;
+    mFrameTime_sec = time_sec;
+
+    // The newest position read before the frame, from the SpiderCam if it reports
+    const sDollySample* newest = nullptr;
+    for (const auto& sample : samples)
+    {
+        if (!sample.gps && mUseGps)
+        {
+            // Do not mix the GPS and SpiderCam positions in a velocity
+            mUseGps = false;
+            mHasSample = false;
+            mHasVelocity = false;
+        }
+
+        if (sample.gps == mUseGps)
+            newest = &sample;
+    }
+
+    if (newest && newest->gps && !mUseGps)
+        newest = nullptr;
+
+    if (newest)
+        updateVelocity(time_sec, *newest);
+
+    if (!mHasSample || !mHasVelocity)
+        return false;
+
+    // Carry the last position over the frames without one
+    const double dt_sec = time_sec - mSampleTime_sec;
+
+    Eigen::Vector3d position_mm(mSample.x_mm, mSample.y_mm, mSample.z_mm);
+    position_mm += mVelocity_mmps * dt_sec;
+
+    // A position is up to one frame period older than the frame it is stamped with
+    Eigen::Matrix3d covariance_mm2 = Eigen::Matrix3d::Identity() * mSample.variance_mm2;
+    covariance_mm2 += mVelocity_mmps * mVelocity_mmps.transpose() * (mFramePeriod_sec * mFramePeriod_sec / 12.0);
+
+    // The velocity may have changed since the last position
+    const double drift_mm = 0.5 * DOLLY_ACCELERATION_MMPS2 * dt_sec * dt_sec;
+    covariance_mm2 += Eigen::Matrix3d::Identity() * (drift_mm * drift_mm);
+
+    pose.Time = time_sec;
+    pose.Pose = Eigen::Isometry3d::Identity();
+    pose.Pose.linear() = mMountRotation;
+    pose.Pose.translation() = position_mm * nConstants::MM_TO_M;
+    pose.Covariance = Eigen::Matrix6d::Zero();
+    pose.Covariance.topLeftCorner<3, 3>() = covariance_mm2 * (nConstants::MM_TO_M * nConstants::MM_TO_M);
+
+    return true;
+}
+
+void cDollyPrior::updateVelocity(double time_sec, const sDollySample& sample)
+{
+    if (mHasSample && (time_sec > mSampleTime_sec))
+    {
+        // The kinematics use timestamps in units of 0.1 us
+        nSpiderCamTypes::sPosition_t start;
+        start.X_mm = static_cast<decltype(start.X_mm)>(std::lround(mSample.x_mm));
+        start.Y_mm = static_cast<decltype(start.Y_mm)>(std::lround(mSample.y_mm));
+        start.Z_mm = static_cast<decltype(start.Z_mm)>(std::lround(mSample.z_mm));
+        start.timestamp = static_cast<decltype(start.timestamp)>(std::llround(mSampleTime_sec * 1.0e7));
+
+        nSpiderCamTypes::sPosition_t end;
+        end.X_mm = static_cast<decltype(end.X_mm)>(std::lround(sample.x_mm));
+        end.Y_mm = static_cast<decltype(end.Y_mm)>(std::lround(sample.y_mm));
+        end.Z_mm = static_cast<decltype(end.Z_mm)>(std::lround(sample.z_mm));
+        end.timestamp = static_cast<decltype(end.timestamp)>(std::llround(time_sec * 1.0e7));
+
+        std::deque<nSpiderCamTypes::sPosition_t> segment = { start, end };
+
+        auto dolly = computeDollyKinematics(segment, 0, 1);
+
+        if (dolly.size() == 2)
+        {
+            mVelocity_mmps = { dolly.front().vx_mmps, dolly.front().vy_mmps, dolly.front().vz_mmps };
+            mHasVelocity = true;
+        }
+    }
+    else if (mHasSample)
+    {
+        // Two positions for the same frame, keep the newest
+        mSample = sample;
+        return;
+    }
+
+    mHasSample = true;
+    mSampleTime_sec = time_sec;
+    mSample = sample;
+
+    if (!sample.gps)
+        mSample.variance_mm2 = SPIDERCAM_VARIANCE_MM2;
+}
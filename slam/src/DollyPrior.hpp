@@ -0,0 +1,80 @@
+#pragma once
+
+#include "ExternalSensorManagers.h"
+
+#include "KinematicDataTypes.hpp"
+
+#include <cbdf/SpiderCamInfoTypes.hpp>
+
+#include <vector>
+
+
+/**
+ * A position of the dolly in the RAPP south/east/up frame, from the SpiderCam
+ * or from the GPS receiver.
+ */
+struct sDollySample
+{
+    double x_mm = 0.0;
+    double y_mm = 0.0;
+    double z_mm = 0.0;
+
+    /// The variance of each coordinate of the position
+    double variance_mm2 = 0.0;
+
+    bool gps = false;
+};
+
+
+/**
+ * Predicts the pose of the LiDAR at the time of each frame from the dolly
+ * positions, to seed the ego-motion of the SLAM.
+ *
+ * The positions carry no time of their own in the recording, so each one is
+ * stamped with the time of the frame read after it, and only the newest one
+ * before a frame is kept.  The dolly velocity between two positions comes
+ * from computeDollyKinematics() and carries the pose over the frames read
+ * without a new position.  The SpiderCam positions are used when there are
+ * any, the GPS positions otherwise.
+ *
+ * The covariance of each pose accounts for the position noise, the frame
+ * period by which a position may be late, and a change of velocity since
+ * the last position, so the SLAM can restrict its matching to it.
+ *
+ * The dolly does not rotate: the orientation of the pose is the mounting
+ * of the LiDAR on the dolly.
+ */
+class cDollyPrior
+{
+public:
+    void clear();
+
+    void setMountAngles(const kdt::sDollyAtitude_t& mount);
+
+    /**
+     * The pose of the LiDAR at time_sec, the time of a frame, given the
+     * dolly positions read since the previous frame.  Returns false until
+     * the velocity of the dolly is known.
+     */
+    bool addFrame(double time_sec, const std::vector<sDollySample>& samples,
+        LidarSlam::ExternalSensors::PoseMeasurement& pose);
+
+private:
+    void updateVelocity(double time_sec, const sDollySample& sample);
+
+private:
+    Eigen::Matrix3d mMountRotation = Eigen::Matrix3d::Identity();
+
+    bool mUseGps = true;
+
+    bool mHasSample = false;
+    double mSampleTime_sec = 0.0;
+    sDollySample mSample;
+
+    bool mHasVelocity = false;
+    Eigen::Vector3d mVelocity_mmps = Eigen::Vector3d::Zero();
+
+    bool mHasFrame = false;
+    double mFrameTime_sec = 0.0;
+    double mFramePeriod_sec = 0.0;
+};
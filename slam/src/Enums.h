@@ -152,6 +152,20 @@ enum class SamplingMode
   CENTROID = 4
 };
 
+//------------------------------------------------------------------------------
+//! How the rolling grid stores its voxels
+enum class VoxelGridStorage
+{
+  //! Hash map of the outer voxels, each holding a hash map of its inner voxels
+  NESTED_HASH = 0,
+
+  //! Single open-addressing hash table of the inner voxels keyed by their
+  //! packed coordinates, with the points stored contiguously.
+  //! Rolling the grid does not move the voxels that stay in it and the
+  //! sub-map KD-tree is only rebuilt when the voxels in its region change.
+  FLAT_HASH = 1
+};
+
 //------------------------------------------------------------------------------
 //! External sensors' references
 enum ExternalSensor
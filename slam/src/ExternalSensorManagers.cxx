@@ -513,8 +513,11 @@ bool PoseManager::ComputeSynchronizedMeasure(double lidarTime, PoseMeasurement&
   // Interpolate external pose at LiDAR timestamp
   synchMeas.Time = lidarTime;
   synchMeas.Pose = LinearInterpolation(bounds.first->Pose, bounds.second->Pose, lidarTime, bounds.first->Time, bounds.second->Time);
-  // No covariance is attached to pose measurement for now
-  // if one is added, it should be rotated here if one uses it in an external pose graph
+  // The covariance is interpolated as is, and kept from the closest measure when extrapolating
+  // it should be rotated here if one uses it in an external pose graph
+  double duration = bounds.second->Time - bounds.first->Time;
+  double w = duration > 0. ? std::min(std::max((lidarTime - bounds.first->Time) / duration, 0.), 1.) : 1.;
+  synchMeas.Covariance = (1. - w) * bounds.first->Covariance + w * bounds.second->Covariance;
 
   return true;
 }
@@ -74,8 +74,9 @@ struct PoseMeasurement
 {
   double Time = 0.;
   Eigen::Isometry3d Pose = Eigen::Isometry3d::Identity();
-  // No covariance is attached to pose measurement for now
-  // Constant one can be used for pose graph optimizations
+  // Covariance of the pose (XYZRPY), zero if unknown
+  // It is only used to weigh the pose as a prior of the ego-motion
+  Eigen::Matrix6d Covariance = Eigen::Matrix6d::Zero();
 };
 
 // ---------------------------------------------------------------------------
@@ -23,6 +23,32 @@ cFileProcessor::~cFileProcessor()
     mFileReader.close();
 }
 
+void cFileProcessor::setFlatVoxelMap(bool flat)
+{
+    mConverter->setVoxelGridStorage(flat ? LidarSlam::VoxelGridStorage::FLAT_HASH
+                                         : LidarSlam::VoxelGridStorage::NESTED_HASH);
+}
+
+void cFileProcessor::setDollyPrior(bool enable)
+{
+    mConverter->setDollyPrior(enable);
+}
+
+void cFileProcessor::setMapOutput(bool enable, double voxelSize_m)
+{
+    mConverter->setMapOutput(enable, voxelSize_m);
+}
+
+void cFileProcessor::setCheckpointInterval(uint32_t frames)
+{
+    mConverter->setCheckpointInterval(frames);
+}
+
+void cFileProcessor::setResume(bool resume)
+{
+    mConverter->setResume(resume);
+}
+
 bool cFileProcessor::open(std::filesystem::directory_entry in,
 							std::filesystem::path out)
 {
@@ -30,13 +56,13 @@ bool cFileProcessor::open(std::filesystem::directory_entry in,
 
     std::filesystem::path outFile  = out.replace_extension();
     std::filesystem::path testFile = outFile;
-    testFile.replace_extension(".0.ply");
+    testFile.replace_extension(".map.ply");
     if (std::filesystem::exists(testFile))
     {
         return false;
     }
 
-//BAF    mConverter->setOutputPath(outFile);
+    mConverter->setOutputPath(outFile);
 
     mFileReader.open(mInputFile.string());
 
@@ -69,6 +95,9 @@ void cFileProcessor::run()
     mFileReader.attach(static_cast<cSpidercamParser*>(p));
     mFileReader.attach(static_cast<cSsnxParser*>(p));
 
+    // This thread is the reader stage of the SLAM pipeline
+    p->start();
+
 	try
     {
         while (!mFileReader.eof())
@@ -76,7 +105,14 @@ void cFileProcessor::run()
             if (mFileReader.fail())
             {
                 mFileReader.close();
-                return;
+                break;
+            }
+
+            // A stage of the SLAM has stopped on an error
+            if (p->stopped())
+            {
+                mFileReader.close();
+                break;
             }
 
             mFileReader.processBlock();
@@ -112,6 +148,8 @@ void cFileProcessor::run()
         msg += e.what();
         console_message(msg);
     }
+
+    p->finish();
 }
 
 
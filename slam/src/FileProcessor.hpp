@@ -17,6 +17,28 @@ public:
 	cFileProcessor();
 	~cFileProcessor();
 
+	/**
+	 * Store the SLAM maps in a flat hash table instead of nested hash maps.
+	 */
+	void setFlatVoxelMap(bool flat);
+
+	/**
+	 * Seed the SLAM pose of each frame from the positions of the dolly.
+	 */
+	void setDollyPrior(bool enable);
+
+	/**
+	 * Write the SLAM map as tiles and merge them into <output>.map.ply.
+	 */
+	void setMapOutput(bool enable, double voxelSize_m);
+
+	/**
+	 * Save the SLAM state every given number of frames, and resume from
+	 * the last saved state of the output file.
+	 */
+	void setCheckpointInterval(uint32_t frames);
+	void setResume(bool resume);
+
 	bool open(std::filesystem::directory_entry in, 
 				std::filesystem::path out);
 
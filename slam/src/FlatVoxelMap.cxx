@@ -0,0 +1,118 @@
+#include "FlatVoxelMap.h"
+
+#include <algorithm>
+
+namespace LidarSlam
+{
+
+namespace
+{
+  //! Bits used by each packed outer voxel coordinate
+  constexpr int OUTER_BITS = 21;
+  constexpr int64_t OUTER_BIAS = int64_t(1) << (OUTER_BITS - 1);
+  constexpr uint64_t OUTER_MASK = (uint64_t(1) << OUTER_BITS) - 1;
+
+  //! Smallest table allocated on the first insertion
+  constexpr std::size_t MIN_SLOTS = 1024;
+}
+
+//------------------------------------------------------------------------------
+uint64_t FlatVoxelMap::PackOuter(const Eigen::Array3i& coord)
+{
+  uint64_t x = static_cast<uint64_t>(coord.x() + OUTER_BIAS) & OUTER_MASK;
+  uint64_t y = static_cast<uint64_t>(coord.y() + OUTER_BIAS) & OUTER_MASK;
+  uint64_t z = static_cast<uint64_t>(coord.z() + OUTER_BIAS) & OUTER_MASK;
+  return x | (y << OUTER_BITS) | (z << (2 * OUTER_BITS));
+}
+
+//------------------------------------------------------------------------------
+Eigen::Array3i FlatVoxelMap::UnpackOuter(uint64_t outer)
+{
+  int x = static_cast<int>(static_cast<int64_t>(outer & OUTER_MASK) - OUTER_BIAS);
+  int y = static_cast<int>(static_cast<int64_t>((outer >> OUTER_BITS) & OUTER_MASK) - OUTER_BIAS);
+  int z = static_cast<int>(static_cast<int64_t>((outer >> (2 * OUTER_BITS)) & OUTER_MASK) - OUTER_BIAS);
+  return {x, y, z};
+}
+
+//------------------------------------------------------------------------------
+void FlatVoxelMap::Clear()
+{
+  this->Voxels.clear();
+  this->Slots.clear();
+}
+
+//------------------------------------------------------------------------------
+int FlatVoxelMap::Find(const Key& key) const
+{
+  if (this->Slots.empty())
+    return -1;
+
+  const std::size_t mask = this->Slots.size() - 1;
+  for (std::size_t slot = this->Hash(key); ; slot = (slot + 1) & mask)
+  {
+    int index = this->Slots[slot];
+    if (index < 0)
+      return -1;
+    if (this->Voxels[index].key == key)
+      return index;
+  }
+}
+
+//------------------------------------------------------------------------------
+int FlatVoxelMap::Insert(const Key& key, bool& added)
+{
+  // Keep the table at most half full so that probe sequences stay short
+  if (2 * (this->Voxels.size() + 1) > this->Slots.size())
+    this->Rehash(std::max(MIN_SLOTS, 2 * this->Slots.size()));
+
+  const std::size_t mask = this->Slots.size() - 1;
+  std::size_t slot = this->Hash(key);
+  for (; this->Slots[slot] >= 0; slot = (slot + 1) & mask)
+  {
+    if (this->Voxels[this->Slots[slot]].key == key)
+    {
+      added = false;
+      return this->Slots[slot];
+    }
+  }
+
+  int index = static_cast<int>(this->Voxels.size());
+  this->Voxels.emplace_back();
+  this->Voxels.back().key = key;
+  this->Slots[slot] = index;
+
+  added = true;
+  return index;
+}
+
+//------------------------------------------------------------------------------
+std::size_t FlatVoxelMap::Hash(const Key& key) const
+{
+  // splitmix64 finalizer of both parts of the key
+  uint64_t h = key.Outer ^ (static_cast<uint64_t>(key.Inner) * 0x9E3779B97F4A7C15ull);
+  h ^= h >> 30;
+  h *= 0xBF58476D1CE4E5B9ull;
+  h ^= h >> 27;
+  h *= 0x94D049BB133111EBull;
+  h ^= h >> 31;
+  return static_cast<std::size_t>(h) & (this->Slots.size() - 1);
+}
+
+//------------------------------------------------------------------------------
+void FlatVoxelMap::Rehash(std::size_t nbSlots)
+{
+  this->Slots.assign(nbSlots, -1);
+  if (nbSlots == 0)
+    return;
+
+  const std::size_t mask = nbSlots - 1;
+  for (std::size_t i = 0; i < this->Voxels.size(); ++i)
+  {
+    std::size_t slot = this->Hash(this->Voxels[i].key);
+    while (this->Slots[slot] >= 0)
+      slot = (slot + 1) & mask;
+    this->Slots[slot] = static_cast<int>(i);
+  }
+}
+
+} // end of LidarSlam namespace
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "LidarPoint.h"
+
+#include <Eigen/Core>
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace LidarSlam
+{
+
+/*!
+ * @brief Voxels of a rolling grid stored in a single contiguous array and
+ * indexed by a single open-addressing hash table.
+ *
+ * A voxel is keyed by the absolute coordinates of its outer voxel, packed in
+ * 64 bits, and by the index of its inner (sampling) voxel. As the coordinates
+ * are absolute, rolling the grid does not change the keys of the voxels that
+ * remain in it.
+ *
+ * The table uses linear probing and is kept at most half full. Removing voxels
+ * compacts the array and rebuilds the table.
+ */
+class FlatVoxelMap
+{
+public:
+
+  using Point = LidarPoint;
+
+  struct Key
+  {
+    uint64_t Outer = 0;
+    uint32_t Inner = 0;
+
+    bool operator==(const Key& other) const { return (this->Outer == other.Outer) && (this->Inner == other.Inner); }
+  };
+
+  struct Voxel
+  {
+    Point point;
+    unsigned int count = 0;
+    //! Last Add() of the rolling grid that reached this voxel
+    unsigned int stamp = 0;
+    Key key;
+  };
+
+  //! Pack absolute outer voxel coordinates, each in [-2^20, 2^20)
+  static uint64_t PackOuter(const Eigen::Array3i& coord);
+  static Eigen::Array3i UnpackOuter(uint64_t outer);
+
+  //! Remove all voxels
+  void Clear();
+
+  std::size_t Size() const { return this->Voxels.size(); }
+  bool Empty() const { return this->Voxels.empty(); }
+
+  //! Get the index of the voxel with the given key, or -1 if there is none
+  int Find(const Key& key) const;
+
+  //! Get the index of the voxel with the given key, adding an empty voxel
+  //! if there is none. Indices remain valid until voxels are removed.
+  int Insert(const Key& key, bool& added);
+
+  Voxel& operator[](int index) { return this->Voxels[index]; }
+  const Voxel& operator[](int index) const { return this->Voxels[index]; }
+
+  //! Remove the voxels for which remove(voxel) is true
+  //! Return the number of removed voxels
+  template<typename Predicate>
+  std::size_t RemoveIf(Predicate remove)
+  {
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < this->Voxels.size(); ++i)
+    {
+      if (remove(this->Voxels[i]))
+        continue;
+      if (kept != i)
+        this->Voxels[kept] = std::move(this->Voxels[i]);
+      ++kept;
+    }
+
+    std::size_t removed = this->Voxels.size() - kept;
+    if (removed > 0)
+    {
+      this->Voxels.resize(kept);
+      this->Rehash(this->Slots.size());
+    }
+    return removed;
+  }
+
+  std::vector<Voxel>::const_iterator begin() const { return this->Voxels.begin(); }
+  std::vector<Voxel>::const_iterator end() const { return this->Voxels.end(); }
+
+private:
+
+  //! First slot to probe for a key
+  std::size_t Hash(const Key& key) const;
+
+  //! Rebuild the table with the given number of slots (a power of 2)
+  void Rehash(std::size_t nbSlots);
+
+  //! Voxels, in insertion order until some are removed
+  std::vector<Voxel> Voxels;
+
+  //! Index of the voxel in each slot of the table, -1 if the slot is empty
+  std::vector<int> Slots;
+};
+
+} // end of LidarSlam namespace
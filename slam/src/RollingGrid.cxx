@@ -54,7 +54,24 @@ void RollingGrid::Clear()
 {
   this->NbPoints = 0;
   this->Voxels.clear();
+  this->FlatVoxels.Clear();
   this->KdTree.Reset();
+  this->SubMapStale = false;
+  this->SubMapChanged = true;
+}
+
+//------------------------------------------------------------------------------
+void RollingGrid::SetStorage(VoxelGridStorage storage)
+{
+  if (storage == this->Storage)
+    return;
+
+  // Clear current voxel grid and fill the new storage back with its points
+  PointCloud::Ptr prevMap = this->Get();
+  this->Clear();
+  this->Storage = storage;
+  if (!prevMap->empty())
+    this->Add(prevMap);
 }
 
 //------------------------------------------------------------------------------
@@ -115,6 +132,17 @@ RollingGrid::PointCloud::Ptr RollingGrid::Get(bool clean) const
   // Merge all points into a single pointcloud
   PointCloud::Ptr pc(new PointCloud);
   pc->reserve(this->NbPoints);
+
+  if (this->Storage == VoxelGridStorage::FLAT_HASH)
+  {
+    for (const auto& voxel : this->FlatVoxels)
+    {
+      if (!clean || voxel.count > this->MinFramesPerVoxel)
+        pc->push_back(voxel.point);
+    }
+    return pc;
+  }
+
   // Loop on the outer voxels (rolling vg)
   for (const auto& kvOut : this->Voxels)
   {
@@ -151,6 +179,12 @@ void RollingGrid::Roll(const Eigen::Array3f& minPoint, const Eigen::Array3f& max
   if ((voxelsOffset == 0).all())
     return;
 
+  if (this->Storage == VoxelGridStorage::FLAT_HASH)
+  {
+    this->FlatRoll(voxelsOffset);
+    return;
+  }
+
   // Fill new voxel grid
   unsigned int newNbPoints = 0;
   RollingVG newVoxels;
@@ -191,6 +225,12 @@ void RollingGrid::Add(const PointCloud::Ptr& pointcloud, bool fixed, bool roll)
     this->Roll(minPoint.head<3>().cast<float>().array(), maxPoint.head<3>().cast<float>().array());
   }
 
+  if (this->Storage == VoxelGridStorage::FLAT_HASH)
+  {
+    this->FlatAdd(*pointcloud, fixed);
+    return;
+  }
+
   // Compute the 3D position of the center of the first voxel
   Eigen::Array3f voxelGridOrigin = this->VoxelGridPosition - int(this->GridSize / 2) * this->VoxelWidth;
 
@@ -346,6 +386,12 @@ void RollingGrid::Add(const PointCloud::Ptr& pointcloud, bool fixed, bool roll)
 //------------------------------------------------------------------------------
 void RollingGrid::ClearOldPoints(double currentTime)
 {
+  if (this->Storage == VoxelGridStorage::FLAT_HASH)
+  {
+    this->FlatClearOldPoints(currentTime);
+    return;
+  }
+
   // Loop on the outer voxels (rolling vg)
   auto itVoxelsOut = this->Voxels.begin();
   while(itVoxelsOut != this->Voxels.end())
@@ -378,6 +424,10 @@ void RollingGrid::BuildSubMapKdTree()
   this->SubMap = this->Get();
   // Build the internal KD-Tree for fast NN queries in map
   this->KdTree.Reset(this->SubMap);
+
+  // The sub-map is not restricted to a region
+  this->SubMapStale = false;
+  this->SubMapChanged = true;
 }
 
 //------------------------------------------------------------------------------
@@ -390,6 +440,12 @@ void RollingGrid::BuildSubMapKdTree(const Eigen::Array3f& minPoint, const Eigen:
   Eigen::Array3i intersectionMin = Utils::PositionToVoxel<Eigen::Array3f>(minPoint, voxelGridOrigin, this->VoxelWidth).max(0);
   Eigen::Array3i intersectionMax = Utils::PositionToVoxel<Eigen::Array3f>(maxPoint, voxelGridOrigin, this->VoxelWidth).min(this->GridSize - 1);
 
+  if (this->Storage == VoxelGridStorage::FLAT_HASH)
+  {
+    this->FlatBuildSubMapKdTree(intersectionMin, intersectionMax, minNbPoints);
+    return;
+  }
+
   // Intersection points
   this->SubMap.reset(new PointCloud);
   // reserve too much space to not have to reallocate memory
@@ -463,6 +519,217 @@ void RollingGrid::BuildSubMapKdTree(const Eigen::Array3f& minPoint, const Eigen:
   this->KdTree.Reset(this->SubMap);
 }
 
+//==============================================================================
+//   Flat hash storage
+//==============================================================================
+
+//------------------------------------------------------------------------------
+void RollingGrid::FlatRoll(const Eigen::Array3i& voxelsOffset)
+{
+  this->VoxelGridPosition += voxelsOffset.cast<float>() * this->VoxelWidth;
+
+  // The voxels are keyed by absolute coordinates, so only the ones that are
+  // now out of the grid have to be removed
+  Eigen::Array3i outerMin = this->OuterVoxelOrigin();
+  Eigen::Array3i outerMax = outerMin + (this->GridSize - 1);
+
+  this->FlatVoxels.RemoveIf([&](const FlatVoxelMap::Voxel& voxel)
+  {
+    Eigen::Array3i outerCoord = FlatVoxelMap::UnpackOuter(voxel.key.Outer);
+    if (((outerMin <= outerCoord) && (outerCoord <= outerMax)).all())
+      return false;
+
+    if (this->InSubMap(outerCoord))
+      this->SubMapChanged = true;
+    return true;
+  });
+
+  this->NbPoints = this->FlatVoxels.Size();
+}
+
+//------------------------------------------------------------------------------
+void RollingGrid::FlatAdd(const PointCloud& pointcloud, bool fixed)
+{
+  // Compute the 3D position of the center of the first voxel
+  Eigen::Array3f voxelGridOrigin = this->VoxelGridPosition - int(this->GridSize / 2) * this->VoxelWidth;
+  Eigen::Array3i outerOrigin = this->OuterVoxelOrigin();
+
+  // The inner voxel coordinates are relative to the center of the outer voxel,
+  // they are offset to be positive before being packed
+  const int innerBias = this->GridInSize;
+  const uint32_t innerWidth = 2 * this->GridInSize + 1;
+
+  const double stamp = Utils::PclStampToSec(pointcloud.header.stamp);
+
+  // Each voxel reached by this cloud is counted once
+  ++this->NbAdds;
+
+  // Voxels' states info (for CENTROID sampling mode) :
+  // mean point of current added points in each voxel
+  std::unordered_map<int, Voxel> meanPts;
+  // Boolean to check if the tree will need update
+  bool updated = false;
+  for (const Point& point : pointcloud)
+  {
+    // Find the outer voxel containing this point
+    Eigen::Array3i voxelCoordOut = Utils::PositionToVoxel<Eigen::Array3f>(point.getArray3fMap(), voxelGridOrigin, this->VoxelWidth);
+
+    // Skip the points out of the grid
+    if (!((0 <= voxelCoordOut) && (voxelCoordOut < this->GridSize)).all())
+      continue;
+
+    // Find the inner voxel containing this point
+    Eigen::Array3f voxelGridCenterIn = voxelCoordOut.cast<float>() * this->VoxelWidth + voxelGridOrigin;
+    Eigen::Array3i voxelCoordIn = Utils::PositionToVoxel<Eigen::Array3f>(point.getArray3fMap(), voxelGridCenterIn, this->LeafSize);
+
+    Eigen::Array3i outerCoord = voxelCoordOut + outerOrigin;
+    Eigen::Array3i innerCoord = voxelCoordIn + innerBias;
+
+    FlatVoxelMap::Key key;
+    key.Outer = FlatVoxelMap::PackOuter(outerCoord);
+    key.Inner = (innerCoord.z() * innerWidth + innerCoord.y()) * innerWidth + innerCoord.x();
+
+    bool added = false;
+    int index = this->FlatVoxels.Insert(key, added);
+    auto& voxel = this->FlatVoxels[index];
+
+    if (added)
+    {
+      voxel.point = point;
+      ++this->NbPoints;
+      updated = true;
+    }
+    else
+    {
+      // Check if the voxel contains a fixed point
+      if (voxel.point.label == 1)
+        continue;
+
+      if (this->Sampling == SamplingMode::CENTROID)
+      {
+        // Compute mean point of current added points in the voxel
+        Voxel& v = meanPts[index];
+        v.point.getVector3fMap() = (v.point.getVector3fMap() * v.count + point.getVector3fMap()) / (v.count + 1);
+        ++v.count;
+        updated = true;
+      }
+      else
+      {
+        Eigen::Vector3f voxelCenter = voxelGridCenterIn - this->VoxelWidth / 2.f + this->LeafSize * voxelCoordIn.cast<float>();
+        if (this->Resample(voxel.point, point, voxelCenter))
+          updated = true;
+      }
+    }
+
+    voxel.point.time = stamp + point.time;
+    voxel.point.label = fixed ? 1 : 0;
+
+    if (voxel.stamp != this->NbAdds)
+    {
+      ++voxel.count;
+      voxel.stamp = this->NbAdds;
+    }
+
+    if (this->InSubMap(outerCoord))
+      this->SubMapChanged = true;
+  }
+
+  // For centroid mode, the voxel point becomes the average of the mean points
+  for (const auto& kv : meanPts)
+  {
+    auto& voxel = this->FlatVoxels[kv.first];
+    voxel.point.getVector3fMap() = (voxel.point.getVector3fMap() * voxel.count + kv.second.point.getVector3fMap()) / (voxel.count + 1);
+  }
+
+  // The sub-map KD-tree is kept until it is rebuilt, in case none of the
+  // changes lie in its region
+  if (updated)
+    this->SubMapStale = true;
+}
+
+//------------------------------------------------------------------------------
+void RollingGrid::FlatClearOldPoints(double currentTime)
+{
+  this->FlatVoxels.RemoveIf([&](const FlatVoxelMap::Voxel& voxel)
+  {
+    // Only remove the voxels that are removable and too old
+    if (voxel.point.label || currentTime - voxel.point.time <= this->DecayingThreshold)
+      return false;
+
+    if (this->InSubMap(FlatVoxelMap::UnpackOuter(voxel.key.Outer)))
+      this->SubMapChanged = true;
+    return true;
+  });
+
+  this->NbPoints = this->FlatVoxels.Size();
+}
+
+//------------------------------------------------------------------------------
+void RollingGrid::FlatBuildSubMapKdTree(const Eigen::Array3i& intersectionMin, const Eigen::Array3i& intersectionMax, int minNbPoints)
+{
+  Eigen::Array3i outerOrigin = this->OuterVoxelOrigin();
+  Eigen::Array3i subMapMin = intersectionMin + outerOrigin;
+  Eigen::Array3i subMapMax = intersectionMax + outerOrigin;
+
+  // Keep the current KD-tree if it was built on the same region
+  // and none of the voxels in this region changed since
+  bool sameRegion = (subMapMin == this->SubMapMin).all() && (subMapMax == this->SubMapMax).all() &&
+                    (minNbPoints == this->SubMapMinNbPoints) &&
+                    (this->MinFramesPerVoxel == this->SubMapMinFramesPerVoxel);
+
+  if (sameRegion && !this->SubMapChanged && this->KdTree.GetInputCloud() && !this->KdTree.GetInputCloud()->empty())
+  {
+    this->SubMapStale = false;
+    return;
+  }
+
+  this->SubMapMin = subMapMin;
+  this->SubMapMax = subMapMax;
+  this->SubMapMinNbPoints = minNbPoints;
+  this->SubMapMinFramesPerVoxel = this->MinFramesPerVoxel;
+  this->SubMapChanged = false;
+  this->SubMapStale = false;
+
+  // Intersection points
+  this->SubMap.reset(new PointCloud);
+  // reserve too much space to not have to reallocate memory
+  this->SubMap->reserve(this->NbPoints);
+
+  // Reject moving objects if required
+  bool rejectMoving = (minNbPoints >= 0) && (this->MinFramesPerVoxel > 1);
+
+  for (const auto& voxel : this->FlatVoxels)
+  {
+    if (!this->InSubMap(FlatVoxelMap::UnpackOuter(voxel.key.Outer)))
+      continue;
+
+    // Check if enough points lie in the voxel
+    // or if the points are fixed before adding it
+    if (!rejectMoving || voxel.count >= this->MinFramesPerVoxel || voxel.point.label == 1)
+      this->SubMap->push_back(voxel.point);
+  }
+
+  // If the constraint was too strong remove the constraint
+  if (rejectMoving && int(this->SubMap->size()) < minNbPoints)
+  {
+    PRINT_WARNING("Moving objects constraint was too strong, removing constraint");
+    for (const auto& voxel : this->FlatVoxels)
+    {
+      if (!this->InSubMap(FlatVoxelMap::UnpackOuter(voxel.key.Outer)))
+        continue;
+
+      // Invert constraint to add the other points
+      if (voxel.count < this->MinFramesPerVoxel && voxel.point.label != 1)
+        this->SubMap->push_back(voxel.point);
+    }
+  }
+
+  if (this->SubMap->empty())
+    PRINT_WARNING("No intersecting voxels found with current scan");
+  // Build the internal KD-Tree for fast NN queries in sub-map
+  this->KdTree.Reset(this->SubMap);
+}
+
 //==============================================================================
 //   Helpers
 //==============================================================================
@@ -484,4 +751,57 @@ Eigen::Array3i RollingGrid::To3d(int voxelId1d, int gridSize) const
   return {x, y, z};
 }
 
+//------------------------------------------------------------------------------
+Eigen::Array3i RollingGrid::OuterVoxelOrigin() const
+{
+  // The grid position is a multiple of the voxel width
+  return (this->VoxelGridPosition / this->VoxelWidth).round().cast<int>() - int(this->GridSize / 2);
+}
+
+//------------------------------------------------------------------------------
+bool RollingGrid::Resample(Point& voxelPoint, const Point& point, const Eigen::Vector3f& voxelCenter) const
+{
+  switch(this->Sampling)
+  {
+    // Keep the first acquired keypoint in the voxel
+    case SamplingMode::FIRST:
+      return false;
+
+    // Use the last acquired keypoint in the voxel
+    case SamplingMode::LAST:
+      voxelPoint = point;
+      return true;
+
+    // Keep the keypoint with maximum intensity
+    case SamplingMode::MAX_INTENSITY:
+      if (point.intensity > voxelPoint.intensity)
+      {
+        voxelPoint = point;
+        return true;
+      }
+      return false;
+
+    // Keep the closest point to the voxel center
+    case SamplingMode::CENTER_POINT:
+      if ((point.getVector3fMap() - voxelCenter).norm() < (voxelPoint.getVector3fMap() - voxelCenter).norm())
+      {
+        voxelPoint = point;
+        return true;
+      }
+      return false;
+
+    // The centroid is computed over all the points added at once
+    case SamplingMode::CENTROID:
+      return false;
+  }
+
+  return false;
+}
+
+//------------------------------------------------------------------------------
+bool RollingGrid::InSubMap(const Eigen::Array3i& outerCoord) const
+{
+  return ((this->SubMapMin <= outerCoord) && (outerCoord <= this->SubMapMax)).all();
+}
+
 } // end of LidarSlam namespace
\ No newline at end of file
@@ -22,6 +22,7 @@
 #include "Enums.h"
 #include "LidarPoint.h"
 #include "KDTreePCLAdaptor.h"
+#include "FlatVoxelMap.h"
 #include <unordered_map>
 
 #define SetMacro(name,type) void Set##name (type _arg) { name = _arg; }
@@ -112,6 +113,11 @@ public:
   SetMacro(DecayingThreshold, double)
   GetMacro(DecayingThreshold, double)
 
+  //! Set how the voxels are stored
+  //! The points are moved to the new storage and the sub-map KD-tree is cleared.
+  void SetStorage(VoxelGridStorage storage);
+  GetMacro(Storage, VoxelGridStorage)
+
   // Check if keypoints time decaying is enabled
   bool IsTimeThreshold() const {return DecayingThreshold > 0;}
   //============================================================================
@@ -150,7 +156,7 @@ public:
 
   //! Check if the KD-tree built on top of the submap is valid or if it needs to be updated.
   //! The KD-tree is cleared every time the map is modified.
-  bool IsSubMapKdTreeValid() const {return this->KdTree.GetInputCloud() && !this->KdTree.GetInputCloud()->empty();}
+  bool IsSubMapKdTreeValid() const {return !this->SubMapStale && this->KdTree.GetInputCloud() && !this->KdTree.GetInputCloud()->empty();}
 
   //! Get the KD-Tree of the submap for fast NN queries
   const KDTree& GetSubMapKdTree() const {return this->KdTree;}
@@ -217,6 +223,26 @@ private:
   //! If negative, the keypoints are never removed
   double DecayingThreshold = -1;
 
+  //! How the voxels are stored
+  VoxelGridStorage Storage = VoxelGridStorage::NESTED_HASH;
+
+  //! Voxels of the FLAT_HASH storage
+  FlatVoxelMap FlatVoxels;
+
+  //! Number of calls to Add(), to count each voxel once per added cloud
+  unsigned int NbAdds = 0;
+
+  //! FLAT_HASH storage: the map changed since the sub-map KD-tree was built,
+  //! which is kept in case the change lies outside of its region
+  bool SubMapStale = false;
+  //! FLAT_HASH storage: a voxel in the region of the sub-map changed
+  bool SubMapChanged = true;
+  //! FLAT_HASH storage: absolute outer voxel bounds and settings of the sub-map
+  Eigen::Array3i SubMapMin = Eigen::Array3i::Zero();
+  Eigen::Array3i SubMapMax = Eigen::Array3i::Constant(-1);
+  int SubMapMinNbPoints = -1;
+  unsigned int SubMapMinFramesPerVoxel = 0;
+
 private:
 
   //! Conversion from 3D voxel index to 1D flattened index
@@ -224,6 +250,22 @@ private:
 
   //! Conversion from 1D flattened voxel index to 3D index
   Eigen::Array3i To3d(int voxelId1d, int gridSize) const;
+
+  //! Absolute coordinates of the outer voxel (0, 0, 0) of the grid
+  Eigen::Array3i OuterVoxelOrigin() const;
+
+  //! Choose the point to keep in an inner voxel when a new one reaches it,
+  //! for all sampling modes but CENTROID. Return true if the point changed.
+  bool Resample(Point& voxelPoint, const Point& point, const Eigen::Vector3f& voxelCenter) const;
+
+  //! Check if an absolute outer voxel lies in the region of the sub-map
+  bool InSubMap(const Eigen::Array3i& outerCoord) const;
+
+  //! FLAT_HASH storage counterparts of the main methods
+  void FlatRoll(const Eigen::Array3i& voxelsOffset);
+  void FlatAdd(const PointCloud& pointcloud, bool fixed);
+  void FlatClearOldPoints(double currentTime);
+  void FlatBuildSubMapKdTree(const Eigen::Array3i& intersectionMin, const Eigen::Array3i& intersectionMax, int minNbPoints);
 };
 
 } // end of LidarSlam namespace
\ No newline at end of file
@@ -72,6 +72,7 @@
 //   initial position. The output trajectory describes BASE origin in WORLD.
 
 // GENERIC
+#include <chrono>
 #include <ctime>
 
 // LOCAL
@@ -151,6 +152,7 @@ void Slam::InitMap(Keypoint k)
 {
   // Allocate map
   mLocalMaps[k] = std::make_shared<RollingGrid>();
+  mLocalMaps[k]->SetStorage(mVoxelGridStorage);
 
   // Set default maps parameters
   mLocalMaps[k]->SetVoxelResolution(10.);
@@ -194,6 +196,8 @@ void Slam::Reset(bool resetLog)
 
   // Reset pose uncertainty
   mLocalizationUncertainty = LocalOptimizer::RegistrationError();
+  mPriorPositionError = -1.;
+  mPriorSquaredInnovation = -1.;
 
   // Reset point clouds
   mCurrentFrames.clear();
@@ -274,6 +278,18 @@ bool Slam::KeypointTypeEnabled(Keypoint k) const
     return mUseKeypoints.at(k);
 }
 
+//-----------------------------------------------------------------------------
+void Slam::AddFrame(const PointCloud::Ptr& pc, const std::map<Keypoint, PointCloud::Ptr>& keypoints)
+{
+    mExtractedKeypoints = keypoints;
+    mUseExtractedKeypoints = true;
+
+    this->AddFrames({pc});
+
+    mUseExtractedKeypoints = false;
+    mExtractedKeypoints.clear();
+}
+
 //-----------------------------------------------------------------------------
 void Slam::AddFrames(const std::vector<PointCloud::Ptr>& frames)
 {
@@ -312,16 +328,29 @@ void Slam::AddFrames(const std::vector<PointCloud::Ptr>& frames)
                     " (at time " << mCurrentTime_sec << ")" << std::scientific);
     PRINT_VERBOSE(2, "#########################################################\n");
 
+    // Durations of the main steps
+    mLastFrameTimings = FrameTimings();
+    auto stepStart = std::chrono::steady_clock::now();
+    auto stepDuration = [&stepStart]()
+    {
+        auto now = std::chrono::steady_clock::now();
+        std::chrono::duration<double> duration = now - stepStart;
+        stepStart = now;
+        return duration.count();
+    };
+
     // Compute the edge and planar keypoints
     IF_VERBOSE(3, Utils::Timer::Init("Keypoints extraction"));
     this->ExtractKeypoints();
     IF_VERBOSE(3, Utils::Timer::StopAndDisplay("Keypoints extraction"));
+    mLastFrameTimings.KeypointsExtraction = stepDuration();
 
     // Estimate Trelative by extrapolating new pose with a constant velocity model
     // and/or registering current frame on previous one
     IF_VERBOSE(3, Utils::Timer::Init("Ego-Motion"));
     this->ComputeEgoMotion();
     IF_VERBOSE(3, Utils::Timer::StopAndDisplay("Ego-Motion"));
+    mLastFrameTimings.EgoMotion = stepDuration();
 
     if ((mWheelOdomManager && mWheelOdomManager->CanBeUsedLocally()) ||
         (mGravityManager && mGravityManager->CanBeUsedLocally()) ||
@@ -335,9 +364,11 @@ void Slam::AddFrames(const std::vector<PointCloud::Ptr>& frames)
 
     // Perform Localization : update Tworld from map and current frame keypoints
     // and optionally undistort keypoints clouds based on ego-motion
+    stepDuration();
     IF_VERBOSE(3, Utils::Timer::Init("Localization"));
     this->Localization();
     IF_VERBOSE(3, Utils::Timer::StopAndDisplay("Localization"));
+    mLastFrameTimings.Localization = stepDuration();
 
     // Compute and check pose confidence estimators
     // Must be set before maps update because the overlap computation
@@ -380,9 +411,11 @@ void Slam::AddFrames(const std::vector<PointCloud::Ptr>& frames)
             || mMapUpdate == MappingMode::UPDATE)
             && mIsKeyFrame)
         {
+            stepDuration();
             IF_VERBOSE(3, Utils::Timer::Init("Maps update"));
             this->UpdateMapsUsingTworld();
             IF_VERBOSE(3, Utils::Timer::StopAndDisplay("Maps update"));
+            mLastFrameTimings.MapsUpdate = stepDuration();
         }
 
         // Log current frame processing results : pose, covariance and keypoints.
@@ -451,6 +484,7 @@ void Slam::AddFrames(const std::vector<PointCloud::Ptr>& frames)
 
     // Frame processing duration
     mLatency_sec = Utils::Timer::Stop("SLAM frame processing");
+    mLastFrameTimings.Total = mLatency_sec;
     mNbrFrameProcessed++;
     IF_VERBOSE(1, Utils::Timer::StopAndDisplay("SLAM frame processing"));
 }
@@ -908,40 +942,54 @@ void Slam::ExtractKeypoints()
   // Current keypoints become previous ones
   mPreviousRawKeypoints = mCurrentRawKeypoints;
 
-  // Extract keypoints from each input cloud
   std::map<Keypoint, std::vector<PointCloud::Ptr>> keypoints;
-  for (const auto& frame: mCurrentFrames)
-  {
-    // If the frame is empty, ignore it
-    if (frame->empty())
-      continue;
 
-    // Get keypoints extractor to use for this LiDAR device
-    int lidarDevice = frame->front().device_id;
-    // Check if KE exists
-    if (!mKeyPointsExtractors.count(lidarDevice))
+  // The keypoints of the frame were extracted before it was added
+  if (mUseExtractedKeypoints)
+  {
+    for (auto k : mUsableKeypoints)
     {
-      // If KE does not exist but we are only using a single KE, use default one
-      if (mKeyPointsExtractors.size() == 1)
-      {
-        PRINT_WARNING("Input frame comes from LiDAR device " << lidarDevice
-                    << " but no keypoints extractor has been set for this device : using default extractor for device 0.");
-        lidarDevice = 0;
-      }
-      // Otherwise ignore frame
-      else
-      {
-        PRINT_ERROR("Input frame comes from LiDAR device " << lidarDevice
-                    << " but no keypoints extractor has been set for this device : ignoring frame.");
+      auto it = mExtractedKeypoints.find(k);
+      if ((it != mExtractedKeypoints.end()) && it->second)
+        keypoints[k].push_back(it->second);
+    }
+  }
+  else
+  {
+    // Extract keypoints from each input cloud
+    for (const auto& frame: mCurrentFrames)
+    {
+      // If the frame is empty, ignore it
+      if (frame->empty())
         continue;
+
+      // Get keypoints extractor to use for this LiDAR device
+      int lidarDevice = frame->front().device_id;
+      // Check if KE exists
+      if (!mKeyPointsExtractors.count(lidarDevice))
+      {
+        // If KE does not exist but we are only using a single KE, use default one
+        if (mKeyPointsExtractors.size() == 1)
+        {
+          PRINT_WARNING("Input frame comes from LiDAR device " << lidarDevice
+                      << " but no keypoints extractor has been set for this device : using default extractor for device 0.");
+          lidarDevice = 0;
+        }
+        // Otherwise ignore frame
+        else
+        {
+          PRINT_ERROR("Input frame comes from LiDAR device " << lidarDevice
+                      << " but no keypoints extractor has been set for this device : ignoring frame.");
+          continue;
+        }
       }
+      KeypointExtractorPtr& ke = mKeyPointsExtractors[lidarDevice];
+      ke->Enable(mUsableKeypoints);
+      // Extract keypoints from this frame
+      ke->ComputeKeyPoints(frame);
+      for (auto k : mUsableKeypoints)
+        keypoints[k].push_back(ke->GetKeypoints(k));
     }
-    KeypointExtractorPtr& ke = mKeyPointsExtractors[lidarDevice];
-    ke->Enable(mUsableKeypoints);
-    // Extract keypoints from this frame
-    ke->ComputeKeyPoints(frame);
-    for (auto k : mUsableKeypoints)
-      keypoints[k].push_back(ke->GetKeypoints(k));
   }
 
   // Merge all keypoints extracted from different frames together
@@ -1004,6 +1052,7 @@ void Slam::ComputeEgoMotion()
 
     // Reset ego-motion
     mTrelative = Eigen::Isometry3d::Identity();
+    mPriorPositionError = -1.;
 
     bool externalAvailable = false;
     // Linearly extrapolate previous motion to estimate new pose
@@ -1022,6 +1071,17 @@ void Slam::ComputeEgoMotion()
                     mTrelative = synchPreviousPoseMeas.Pose.inverse() * synchPoseMeas.Pose;
                     externalAvailable = true;
                     PRINT_VERBOSE(3, "Prior pose computed using external poses supplied");
+
+                    // Uncertainty of the predicted position, once the prediction
+                    // could be compared to the localization of previous frames
+                    if (mPriorSquaredInnovation >= 0.)
+                    {
+                        double variance = synchPreviousPoseMeas.Covariance.topLeftCorner<3, 3>().trace()
+                                        + synchPoseMeas.Covariance.topLeftCorner<3, 3>().trace();
+                        mPriorPositionError = std::sqrt(variance + mPriorSquaredInnovation);
+                    }
+                    else
+                        mPriorPositionError = std::numeric_limits<double>::infinity();
                 }
             }
         }
@@ -1199,6 +1259,7 @@ void Slam::Localization()
     // Integrate the relative motion to the world transformation
     // Store previous tworld for next iteration
     mTworld = mTworld * mTrelative;
+    const Eigen::Isometry3d predictedTworld = mTworld;
 
     // Init undistorted keypoints clouds from raw points
     // Warning : pointer copy = points modification :
@@ -1286,6 +1347,23 @@ void Slam::Localization()
 
     // Reset ICP results
     mTotalMatchedKeypoints = 0;
+    mLocalizationNbIterations = 0;
+
+    // With a precise prior, start matching within its uncertainty
+    // and only refine the matches as long as this range shrinks
+    unsigned int icpMaxIter = mLocalizationICPMaxIter;
+    double initSaturationDistance = mLocalizationInitSaturationDistance;
+    if (mLocalizationAdaptToPrior && mPriorPositionError >= 0. && icpMaxIter > 1 &&
+        mLocalizationInitSaturationDistance > mLocalizationFinalSaturationDistance)
+    {
+        initSaturationDistance = std::max(mLocalizationFinalSaturationDistance,
+                                          std::min(mLocalizationInitSaturationDistance, 3. * mPriorPositionError));
+        double ratio = (initSaturationDistance - mLocalizationFinalSaturationDistance)
+                     / (mLocalizationInitSaturationDistance - mLocalizationFinalSaturationDistance);
+        icpMaxIter = 1 + static_cast<unsigned int>(std::ceil(ratio * (mLocalizationICPMaxIter - 1)));
+        PRINT_VERBOSE(3, "Prior position uncertainty : " << mPriorPositionError << " m, "
+                         << icpMaxIter << " ICP iterations at most");
+    }
 
     // Init matching parameters
     KeypointsMatcher::Parameters matchingParams;
@@ -1304,9 +1382,10 @@ void Slam::Localization()
     // At each step of this loop an ICP matching is performed. Once the keypoints
     // are matched, we estimate the the 6-DOF parameters by minimizing the
     // non-linear least square cost function using Levenberg-Marquardt algorithm.
-    for (unsigned int icpIter = 0; icpIter < mLocalizationICPMaxIter; ++icpIter)
+    for (unsigned int icpIter = 0; icpIter < icpMaxIter; ++icpIter)
     {
         IF_VERBOSE(3, Utils::Timer::Init("  Localization : ICP"));
+        mLocalizationNbIterations = icpIter + 1;
 
         // We want to estimate our 6-DOF parameters using a non linear least square
         // minimization. The non linear part comes from the parametrization of the
@@ -1317,8 +1396,8 @@ void Slam::Localization()
 
         // Create a keypoints matcher
         // At each ICP iteration, the outliers removal is refined to be stricter
-        double iterRatio = icpIter / static_cast<double>(mLocalizationICPMaxIter - 1);
-        matchingParams.SaturationDistance = (1 - iterRatio) * mLocalizationInitSaturationDistance
+        double iterRatio = icpMaxIter > 1 ? icpIter / static_cast<double>(icpMaxIter - 1) : 1.;
+        matchingParams.SaturationDistance = (1 - iterRatio) * initSaturationDistance
             + iterRatio * mLocalizationFinalSaturationDistance;
 
         KeypointsMatcher matcher(matchingParams, mTworld);
@@ -1404,7 +1483,7 @@ void Slam::Localization()
         // that we reached a local minimum for the ICP-LM algorithm.
         // We evaluate the quality of the Tworld optimization using an approximate
         // computation of the variance covariance matrix.
-        if ((summary.num_successful_steps == 1) || (icpIter == mLocalizationICPMaxIter - 1))
+        if ((summary.num_successful_steps == 1) || (icpIter == icpMaxIter - 1))
         {
             mLocalizationUncertainty = optimizer.EstimateRegistrationError();
             break;
@@ -1413,6 +1492,16 @@ void Slam::Localization()
 
     IF_VERBOSE(3, Utils::Timer::StopAndDisplay("Localization : whole ICP-LM loop"));
 
+    // Track how far the external poses predicted the localized position
+    if (mPriorPositionError >= 0. && mValid)
+    {
+        double innovation2 = (mTworld.translation() - predictedTworld.translation()).squaredNorm();
+        if (mPriorSquaredInnovation < 0.)
+            mPriorSquaredInnovation = innovation2;
+        else
+            mPriorSquaredInnovation = 0.9 * mPriorSquaredInnovation + 0.1 * innovation2;
+    }
+
     // Optionally print localization optimization summary
     if (mVerbosity >= 2)
     {
@@ -2443,6 +2532,12 @@ double Slam::GetVoxelGridLeafSize(Keypoint k) const
     return mLocalMaps.at(k)->GetLeafSize();
 }
 
+//-----------------------------------------------------------------------------
+int Slam::GetVoxelGridSize() const
+{
+    return mLocalMaps.at(mUsableKeypoints.front())->GetGridSize();
+}
+
 //-----------------------------------------------------------------------------
 void Slam::SetVoxelGridSize(int size)
 {
@@ -2450,6 +2545,12 @@ void Slam::SetVoxelGridSize(int size)
         mLocalMaps[k]->SetGridSize(size);
 }
 
+//-----------------------------------------------------------------------------
+double Slam::GetVoxelGridResolution() const
+{
+    return mLocalMaps.at(mUsableKeypoints.front())->GetVoxelResolution();
+}
+
 //-----------------------------------------------------------------------------
 void Slam::SetVoxelGridResolution(double resolution)
 {
@@ -2464,6 +2565,14 @@ void Slam::SetVoxelGridMinFramesPerVoxel(unsigned int minFrames)
         mLocalMaps[k]->SetMinFramesPerVoxel(minFrames);
 }
 
+//-----------------------------------------------------------------------------
+void Slam::SetVoxelGridStorage(VoxelGridStorage storage)
+{
+    mVoxelGridStorage = storage;
+    for (auto& kmap : mLocalMaps)
+        kmap.second->SetStorage(storage);
+}
+
 //==============================================================================
 //   Memory parameters setting
 //==============================================================================
@@ -148,6 +148,16 @@ public:
     // current pose time, its frame id will be used if no other is specified, ...
     void AddFrames(const std::vector<PointCloud::Ptr>& frames);
 
+    // Add a new frame whose keypoints have already been extracted, for instance
+    // by a pipeline stage running ahead of the pose estimation.
+    // The keypoints are expected in LIDAR coordinates, as returned by the
+    // keypoints extractor, with one cloud for each enabled keypoint type.
+    // The remaining steps are the same as for AddFrame.
+    void AddFrame(const PointCloud::Ptr& pc, const std::map<Keypoint, PointCloud::Ptr>& keypoints);
+
+    // Get the pose of BASE in WORLD coordinates at the time of the last processed frame.
+    Eigen::Isometry3d GetWorldTransform() const { return mTworld; }
+
     // Get the computed world transform so far, but compensating SLAM computation duration latency.
     Eigen::Isometry3d GetLatencyCompensatedWorldTransform() const;
 
@@ -232,6 +242,19 @@ public:
 
     Getter(Latency_sec, double)
 
+    // [s] Durations of the main steps of the last processed frame,
+    // measured whatever the verbosity level
+    struct FrameTimings
+    {
+        double KeypointsExtraction = 0.;
+        double EgoMotion = 0.;
+        double Localization = 0.;
+        double MapsUpdate = 0.;
+        double Total = 0.;
+    };
+
+    Getter(LastFrameTimings, FrameTimings)
+
     // ---------------------------------------------------------------------------
     //   Graph parameters
     // ---------------------------------------------------------------------------
@@ -363,6 +386,18 @@ public:
     Getter(LocalizationFinalSaturationDistance, double)
     Setter(LocalizationFinalSaturationDistance, double)
 
+    // Restrict the localization ICP to the uncertainty of the ego-motion
+    // when it was predicted from external poses (see AddPoseMeasurement)
+    Getter(LocalizationAdaptToPrior, bool)
+    Setter(LocalizationAdaptToPrior, bool)
+
+    // [m] Uncertainty of the position predicted by external poses for the last
+    // frame, negative if the ego-motion did not use them
+    Getter(PriorPositionError, double)
+
+    // Number of ICP iterations of the last localization
+    Getter(LocalizationNbIterations, unsigned int)
+
     // External Sensor parameters
 
     // General
@@ -468,9 +503,13 @@ public:
     void ClearMaps();
     double GetVoxelGridLeafSize(Keypoint k) const;
     void SetVoxelGridLeafSize(Keypoint k, double size);
+    int GetVoxelGridSize() const;
     void SetVoxelGridSize(int size);
+    double GetVoxelGridResolution() const;
     void SetVoxelGridResolution(double resolution);
     void SetVoxelGridMinFramesPerVoxel(unsigned int minFrames);
+    Getter(VoxelGridStorage, VoxelGridStorage)
+    void SetVoxelGridStorage(VoxelGridStorage storage);
 
     // ---------------------------------------------------------------------------
     //   Confidence estimation
@@ -587,6 +626,9 @@ private:
     // It is used to reset the pose in case of failure
     Eigen::Isometry3d mTworldInit = Eigen::Isometry3d::Identity();
 
+    // [s] Durations of the main steps of the last processed frame
+    FrameTimings mLastFrameTimings;
+
     // Reflect the success of one SLAM iteration computation (used to log or not the state).
     bool mValid = true;
 
@@ -641,6 +683,11 @@ private:
     // Current frames (all raw input frames)
     std::vector<PointCloud::Ptr> mCurrentFrames;
 
+    // Keypoints of the current frame extracted before AddFrame was called,
+    // used instead of running the keypoints extractors
+    std::map<Keypoint, PointCloud::Ptr> mExtractedKeypoints;
+    bool mUseExtractedKeypoints = false;
+
     // Current aggregated points from all input frames, in WORLD coordinates (with undistortion if enabled)
     PointCloud::Ptr mRegisteredFrame;
 
@@ -685,6 +732,9 @@ private:
     // Keypoints local map
     std::map<Keypoint, std::shared_ptr<RollingGrid>> mLocalMaps;
 
+    // How the voxels of the local maps are stored
+    VoxelGridStorage mVoxelGridStorage = VoxelGridStorage::NESTED_HASH;
+
     // ---------------------------------------------------------------------------
     //   Optimization data
     // ---------------------------------------------------------------------------
@@ -839,6 +889,16 @@ private:
     double mLocalizationInitSaturationDistance = 2.0;
     double mLocalizationFinalSaturationDistance = 0.5;
 
+    // With a precise external pose prior, the localization starts with a
+    // saturation distance of 3 times its uncertainty and runs fewer ICP
+    // iterations. The uncertainty combines the covariance of the external
+    // poses and the mean squared distance between the predicted and the
+    // localized positions of the previous frames.
+    bool mLocalizationAdaptToPrior = false;
+    double mPriorPositionError = -1.;
+    double mPriorSquaredInnovation = -1.;
+    unsigned int mLocalizationNbIterations = 0;
+
     // ---------------------------------------------------------------------------
     //   Graph parameters
     // ---------------------------------------------------------------------------
@@ -0,0 +1,800 @@
+/**
+ * Measures the LiDAR SLAM on synthetic Ouster scans of a crop field.
+ *
+ * The scans are ray cast into a procedural field of crop rows, with an
+ * undulating ground and a few tall poles, from a sensor carried along a
+ * SpiderCam like trajectory.  Each frame goes through Slam::AddFrame and
+ * the benchmark reports the time spent in each step of the SLAM, the growth
+ * of the memory and of the maps, and the error of the estimated trajectory
+ * against the ground truth.
+ *
+ * The field, the trajectory and the range noise only depend on the seed,
+ * so two runs with the same options process the same scans.
+ *
+ * Usage: slam_benchmark [--frames N] [--seed N] [--trajectory line|serpentine|loop]
+ *                       [--speed m/s] [--height m] [--columns N] [--flat_map]
+ */
+
+#include "SlamParameters.hpp"
+
+#include "LidarPoint.h"
+
+#include <lyra/lyra.hpp>
+
+#include <Eigen/Geometry>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <numbers>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__linux__)
+#include <unistd.h>
+#include <fstream>
+#endif
+
+
+namespace
+{
+    constexpr double DEG_TO_RAD = std::numbers::pi / 180.0;
+
+    /// Ouster OS1-64 like sensor
+    constexpr int      NUM_RINGS = 64;
+    constexpr double   VERTICAL_FOV_DEG = 45.0;
+    constexpr double   FRAME_PERIOD_SEC = 0.1;
+    constexpr double   MIN_RANGE_M = 0.5;
+    constexpr double   MAX_RANGE_M = 50.0;
+    constexpr double   RANGE_NOISE_M = 0.01;
+
+    /// The crop rows run along x
+    constexpr double   ROW_SPACING_M = 0.76;
+    constexpr double   PLANT_SPACING_M = 0.3;
+    constexpr double   MAX_PLANT_HEIGHT_M = 0.9;
+
+    /// The ground stays within +/- this height of z = 0
+    constexpr double   GROUND_AMPLITUDE_M = 0.17;
+
+    constexpr double   POLE_SPACING_M = 20.0;
+    constexpr double   POLE_RADIUS_M = 0.15;
+    constexpr double   POLE_HEIGHT_M = 5.0;
+
+    /// Distance between the lanes of the serpentine and loop trajectories
+    constexpr double   LANE_SPACING_M = 4.0;
+    constexpr double   LANE_LENGTH_M = 30.0;
+
+    /// The dolly starts at rest and reaches its speed with this acceleration
+    constexpr double   START_ACCELERATION_MPS2 = 0.5;
+
+    /// The number of frames between progress reports
+    constexpr int      REPORT_INTERVAL = 50;
+
+    enum class eTrajectory { LINE, SERPENTINE, LOOP };
+
+    /// A value in [0, 1) that only depends on its arguments
+    double hash01(uint64_t seed, int64_t a, int64_t b, uint64_t salt)
+    {
+        uint64_t h = seed * 0x9E3779B97F4A7C15ull;
+        h ^= static_cast<uint64_t>(a) + 0x632BE59BD9B4E019ull + (h << 6) + (h >> 2);
+        h ^= static_cast<uint64_t>(b) + 0x85157AF5ull + (h << 6) + (h >> 2);
+        h ^= salt * 0xD6E8FEB86659FD93ull;
+
+        // splitmix64 finalizer
+        h ^= h >> 30;
+        h *= 0xBF58476D1CE4E5B9ull;
+        h ^= h >> 27;
+        h *= 0x94D049BB133111EBull;
+        h ^= h >> 31;
+
+        return static_cast<double>(h >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    struct sHit
+    {
+        double range = MAX_RANGE_M;
+        float intensity = 0.0f;
+        bool hit = false;
+    };
+
+    /**
+     * Rows of plants on an undulating ground, with poles on a jittered
+     * lattice.  Every plant stays inside the cell of the row and the plant
+     * spacing, so a ray only tests the plants of the cells that it crosses.
+     */
+    class cCropField
+    {
+    public:
+        explicit cCropField(uint64_t seed) : mSeed(seed) {}
+
+        double groundHeight(double x, double y) const
+        {
+            return 0.12 * std::sin(0.21 * x + 0.4) * std::cos(0.17 * y)
+                + 0.05 * std::sin(0.9 * x + 1.3 * y);
+        }
+
+        /**
+         * Keep the poles within reach of a sensor at position.
+         */
+        void selectPoles(const Eigen::Vector3d& position)
+        {
+            mPoles.clear();
+
+            const double reach = MAX_RANGE_M + POLE_SPACING_M;
+            const int64_t i0 = static_cast<int64_t>(std::floor((position.x() - reach) / POLE_SPACING_M));
+            const int64_t i1 = static_cast<int64_t>(std::floor((position.x() + reach) / POLE_SPACING_M));
+            const int64_t j0 = static_cast<int64_t>(std::floor((position.y() - reach) / POLE_SPACING_M));
+            const int64_t j1 = static_cast<int64_t>(std::floor((position.y() + reach) / POLE_SPACING_M));
+
+            for (int64_t i = i0; i <= i1; ++i)
+            {
+                for (int64_t j = j0; j <= j1; ++j)
+                {
+                    if (hash01(mSeed, i, j, 10) < 0.5)
+                        continue;
+
+                    // Keep the poles half a lattice step away from the lanes
+                    Eigen::Vector2d pole;
+                    pole.x() = (i + 0.3 + 0.4 * hash01(mSeed, i, j, 11)) * POLE_SPACING_M;
+                    pole.y() = (j + 0.5) * POLE_SPACING_M + (hash01(mSeed, i, j, 12) - 0.5) * 4.0;
+
+                    if ((pole - position.head<2>()).norm() < reach)
+                        mPoles.push_back(pole);
+                }
+            }
+        }
+
+        sHit cast(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction) const
+        {
+            sHit result;
+
+            double ground = castGround(origin, direction);
+            if (ground < result.range)
+            {
+                result.range = ground;
+                result.hit = true;
+
+                Eigen::Vector3d p = origin + ground * direction;
+                result.intensity = static_cast<float>(10.0 + 20.0 * hash01(mSeed,
+                    static_cast<int64_t>(std::floor(p.x() * 20.0)), static_cast<int64_t>(std::floor(p.y() * 20.0)), 1));
+            }
+
+            castPlants(origin, direction, result);
+            castPoles(origin, direction, result);
+
+            return result;
+        }
+
+    private:
+        struct sPlant
+        {
+            double x = 0.0;
+            double y = 0.0;
+            double radius = 0.0;
+            double base = 0.0;
+            double top = 0.0;
+            float intensity = 0.0f;
+        };
+
+        /// The plant of the cell in row i and column j, if there is one
+        bool plant(int64_t i, int64_t j, sPlant& p) const
+        {
+            // Some plants did not come up
+            if (hash01(mSeed, i, j, 2) < 0.1)
+                return false;
+
+            p.x = j * PLANT_SPACING_M + (hash01(mSeed, i, j, 3) - 0.5) * 0.1;
+            p.y = i * ROW_SPACING_M + (hash01(mSeed, i, j, 4) - 0.5) * 0.06;
+            p.radius = 0.04 + 0.06 * hash01(mSeed, i, j, 5);
+            p.base = groundHeight(p.x, p.y) - 0.05;
+            p.top = p.base + 0.35 + (MAX_PLANT_HEIGHT_M - 0.35) * hash01(mSeed, i, j, 6);
+            p.intensity = static_cast<float>(40.0 + 50.0 * hash01(mSeed, i, j, 7));
+            return true;
+        }
+
+        /// The range to the ground, found by regula falsi between the ground extremes
+        double castGround(const Eigen::Vector3d& o, const Eigen::Vector3d& d) const
+        {
+            if (d.z() > -1.0e-6)
+                return MAX_RANGE_M;
+
+            double t0 = std::max((o.z() - GROUND_AMPLITUDE_M) / -d.z(), 0.0);
+            double t1 = (o.z() + GROUND_AMPLITUDE_M) / -d.z();
+
+            if (t0 >= MAX_RANGE_M)
+                return MAX_RANGE_M;
+
+            auto above = [&](double t)
+            {
+                Eigen::Vector3d p = o + t * d;
+                return p.z() - groundHeight(p.x(), p.y());
+            };
+
+            double f0 = above(t0);
+            double f1 = above(t1);
+
+            // Illinois variant, which keeps both ends of the bracket moving
+            int side = 0;
+            for (int k = 0; (k < 30) && (t1 - t0 > 1.0e-4); ++k)
+            {
+                double t = (f0 == f1) ? 0.5 * (t0 + t1) : t1 - f1 * (t1 - t0) / (f1 - f0);
+                double f = above(t);
+
+                if ((f > 0.0) == (f0 > 0.0))
+                {
+                    t0 = t;
+                    f0 = f;
+                    if (side == -1)
+                        f1 *= 0.5;
+                    side = -1;
+                }
+                else
+                {
+                    t1 = t;
+                    f1 = f;
+                    if (side == 1)
+                        f0 *= 0.5;
+                    side = 1;
+                }
+            }
+
+            return std::min(0.5 * (t0 + t1), MAX_RANGE_M);
+        }
+
+        /// Walk the plant cells that the ray crosses within the height of the plants
+        void castPlants(const Eigen::Vector3d& o, const Eigen::Vector3d& d, sHit& result) const
+        {
+            const double bandLow = -GROUND_AMPLITUDE_M - 0.05;
+            const double bandHigh = GROUND_AMPLITUDE_M + MAX_PLANT_HEIGHT_M;
+
+            double tEnter = 0.0;
+            double tExit = result.range;
+
+            if (std::abs(d.z()) < 1.0e-9)
+            {
+                if ((o.z() < bandLow) || (o.z() > bandHigh))
+                    return;
+            }
+            else
+            {
+                double ta = (bandLow - o.z()) / d.z();
+                double tb = (bandHigh - o.z()) / d.z();
+                tEnter = std::max(tEnter, std::min(ta, tb));
+                tExit = std::min(tExit, std::max(ta, tb));
+            }
+
+            if (tEnter >= tExit)
+                return;
+
+            // Cell (i, j) covers row i and plant j, centered on the nominal plant
+            const double u0 = (o.x() + tEnter * d.x()) / PLANT_SPACING_M + 0.5;
+            const double v0 = (o.y() + tEnter * d.y()) / ROW_SPACING_M + 0.5;
+            const double du = d.x() / PLANT_SPACING_M;
+            const double dv = d.y() / ROW_SPACING_M;
+
+            int64_t j = static_cast<int64_t>(std::floor(u0));
+            int64_t i = static_cast<int64_t>(std::floor(v0));
+
+            const int64_t stepJ = (du > 0.0) ? 1 : -1;
+            const int64_t stepI = (dv > 0.0) ? 1 : -1;
+
+            const double inf = std::numeric_limits<double>::infinity();
+            const double deltaU = (du != 0.0) ? std::abs(1.0 / du) : inf;
+            const double deltaV = (dv != 0.0) ? std::abs(1.0 / dv) : inf;
+
+            double nextU = (du > 0.0) ? (j + 1 - u0) * deltaU : (u0 - j) * deltaU;
+            double nextV = (dv > 0.0) ? (i + 1 - v0) * deltaV : (v0 - i) * deltaV;
+            if (du == 0.0)
+                nextU = inf;
+            if (dv == 0.0)
+                nextV = inf;
+
+            double t = tEnter;
+            while (t < tExit)
+            {
+                sPlant p;
+                if (plant(i, j, p))
+                {
+                    double hit = castPlant(o, d, p);
+                    if (hit < result.range)
+                    {
+                        // The plants do not leave their cells, so the first hit is the nearest
+                        result.range = hit;
+                        result.intensity = p.intensity;
+                        result.hit = true;
+                        return;
+                    }
+                }
+
+                if (nextU < nextV)
+                {
+                    t = tEnter + nextU;
+                    nextU += deltaU;
+                    j += stepJ;
+                }
+                else
+                {
+                    t = tEnter + nextV;
+                    nextV += deltaV;
+                    i += stepI;
+                }
+            }
+        }
+
+        /// The range to a vertical cylinder, through its side or its top
+        static double cylinder(const Eigen::Vector3d& o, const Eigen::Vector3d& d,
+            double cx, double cy, double radius, double base, double top)
+        {
+            const double ox = o.x() - cx;
+            const double oy = o.y() - cy;
+
+            const double a = d.x() * d.x() + d.y() * d.y();
+            const double b = ox * d.x() + oy * d.y();
+            const double c = ox * ox + oy * oy - radius * radius;
+
+            if (a > 1.0e-12)
+            {
+                const double disc = b * b - a * c;
+                if (disc < 0.0)
+                    return MAX_RANGE_M;
+
+                const double t = (-b - std::sqrt(disc)) / a;
+                if (t > 0.0)
+                {
+                    const double z = o.z() + t * d.z();
+                    if ((z >= base) && (z <= top))
+                        return t;
+                }
+            }
+
+            // Through the top
+            if (d.z() < 0.0)
+            {
+                const double t = (top - o.z()) / d.z();
+                if (t > 0.0)
+                {
+                    const double x = ox + t * d.x();
+                    const double y = oy + t * d.y();
+                    if (x * x + y * y <= radius * radius)
+                        return t;
+                }
+            }
+
+            return MAX_RANGE_M;
+        }
+
+        static double castPlant(const Eigen::Vector3d& o, const Eigen::Vector3d& d, const sPlant& p)
+        {
+            return cylinder(o, d, p.x, p.y, p.radius, p.base, p.top);
+        }
+
+        void castPoles(const Eigen::Vector3d& o, const Eigen::Vector3d& d, sHit& result) const
+        {
+            for (const auto& pole : mPoles)
+            {
+                double hit = cylinder(o, d, pole.x(), pole.y(), POLE_RADIUS_M,
+                    -GROUND_AMPLITUDE_M, POLE_HEIGHT_M);
+
+                if (hit < result.range)
+                {
+                    result.range = hit;
+                    result.intensity = 200.0f;
+                    result.hit = true;
+                }
+            }
+        }
+
+    private:
+        uint64_t mSeed = 0;
+        std::vector<Eigen::Vector2d> mPoles;
+    };
+
+    /**
+     * The path of the sensor: a single lane, a serpentine over adjacent lanes
+     * or a loop over two lanes, joined by half circles.  The dolly of a
+     * SpiderCam does not turn, so the orientation of the sensor is fixed.
+     */
+    class cTrajectory
+    {
+    public:
+        cTrajectory(eTrajectory type, double speed_mps, double height_m)
+            : mType(type), mSpeed_mps(speed_mps), mHeight_m(height_m)
+        {
+            // The spin axis lies along the lanes, so the scans sweep across the rows
+            mOrientation = Eigen::AngleAxisd(std::numbers::pi / 2.0, Eigen::Vector3d::UnitY());
+        }
+
+        /// The distance travelled at time_sec
+        double distance(double time_sec) const
+        {
+            const double rampTime = mSpeed_mps / START_ACCELERATION_MPS2;
+            if (time_sec < rampTime)
+                return 0.5 * START_ACCELERATION_MPS2 * time_sec * time_sec;
+
+            return 0.5 * mSpeed_mps * rampTime + mSpeed_mps * (time_sec - rampTime);
+        }
+
+        Eigen::Isometry3d pose(double time_sec) const
+        {
+            const double s = distance(time_sec);
+
+            Eigen::Vector3d position;
+            position.head<2>() = planar(s);
+
+            // Slow sway of the cables
+            position.z() = mHeight_m + 0.05 * std::sin(0.4 * time_sec);
+
+            Eigen::Isometry3d pose = Eigen::Isometry3d::Identity();
+            pose.linear() = mOrientation;
+            pose.translation() = position;
+            return pose;
+        }
+
+    private:
+        double laneY(int64_t lane) const
+        {
+            switch (mType)
+            {
+            case eTrajectory::SERPENTINE:
+                return lane * LANE_SPACING_M;
+            case eTrajectory::LOOP:
+                return (lane % 2) * LANE_SPACING_M;
+            default:
+                return 0.0;
+            }
+        }
+
+        Eigen::Vector2d planar(double s) const
+        {
+            if (mType == eTrajectory::LINE)
+                return { s, 0.0 };
+
+            const double radius = 0.5 * LANE_SPACING_M;
+            const double laneLength = LANE_LENGTH_M + std::numbers::pi * radius;
+
+            const int64_t lane = static_cast<int64_t>(std::floor(s / laneLength));
+            const double u = s - lane * laneLength;
+
+            const double forward = (lane % 2 == 0) ? 1.0 : -1.0;
+            const double y = laneY(lane);
+
+            if (u < LANE_LENGTH_M)
+                return { (forward > 0.0) ? u : LANE_LENGTH_M - u, y };
+
+            // Half circle to the next lane
+            const double phi = (u - LANE_LENGTH_M) / radius;
+            const double side = (laneY(lane + 1) > y) ? 1.0 : -1.0;
+            const double endX = (forward > 0.0) ? LANE_LENGTH_M : 0.0;
+
+            return { endX + forward * radius * std::sin(phi), y + side * radius * (1.0 - std::cos(phi)) };
+        }
+
+    private:
+        eTrajectory mType;
+        double mSpeed_mps;
+        double mHeight_m;
+        Eigen::Matrix3d mOrientation;
+    };
+
+    /**
+     * Ray casts the frames of a spinning sensor moving along a trajectory.
+     * Each column is cast from the pose of the sensor at its own time, so the
+     * frames carry the distortion of the motion.
+     */
+    class cScanner
+    {
+    public:
+        cScanner(const cTrajectory& trajectory, cCropField& field, int columns, uint64_t seed)
+            : mTrajectory(trajectory), mField(field), mColumns(columns), mRandom(seed), mNoise(0.0, RANGE_NOISE_M)
+        {
+            // Ring 0 is the top beam, as in the channels of an Ouster column
+            for (int n = 0; n < NUM_RINGS; ++n)
+            {
+                double elevation = (0.5 - n / (NUM_RINGS - 1.0)) * VERTICAL_FOV_DEG * DEG_TO_RAD;
+                mElevations.push_back(elevation);
+            }
+        }
+
+        LidarSlam::Slam::PointCloud::Ptr frame(uint32_t seq, double start_sec)
+        {
+            auto cloud = std::make_shared<LidarSlam::Slam::PointCloud>();
+            cloud->reserve(static_cast<std::size_t>(mColumns) * NUM_RINGS);
+            cloud->header.seq = seq;
+            cloud->header.stamp = static_cast<uint64_t>(std::llround(start_sec * 1'000'000.0));
+            cloud->header.frame_id = "lidar";
+
+            mField.selectPoles(mTrajectory.pose(start_sec).translation());
+
+            for (int c = 0; c < mColumns; ++c)
+            {
+                // Time of the column relative to the header
+                const double dt = c * FRAME_PERIOD_SEC / mColumns;
+                const double azimuth = 2.0 * std::numbers::pi * c / mColumns;
+
+                const Eigen::Isometry3d pose = mTrajectory.pose(start_sec + dt);
+
+                for (int n = 0; n < NUM_RINGS; ++n)
+                {
+                    const double elevation = mElevations[n];
+
+                    Eigen::Vector3d ray(std::cos(elevation) * std::cos(azimuth),
+                        std::cos(elevation) * std::sin(azimuth), std::sin(elevation));
+
+                    sHit hit = mField.cast(pose.translation(), pose.linear() * ray);
+                    if (!hit.hit)
+                        continue;
+
+                    double range = hit.range + mNoise(mRandom);
+                    if ((range < MIN_RANGE_M) || (range >= MAX_RANGE_M))
+                        continue;
+
+                    LidarSlam::LidarPoint point;
+                    point.x = static_cast<float>(range * ray.x());
+                    point.y = static_cast<float>(range * ray.y());
+                    point.z = static_cast<float>(range * ray.z());
+                    point.intensity = hit.intensity;
+                    point.laser_id = n;
+                    point.device_id = 0;
+                    point.time = dt;
+
+                    cloud->push_back(point);
+                }
+            }
+
+            return cloud;
+        }
+
+    private:
+        const cTrajectory& mTrajectory;
+        cCropField& mField;
+        int mColumns;
+        std::vector<double> mElevations;
+
+        std::mt19937_64 mRandom;
+        std::normal_distribution<double> mNoise;
+    };
+
+    /// The resident memory of the process, 0 if unknown
+    double residentMemory_MB()
+    {
+#if defined(_WIN32)
+        PROCESS_MEMORY_COUNTERS counters;
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+            return counters.WorkingSetSize / (1024.0 * 1024.0);
+#elif defined(__linux__)
+        std::ifstream statm("/proc/self/statm");
+        std::size_t size = 0;
+        std::size_t resident = 0;
+        if (statm >> size >> resident)
+            return static_cast<double>(resident) * sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0);
+#endif
+        return 0.0;
+    }
+
+    std::size_t mapSize(const LidarSlam::Slam& slam)
+    {
+        std::size_t points = 0;
+        for (auto k : LidarSlam::KeypointTypes)
+        {
+            if (slam.KeypointTypeEnabled(k))
+                points += slam.GetMap(k)->size();
+        }
+        return points;
+    }
+
+    /// The duration and worst case of a step of the SLAM
+    struct sStepTiming
+    {
+        double total_sec = 0.0;
+        double max_sec = 0.0;
+
+        void add(double sec)
+        {
+            total_sec += sec;
+            max_sec = std::max(max_sec, sec);
+        }
+    };
+
+    struct sPoseError
+    {
+        double sumSquared_m2 = 0.0;
+        double max_m = 0.0;
+        double maxRotation_deg = 0.0;
+        double last_m = 0.0;
+        int count = 0;
+
+        void add(const Eigen::Isometry3d& estimate, const Eigen::Isometry3d& truth)
+        {
+            double e = (estimate.translation() - truth.translation()).norm();
+            double r = Eigen::AngleAxisd(estimate.linear().transpose() * truth.linear()).angle() / DEG_TO_RAD;
+
+            sumSquared_m2 += e * e;
+            max_m = std::max(max_m, e);
+            maxRotation_deg = std::max(maxRotation_deg, r);
+            last_m = e;
+            ++count;
+        }
+
+        double rmse_m() const { return (count > 0) ? std::sqrt(sumSquared_m2 / count) : 0.0; }
+    };
+
+    void printStep(const std::string& label, const sStepTiming& timing, int frames)
+    {
+        std::cout << std::setw(22) << label << ": "
+            << std::setw(8) << 1000.0 * timing.total_sec / frames << " ms mean, "
+            << std::setw(8) << 1000.0 * timing.max_sec << " ms max" << std::endl;
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    int numFrames = 600;
+    int columns = 1024;
+    uint64_t seed = 1;
+    std::string trajectoryName = "serpentine";
+    double speed_mps = 1.0;
+    double height_m = 8.0;
+    bool flatMap = false;
+    bool showHelp = false;
+
+    auto cli = lyra::cli()
+        | lyra::help(showHelp)
+        ("Show usage information.")
+        | lyra::opt(numFrames, "frames")
+        ["-n"]["--frames"]
+        ("The number of frames to process.")
+        | lyra::opt(seed, "seed")
+        ["-s"]["--seed"]
+        ("The seed of the field and of the range noise.")
+        | lyra::opt(trajectoryName, "line|serpentine|loop")
+        ["--trajectory"]
+        ("The path of the sensor over the field.")
+        | lyra::opt(speed_mps, "m/s")
+        ["--speed"]
+        ("The speed of the sensor.")
+        | lyra::opt(height_m, "m")
+        ["--height"]
+        ("The height of the sensor above the field.")
+        | lyra::opt(columns, "columns")
+        ["--columns"]
+        ("The number of columns of a frame, 512, 1024 or 2048.")
+        | lyra::opt(flatMap)
+        ["--flat_map"]
+        ("Store the SLAM maps in a flat hash table instead of nested hash maps.");
+
+    auto result = cli.parse({argc, argv});
+
+    if (showHelp)
+    {
+        std::cout << cli << std::endl;
+        return 0;
+    }
+
+    if (!result)
+    {
+        std::cerr << "Error in command line: " << result.message() << std::endl;
+        std::cerr << std::endl;
+        std::cerr << cli << std::endl;
+        return 1;
+    }
+
+    eTrajectory type = eTrajectory::SERPENTINE;
+    if (trajectoryName == "line")
+        type = eTrajectory::LINE;
+    else if (trajectoryName == "loop")
+        type = eTrajectory::LOOP;
+    else if (trajectoryName != "serpentine")
+    {
+        std::cerr << "Unknown trajectory: " << trajectoryName << std::endl;
+        return 1;
+    }
+
+    if ((numFrames < 1) || (columns < 16) || (speed_mps <= 0.0) || (height_m <= 0.0))
+    {
+        std::cerr << "The frames, columns, speed and height must be positive." << std::endl;
+        return 1;
+    }
+
+    LidarSlam::Slam slam;
+    nSlamParameters::apply(slam);
+    slam.SetVerbosity(0);
+
+    if (flatMap)
+        slam.SetVoxelGridStorage(LidarSlam::VoxelGridStorage::FLAT_HASH);
+
+    cCropField field(seed);
+    cTrajectory trajectory(type, speed_mps, height_m);
+    cScanner scanner(trajectory, field, columns, seed);
+
+    std::cout << "Trajectory: " << trajectoryName << " at " << speed_mps << " m/s, " << height_m << " m high, "
+        << columns << " x " << NUM_RINGS << " scans, seed " << seed
+        << (flatMap ? ", flat map" : "") << std::endl;
+
+    const double startMemory_MB = residentMemory_MB();
+
+    // The SLAM starts at the identity, at the first pose of the trajectory
+    const Eigen::Isometry3d firstPose = trajectory.pose(0.0);
+    const Eigen::Isometry3d toFirst = firstPose.inverse();
+
+    sStepTiming generation;
+    sStepTiming keypoints;
+    sStepTiming egoMotion;
+    sStepTiming localization;
+    sStepTiming mapsUpdate;
+    sStepTiming total;
+    sPoseError error;
+
+    std::cout << std::fixed << std::setprecision(3);
+
+    for (int i = 0; i < numFrames; ++i)
+    {
+        const double time_sec = i * FRAME_PERIOD_SEC;
+
+        auto start = std::chrono::steady_clock::now();
+        auto cloud = scanner.frame(static_cast<uint32_t>(i), time_sec);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        generation.add(elapsed.count());
+
+        slam.AddFrame(cloud);
+
+        const auto& timings = slam.GetLastFrameTimings();
+        keypoints.add(timings.KeypointsExtraction);
+        egoMotion.add(timings.EgoMotion);
+        localization.add(timings.Localization);
+        mapsUpdate.add(timings.MapsUpdate);
+        total.add(timings.Total);
+
+        error.add(slam.GetWorldTransform(), toFirst * trajectory.pose(time_sec));
+
+        if (((i + 1) % REPORT_INTERVAL) == 0)
+        {
+            std::cout << "Frame " << std::setw(5) << i + 1
+                << ": " << std::setw(8) << mapSize(slam) << " map points, "
+                << std::setw(8) << residentMemory_MB() - startMemory_MB << " MB added, "
+                << "error " << error.last_m << " m" << std::endl;
+        }
+    }
+
+    const double distance_m = trajectory.distance((numFrames - 1) * FRAME_PERIOD_SEC);
+
+    std::cout << std::endl;
+    std::cout << numFrames << " frames, " << distance_m << " m travelled" << std::endl;
+
+    printStep("Scan generation", generation, numFrames);
+    printStep("Keypoints extraction", keypoints, numFrames);
+    printStep("Ego-motion", egoMotion, numFrames);
+    printStep("Localization", localization, numFrames);
+    printStep("Maps update", mapsUpdate, numFrames);
+    printStep("SLAM frame", total, numFrames);
+
+    std::cout << std::setw(22) << "SLAM frame rate" << ": "
+        << std::setw(8) << ((total.total_sec > 0.0) ? numFrames / total.total_sec : 0.0) << " fps" << std::endl;
+
+    std::cout << std::setw(22) << "Memory added" << ": "
+        << std::setw(8) << residentMemory_MB() - startMemory_MB << " MB, "
+        << mapSize(slam) << " map points" << std::endl;
+
+    std::cout << std::setw(22) << "Translation error" << ": "
+        << std::setw(8) << error.rmse_m() << " m RMSE, "
+        << error.max_m << " m max, " << error.last_m << " m final" << std::endl;
+
+    std::cout << std::setw(22) << "Rotation error" << ": "
+        << std::setw(8) << error.maxRotation_deg << " deg max" << std::endl;
+
+    if (distance_m > 0.0)
+    {
+        std::cout << std::setw(22) << "Drift" << ": "
+            << std::setw(8) << 100.0 * error.last_m / distance_m << " % of the distance" << std::endl;
+    }
+
+    return 0;
+}
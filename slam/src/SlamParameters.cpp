@@ -0,0 +1,176 @@
+#include "SlamParameters.hpp"
+
+#include <climits>
+
+
+std::shared_ptr<LidarSlam::SpinningSensorKeypointExtractor> nSlamParameters::createKeypointExtractor()
+{
+    auto ke = std::make_shared<LidarSlam::SpinningSensorKeypointExtractor>();
+
+    ke->SetAzimuthalResolution_rad(0.0);
+    ke->SetNbThreads(4);
+    ke->SetMinNeighNb(4);
+    ke->SetMinNeighRadius(0.05);
+    ke->SetMinDistanceToSensor_m(1.5);
+    ke->SetMinBeamSurfaceAngle_deg(10);
+    ke->SetMinAzimuth_deg(0.0);
+    ke->SetMaxAzimuth_deg(360.0);
+    ke->SetPlaneSinAngleThreshold(0.5);
+    ke->SetEdgeSinAngleThreshold(0.86);
+    ke->SetEdgeDepthGapThreshold_m(0.5);
+    ke->SetEdgeNbGapPoints(5);
+    ke->SetEdgeIntensityGapThreshold(50.0);
+    ke->SetMaxPoints(INT_MAX);
+    ke->SetVoxelResolution_m(0.1);
+    ke->SetInputSamplingRatio(1.0f);
+
+    return ke;
+}
+
+//------------------------------------------------------------------------------
+void nSlamParameters::apply(LidarSlam::Slam& slam)
+{
+    // General
+    slam.SetTwoDMode(false);
+    slam.SetVerbosity(2);
+    slam.SetNbThreads(4);
+    slam.SetLoggingTimeout(4);
+    slam.SetLogOnlyKeyframes(true);
+
+    auto egoMotion = LidarSlam::EgoMotionMode::MOTION_EXTRAPOLATION;
+    slam.SetEgoMotion(egoMotion);
+
+
+    slam.SetUndistortion(LidarSlam::UndistortionMode::REFINED);
+
+    slam.SetLoggingStorage(LidarSlam::PointCloudStorageType::PCL_CLOUD);
+
+    // Frame Ids
+    slam.SetWorldFrameId("world");
+    slam.SetBaseFrameId("base");
+
+    // Multi-LiDAR devices
+
+    // Single LiDAR device
+    slam.SetKeyPointsExtractor(nSlamParameters::createKeypointExtractor());
+
+    slam.EnableKeypointType(LidarSlam::Keypoint::EDGE, true);
+    slam.EnableKeypointType(LidarSlam::Keypoint::INTENSITY_EDGE, true);
+    slam.EnableKeypointType(LidarSlam::Keypoint::PLANE, true);
+    slam.EnableKeypointType(LidarSlam::Keypoint::BLOB, true);
+
+/*
+    // Ego motion
+    slam.SetEgoMotionICPMaxIter();
+    slam.SetEgoMotionLMMaxIter();
+    slam.SetEgoMotionMaxNeighborsDistance();
+    slam.SetEgoMotionEdgeNbNeighbors();
+    slam.SetEgoMotionEdgeMinNbNeighbors();
+    slam.SetEgoMotionEdgeMaxModelError();
+    slam.SetEgoMotionPlaneNbNeighbors();
+    slam.SetEgoMotionPlanarityThreshold();
+    slam.SetEgoMotionPlaneMaxModelError();
+    slam.SetEgoMotionInitSaturationDistance();
+    slam.SetEgoMotionFinalSaturationDistance();
+
+    // Localization
+    slam.SetLocalizationICPMaxIter();
+    slam.SetLocalizationLMMaxIter();
+    slam.SetLocalizationMaxNeighborsDistance();
+    slam.SetLocalizationEdgeNbNeighbors();
+    slam.SetLocalizationEdgeMinNbNeighbors();
+    slam.SetLocalizationEdgeMaxModelError();
+    slam.SetLocalizationPlaneNbNeighbors();
+    slam.SetLocalizationPlanarityThreshold();
+    slam.SetLocalizationPlaneMaxModelError();
+    slam.SetLocalizationBlobNbNeighbors();
+    slam.SetLocalizationInitSaturationDistance();
+    slam.SetLocalizationFinalSaturationDistance();
+
+    // External sensors
+    slam.SetSensorMaxMeasures();
+    slam.SetSensorTimeThreshold();
+    slam.SetLandmarkWeight();
+    slam.SetLandmarkSaturationDistance();
+    slam.SetLandmarkPositionOnly();
+    //this->LidarTimePosix = this->PrivNh.param("external_sensors/landmark_detector/lidar_is_posix", true);
+
+    // Graph parameters
+    slam.SetG2oFileName();
+    slam.SetFixFirstVertex();
+    slam.SetFixLastVertex();
+    slam.SetCovarianceScale();
+    slam.SetNbGraphIterations();
+*/
+
+    // Confidence estimators
+    // Overlap
+//    slam.SetOverlapSamplingRatio();
+
+    // Motion limitations (hard constraints to detect failure();
+    slam.SetAccelerationLimit_mps2(2.0);
+    slam.SetRotationAccelLimit_dps2(10.0);
+
+    slam.SetVelocityLimit_mps(2.0);
+    slam.SetRotationRateLimit_dps(10.0);
+
+    slam.SetTimeWindowDuration_sec(1.0);
+
+    // Keyframes
+//    slam.SetKfDistanceThreshold();
+//    slam.SetKfAngleThreshold();
+
+/*
+    // Maps
+    int mapUpdateMode;
+    if (this->PrivNh.getParam("slam/voxel_grid/update_maps", mapUpdateMode))
+    {
+        LidarSlam::MappingMode mapUpdate = static_cast<LidarSlam::MappingMode>(mapUpdateMode);
+        if (mapUpdate != LidarSlam::MappingMode::NONE &&
+            mapUpdate != LidarSlam::MappingMode::ADD_KPTS_TO_FIXED_MAP &&
+            mapUpdate != LidarSlam::MappingMode::UPDATE)
+        {
+            ROS_ERROR_STREAM("Invalid map update mode (" << mapUpdateMode << "). Setting it to 'UPDATE'.");
+            mapUpdate = LidarSlam::MappingMode::UPDATE;
+        }
+        slam.SetMapUpdate(mapUpdate);
+    }
+    double size = 0.0;
+    if (this->PrivNh.getParam("slam/voxel_grid/leaf_size/edges", size) && slam.KeypointTypeEnabled(LidarSlam::EDGE))
+        slam.SetVoxelGridLeafSize(LidarSlam::EDGE, size);
+    if (this->PrivNh.getParam("slam/voxel_grid/leaf_size/intensity_edges", size) && slam.KeypointTypeEnabled(LidarSlam::INTENSITY_EDGE))
+        slam.SetVoxelGridLeafSize(LidarSlam::INTENSITY_EDGE, size);
+    if (this->PrivNh.getParam("slam/voxel_grid/leaf_size/planes", size) && slam.KeypointTypeEnabled(LidarSlam::PLANE))
+        slam.SetVoxelGridLeafSize(LidarSlam::PLANE, size);
+    if (this->PrivNh.getParam("slam/voxel_grid/leaf_size/blobs", size) && slam.KeypointTypeEnabled(LidarSlam::BLOB))
+        slam.SetVoxelGridLeafSize(LidarSlam::BLOB, size);
+
+    slam.SetVoxelGridResolution();
+    slam.SetVoxelGridSize();
+    slam.SetVoxelGridDecayingThreshold();
+    slam.SetVoxelGridMinFramesPerVoxel();
+*/
+
+    for (auto k : LidarSlam::KeypointTypes)
+    {
+        if (!slam.KeypointTypeEnabled(k))
+           continue;
+
+        int samplingMode;
+
+        // if (this->PrivNh.getParam("slam/voxel_grid/sampling_mode/" + LidarSlam::KeypointTypeNames.at(k), samplingMode))
+        if (false)
+        {
+            LidarSlam::SamplingMode sampling = static_cast<LidarSlam::SamplingMode>(samplingMode);
+            if (sampling != LidarSlam::SamplingMode::FIRST &&
+                    sampling != LidarSlam::SamplingMode::LAST &&
+                    sampling != LidarSlam::SamplingMode::MAX_INTENSITY &&
+                    sampling != LidarSlam::SamplingMode::CENTER_POINT &&
+                    sampling != LidarSlam::SamplingMode::CENTROID)
+            {
+               sampling = LidarSlam::SamplingMode::MAX_INTENSITY;
+            }
+            slam.SetVoxelGridSamplingMode(k, sampling);
+        }
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "Slam.h"
+#include "SpinningSensorKeypointExtractor.h"
+
+#include <memory>
+
+
+/**
+ * The SLAM settings used for the LiDAR scans of the gantry, shared by the
+ * SLAM tool and its benchmark so that both run the same configuration.
+ */
+namespace nSlamParameters
+{
+    /**
+     * A keypoint extractor with the settings used by the SLAM.
+     */
+    std::shared_ptr<LidarSlam::SpinningSensorKeypointExtractor> createKeypointExtractor();
+
+    /**
+     * Fill the SLAM parameters, including its keypoint extractor.
+     */
+    void apply(LidarSlam::Slam& slam);
+}
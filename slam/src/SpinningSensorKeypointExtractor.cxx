@@ -28,11 +28,25 @@
 
 #include <random>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 namespace LidarSlam
 {
 
 namespace
 {
+//-----------------------------------------------------------------------------
+inline int ThreadIndex()
+{
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
 //-----------------------------------------------------------------------------
 bool LineFitting::FitLineAndCheckConsistency(const SpinningSensorKeypointExtractor::PointCloud& cloud,
                                             const std::vector<int>& indices)
@@ -203,17 +217,46 @@ void SpinningSensorKeypointExtractor::PrepareDataForNextFrame()
     mSpaceGap.resize(mNbLaserRings);
     mIntensityGap.resize(mNbLaserRings);
     mLabel.resize(mNbLaserRings);
+    mDepth.resize(mNbLaserRings);
+    mSampledOut.resize(mNbLaserRings);
+    mSelectedKpts.resize(mNbLaserRings);
+    mThreadBuffers.resize(std::max(mNbThreads, 1));
 
     // Initialize the scan lines features vectors with the correct length
+    // The vectors keep their memory from frame to frame
     #pragma omp parallel for num_threads(mNbThreads) schedule(guided)
     for (int scanLine = 0; scanLine < static_cast<int>(mNbLaserRings); ++scanLine)
     {
-        size_t nbPoint = mScanLines[scanLine]->size();
+        const PointCloud& scanLineCloud = *(mScanLines[scanLine]);
+        size_t nbPoint = scanLineCloud.size();
         mLabel[scanLine].assign(nbPoint, KeypointFlags().reset());  // set all flags to 0
         mAngles[scanLine].assign(nbPoint, -1.);
         mDepthGap[scanLine].assign(nbPoint, -1.);
         mSpaceGap[scanLine].assign(nbPoint, -1.);
         mIntensityGap[scanLine].assign(nbPoint, -1.);
+
+        // Each depth is used by the point and by its neighbors. It is computed
+        // with the same expression as they would, to get the same rounding.
+        mDepth[scanLine].resize(nbPoint);
+        for (size_t index = 0; index < nbPoint; ++index)
+            mDepth[scanLine][index] = scanLineCloud[index].getVector3fMap().norm();
+    }
+
+    // Draw the input sampling before the parallel loops, which cannot share a generator
+    if (mInputSamplingRatio < 1.0f)
+    {
+        std::uniform_real_distribution<> dis(0.0, 1.0);
+        for (unsigned int scanLine = 0; scanLine < mNbLaserRings; ++scanLine)
+        {
+            const int Npts = mScanLines[scanLine]->size();
+            mSampledOut[scanLine].assign(Npts, 0);
+
+            if (IsScanLineAlmostEmpty(Npts))
+                continue;
+
+            for (int index = 0; index < Npts; ++index)
+                mSampledOut[scanLine][index] = dis(mSamplingGenerator) > mInputSamplingRatio;
+        }
     }
 
     // Reset voxel grids
@@ -247,9 +290,10 @@ void SpinningSensorKeypointExtractor::ComputeCurvature()
     while (maxAzimuth_rad < 0)
         maxAzimuth_rad += 2 * M_PI;
 
-    std::random_device rd;  // Will be used to obtain a seed for the random number engine
-    std::mt19937 gen(rd()); // Standard mersenne_twister_engine seeded with rd()
-    std::uniform_real_distribution<> dis(0.0, 1.0);
+    // The map of the enabled keypoints is not read from the threads
+    const bool edgeEnabled = mEnabled[EDGE];
+    const bool intensityEdgeEnabled = mEnabled[INTENSITY_EDGE];
+    const bool angleEnabled = mEnabled[PLANE] || edgeEnabled;
 
     // loop over scans lines
     #pragma omp parallel for num_threads(mNbThreads) schedule(guided)
@@ -257,23 +301,28 @@ void SpinningSensorKeypointExtractor::ComputeCurvature()
     {
         // Useful shortcuts
         const PointCloud& scanLineCloud = *(mScanLines[scanLine]);
+        const std::vector<float>& depths = mDepth[scanLine];
         const int Npts = scanLineCloud.size();
 
         // if the line is almost empty, skip it
         if (IsScanLineAlmostEmpty(Npts))
             continue;
 
+        ThreadBuffers& buffers = mThreadBuffers[ThreadIndex()];
+        std::vector<int>& leftNeighbors = buffers.LeftNeighbors;
+        std::vector<int>& rightNeighbors = buffers.RightNeighbors;
+
         // Loop over points in the current scan line
         for (int index = 0; index < Npts; ++index)
         {
             // Random sampling to decrease keypoints extraction
             // computation time
-            if (mInputSamplingRatio < 1.0f && dis(gen) > mInputSamplingRatio)
+            if (mInputSamplingRatio < 1.0f && mSampledOut[scanLine][index])
                 continue;
 
             // Central point
             const Eigen::Vector3f& centralPoint = scanLineCloud[index].getVector3fMap();
-            float centralDepth = centralPoint.norm();
+            float centralDepth = depths[index];
 
             // Check distance to sensor
             if (centralDepth < mMinDistanceToSensor_m)
@@ -298,7 +347,7 @@ void SpinningSensorKeypointExtractor::ComputeCurvature()
 
             // Fill left and right neighbors
             // Those points must be more numerous than MinNeighNb and occupy more space than MinNeighRadius
-            std::vector<int> leftNeighbors;
+            leftNeighbors.clear();
             int idxNeigh = 1;
             float lineLength = 0.0f;
 
@@ -311,7 +360,7 @@ void SpinningSensorKeypointExtractor::ComputeCurvature()
                 ++idxNeigh;
             }
 
-            std::vector<int> rightNeighbors;
+            rightNeighbors.clear();
             idxNeigh = 1;
             lineLength = 0.0f;
             while ((int(rightNeighbors.size()) < mMinNeighNb
@@ -326,8 +375,8 @@ void SpinningSensorKeypointExtractor::ComputeCurvature()
             const auto& rightPt = scanLineCloud[rightNeighbors.front()].getVector3fMap();
             const auto& leftPt = scanLineCloud[leftNeighbors.front()].getVector3fMap();
 
-            const float rightDepth = rightPt.norm();
-            const float leftDepth = leftPt.norm();
+            const float rightDepth = depths[rightNeighbors.front()];
+            const float leftDepth = depths[leftNeighbors.front()];
 
             const float cosAngleRight = std::abs(rightPt.dot(centralPoint) / (rightDepth * centralDepth));
             const float cosAngleLeft = std::abs(leftPt.dot(centralPoint) / (leftDepth * centralDepth));
@@ -341,7 +390,7 @@ void SpinningSensorKeypointExtractor::ComputeCurvature()
             float cosBeamLineAngleLeft = std::abs(diffVecLeft.dot(centralPoint) / (diffLeftNorm * centralDepth) );
             float cosBeamLineAngleRight = std::abs(diffVecRight.dot(centralPoint) / (diffRightNorm * centralDepth));
 
-            if (mEnabled[EDGE])
+            if (edgeEnabled)
             {
                 // Compute space gap
 
@@ -420,7 +469,7 @@ void SpinningSensorKeypointExtractor::ComputeCurvature()
             if (cosBeamLineAngleRight > cosMinBeamSurfaceAngle)
                 continue;
 
-            if (mEnabled[INTENSITY_EDGE])
+            if (intensityEdgeEnabled)
             {
                 // Compute intensity gap
                 if (std::abs(scanLineCloud[rightNeighbors.front()].intensity - scanLineCloud[leftNeighbors.front()].intensity)
@@ -457,13 +506,13 @@ void SpinningSensorKeypointExtractor::ComputeCurvature()
                 continue;
             }
 
-            if (mEnabled[PLANE] || mEnabled[EDGE])
+            if (angleEnabled)
             {
                 // Compute angles
                 mAngles[scanLine][index] = (leftLine.mDirection.cross(rightLine.mDirection)).norm();
 
                 // Remove previous point from angle inspection if the angle is not maximal locally
-                if (mEnabled[EDGE] && mAngles[scanLine][index] > mEdgeSinAngleThreshold)
+                if (edgeEnabled && mAngles[scanLine][index] > mEdgeSinAngleThreshold)
                 {
                     // Check previously computed angle to keep only the maximum angle keypoint locally
                     for (int indexLeft : leftNeighbors)
@@ -490,9 +539,12 @@ void SpinningSensorKeypointExtractor::AddKptsUsingCriterion (Keypoint k,
                                                                 double weightBasis)
 {
     // Loop over the scan lines
+    #pragma omp parallel for num_threads(mNbThreads) schedule(guided)
     for (int scanlineIdx = 0; scanlineIdx < static_cast<int>(mNbLaserRings); ++scanlineIdx)
     {
         const int Npts = mScanLines[scanlineIdx]->size();
+        std::vector<std::pair<int, float>>& selected = mSelectedKpts[scanlineIdx];
+        selected.clear();
 
         // If the line is almost empty, skip it
         if (IsScanLineAlmostEmpty(Npts))
@@ -500,7 +552,8 @@ void SpinningSensorKeypointExtractor::AddKptsUsingCriterion (Keypoint k,
 
         // If threshIsMax : ascending order (lowest first)
         // If threshIsMin : descending order (greatest first)
-        std::vector<size_t> sortedValuesIndices = Utils::SortIdx(values[scanlineIdx], threshIsMax);
+        std::vector<size_t>& sortedValuesIndices = mThreadBuffers[ThreadIndex()].SortedIndices;
+        Utils::SortIdx(values[scanlineIdx], sortedValuesIndices, threshIsMax);
 
         for (const auto& index: sortedValuesIndices)
         {
@@ -524,10 +577,17 @@ void SpinningSensorKeypointExtractor::AddKptsUsingCriterion (Keypoint k,
             // Indicate the type of the keypoint to debug and to exclude double edges
             mLabel[scanlineIdx][index].set(k);
 
-            // Add keypoint
-            mKeypoints[k].AddPoint(mScanLines[scanlineIdx]->at(index), weight);
+            selected.emplace_back(index, weight);
         }
     }
+
+    // Add keypoints, the voxel grid is shared by all scan lines
+    VoxelGrid& keypoints = mKeypoints[k];
+    for (unsigned int scanlineIdx = 0; scanlineIdx < mNbLaserRings; ++scanlineIdx)
+    {
+        for (const auto& kpt : mSelectedKpts[scanlineIdx])
+            keypoints.AddPoint(mScanLines[scanlineIdx]->at(kpt.first), kpt.second);
+    }
 }
 
 //-----------------------------------------------------------------------------
@@ -30,6 +30,7 @@
 #include <map>
 #include <bitset>
 #include <map>
+#include <random>
 
 #define SetMacro(name,type) void Set##name (type _arg) { name = _arg; }
 #define GetMacro(name,type) type Get##name () const { return name; }
@@ -159,6 +160,7 @@ private:
     // Compute the curvature and other features within each the scan line.
     // The curvature is not the one of the surface that intersects the lines but
     // the 1D curvature within each isolated scan line.
+    // The scan lines are processed in parallel, each one by a single thread.
     void ComputeCurvature();
 
     // Labelize points (unvalid, edge, plane, blob)
@@ -179,6 +181,8 @@ private:
     // Add all keypoints of the type k that comply with the threshold criteria for these values
     // The threshold can be a minimum or maximum value (threshIsMax)
     // The weight basis allow to weight the keypoint depending on its certainty
+    // The keypoints are selected in parallel for each scan line, then added
+    // to the voxel grid in scan line order, as a sequential extraction would.
     void AddKptsUsingCriterion (Keypoint k,
                                 const std::vector<std::vector<float>>& values,
                                 float threshold,
@@ -253,6 +257,9 @@ private:
     //! We use binary flags as each point can have different keypoint labels.
     using KeypointFlags = std::bitset<Keypoint::nKeypointTypes>;
 
+    // Distance of the points to the sensor (scan by scan, point by point)
+    std::vector<std::vector<float>> mDepth;
+
     // Curvature and other differential operations (scan by scan, point by point)
     std::vector<std::vector<float>> mAngles;
     std::vector<std::vector<float>> mDepthGap;
@@ -266,6 +273,22 @@ private:
     // Current point cloud stored in two differents formats
     PointCloud::Ptr mpScan;
     std::vector<PointCloud::Ptr> mScanLines;
+
+    // Points left out by the input sampling (scan line by scan line, point by point)
+    std::vector<std::vector<uint8_t>> mSampledOut;
+    std::mt19937 mSamplingGenerator{std::random_device{}()};
+
+    // Keypoints selected by AddKptsUsingCriterion (index and weight), for each scan line
+    std::vector<std::vector<std::pair<int, float>>> mSelectedKpts;
+
+    // Working memory of a thread, kept from frame to frame to avoid allocations
+    struct ThreadBuffers
+    {
+        std::vector<int> LeftNeighbors;
+        std::vector<int> RightNeighbors;
+        std::vector<size_t> SortedIndices;
+    };
+    std::vector<ThreadBuffers> mThreadBuffers;
 };
 
 } // end of LidarSlam namespace
\ No newline at end of file
@@ -0,0 +1,614 @@
+
+#include "TiledMapStore.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+
+namespace
+{
+    /// Bytes of a point in a chunk: x, y, z offsets and intensity, 16 bits each
+    const std::size_t CHUNK_POINT_SIZE = 4 * sizeof(uint16_t);
+
+    /// The smallest quantization step of a chunk
+    const float MIN_CHUNK_STEP_M = 0.001f;
+
+    const char* INDEX_TAG = "#tiles";
+
+    const uint64_t EMPTY_VOXEL = std::numeric_limits<uint64_t>::max();
+
+    /// Bits of the x, y and z voxel indices in a voxel key
+    const int VOXEL_XY_BITS = 20;
+    const int VOXEL_Z_BITS = 24;
+    const int64_t VOXEL_Z_BIAS = int64_t(1) << (VOXEL_Z_BITS - 1);
+
+    void putUint16(std::vector<char>& buffer, std::size_t& pos, uint16_t value)
+    {
+        buffer[pos++] = static_cast<char>(value & 0xFF);
+        buffer[pos++] = static_cast<char>(value >> 8);
+    }
+
+    uint16_t getUint16(const std::vector<char>& buffer, std::size_t& pos)
+    {
+        uint16_t lo = static_cast<uint8_t>(buffer[pos++]);
+        uint16_t hi = static_cast<uint8_t>(buffer[pos++]);
+        return lo | (hi << 8);
+    }
+
+    uint16_t quantize(float value, float min, float step)
+    {
+        float q = std::round((value - min) / step);
+        return static_cast<uint16_t>(std::clamp(q, 0.0f, 65535.0f));
+    }
+}
+
+
+/**
+ * The voxels of a tile that already have a point, in an open addressing
+ * hash table kept at most half full.
+ */
+class cTiledMapStore::cVoxelSet
+{
+public:
+    /// Returns true if the voxel had no point yet
+    bool insert(uint64_t key)
+    {
+        if (2 * (mSize + 1) > mSlots.size())
+            rehash(std::max<std::size_t>(1024, 2 * mSlots.size()));
+
+        const std::size_t mask = mSlots.size() - 1;
+        for (std::size_t slot = hash(key) & mask; ; slot = (slot + 1) & mask)
+        {
+            if (mSlots[slot] == key)
+                return false;
+
+            if (mSlots[slot] == EMPTY_VOXEL)
+            {
+                mSlots[slot] = key;
+                ++mSize;
+                return true;
+            }
+        }
+    }
+
+    void clear()
+    {
+        mSlots.clear();
+        mSize = 0;
+    }
+
+private:
+    static std::size_t hash(uint64_t key)
+    {
+        key ^= key >> 30;
+        key *= 0xBF58476D1CE4E5B9ull;
+        key ^= key >> 27;
+        key *= 0x94D049BB133111EBull;
+        key ^= key >> 31;
+        return static_cast<std::size_t>(key);
+    }
+
+    void rehash(std::size_t numSlots)
+    {
+        std::vector<uint64_t> slots(numSlots, EMPTY_VOXEL);
+        const std::size_t mask = numSlots - 1;
+
+        for (uint64_t key : mSlots)
+        {
+            if (key == EMPTY_VOXEL)
+                continue;
+
+            std::size_t slot = hash(key) & mask;
+            while (slots[slot] != EMPTY_VOXEL)
+                slot = (slot + 1) & mask;
+
+            slots[slot] = key;
+        }
+
+        mSlots.swap(slots);
+    }
+
+private:
+    std::vector<uint64_t> mSlots;
+    std::size_t mSize = 0;
+};
+
+
+struct cTiledMapStore::sTile
+{
+    int32_t x = 0;
+    int32_t y = 0;
+
+    cVoxelSet voxels;
+    std::vector<sPoint> points;
+
+    /// The points already written to the tile file
+    std::size_t written = 0;
+};
+
+
+cTiledMapStore::cTiledMapStore()
+{}
+
+cTiledMapStore::~cTiledMapStore()
+{
+    try
+    {
+        close();
+    }
+    catch (...)
+    {
+    }
+}
+
+void cTiledMapStore::setTileSize(double tileSize_m)
+{
+    if (isOpen())
+        throw std::logic_error("The tile size cannot change while the tile files are open.");
+
+    mTileSize_m = tileSize_m;
+}
+
+void cTiledMapStore::setVoxelSize(double voxelSize_m)
+{
+    if (isOpen())
+        throw std::logic_error("The voxel size cannot change while the tile files are open.");
+
+    mVoxelSize_m = voxelSize_m;
+}
+
+void cTiledMapStore::setKeepDistance(double distance_m)
+{
+    mKeepDistance_m = distance_m;
+}
+
+void cTiledMapStore::open(const std::filesystem::path& base, bool resume)
+{
+    if (isOpen())
+        throw std::logic_error("The tile files are already open.");
+
+    if ((mVoxelSize_m <= 0.0) || (mTileSize_m < mVoxelSize_m)
+        || (mTileSize_m / mVoxelSize_m >= (1 << VOXEL_XY_BITS)))
+    {
+        throw std::invalid_argument("The map tiles must hold a positive number of voxels, less than 2^20 per side.");
+    }
+
+    mTilesFile = base;
+    mTilesFile += ".tiles";
+    mIndexFile = base;
+    mIndexFile += ".tiles.idx";
+
+    mChunks.clear();
+    mTilesInMemory.clear();
+    mTilesSize = 0;
+
+    if (resume && std::filesystem::exists(mIndexFile) && std::filesystem::exists(mTilesFile))
+    {
+        readIndex();
+
+        // Chunks written after the last index are not listed, skip over them
+        mTilesSize = std::filesystem::file_size(mTilesFile);
+        mTiles.open(mTilesFile, std::ios::binary | std::ios::app);
+    }
+    else
+    {
+        mTiles.open(mTilesFile, std::ios::binary | std::ios::trunc);
+        writeIndex();
+    }
+
+    if (!mTiles.is_open())
+    {
+        std::string msg = "Unable to open the map tiles: ";
+        msg += mTilesFile.string();
+        throw std::runtime_error(msg);
+    }
+}
+
+void cTiledMapStore::close()
+{
+    if (!isOpen())
+        return;
+
+    flush();
+
+    mTilesInMemory.clear();
+    mTiles.close();
+}
+
+bool cTiledMapStore::isOpen() const
+{
+    return mTiles.is_open();
+}
+
+void cTiledMapStore::addPoints(const PointCloud& cloud, const Eigen::Vector3d& sensor_m)
+{
+    if (!isOpen())
+        throw std::logic_error("The tile files are not open.");
+
+    sTile* current = nullptr;
+
+    for (const auto& point : cloud)
+    {
+        if (!std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z))
+            continue;
+
+        int32_t tileX = static_cast<int32_t>(std::floor(point.x / mTileSize_m));
+        int32_t tileY = static_cast<int32_t>(std::floor(point.y / mTileSize_m));
+
+        // Consecutive points are mostly in the same tile
+        if (!current || (current->x != tileX) || (current->y != tileY))
+            current = &tile(tileX, tileY);
+
+        if (!current->voxels.insert(voxelKey(*current, point.x, point.y, point.z)))
+            continue;
+
+        current->points.push_back({ point.x, point.y, point.z, point.intensity });
+    }
+
+    // Release the tiles that the SLAM can no longer update
+    bool written = false;
+
+    for (auto it = mTilesInMemory.begin(); it != mTilesInMemory.end(); )
+    {
+        sTile& t = *it->second;
+
+        double x0 = t.x * mTileSize_m;
+        double y0 = t.y * mTileSize_m;
+        double dx = std::max({ x0 - sensor_m.x(), 0.0, sensor_m.x() - (x0 + mTileSize_m) });
+        double dy = std::max({ y0 - sensor_m.y(), 0.0, sensor_m.y() - (y0 + mTileSize_m) });
+
+        if (std::hypot(dx, dy) <= mKeepDistance_m)
+        {
+            ++it;
+            continue;
+        }
+
+        if (t.written < t.points.size())
+        {
+            writeChunk(t);
+            written = true;
+        }
+
+        it = mTilesInMemory.erase(it);
+    }
+
+    if (written)
+        writeIndex();
+}
+
+void cTiledMapStore::flush()
+{
+    if (!isOpen())
+        return;
+
+    bool written = false;
+
+    for (auto& entry : mTilesInMemory)
+    {
+        sTile& t = *entry.second;
+
+        if (t.written < t.points.size())
+        {
+            writeChunk(t);
+            written = true;
+        }
+    }
+
+    if (written)
+        writeIndex();
+}
+
+std::size_t cTiledMapStore::exportPly(const std::filesystem::path& filename) const
+{
+    std::ifstream in(mTilesFile, std::ios::binary);
+    if (!in.is_open())
+    {
+        std::string msg = "Unable to read the map tiles: ";
+        msg += mTilesFile.string();
+        throw std::runtime_error(msg);
+    }
+
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+    {
+        std::string msg = "Unable to create the map: ";
+        msg += filename.string();
+        throw std::runtime_error(msg);
+    }
+
+    // The number of points is known at the end, leave room for it in the header
+    const int countWidth = 12;
+
+    out << "ply\n";
+    out << "format binary_little_endian 1.0\n";
+    out << "comment SLAM map merged from tiles of " << mTileSize_m << " m\n";
+    out << "element vertex ";
+    auto countPos = out.tellp();
+    out << std::setw(countWidth) << std::setfill('0') << 0 << "\n";
+    out << "property float x\n";
+    out << "property float y\n";
+    out << "property float z\n";
+    out << "property float intensity\n";
+    out << "end_header\n";
+
+    // The chunks of each tile, in the order they were written
+    std::vector<sChunk> chunks = mChunks;
+    std::stable_sort(chunks.begin(), chunks.end(), [this](const sChunk& a, const sChunk& b)
+        {
+            return tileKey(a.tileX, a.tileY) < tileKey(b.tileX, b.tileY);
+        });
+
+    std::size_t count = 0;
+    std::vector<float> vertices;
+
+    for (auto first = chunks.begin(); first != chunks.end(); )
+    {
+        auto last = first;
+        while ((last != chunks.end()) && (last->tileX == first->tileX) && (last->tileY == first->tileY))
+            ++last;
+
+        // A tile released and reloaded has voxels in several chunks, keep the first point
+        sTile merged;
+        merged.x = first->tileX;
+        merged.y = first->tileY;
+
+        vertices.clear();
+
+        for (auto it = first; it != last; ++it)
+        {
+            for (const auto& point : readChunk(in, *it))
+            {
+                if (!merged.voxels.insert(voxelKey(merged, point.x, point.y, point.z)))
+                    continue;
+
+                vertices.push_back(point.x);
+                vertices.push_back(point.y);
+                vertices.push_back(point.z);
+                vertices.push_back(point.intensity);
+            }
+        }
+
+        out.write(reinterpret_cast<const char*>(vertices.data()), vertices.size() * sizeof(float));
+        count += vertices.size() / 4;
+
+        first = last;
+    }
+
+    out.seekp(countPos);
+    out << std::setw(countWidth) << std::setfill('0') << count;
+
+    if (!out.good())
+    {
+        std::string msg = "Failed writing the map: ";
+        msg += filename.string();
+        throw std::runtime_error(msg);
+    }
+
+    return count;
+}
+
+std::size_t cTiledMapStore::numTilesInMemory() const
+{
+    return mTilesInMemory.size();
+}
+
+std::size_t cTiledMapStore::numPointsInMemory() const
+{
+    std::size_t n = 0;
+    for (const auto& entry : mTilesInMemory)
+        n += entry.second->points.size();
+
+    return n;
+}
+
+std::size_t cTiledMapStore::numChunks() const
+{
+    return mChunks.size();
+}
+
+int64_t cTiledMapStore::tileKey(int32_t tileX, int32_t tileY) const
+{
+    return (static_cast<int64_t>(tileX) << 32) | static_cast<uint32_t>(tileY);
+}
+
+cTiledMapStore::sTile& cTiledMapStore::tile(int32_t tileX, int32_t tileY)
+{
+    auto& t = mTilesInMemory[tileKey(tileX, tileY)];
+
+    if (!t)
+    {
+        t = std::make_unique<sTile>();
+        t->x = tileX;
+        t->y = tileY;
+    }
+
+    return *t;
+}
+
+uint64_t cTiledMapStore::voxelKey(const sTile& tile, float x, float y, float z) const
+{
+    const uint64_t maxXY = (uint64_t(1) << VOXEL_XY_BITS) - 1;
+    const uint64_t maxZ = (uint64_t(1) << VOXEL_Z_BITS) - 1;
+
+    // Points on the far edges of a tile are clamped into its last voxels
+    double vx = std::floor((x - tile.x * mTileSize_m) / mVoxelSize_m);
+    double vy = std::floor((y - tile.y * mTileSize_m) / mVoxelSize_m);
+    double vz = std::floor(z / mVoxelSize_m) + VOXEL_Z_BIAS;
+
+    uint64_t ix = static_cast<uint64_t>(std::clamp(vx, 0.0, static_cast<double>(maxXY)));
+    uint64_t iy = static_cast<uint64_t>(std::clamp(vy, 0.0, static_cast<double>(maxXY)));
+    uint64_t iz = static_cast<uint64_t>(std::clamp(vz, 0.0, static_cast<double>(maxZ)));
+
+    return ix | (iy << VOXEL_XY_BITS) | (iz << (2 * VOXEL_XY_BITS));
+}
+
+void cTiledMapStore::writeChunk(sTile& tile)
+{
+    sChunk chunk;
+    chunk.tileX = tile.x;
+    chunk.tileY = tile.y;
+    chunk.offset = mTilesSize;
+    chunk.count = static_cast<uint32_t>(tile.points.size() - tile.written);
+
+    auto first = tile.points.begin() + tile.written;
+
+    float max[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        chunk.min[i] = std::numeric_limits<float>::max();
+        max[i] = std::numeric_limits<float>::lowest();
+    }
+
+    for (auto it = first; it != tile.points.end(); ++it)
+    {
+        const float xyz[3] = { it->x, it->y, it->z };
+        for (int i = 0; i < 3; ++i)
+        {
+            chunk.min[i] = std::min(chunk.min[i], xyz[i]);
+            max[i] = std::max(max[i], xyz[i]);
+        }
+    }
+
+    for (int i = 0; i < 3; ++i)
+        chunk.step[i] = std::max(MIN_CHUNK_STEP_M, (max[i] - chunk.min[i]) / 65535.0f);
+
+    std::vector<char> buffer(chunk.count * CHUNK_POINT_SIZE);
+    std::size_t pos = 0;
+
+    for (auto it = first; it != tile.points.end(); ++it)
+    {
+        putUint16(buffer, pos, quantize(it->x, chunk.min[0], chunk.step[0]));
+        putUint16(buffer, pos, quantize(it->y, chunk.min[1], chunk.step[1]));
+        putUint16(buffer, pos, quantize(it->z, chunk.min[2], chunk.step[2]));
+        putUint16(buffer, pos, quantize(it->intensity, 0.0f, 1.0f));
+    }
+
+    mTiles.write(buffer.data(), buffer.size());
+    mTiles.flush();
+
+    if (!mTiles.good())
+    {
+        std::string msg = "Failed writing the map tiles: ";
+        msg += mTilesFile.string();
+        throw std::runtime_error(msg);
+    }
+
+    mTilesSize += buffer.size();
+    mChunks.push_back(chunk);
+
+    tile.written = tile.points.size();
+}
+
+void cTiledMapStore::writeIndex()
+{
+    std::filesystem::path tmp = mIndexFile;
+    tmp += ".tmp";
+
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        if (!out.is_open())
+        {
+            std::string msg = "Unable to write the map tile index: ";
+            msg += tmp.string();
+            throw std::runtime_error(msg);
+        }
+
+        out << std::setprecision(std::numeric_limits<float>::max_digits10);
+        out << INDEX_TAG << "," << mTileSize_m << "," << mVoxelSize_m << "\n";
+        out << "tile_x,tile_y,offset,count,min_x_m,min_y_m,min_z_m,step_x_m,step_y_m,step_z_m\n";
+
+        for (const auto& chunk : mChunks)
+        {
+            out << chunk.tileX << "," << chunk.tileY << "," << chunk.offset << "," << chunk.count;
+            for (int i = 0; i < 3; ++i)
+                out << "," << chunk.min[i];
+            for (int i = 0; i < 3; ++i)
+                out << "," << chunk.step[i];
+            out << "\n";
+        }
+    }
+
+    // Replace the index in one step, a crash leaves either the old or the new one
+    std::filesystem::rename(tmp, mIndexFile);
+}
+
+void cTiledMapStore::readIndex()
+{
+    std::ifstream in(mIndexFile);
+    std::string line;
+
+    if (!std::getline(in, line) || (line.rfind(INDEX_TAG, 0) != 0))
+    {
+        std::string msg = "Not a map tile index: ";
+        msg += mIndexFile.string();
+        throw std::runtime_error(msg);
+    }
+
+    // The tiles of a resumed run keep their size
+    {
+        std::istringstream header(line.substr(std::string(INDEX_TAG).size()));
+        char comma = 0;
+        header >> comma >> mTileSize_m >> comma >> mVoxelSize_m;
+    }
+
+    // Column names
+    std::getline(in, line);
+
+    while (std::getline(in, line))
+    {
+        if (line.empty())
+            continue;
+
+        std::istringstream fields(line);
+        sChunk chunk;
+        char comma = 0;
+
+        fields >> chunk.tileX >> comma >> chunk.tileY >> comma >> chunk.offset >> comma >> chunk.count;
+        for (int i = 0; i < 3; ++i)
+            fields >> comma >> chunk.min[i];
+        for (int i = 0; i < 3; ++i)
+            fields >> comma >> chunk.step[i];
+
+        if (fields.fail())
+        {
+            std::string msg = "Invalid chunk in the map tile index: ";
+            msg += line;
+            throw std::runtime_error(msg);
+        }
+
+        mChunks.push_back(chunk);
+    }
+}
+
+std::vector<cTiledMapStore::sPoint> cTiledMapStore::readChunk(std::ifstream& in, const sChunk& chunk) const
+{
+    std::vector<char> buffer(chunk.count * CHUNK_POINT_SIZE);
+
+    in.seekg(chunk.offset);
+    in.read(buffer.data(), buffer.size());
+
+    if (!in.good())
+    {
+        std::string msg = "Failed reading the map tiles: ";
+        msg += mTilesFile.string();
+        throw std::runtime_error(msg);
+    }
+
+    std::vector<sPoint> points(chunk.count);
+    std::size_t pos = 0;
+
+    for (auto& point : points)
+    {
+        point.x = chunk.min[0] + getUint16(buffer, pos) * chunk.step[0];
+        point.y = chunk.min[1] + getUint16(buffer, pos) * chunk.step[1];
+        point.z = chunk.min[2] + getUint16(buffer, pos) * chunk.step[2];
+        point.intensity = getUint16(buffer, pos);
+    }
+
+    return points;
+}
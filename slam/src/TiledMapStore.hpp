@@ -0,0 +1,132 @@
+#pragma once
+
+#include "LidarPoint.h"
+
+#include <Eigen/Core>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <vector>
+
+
+/**
+ * Stores the registered points of a SLAM run as square tiles of the XY plane
+ * of the world frame, keeping in memory only the tiles near the sensor.
+ *
+ * A tile keeps one point per voxel, the first to reach it, so passing over
+ * the same ground again does not grow the tile.  Once a tile is farther from
+ * the sensor than the keep distance, the SLAM can no longer update it: its
+ * points are appended to the tile file as a chunk and the tile is released.
+ * A chunk stores each point as 16-bit offsets from the corner of its bounding
+ * box and a 16-bit intensity.
+ *
+ * The index file lists every chunk with its tile, its place in the tile file
+ * and its bounding box.  It is rewritten through a temporary file each time
+ * chunks are written, so after a crash the tile file can be used up to the
+ * last flush and a run can append to it.
+ *
+ * The export merges the chunks of one tile at a time, so it needs the memory
+ * of a single tile whatever the size of the map.
+ */
+class cTiledMapStore
+{
+public:
+    using Point = LidarSlam::LidarPoint;
+    using PointCloud = pcl::PointCloud<Point>;
+
+    cTiledMapStore();
+    ~cTiledMapStore();
+
+    void setTileSize(double tileSize_m);
+    void setVoxelSize(double voxelSize_m);
+
+    /**
+     * Tiles farther than this from the sensor, in the XY plane, are written
+     * and released.
+     */
+    void setKeepDistance(double distance_m);
+
+    /**
+     * Opens <base>.tiles and <base>.tiles.idx.  When resuming, the chunks of
+     * the existing files are kept and new chunks are appended after them.
+     */
+    void open(const std::filesystem::path& base, bool resume);
+
+    /**
+     * Writes the tiles still in memory and closes the files.
+     */
+    void close();
+
+    bool isOpen() const;
+
+    /**
+     * Adds points in world coordinates, then releases the tiles out of reach
+     * of the sensor.
+     */
+    void addPoints(const PointCloud& cloud, const Eigen::Vector3d& sensor_m);
+
+    /**
+     * Writes the points not yet written of every tile, keeping the tiles in
+     * memory.
+     */
+    void flush();
+
+    /**
+     * Merges the chunks of each tile into a binary PLY file.
+     * Returns the number of points written.
+     */
+    std::size_t exportPly(const std::filesystem::path& filename) const;
+
+    std::size_t numTilesInMemory() const;
+    std::size_t numPointsInMemory() const;
+    std::size_t numChunks() const;
+
+private:
+    struct sPoint
+    {
+        float x = 0.0f;
+        float y = 0.0f;
+        float z = 0.0f;
+        float intensity = 0.0f;
+    };
+
+    struct sChunk
+    {
+        int32_t tileX = 0;
+        int32_t tileY = 0;
+        uint64_t offset = 0;
+        uint32_t count = 0;
+        float min[3] = { 0.0f, 0.0f, 0.0f };
+        float step[3] = { 0.0f, 0.0f, 0.0f };
+    };
+
+    class cVoxelSet;
+    struct sTile;
+
+    int64_t tileKey(int32_t tileX, int32_t tileY) const;
+    sTile& tile(int32_t tileX, int32_t tileY);
+
+    uint64_t voxelKey(const sTile& tile, float x, float y, float z) const;
+
+    void writeChunk(sTile& tile);
+    void writeIndex();
+    void readIndex();
+
+    std::vector<sPoint> readChunk(std::ifstream& in, const sChunk& chunk) const;
+
+private:
+    double mTileSize_m = 10.0;
+    double mVoxelSize_m = 0.02;
+    double mKeepDistance_m = 250.0;
+
+    std::filesystem::path mTilesFile;
+    std::filesystem::path mIndexFile;
+    std::ofstream mTiles;
+    uint64_t mTilesSize = 0;
+
+    std::map<int64_t, std::unique_ptr<sTile>> mTilesInMemory;
+    std::vector<sChunk> mChunks;
+};
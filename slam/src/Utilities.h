@@ -101,17 +101,16 @@ namespace Utils
 
 //------------------------------------------------------------------------------
 /*!
- * @brief Sort a vector and return sorted indices
+ * @brief Sort a vector into the given indices, reusing their memory
  * @param v The vector to sort
+ * @param idx The sorted indices, same order as SortIdx(v, ascending)
  * @param ascending If true, sort in ascending (increasing) order
- * @return The sorted indices such that the first index is the biggest input
- *         value and the last the smallest.
  */
 template<typename T>
-std::vector<size_t> SortIdx(const std::vector<T>& v, bool ascending=true)
+void SortIdx(const std::vector<T>& v, std::vector<size_t>& idx, bool ascending=true)
 {
   // Initialize original index locations
-  std::vector<size_t> idx(v.size());
+  idx.resize(v.size());
   std::iota(idx.begin(), idx.end(), 0);
 
   // Sort indices based on comparing values in v
@@ -119,7 +118,21 @@ std::vector<size_t> SortIdx(const std::vector<T>& v, bool ascending=true)
     std::sort(idx.begin(), idx.end(), [&v](size_t i1, size_t i2) { return v[i1] < v[i2]; });
   else
     std::sort(idx.begin(), idx.end(), [&v](size_t i1, size_t i2) { return v[i1] > v[i2]; });
+}
 
+//------------------------------------------------------------------------------
+/*!
+ * @brief Sort a vector and return sorted indices
+ * @param v The vector to sort
+ * @param ascending If true, sort in ascending (increasing) order
+ * @return The sorted indices such that the first index is the biggest input
+ *         value and the last the smallest.
+ */
+template<typename T>
+std::vector<size_t> SortIdx(const std::vector<T>& v, bool ascending=true)
+{
+  std::vector<size_t> idx;
+  SortIdx(v, idx, ascending);
   return idx;
 }
 
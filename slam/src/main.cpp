@@ -85,6 +85,12 @@ int main(int argc, char** argv)
 	std::string output_directory = current_path().string();
 
 	bool isFile = false;
+	bool flatMap = false;
+	bool dollyPrior = false;
+	bool writeMap = false;
+	double mapVoxelSize_m = 0.02;
+	uint32_t checkpointInterval = 0;
+	bool resume = false;
 	bool showHelp = false;
 
 	auto cli = lyra::cli()
@@ -97,6 +103,26 @@ int main(int argc, char** argv)
 		["-t"]["--threads"]
 		("The number of threads to use for repairing data files.")
 		.optional()
+		| lyra::opt(flatMap)
+		["--flat_map"]
+		("Store the SLAM maps in a flat hash table instead of nested hash maps.")
+		| lyra::opt(dollyPrior)
+		["--dolly_prior"]
+		("Seed the SLAM pose of each frame from the SpiderCam or GPS positions of the dolly.")
+		| lyra::opt(writeMap)
+		["--map"]
+		("Write the SLAM map as tiles on disk and merge them into a ply file at the end.")
+		| lyra::opt(mapVoxelSize_m, "meters")
+		["--map_voxel"]
+		("The size of the voxels of the SLAM map, with one point per voxel.")
+		.optional()
+		| lyra::opt(checkpointInterval, "frames")
+		["--checkpoint"]
+		("Save the SLAM state every given number of frames.")
+		.optional()
+		| lyra::opt(resume)
+		["--resume"]
+		("Resume from the last saved SLAM state of the output file.")
 		| lyra::arg(input_directory, "input directory")
 		("The path to input directory/file for converting pointcloud data to a ply file(s).")
 		.required()
@@ -223,6 +249,11 @@ int main(int argc, char** argv)
 		}
 
 		cFileProcessor* fp = new cFileProcessor();
+		fp->setFlatVoxelMap(flatMap);
+		fp->setDollyPrior(dollyPrior);
+		fp->setMapOutput(writeMap, mapVoxelSize_m);
+		fp->setCheckpointInterval(checkpointInterval);
+		fp->setResume(resume);
 
 		pool.push_task(&cFileProcessor::process_file, fp, in_file, out_file);
 
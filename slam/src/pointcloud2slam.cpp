@@ -1,12 +1,23 @@
 
 #include "pointcloud2slam.hpp"
 #include "PointCloudTypes.hpp"
+#include "SlamParameters.hpp"
 
 #include "LidarPoint.h"
 #include "Utilities.h"
 
+#include "Constants.hpp"
+#include "RappFieldBoundary.hpp"
+
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <limits>
 #include <memory>
+#include <sstream>
+
+
+extern void console_message(const std::string& msg);
 
 
 //#define USE_BINARY
@@ -14,13 +25,37 @@ using namespace LidarSlam;
 
 namespace
 {
+    /// The number of decoded frames the reader stage may run ahead of the conversion
+    const std::size_t SENSOR_QUEUE_DEPTH = 4;
+
+    /// The number of converted frames the conversion stage may run ahead of the SLAM
+    const std::size_t SLAM_QUEUE_DEPTH = 4;
+
+    /// The number of registered frames the SLAM may run ahead of the map stage
+    const std::size_t MAP_QUEUE_DEPTH = 4;
+
+    /// The number of frames between throughput reports
+    const uint32_t REPORT_INTERVAL = 100;
+
     inline bool IsZero(const pointcloud::sCloudPoint_t& point)
     {
         return (point.X_m == 0.0) && (point.Y_m == 0.0) && (point.Z_m == 0.0);
     }
+
+    int64_t elapsed_us(std::chrono::steady_clock::time_point since)
+    {
+        auto dt = std::chrono::steady_clock::now() - since;
+        return std::chrono::duration_cast<std::chrono::microseconds>(dt).count();
+    }
+
+    double frameRate(uint32_t frames, int64_t time_us)
+    {
+        return (time_us > 0) ? (frames * 1'000'000.0) / time_us : 0.0;
+    }
 }
 
-cPointCloud2Slam::cPointCloud2Slam() : cPointCloudParser()
+cPointCloud2Slam::cPointCloud2Slam() : cPointCloudParser(),
+    mSensorFrames(SENSOR_QUEUE_DEPTH), mSlamFrames(SLAM_QUEUE_DEPTH), mMapFrames(MAP_QUEUE_DEPTH)
 {
     // ***************************************************************************
     // Init SLAM state
@@ -31,6 +66,8 @@ cPointCloud2Slam::cPointCloud2Slam() : cPointCloudParser()
 
 cPointCloud2Slam::~cPointCloud2Slam()
 {
+    finish();
+
 //    mLidarSlam.SaveMapsToPCD("McGrath_Soy1_");
 }
 
@@ -39,173 +76,141 @@ void cPointCloud2Slam::setOutputPath(std::filesystem::path out)
     mOutputPath = out;
 }
 
-//------------------------------------------------------------------------------
-void cPointCloud2Slam::setSlamParameters()
+void cPointCloud2Slam::setVoxelGridStorage(LidarSlam::VoxelGridStorage storage)
 {
-#define SetSlamParam(type, rosParam, slamParam) { type val; if (this->PrivNh.getParam(rosParam, val)) this->LidarSlam.Set##slamParam(val); }
-    // General
-    mLidarSlam.SetTwoDMode(false);
-    mLidarSlam.SetVerbosity(2);
-    mLidarSlam.SetNbThreads(4);
-    mLidarSlam.SetLoggingTimeout(4);
-    mLidarSlam.SetLogOnlyKeyframes(true);
-
-    auto egoMotion = LidarSlam::EgoMotionMode::MOTION_EXTRAPOLATION;
-    mLidarSlam.SetEgoMotion(egoMotion);
-
-
-    mLidarSlam.SetUndistortion(LidarSlam::UndistortionMode::REFINED);
-
-    mLidarSlam.SetLoggingStorage(LidarSlam::PointCloudStorageType::PCL_CLOUD);
-
-    // Frame Ids
-    mLidarSlam.SetWorldFrameId("world");
-    mLidarSlam.SetBaseFrameId("base");
-
-    // Multi-LiDAR devices
-
-    // Single LiDAR device
-    auto ke = std::make_shared<LidarSlam::SpinningSensorKeypointExtractor>();
-
-    ke->SetAzimuthalResolution_rad(0.0);
-    ke->SetNbThreads(1);
-    ke->SetMinNeighNb(4);
-    ke->SetMinNeighRadius(0.05);
-    ke->SetMinDistanceToSensor_m(1.5);
-    ke->SetMinBeamSurfaceAngle_deg(10);
-    ke->SetMinAzimuth_deg(0.0);
-    ke->SetMaxAzimuth_deg(360.0);
-    ke->SetPlaneSinAngleThreshold(0.5);
-    ke->SetEdgeSinAngleThreshold(0.86);
-    ke->SetEdgeDepthGapThreshold_m(0.5);
-    ke->SetEdgeNbGapPoints(5);
-    ke->SetEdgeIntensityGapThreshold(50.0);
-    ke->SetMaxPoints(INT_MAX);
-    ke->SetVoxelResolution_m(0.1);
-    ke->SetInputSamplingRatio(1.0f);
-
-    mLidarSlam.SetKeyPointsExtractor(ke);
-    mLidarSlam.EnableKeypointType(LidarSlam::Keypoint::EDGE, true);
-    mLidarSlam.EnableKeypointType(LidarSlam::Keypoint::INTENSITY_EDGE, true);
-    mLidarSlam.EnableKeypointType(LidarSlam::Keypoint::PLANE, true);
-    mLidarSlam.EnableKeypointType(LidarSlam::Keypoint::BLOB, true);
-
-/*
-    // Ego motion
-    mLidarSlam.SetEgoMotionICPMaxIter();
-    mLidarSlam.SetEgoMotionLMMaxIter();
-    mLidarSlam.SetEgoMotionMaxNeighborsDistance();
-    mLidarSlam.SetEgoMotionEdgeNbNeighbors();
-    mLidarSlam.SetEgoMotionEdgeMinNbNeighbors();
-    mLidarSlam.SetEgoMotionEdgeMaxModelError();
-    mLidarSlam.SetEgoMotionPlaneNbNeighbors();
-    mLidarSlam.SetEgoMotionPlanarityThreshold();
-    mLidarSlam.SetEgoMotionPlaneMaxModelError();
-    mLidarSlam.SetEgoMotionInitSaturationDistance();
-    mLidarSlam.SetEgoMotionFinalSaturationDistance();
-
-    // Localization
-    mLidarSlam.SetLocalizationICPMaxIter();
-    mLidarSlam.SetLocalizationLMMaxIter();
-    mLidarSlam.SetLocalizationMaxNeighborsDistance();
-    mLidarSlam.SetLocalizationEdgeNbNeighbors();
-    mLidarSlam.SetLocalizationEdgeMinNbNeighbors();
-    mLidarSlam.SetLocalizationEdgeMaxModelError();
-    mLidarSlam.SetLocalizationPlaneNbNeighbors();
-    mLidarSlam.SetLocalizationPlanarityThreshold();
-    mLidarSlam.SetLocalizationPlaneMaxModelError();
-    mLidarSlam.SetLocalizationBlobNbNeighbors();
-    mLidarSlam.SetLocalizationInitSaturationDistance();
-    mLidarSlam.SetLocalizationFinalSaturationDistance();
-
-    // External sensors
-    mLidarSlam.SetSensorMaxMeasures();
-    mLidarSlam.SetSensorTimeThreshold();
-    mLidarSlam.SetLandmarkWeight();
-    mLidarSlam.SetLandmarkSaturationDistance();
-    mLidarSlam.SetLandmarkPositionOnly();
-    //this->LidarTimePosix = this->PrivNh.param("external_sensors/landmark_detector/lidar_is_posix", true);
-
-    // Graph parameters
-    mLidarSlam.SetG2oFileName();
-    mLidarSlam.SetFixFirstVertex();
-    mLidarSlam.SetFixLastVertex();
-    mLidarSlam.SetCovarianceScale();
-    mLidarSlam.SetNbGraphIterations();
-*/
-
-    // Confidence estimators
-    // Overlap
-//    mLidarSlam.SetOverlapSamplingRatio();
-
-    // Motion limitations (hard constraints to detect failure();
-    mLidarSlam.SetAccelerationLimit_mps2(2.0);
-    mLidarSlam.SetRotationAccelLimit_dps2(10.0);
-
-    mLidarSlam.SetVelocityLimit_mps(2.0);
-    mLidarSlam.SetRotationRateLimit_dps(10.0);
-
-    mLidarSlam.SetTimeWindowDuration_sec(1.0);
-
-    // Keyframes
-//    mLidarSlam.SetKfDistanceThreshold();
-//    mLidarSlam.SetKfAngleThreshold();
-
-/*
-    // Maps
-    int mapUpdateMode;
-    if (this->PrivNh.getParam("slam/voxel_grid/update_maps", mapUpdateMode))
-    {
-        LidarSlam::MappingMode mapUpdate = static_cast<LidarSlam::MappingMode>(mapUpdateMode);
-        if (mapUpdate != LidarSlam::MappingMode::NONE &&
-            mapUpdate != LidarSlam::MappingMode::ADD_KPTS_TO_FIXED_MAP &&
-            mapUpdate != LidarSlam::MappingMode::UPDATE)
-        {
-            ROS_ERROR_STREAM("Invalid map update mode (" << mapUpdateMode << "). Setting it to 'UPDATE'.");
-            mapUpdate = LidarSlam::MappingMode::UPDATE;
-        }
-        mLidarSlam.SetMapUpdate(mapUpdate);
-    }
-    double size = 0.0;
-    if (this->PrivNh.getParam("slam/voxel_grid/leaf_size/edges", size) && mLidarSlam.KeypointTypeEnabled(LidarSlam::EDGE))
-        mLidarSlam.SetVoxelGridLeafSize(LidarSlam::EDGE, size);
-    if (this->PrivNh.getParam("slam/voxel_grid/leaf_size/intensity_edges", size) && mLidarSlam.KeypointTypeEnabled(LidarSlam::INTENSITY_EDGE))
-        mLidarSlam.SetVoxelGridLeafSize(LidarSlam::INTENSITY_EDGE, size);
-    if (this->PrivNh.getParam("slam/voxel_grid/leaf_size/planes", size) && mLidarSlam.KeypointTypeEnabled(LidarSlam::PLANE))
-        mLidarSlam.SetVoxelGridLeafSize(LidarSlam::PLANE, size);
-    if (this->PrivNh.getParam("slam/voxel_grid/leaf_size/blobs", size) && mLidarSlam.KeypointTypeEnabled(LidarSlam::BLOB))
-        mLidarSlam.SetVoxelGridLeafSize(LidarSlam::BLOB, size);
-
-    mLidarSlam.SetVoxelGridResolution();
-    mLidarSlam.SetVoxelGridSize();
-    mLidarSlam.SetVoxelGridDecayingThreshold();
-    mLidarSlam.SetVoxelGridMinFramesPerVoxel();
-*/
+    mLidarSlam.SetVoxelGridStorage(storage);
+}
+
+void cPointCloud2Slam::setDollyPrior(bool enable)
+{
+    mDollyPriorEnabled = enable;
+    mDollyPrior.clear();
+
+    // The ego-motion falls back to the motion extrapolation until the dolly has moved
+    if (enable)
+        mLidarSlam.SetEgoMotion(LidarSlam::EgoMotionMode::EXTERNAL_OR_MOTION_EXTRAPOLATION);
+
+    mLidarSlam.SetLocalizationAdaptToPrior(enable);
+}
+
+void cPointCloud2Slam::setMapOutput(bool enable, double voxelSize_m)
+{
+    mMapEnabled = enable;
+    mMapStore.setVoxelSize(voxelSize_m);
+}
+
+void cPointCloud2Slam::setCheckpointInterval(uint32_t frames)
+{
+    mCheckpointInterval = frames;
+}
+
+void cPointCloud2Slam::setResume(bool resume)
+{
+    mResume = resume;
+}
+
+void cPointCloud2Slam::start()
+{
+    if (mConversionThread.joinable() || mPoseThread.joinable() || mMapThread.joinable())
+    {
+        throw std::logic_error("The SLAM pipeline is already running.");
+    }
 
+    if ((mMapEnabled || (mCheckpointInterval > 0) || mResume) && mOutputPath.empty())
+    {
+        throw std::logic_error("The SLAM map and checkpoints need an output path.");
+    }
+
+    if (mResume)
+        loadCheckpoint();
+
+    if (mMapEnabled)
+    {
+        // The SLAM no longer moves the points it has registered out of its maps
+        double halfWidth_m = 0.5 * mLidarSlam.GetVoxelGridSize() * mLidarSlam.GetVoxelGridResolution();
+        mMapStore.setKeepDistance(halfWidth_m);
+        mMapStore.open(mOutputPath, mResumedFrames > 0);
+    }
+
+    // Extract the same keypoint types as the SLAM uses
+    mKeypointTypes.clear();
     for (auto k : LidarSlam::KeypointTypes)
     {
-        if (!mLidarSlam.KeypointTypeEnabled(k))
-           continue;
+        if (mLidarSlam.KeypointTypeEnabled(k))
+            mKeypointTypes.push_back(k);
+    }
 
-        int samplingMode;
+    mKeypointExtractor->Enable(mKeypointTypes);
 
-        // if (this->PrivNh.getParam("slam/voxel_grid/sampling_mode/" + LidarSlam::KeypointTypeNames.at(k), samplingMode))
-        if (false)
+    mStartTime = std::chrono::steady_clock::now();
+    mReadResumed = mStartTime;
+
+    mConversionThread = std::thread(&cPointCloud2Slam::convertFrames, this);
+    mPoseThread = std::thread(&cPointCloud2Slam::estimatePoses, this);
+
+    if (mMapEnabled || (mCheckpointInterval > 0))
+        mMapThread = std::thread(&cPointCloud2Slam::storeMap, this);
+}
+
+void cPointCloud2Slam::finish()
+{
+    if (!mConversionThread.joinable() && !mPoseThread.joinable() && !mMapThread.joinable())
+        return;
+
+    // No more frames will be read, let the stages drain the queues
+    mSensorFrames.close();
+
+    if (mConversionThread.joinable())
+        mConversionThread.join();
+
+    if (mPoseThread.joinable())
+        mPoseThread.join();
+
+    if (mMapThread.joinable())
+        mMapThread.join();
+
+    if (!mError.empty())
+    {
+        console_message(mError);
+    }
+
+    reportThroughput();
+
+    if (mMapStore.isOpen())
+    {
+        try
         {
-            LidarSlam::SamplingMode sampling = static_cast<LidarSlam::SamplingMode>(samplingMode);
-            if (sampling != LidarSlam::SamplingMode::FIRST &&
-                    sampling != LidarSlam::SamplingMode::LAST &&
-                    sampling != LidarSlam::SamplingMode::MAX_INTENSITY &&
-                    sampling != LidarSlam::SamplingMode::CENTER_POINT &&
-                    sampling != LidarSlam::SamplingMode::CENTROID)
-            {
-               sampling = LidarSlam::SamplingMode::MAX_INTENSITY;
-            }
-            mLidarSlam.SetVoxelGridSamplingMode(k, sampling);
+            mMapStore.close();
+
+            std::filesystem::path mapFile = mOutputPath;
+            mapFile += ".map.ply";
+
+            auto count = mMapStore.exportPly(mapFile);
+
+            std::string msg = "SLAM map: ";
+            msg += std::to_string(count);
+            msg += " points written to ";
+            msg += mapFile.string();
+            console_message(msg);
+        }
+        catch (const std::exception& e)
+        {
+            std::string msg = "Map Error: ";
+            msg += e.what();
+            console_message(msg);
         }
     }
 }
 
+//------------------------------------------------------------------------------
+void cPointCloud2Slam::setSlamParameters()
+{
+    nSlamParameters::apply(mLidarSlam);
+
+    // The keypoints are extracted by the conversion stage with the same settings
+    mKeypointExtractor = nSlamParameters::createKeypointExtractor();
+}
+
 //------------------------------------------------------------------------------
 void cPointCloud2Slam::setSlamInitialState()
 {
@@ -253,24 +258,401 @@ bool cPointCloud2Slam::updateBaseToLidarOffset(uint32_t lidarFrameId, uint8_t li
     return true;
 }
 
-/*----------------------------------------------------------------------------
- *  Called by cPointCloudParser
- *---------------------------------------------------------------------------*/
-void cPointCloud2Slam::onCoordinateSystem(pointcloud::eCOORDINATE_SYSTEM config_param) {}
-void cPointCloud2Slam::onKinematicModel(pointcloud::eKINEMATIC_MODEL model) {}
-void cPointCloud2Slam::onSensorAngles(double pitch_deg, double roll_deg, double yaw_deg) {}
-void cPointCloud2Slam::onKinematicSpeed(double vx_mps, double vy_mps, double vz_mps) {}
+//==============================================================================
+//   Pipeline stages
+//==============================================================================
 
-void cPointCloud2Slam::onDimensions(double x_min_m, double x_max_m,
-    double y_min_m, double y_max_m, double z_min_m, double z_max_m) {}
+//------------------------------------------------------------------------------
+void cPointCloud2Slam::convertFrames()
+{
+    try
+    {
+        std::unique_ptr<sSensorFrame> sensorFrame;
 
-void cPointCloud2Slam::onImuData(pointcloud::imu_data_t data) {}
+        while (mSensorFrames.pop(sensorFrame))
+        {
+            auto start = std::chrono::steady_clock::now();
 
-void cPointCloud2Slam::onReducedPointCloudByFrame(uint16_t frameID, uint64_t timestamp_ns, cReducedPointCloudByFrame pointCloud)
+            sSlamFrame frame;
+            frame.cloud = convert(sensorFrame->frameID, sensorFrame->timestamp_ns, sensorFrame->pointCloud);
+
+            if (mDollyPriorEnabled)
+            {
+                // The SLAM times a frame by the stamp of its header
+                double time_sec = frame.cloud->header.stamp * 1.0e-6;
+
+                mDollyPrior.setMountAngles(sensorFrame->mountAngles);
+                frame.hasPrior = mDollyPrior.addFrame(time_sec, sensorFrame->dolly, frame.prior);
+            }
+
+            sensorFrame.reset();
+
+            // An empty frame is rejected by the SLAM, there is nothing to extract
+            if (!frame.cloud->empty())
+            {
+                mKeypointExtractor->ComputeKeyPoints(frame.cloud);
+
+                for (auto k : mKeypointTypes)
+                    frame.keypoints[k] = mKeypointExtractor->GetKeypoints(k);
+            }
+
+            mConversionTiming.busy_us += elapsed_us(start);
+            ++mConversionTiming.frames;
+
+            // The pose estimation stage has stopped
+            if (!mSlamFrames.push(std::move(frame)))
+            {
+                mSensorFrames.close();
+                break;
+            }
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::string msg = "Conversion Error: ";
+        msg += e.what();
+        stop(msg);
+    }
+
+    mSlamFrames.close();
+}
+
+//------------------------------------------------------------------------------
+void cPointCloud2Slam::estimatePoses()
 {
+    try
+    {
+        sSlamFrame frame;
+
+        while (mSlamFrames.pop(frame))
+        {
+            auto start = std::chrono::steady_clock::now();
+
+            if (frame.hasPrior)
+                mLidarSlam.AddPoseMeasurement(frame.prior);
+
+            // Run SLAM : register new frame and update localization and map.
+            mLidarSlam.AddFrame(frame.cloud, frame.keypoints);
+
+            if (frame.hasPrior)
+            {
+                ++mPriorFrames;
+                mPriorIcpIterations += mLidarSlam.GetLocalizationNbIterations();
+            }
+
+            sMapFrame mapFrame;
+
+            // The SLAM rejects an empty frame, it has no registered points
+            if (mMapEnabled && !frame.cloud->empty())
+            {
+                mapFrame.cloud = mLidarSlam.GetRegisteredFrame();
+                mapFrame.sensor_m = mLidarSlam.GetWorldTransform().translation();
+            }
+
+            uint32_t frames = mResumedFrames + mPoseTiming.frames + 1;
+            if ((mCheckpointInterval > 0) && ((frames % mCheckpointInterval) == 0))
+            {
+                mapFrame.hasCheckpoint = true;
+                mapFrame.checkpoint = saveCheckpoint(frames);
+            }
+
+            frame = sSlamFrame();
+
+            mPoseTiming.busy_us += elapsed_us(start);
+
+            // The map stage has stopped
+            if ((mapFrame.cloud || mapFrame.hasCheckpoint) && !mMapFrames.push(std::move(mapFrame)))
+            {
+                mSlamFrames.close();
+                break;
+            }
+
+            if ((++mPoseTiming.frames % REPORT_INTERVAL) == 0)
+                reportThroughput();
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::string msg = "SLAM Error: ";
+        msg += e.what();
+        stop(msg);
+    }
+
+    mMapFrames.close();
 }
 
-void cPointCloud2Slam::onSensorPointCloudByFrame(uint16_t frameID, uint64_t timestamp_ns, cSensorPointCloudByFrame pointCloud)
+//------------------------------------------------------------------------------
+void cPointCloud2Slam::storeMap()
+{
+    try
+    {
+        sMapFrame frame;
+
+        while (mMapFrames.pop(frame))
+        {
+            auto start = std::chrono::steady_clock::now();
+
+            if (frame.cloud)
+            {
+                mMapStore.addPoints(*frame.cloud, frame.sensor_m);
+                mMapTilesInMemory = mMapStore.numTilesInMemory();
+                ++mMapTiming.frames;
+            }
+
+            if (frame.hasCheckpoint)
+            {
+                mMapStore.flush();
+                writeCheckpoint(frame.checkpoint);
+            }
+
+            frame = sMapFrame();
+
+            mMapTiming.busy_us += elapsed_us(start);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::string msg = "Map Error: ";
+        msg += e.what();
+        stop(msg);
+    }
+}
+
+//------------------------------------------------------------------------------
+std::filesystem::path cPointCloud2Slam::checkpointFile() const
+{
+    std::filesystem::path file = mOutputPath;
+    file += ".checkpoint";
+    return file;
+}
+
+//------------------------------------------------------------------------------
+cPointCloud2Slam::sCheckpoint cPointCloud2Slam::saveCheckpoint(uint32_t frames)
+{
+    sCheckpoint checkpoint;
+    checkpoint.frames = frames;
+    checkpoint.startTimestamp_ns = mStartTimestamp_ns;
+    checkpoint.pose = mLidarSlam.GetWorldTransform();
+
+    // The map stage commits a checkpoint a few frames after it is saved, so
+    // each checkpoint has maps of its own rather than reusing a file name
+    checkpoint.mapsPrefix = checkpointFile().string();
+    checkpoint.mapsPrefix += "." + std::to_string(frames) + ".";
+
+    mLidarSlam.SaveMapsToPCD(checkpoint.mapsPrefix, LidarSlam::PCDFormat::BINARY_COMPRESSED, false);
+
+    return checkpoint;
+}
+
+//------------------------------------------------------------------------------
+void cPointCloud2Slam::writeCheckpoint(const sCheckpoint& checkpoint)
+{
+    std::filesystem::path file = checkpointFile();
+    std::filesystem::path tmp = file;
+    tmp += ".tmp";
+
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        if (!out.is_open())
+        {
+            std::string msg = "Unable to write the SLAM checkpoint: ";
+            msg += tmp.string();
+            throw std::runtime_error(msg);
+        }
+
+        Eigen::Vector6d pose = LidarSlam::Utils::IsometryToXYZRPY(checkpoint.pose);
+
+        out << std::setprecision(std::numeric_limits<double>::max_digits10);
+        out << "frames " << checkpoint.frames << "\n";
+        out << "start_timestamp_ns " << checkpoint.startTimestamp_ns << "\n";
+        out << "maps " << checkpoint.mapsPrefix << "\n";
+        out << "pose";
+        for (int i = 0; i < 6; ++i)
+            out << " " << pose[i];
+        out << "\n";
+    }
+
+    std::filesystem::rename(tmp, file);
+
+    // Only now are the maps of the previous checkpoint no longer needed
+    if (!mCommittedMapsPrefix.empty() && (mCommittedMapsPrefix != checkpoint.mapsPrefix))
+        removeMaps(mCommittedMapsPrefix);
+
+    mCommittedMapsPrefix = checkpoint.mapsPrefix;
+}
+
+//------------------------------------------------------------------------------
+void cPointCloud2Slam::removeMaps(const std::string& mapsPrefix)
+{
+    std::filesystem::path prefix = mapsPrefix;
+
+    auto directory = prefix.parent_path();
+    if (directory.empty())
+        directory = ".";
+
+    const auto name = prefix.filename().string();
+
+    std::error_code ec;
+    std::filesystem::directory_iterator it(directory, ec), end;
+
+    for (; !ec && (it != end); it.increment(ec))
+    {
+        const auto& file = it->path();
+
+        if ((file.filename().string().compare(0, name.size(), name) == 0) && (file.extension() == ".pcd"))
+            std::filesystem::remove(file, ec);
+    }
+
+    // An old map left on disk does not affect the checkpoints
+    if (ec)
+    {
+        std::string msg = "Unable to remove the SLAM maps: ";
+        msg += mapsPrefix;
+        msg += "*.pcd";
+        console_message(msg);
+    }
+}
+
+//------------------------------------------------------------------------------
+bool cPointCloud2Slam::loadCheckpoint()
+{
+    std::ifstream in(checkpointFile());
+    if (!in.is_open())
+        return false;
+
+    sCheckpoint checkpoint;
+    std::vector<double> pose;
+
+    std::string line;
+    while (std::getline(in, line))
+    {
+        std::istringstream fields(line);
+        std::string key;
+        fields >> key;
+
+        if (key == "frames")
+            fields >> checkpoint.frames;
+        else if (key == "start_timestamp_ns")
+            fields >> checkpoint.startTimestamp_ns;
+        else if (key == "maps")
+            std::getline(fields >> std::ws, checkpoint.mapsPrefix);
+        else if (key == "pose")
+        {
+            double value = 0.0;
+            while (fields >> value)
+                pose.push_back(value);
+        }
+    }
+
+    if ((checkpoint.frames == 0) || checkpoint.mapsPrefix.empty() || (pose.size() != 6))
+    {
+        std::string msg = "Invalid SLAM checkpoint: ";
+        msg += checkpointFile().string();
+        throw std::runtime_error(msg);
+    }
+
+    mLidarSlam.LoadMapsFromPCD(checkpoint.mapsPrefix);
+    mCommittedMapsPrefix = checkpoint.mapsPrefix;
+    mLidarSlam.SetWorldTransformFromGuess(LidarSlam::Utils::XYZRPYtoIsometry(pose));
+
+    // Keep the frame times and numbers of the interrupted run
+    mStartTimestamp_ns = checkpoint.startTimestamp_ns;
+    mResyncTimestamp = false;
+    mLidarFrameId = checkpoint.frames;
+
+    mResumedFrames = checkpoint.frames;
+    mSkipFrames = checkpoint.frames;
+
+    std::string msg = "Resuming the SLAM after frame ";
+    msg += std::to_string(checkpoint.frames);
+    console_message(msg);
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void cPointCloud2Slam::stop(const std::string& error)
+{
+    {
+        std::lock_guard<std::mutex> guard(mErrorMutex);
+        if (mError.empty())
+            mError = error;
+    }
+
+    mStopped = true;
+
+    mSensorFrames.close();
+    mSlamFrames.close();
+    mMapFrames.close();
+}
+
+bool cPointCloud2Slam::stopped() const
+{
+    return mStopped;
+}
+
+//------------------------------------------------------------------------------
+void cPointCloud2Slam::reportThroughput()
+{
+    struct sStage
+    {
+        const char* name;
+        double fps;
+    };
+
+    std::vector<sStage> stages =
+    {
+        { "read",    frameRate(mReadTiming.frames, mReadTiming.busy_us) },
+        { "convert", frameRate(mConversionTiming.frames, mConversionTiming.busy_us) },
+        { "pose",    frameRate(mPoseTiming.frames, mPoseTiming.busy_us) }
+    };
+
+    if (mMapEnabled)
+        stages.push_back({ "map", frameRate(mMapTiming.frames, mMapTiming.busy_us) });
+
+    // The stage with the lowest rate of its own holds the others back
+    const sStage* slowest = &stages[0];
+    for (const auto& stage : stages)
+    {
+        if (stage.fps < slowest->fps)
+            slowest = &stage;
+    }
+
+    std::ostringstream msg;
+    msg << std::fixed << std::setprecision(1);
+    msg << "SLAM: " << mPoseTiming.frames << " frames at "
+        << frameRate(mPoseTiming.frames, elapsed_us(mStartTime)) << " fps (";
+
+    for (const auto& stage : stages)
+    {
+        msg << stage.name << " " << stage.fps << " fps, ";
+    }
+
+    msg << "queued " << mSensorFrames.size() << "/" << mSensorFrames.capacity()
+        << " and " << mSlamFrames.size() << "/" << mSlamFrames.capacity();
+
+    if (mMapEnabled)
+        msg << " and " << mMapFrames.size() << "/" << mMapFrames.capacity();
+
+    msg << "), limited by " << slowest->name;
+
+    if (mMapEnabled)
+    {
+        msg << ", " << mMapTilesInMemory << " map tiles in memory";
+    }
+
+    if (mPriorFrames > 0)
+    {
+        msg << ", " << static_cast<double>(mPriorIcpIterations) / mPriorFrames
+            << " ICP iterations per frame with a dolly prior";
+    }
+
+    console_message(msg.str());
+}
+
+//------------------------------------------------------------------------------
+cPointCloud2Slam::CloudS::Ptr cPointCloud2Slam::convert(uint16_t frameID, uint64_t timestamp_ns,
+    const cSensorPointCloudByFrame& pointCloud)
 {
     static double delta_t_us = 100'000.0 / 1024.0;
 
@@ -280,8 +662,6 @@ void cPointCloud2Slam::onSensorPointCloudByFrame(uint16_t frameID, uint64_t time
         mResyncTimestamp = false;
     }
 
-    std::cout << "Frame ID: " << mLidarFrameId << "\n";
-
     double time_us = static_cast<double>(timestamp_ns - mStartTimestamp_ns) / 1'000.0;
 
     auto channelsPerColumn = pointCloud.channelsPerColumn();
@@ -321,16 +701,67 @@ void cPointCloud2Slam::onSensorPointCloudByFrame(uint16_t frameID, uint64_t time
         }
     }
 
+    return frame;
+}
 
-    // Update TF from BASE to LiDAR
-//    if (!updateBaseToLidarOffset(cloudS_ptr->header.frame_id, cloudS_ptr->front().device_id))
-//        return;
+/*----------------------------------------------------------------------------
+ *  Called by cPointCloudParser
+ *---------------------------------------------------------------------------*/
+void cPointCloud2Slam::onCoordinateSystem(pointcloud::eCOORDINATE_SYSTEM config_param) {}
+void cPointCloud2Slam::onKinematicModel(pointcloud::eKINEMATIC_MODEL model) {}
+void cPointCloud2Slam::onSensorAngles(double pitch_deg, double roll_deg, double yaw_deg)
+{
+    mMountAngles.pitch_deg = pitch_deg;
+    mMountAngles.roll_deg = roll_deg;
+    mMountAngles.yaw_deg = yaw_deg;
+}
+
+void cPointCloud2Slam::onKinematicSpeed(double vx_mps, double vy_mps, double vz_mps) {}
+
+void cPointCloud2Slam::onDimensions(double x_min_m, double x_max_m,
+    double y_min_m, double y_max_m, double z_min_m, double z_max_m) {}
+
+void cPointCloud2Slam::onImuData(pointcloud::imu_data_t data) {}
+
+void cPointCloud2Slam::onReducedPointCloudByFrame(uint16_t frameID, uint64_t timestamp_ns, cReducedPointCloudByFrame pointCloud)
+{
+}
+
+void cPointCloud2Slam::onSensorPointCloudByFrame(uint16_t frameID, uint64_t timestamp_ns, cSensorPointCloudByFrame pointCloud)
+{
+    if (mStopped)
+        return;
+
+    // The frames of the checkpoint the run resumed from are already in the SLAM
+    if (mSkipFrames > 0)
+    {
+        --mSkipFrames;
+        mDollySamples.clear();
+        mReadResumed = std::chrono::steady_clock::now();
+        return;
+    }
+
+    // The reader stage is busy from the end of one push to the start of the next
+    mReadTiming.busy_us += elapsed_us(mReadResumed);
+    ++mReadTiming.frames;
 
-    // Set the SLAM main input frame at first position
-//    mFrames.insert(mFrames.begin(), pFrame);
+    auto frame = std::make_unique<sSensorFrame>();
+    frame->frameID = frameID;
+    frame->timestamp_ns = timestamp_ns;
+    frame->pointCloud = std::move(pointCloud);
+    frame->dolly = std::move(mDollySamples);
+    frame->mountAngles = mMountAngles;
 
-    // Run SLAM : register new frame and update localization and map.
-    mLidarSlam.AddFrame(frame);
+    mDollySamples.clear();
+
+    // Blocks while the conversion stage is behind, fails once it has stopped
+    if (!mSensorFrames.push(std::move(frame)))
+    {
+        mStopped = true;
+        return;
+    }
+
+    mReadResumed = std::chrono::steady_clock::now();
 }
 
 void cPointCloud2Slam::onPointCloudData(cPointCloud pointCloud)
@@ -344,6 +775,17 @@ void cPointCloud2Slam::onPosition(spidercam::sPosition_1_t pos)
 {
 //    mResyncTimestamp = true;
 
+    if (mDollyPriorEnabled)
+    {
+        sDollySample sample;
+        sample.x_mm = pos.X_mm;
+        sample.y_mm = pos.Y_mm;
+        sample.z_mm = pos.Z_mm;
+        sample.gps = false;
+
+        mDollySamples.push_back(sample);
+    }
+
     float4 xyz;
     xyz.x = pos.X_mm / 1000.0;
     xyz.y = pos.Y_mm / 1000.0;
@@ -358,20 +800,45 @@ void cPointCloud2Slam::onPosition(spidercam::sPosition_1_t pos)
  *---------------------------------------------------------------------------*/
 void cPointCloud2Slam::onPVT_Cartesian(ssnx::gps::PVT_Cartesian_1_t pos) {}
 void cPointCloud2Slam::onPVT_Cartesian(ssnx::gps::PVT_Cartesian_2_t pos) {}
-void cPointCloud2Slam::onPVT_Geodetic(ssnx::gps::PVT_Geodetic_1_t pos) {}
+void cPointCloud2Slam::onPVT_Geodetic(ssnx::gps::PVT_Geodetic_1_t pos)
+{
+    if (!pos.dataValid || !mDollyPriorEnabled) return;
+
+    auto point = rfb::fromGPS(pos.Lat_rad, pos.Lon_rad, pos.Alt_m);
+
+    sDollySample sample;
+    sample.x_mm = point.x_mm;
+    sample.y_mm = point.y_mm;
+    sample.z_mm = point.z_mm;
+    sample.variance_mm2 = mGpsVariance_mm2;
+    sample.gps = true;
+
+    mDollySamples.push_back(sample);
+}
 
 void cPointCloud2Slam::onPVT_Geodetic(ssnx::gps::PVT_Geodetic_2_t pos) 
 {
-    if (!pos.dataValid) return;
+    if (!pos.dataValid || !mDollyPriorEnabled) return;
+
+    double elevation_m = pos.Height_m - pos.Undulation_m;
+    auto point = rfb::fromGPS(pos.Lat_rad, pos.Lon_rad, elevation_m);
+
+    sDollySample sample;
+    sample.x_mm = point.x_mm;
+    sample.y_mm = point.y_mm;
+    sample.z_mm = point.z_mm;
+    sample.variance_mm2 = mGpsVariance_mm2;
+    sample.gps = true;
 
-    auto n = pos.Ve_mps;
+    mDollySamples.push_back(sample);
 }
 
 void cPointCloud2Slam::onPosCovGeodetic(ssnx::gps::PosCovGeodetic_1_t cov)
 {
     if (!cov.dataValid) return;
 
-    auto n = cov.Cov_latlat_m2;
+    // The horizontal variance is used for every axis of the positions that follow
+    mGpsVariance_mm2 = cov.Cov_latlat_m2 * nConstants::M2_TO_MM2;
 }
 
 void cPointCloud2Slam::onVelCovGeodetic(ssnx::gps::VelCovGeodetic_1_t cov)
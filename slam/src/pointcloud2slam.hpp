@@ -4,18 +4,52 @@
 #include "PointCloudParser.hpp"
 #include "PointCloud.hpp"
 #include "Slam.h"
+#include "DollyPrior.hpp"
+#include "TiledMapStore.hpp"
+
+#include "BoundedQueue.hpp"
 
 #include <cbdf/SpidercamParser.hpp>
 #include <cbdf/SsnxParser.hpp>
 
 #include <pcl/PCLHeader.h>
 
+#include <atomic>
+#include <chrono>
 #include <filesystem>
 #include <string>
 #include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 
+/**
+ * Runs the LiDAR SLAM over the point clouds of a ceres file as a pipeline of
+ * stages connected by bounded queues:
+ *
+ *  - the reader stage is the thread that parses the file, it queues each
+ *    decoded sensor frame,
+ *  - the conversion stage builds the SLAM point cloud of a frame and extracts
+ *    its keypoints, running ahead of the pose estimation,
+ *  - the pose estimation stage adds the frame and its keypoints to the SLAM,
+ *  - the map stage, when the map is written, adds the registered points of
+ *    each frame to the tiled map store.
+ *
+ * A full queue blocks the stage that feeds it.  The frame rate that each
+ * stage could sustain on its own is reported periodically, so the slowest
+ * stage shows which one limits the pipeline.
+ *
+ * With the dolly prior, the conversion stage also predicts the pose of each
+ * frame from the dolly positions read before it, and the SLAM starts its
+ * ego-motion and localization from that pose.
+ *
+ * With checkpoints, the SLAM maps and pose are saved every few frames, once
+ * the map tiles of those frames are on disk, so that an interrupted run can
+ * resume from the last checkpoint instead of the start of the file.
+ */
 class cPointCloud2Slam : 
     public cPointCloudParser,   // <-- Read pointcloud data from ceres file
     public cSpidercamParser,    // <-- Read SpiderCam control/status data from ceres file
@@ -30,6 +64,52 @@ public:
 
     void setOutputPath(std::filesystem::path out);
 
+    /**
+     * Select how the voxels of the SLAM maps are stored.
+     */
+    void setVoxelGridStorage(LidarSlam::VoxelGridStorage storage);
+
+    /**
+     * Seed the pose of each frame from the SpiderCam, or GPS, positions of
+     * the dolly and limit the localization to the uncertainty of that pose.
+     */
+    void setDollyPrior(bool enable);
+
+    /**
+     * Write the registered points as map tiles next to the output path and
+     * merge them into <output>.map.ply at the end.  The map keeps one point
+     * per voxel of the given size.
+     */
+    void setMapOutput(bool enable, double voxelSize_m);
+
+    /**
+     * Save the SLAM state every given number of frames, 0 to disable.
+     */
+    void setCheckpointInterval(uint32_t frames);
+
+    /**
+     * Start from the last checkpoint of the output path, if there is one,
+     * skipping the frames it covers.
+     */
+    void setResume(bool resume);
+
+    /**
+     * Start the conversion and pose estimation stages.
+     */
+    void start();
+
+    /**
+     * Wait for the frames already read to go through the pipeline and stop
+     * the stages.
+     */
+    void finish();
+
+    /**
+     * Returns true once a stage has stopped on an error, the rest of the
+     * file does not need to be read.
+     */
+    bool stopped() const;
+
     uint32_t mLidarFrameId = 0;
 
 private:
@@ -55,6 +135,18 @@ private:
      */
     bool updateBaseToLidarOffset(uint32_t lidarFrameId, uint8_t lidarDeviceId);
 
+    /*----------------------------------------------------------------------------
+     *  Pipeline stages
+     */
+    void convertFrames();
+    void estimatePoses();
+    void storeMap();
+
+    CloudS::Ptr convert(uint16_t frameID, uint64_t timestamp_ns, const cSensorPointCloudByFrame& pointCloud);
+
+    void stop(const std::string& error);
+    void reportThroughput();
+
 private:
     /*----------------------------------------------------------------------------
      *  Called by cPointCloudParser
@@ -111,6 +203,131 @@ private:
     bool mTimestampFirstPacket = false;
 
     LidarSlam::Slam mLidarSlam;
+
+    /// Runs on the conversion stage, separate from the extractor of the SLAM
+    std::shared_ptr<LidarSlam::SpinningSensorKeypointExtractor> mKeypointExtractor;
+    std::vector<LidarSlam::Keypoint> mKeypointTypes;
+
+    struct sSensorFrame
+    {
+        uint16_t frameID = 0;
+        uint64_t timestamp_ns = 0;
+        cSensorPointCloudByFrame pointCloud;
+
+        /// The dolly positions read since the previous frame
+        std::vector<sDollySample> dolly;
+        kdt::sDollyAtitude_t mountAngles;
+    };
+
+    struct sSlamFrame
+    {
+        CloudS::Ptr cloud;
+        std::map<LidarSlam::Keypoint, CloudS::Ptr> keypoints;
+
+        bool hasPrior = false;
+        LidarSlam::ExternalSensors::PoseMeasurement prior;
+    };
+
+    /// The state of the SLAM after a number of frames
+    struct sCheckpoint
+    {
+        uint32_t frames = 0;
+        uint64_t startTimestamp_ns = 0;
+        std::string mapsPrefix;
+        Eigen::Isometry3d pose = Eigen::Isometry3d::Identity();
+    };
+
+    struct sMapFrame
+    {
+        /// The registered points, in world coordinates
+        CloudS::Ptr cloud;
+        Eigen::Vector3d sensor_m = Eigen::Vector3d::Zero();
+
+        /// Written once the tiles of the frames before it are on disk
+        bool hasCheckpoint = false;
+        sCheckpoint checkpoint;
+    };
+
+    /**
+     * Saves the SLAM maps, on the pose estimation stage.  Each checkpoint
+     * saves its maps to files named after its frame number, so the maps of
+     * the last complete checkpoint survive until the next one is written.
+     */
+    sCheckpoint saveCheckpoint(uint32_t frames);
+
+    /**
+     * Writes the checkpoint file, on the map stage, once the maps and tiles
+     * it refers to are on disk, then removes the maps of the checkpoint it
+     * replaces.
+     */
+    void writeCheckpoint(const sCheckpoint& checkpoint);
+
+    /**
+     * Removes the map files saved with a prefix.
+     */
+    void removeMaps(const std::string& mapsPrefix);
+
+    /**
+     * Restores the SLAM from the checkpoint file, if there is one.
+     */
+    bool loadCheckpoint();
+
+    std::filesystem::path checkpointFile() const;
+
+    /// The frames and the time spent working, not waiting on a queue, by a stage
+    struct sStageTiming
+    {
+        std::atomic<uint32_t> frames{0};
+        std::atomic<int64_t>  busy_us{0};
+    };
+
+    cBoundedQueue<std::unique_ptr<sSensorFrame>> mSensorFrames;
+    cBoundedQueue<sSlamFrame> mSlamFrames;
+    cBoundedQueue<sMapFrame> mMapFrames;
+
+    std::thread mConversionThread;
+    std::thread mPoseThread;
+    std::thread mMapThread;
+
+    sStageTiming mReadTiming;
+    sStageTiming mConversionTiming;
+    sStageTiming mPoseTiming;
+    sStageTiming mMapTiming;
+
+    std::chrono::steady_clock::time_point mStartTime;
+    std::chrono::steady_clock::time_point mReadResumed;
+
+    std::mutex  mErrorMutex;
+    std::string mError;
+    std::atomic<bool> mStopped{false};
+
+    /// The dolly prior, read on the reader stage and used on the conversion stage
+    bool mDollyPriorEnabled = false;
+    cDollyPrior mDollyPrior;
+    std::vector<sDollySample> mDollySamples;
+    kdt::sDollyAtitude_t mMountAngles;
+    double mGpsVariance_mm2 = 0.0;
+
+    /// The ICP iterations of the frames localized from a dolly prior
+    std::atomic<uint32_t> mPriorFrames{0};
+    std::atomic<uint64_t> mPriorIcpIterations{0};
+
+    /// The map tiles, used by the map stage only
+    bool mMapEnabled = false;
+    cTiledMapStore mMapStore;
+    std::atomic<std::size_t> mMapTilesInMemory{0};
+
+    uint32_t mCheckpointInterval = 0;
+    bool mResume = false;
+
+    /// The maps of the checkpoint file on disk, used by the map stage only
+    std::string mCommittedMapsPrefix;
+
+    /// The frames covered by the checkpoint the run resumed from
+    uint32_t mResumedFrames = 0;
+
+    /// The frames of the file still to skip, on the reader stage
+    uint32_t mSkipFrames = 0;
 //    PointS
 //    pcl::PointCloud<LidarSlam::LidarPoint> mFrame;
     std::vector<CloudS::Ptr> mFrames;
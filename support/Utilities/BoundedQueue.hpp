@@ -0,0 +1,105 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+
+/**
+ * A first-in first-out queue with a fixed capacity used to pass work
+ * between the threads of a processing pipeline.
+ *
+ * push() blocks while the queue is full, which keeps a fast producer from
+ * running too far ahead of a slow consumer.  pop() blocks while the queue
+ * is empty.  Once close() is called, push() fails and pop() returns the
+ * remaining items before failing.
+ */
+template<typename T>
+class cBoundedQueue
+{
+public:
+	explicit cBoundedQueue(std::size_t capacity) : mCapacity(capacity > 0 ? capacity : 1)
+	{}
+
+	cBoundedQueue(const cBoundedQueue&) = delete;
+	cBoundedQueue& operator=(const cBoundedQueue&) = delete;
+
+	/**
+	 * Adds an item to the back of the queue, waiting for space if needed.
+	 * Returns false if the queue has been closed.
+	 */
+	bool push(T item)
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mNotFull.wait(lock, [this] { return mClosed || (mItems.size() < mCapacity); });
+
+		if (mClosed)
+			return false;
+
+		mItems.push_back(std::move(item));
+		lock.unlock();
+
+		mNotEmpty.notify_one();
+		return true;
+	}
+
+	/**
+	 * Removes an item from the front of the queue, waiting for one if needed.
+	 * Returns false once the queue has been closed and is empty.
+	 */
+	bool pop(T& item)
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mNotEmpty.wait(lock, [this] { return mClosed || !mItems.empty(); });
+
+		if (mItems.empty())
+			return false;
+
+		item = std::move(mItems.front());
+		mItems.pop_front();
+		lock.unlock();
+
+		mNotFull.notify_one();
+		return true;
+	}
+
+	/**
+	 * Signals that no more items will be added and wakes all waiting threads.
+	 */
+	void close()
+	{
+		{
+			std::lock_guard<std::mutex> guard(mMutex);
+			mClosed = true;
+		}
+
+		mNotFull.notify_all();
+		mNotEmpty.notify_all();
+	}
+
+	bool closed() const
+	{
+		std::lock_guard<std::mutex> guard(mMutex);
+		return mClosed;
+	}
+
+	std::size_t size() const
+	{
+		std::lock_guard<std::mutex> guard(mMutex);
+		return mItems.size();
+	}
+
+	std::size_t capacity() const { return mCapacity; }
+
+private:
+	const std::size_t mCapacity;
+
+	mutable std::mutex mMutex;
+	std::condition_variable mNotFull;
+	std::condition_variable mNotEmpty;
+
+	std::deque<T> mItems;
+	bool mClosed = false;
+};